@@ -0,0 +1,177 @@
+package com.example.biobanddisplay
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import com.chaquo.python.PyObject
+import com.chaquo.python.Python
+import com.chaquo.python.android.AndroidPlatform
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+import kotlin.math.PI
+import kotlin.math.cos
+import kotlin.math.ln
+import kotlin.math.roundToInt
+import kotlin.math.sin
+import kotlin.math.sqrt
+
+/**
+ * Checks the native EMG engine (EmgDsp) against emg_analyzer.py, which
+ * stays the reference.
+ *
+ * The engine is causal where Python works on the whole buffer, so the
+ * results are close rather than equal (see src/main/cpp/emg_dsp.h):
+ *   - Bursts start and end up to one moving-average window later, because
+ *     the engine's average trails where np.convolve(mode='same') is centred.
+ *   - Burst Vrms and mean frequency agree within a few percent.
+ *   - The idle figures cover the last second, so they are compared with
+ *     analyze_EMG_array() on that second.
+ *
+ * The burst signal sits on a DC offset like the ADC's. Python removes the
+ * mean of its whole buffer, and without an offset the rectified rest
+ * between bursts stays above the threshold on long recordings.
+ *
+ * Also prints the cost per 100-sample packet of both.
+ */
+@RunWith(AndroidJUnit4::class)
+class EmgDspEquivalenceTest {
+
+    private val fs = 4000f
+    private val window = (0.150 * fs).toInt()
+
+    private lateinit var analyzer: PyObject
+    private lateinit var emgAnalyzer: PyObject
+    private lateinit var np: PyObject
+
+    @Before
+    fun startPython() {
+        if (!Python.isStarted()) {
+            Python.start(AndroidPlatform(InstrumentationRegistry.getInstrumentation().targetContext))
+        }
+        val python = Python.getInstance()
+        analyzer = python.getModule("analyzer")
+        emgAnalyzer = python.getModule("emg_analyzer")
+        np = python.getModule("numpy")
+    }
+
+    // xorshift and Box-Muller, so the signal does not depend on the platform's Random
+    private class Rng(private var s: Long) {
+        fun uniform(): Double = ((next() ushr 11) + 1).toDouble() / (1L shl 53).toDouble()
+        fun gauss(): Double = sqrt(-2.0 * ln(uniform())) * cos(2.0 * PI * uniform())
+        private fun next(): Long {
+            s = s xor (s shl 13)
+            s = s xor (s ushr 7)
+            s = s xor (s shl 17)
+            return s
+        }
+    }
+
+    private class Span(val startS: Double, val endS: Double, val amplitude: Double)
+
+    /** Noise and 60 Hz hum on [dc], plus bursts of noise around 120 Hz with the given RMS. */
+    private fun synth(seconds: Int, bursts: List<Span>, seed: Long, dc: Double): FloatArray {
+        val rng = Rng(seed)
+        // Resonator at 120 Hz, scaled to unit RMS
+        val r = 0.97
+        val a1 = -2 * r * cos(2 * PI * 120 / fs)
+        val a2 = r * r
+        var z1 = 0.0
+        var z2 = 0.0
+        return FloatArray(seconds * fs.toInt()) { i ->
+            var v = rng.gauss() + 20 * sin(2 * PI * 60 * i / fs) + dc
+            val y = 0.065 * rng.gauss() - a1 * z1 - a2 * z2
+            z2 = z1
+            z1 = y
+            val t = i / fs.toDouble()
+            for (b in bursts) if (t >= b.startS && t < b.endS) v += b.amplitude * y
+            v.roundToInt().toFloat()
+        }
+    }
+
+    private fun toNumpy(x: FloatArray): PyObject =
+        np.callAttr("abs", np.callAttr("array", PyObject.fromJava(DoubleArray(x.size) { x[it].toDouble() })))
+
+    private fun runEngine(x: FloatArray, chunk: Int): EmgDsp {
+        val dsp = EmgDsp(fs)
+        var i = 0
+        while (i < x.size) {
+            val n = minOf(chunk, x.size - i)
+            dsp.push(x.copyOfRange(i, i + n), n)
+            i += n
+        }
+        return dsp
+    }
+
+    @Test
+    fun burstsMatchPython() {
+        val x = synth(20, listOf(Span(2.0, 5.0, 400.0), Span(8.0, 10.5, 800.0), Span(13.0, 16.0, 250.0)),
+            seed = 1, dc = 2000.0)
+        val expected = emgAnalyzer.callAttr("burst_table", toNumpy(x), fs).asList()
+            .map { row -> row.asList().map { it.toDouble() } }
+        val actual = runEngine(x, 100).use { it.burstTable() }
+
+        assertEquals(3, expected.size)
+        assertEquals(expected.size, actual.size)
+        for ((py, native) in expected.zip(actual)) {
+            assertTrue("start ${native[0]} vs ${py[0]}", native[0] - py[0] in 0.0..window.toDouble())
+            assertTrue("end ${native[1]} vs ${py[1]}", native[1] - py[1] in 0.0..2.0 * window)
+            assertEquals(py[2], native[2], py[2] * 0.10)
+            assertEquals(py[3], native[3], py[3] * 0.05)
+        }
+    }
+
+    @Test
+    fun idleWindowMatchesPython() {
+        val x = synth(4, emptyList(), seed = 3, dc = 0.0)
+        val last = x.copyOfRange(x.size - fs.toInt(), x.size)
+        val py = emgAnalyzer.callAttr("analyze_EMG_array", toNumpy(last), fs).asMap()
+        val vrms = py[PyObject.fromJava("vrms")]!!.toDouble()
+        val tdmf = py[PyObject.fromJava("tdmf")]!!.toDouble()
+
+        runEngine(x, 100).use { dsp ->
+            assertTrue(dsp.isResting)
+            assertEquals(vrms, dsp.vrms.toDouble(), vrms * 0.02)
+            assertEquals(tdmf, dsp.meanFrequency.toDouble(), tdmf * 0.05)
+        }
+    }
+
+    @Test
+    fun resultsDoNotDependOnPacketSize() {
+        val x = synth(12, listOf(Span(2.0, 5.0, 400.0), Span(7.0, 9.0, 600.0)), seed = 5, dc = 2000.0)
+        val results = listOf(1, 100, 997).map { chunk ->
+            runEngine(x, chunk).use { dsp ->
+                listOf(dsp.vrms, dsp.meanFrequency, dsp.envelope, dsp.bursts.toFloat()) +
+                    dsp.burstTable().flatMap { row -> row.map { it.toFloat() } }
+            }
+        }
+        assertEquals(results[0], results[1])
+        assertEquals(results[0], results[2])
+    }
+
+    @Test
+    fun costPerPacket() {
+        val x = synth(10, listOf(Span(2.0, 5.0, 400.0)), seed = 7, dc = 2000.0)
+        val packet = 100
+        val packets = x.size / packet
+
+        val dsp = EmgDsp(fs)
+        val buf = FloatArray(packet)
+        var start = System.nanoTime()
+        for (p in 0 until packets) {
+            System.arraycopy(x, p * packet, buf, 0, packet)
+            dsp.push(buf, packet)
+        }
+        val nativeUs = (System.nanoTime() - start) / 1e3 / packets
+        dsp.close()
+
+        // What RealTimeActivity did before: one process_ble_data() call per text packet
+        val lines = List(packets) { p -> (0 until packet).joinToString(",") { x[p * packet + it].toInt().toString() } }
+        start = System.nanoTime()
+        for (line in lines) analyzer.callAttr("process_ble_data", line)
+        val pythonUs = (System.nanoTime() - start) / 1e3 / packets
+
+        println("EMG analysis per %d-sample packet: native %.1f us, python %.1f us".format(packet, nativeUs, pythonUs))
+        assertTrue(nativeUs < pythonUs)
+    }
+}
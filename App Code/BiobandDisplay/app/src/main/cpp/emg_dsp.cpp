@@ -0,0 +1,297 @@
+/*
+ * Streaming EMG analysis. See emg_dsp.h.
+ */
+#include "emg_dsp.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace emg {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+uint32_t log2_exact(uint32_t n)
+{
+    uint32_t bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+}  // namespace
+
+void Biquad::set(double b0, double b1, double b2, double a1, double a2)
+{
+    b0_ = b0;
+    b1_ = b1;
+    b2_ = b2;
+    a1_ = a1;
+    a2_ = a2;
+}
+
+void Biquad::prime(double x)
+{
+    z2_ = (b2_ - a2_) * x;
+    z1_ = (b1_ - a1_) * x + z2_;
+}
+
+Engine::Engine(const Config &cfg) : cfg_(cfg)
+{
+    /* Same arithmetic as scipy.signal.iirnotch() */
+    double w0 = kPi * 2.0 * cfg_.notch_hz / cfg_.fs;
+    double beta = std::tan(w0 / cfg_.notch_q / 2.0);
+    double gain = 1.0 / (1.0 + beta);
+    for (Biquad &b : notch_) {
+        b.set(gain, -2.0 * gain * std::cos(w0), gain, -2.0 * gain * std::cos(w0), 2.0 * gain - 1.0);
+    }
+
+    dc_len_ = std::max<uint32_t>(1, static_cast<uint32_t>(cfg_.dc_s * cfg_.fs));
+    mov_ring_.assign(std::max(1, static_cast<int>(cfg_.mov_avg_s * cfg_.fs)), 0.0f);
+    win_ring_.assign(std::max<uint32_t>(1, static_cast<uint32_t>(cfg_.window_s * cfg_.fs)), 0.0f);
+
+    const uint32_t n = cfg_.fft_size;
+    const uint32_t bits = log2_exact(n);
+    fft_ring_.assign(n, 0.0f);
+    buf_.resize(n);
+    hann_.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        hann_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / n));
+    }
+    twiddle_.resize(n / 2);
+    for (uint32_t i = 0; i < n / 2; i++) {
+        twiddle_[i] = std::polar(1.0f, static_cast<float>(-2.0 * kPi * i / n));
+    }
+    bitrev_.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        bitrev_[i] = r;
+    }
+    bin_low_ = static_cast<uint32_t>(std::ceil(cfg_.f_low * n / cfg_.fs));
+    bin_high_ = std::min(n / 2, static_cast<uint32_t>(std::floor(cfg_.f_high * n / cfg_.fs)));
+
+    size_t frames = static_cast<size_t>(std::ceil(win_ring_.size() / double(cfg_.hop))) +
+                    cfg_.end_hold / cfg_.hop + 2;
+    frames_.resize(frames);
+
+    reset();
+}
+
+void Engine::reset()
+{
+    n_ = 0;
+    dc_n_ = 0;
+    mean_ = 0;
+    std::fill(mov_ring_.begin(), mov_ring_.end(), 0.0f);
+    mov_pos_ = 0;
+    mov_sum_ = 0;
+    std::fill(win_ring_.begin(), win_ring_.end(), 0.0f);
+    win_pos_ = 0;
+    win_sumsq_ = 0;
+    std::fill(fft_ring_.begin(), fft_ring_.end(), 0.0f);
+    fft_pos_ = 0;
+    since_frame_ = 0;
+    frame_pos_ = 0;
+    frame_count_ = 0;
+    logging_ = false;
+    below_ = 0;
+    burst_sumsq_ = 0;
+    burst_n_ = 0;
+    burst_fp_ = burst_p_ = 0;
+    have_burst_ = false;
+    bursts_.clear();
+    burst_total_ = 0;
+    result_ = Result();
+}
+
+void Engine::push(const float *samples, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        step(samples[i]);
+    }
+    update_result();
+}
+
+void Engine::step(float raw)
+{
+    const uint64_t i = n_;
+    const double x = std::fabs(raw);
+
+    if (i == 0) {
+        for (Biquad &b : notch_) {
+            b.prime(x);
+        }
+    }
+    const double y = notch_[1].step(notch_[0].step(x));
+
+    if (dc_n_ < dc_len_) {
+        dc_n_++;
+    }
+    mean_ += (y - mean_) / dc_n_;
+    double r = std::fabs(y - mean_);
+    if (r < cfg_.noise_floor) {
+        r = 0;
+    }
+
+    /* Running sums are recomputed once per ring turn so rounding cannot build up */
+    mov_sum_ += r - mov_ring_[mov_pos_];
+    mov_ring_[mov_pos_] = static_cast<float>(r);
+    if (++mov_pos_ == mov_ring_.size()) {
+        mov_pos_ = 0;
+        mov_sum_ = 0;
+        for (float v : mov_ring_) {
+            mov_sum_ += v;
+        }
+    }
+    const double mov = mov_sum_ / mov_ring_.size();
+    result_.envelope = static_cast<float>(mov);
+
+    const double old = win_ring_[win_pos_];
+    win_sumsq_ += y * y - old * old;
+    win_ring_[win_pos_] = static_cast<float>(y);
+    if (++win_pos_ == win_ring_.size()) {
+        win_pos_ = 0;
+        win_sumsq_ = 0;
+        for (float v : win_ring_) {
+            win_sumsq_ += double(v) * v;
+        }
+    }
+
+    fft_ring_[fft_pos_] = static_cast<float>(y);
+    fft_pos_ = (fft_pos_ + 1) % fft_ring_.size();
+    n_++;
+    /* Frames start at 0, hop, 2 hop, ... as with stft(boundary=None, padded=False) */
+    if (n_ >= cfg_.fft_size) {
+        if (since_frame_ == 0) {
+            spectrum_frame();
+        }
+        since_frame_ = (since_frame_ + 1) % cfg_.hop;
+    }
+
+    /* detectBursts(), one sample at a time */
+    if (!logging_ && mov > cfg_.threshold) {
+        logging_ = true;
+        start_ = i;
+        below_ = 0;
+        burst_sumsq_ = 0;
+        burst_n_ = 0;
+        burst_fp_ = burst_p_ = 0;
+    } else if (logging_) {
+        burst_sumsq_ += r * r;
+        burst_n_++;
+        below_ = mov < cfg_.threshold ? below_ + 1 : 0;
+        if (below_ >= cfg_.end_hold) {
+            end_burst(i - cfg_.end_hold);
+        }
+    }
+}
+
+void Engine::spectrum_frame()
+{
+    const uint32_t n = cfg_.fft_size;
+
+    /* fft_pos_ is the oldest sample */
+    for (uint32_t k = 0; k < n; k++) {
+        buf_[bitrev_[k]] = std::complex<float>(fft_ring_[(fft_pos_ + k) % n] * hann_[k], 0.0f);
+    }
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        const uint32_t half = len / 2;
+        const uint32_t step = n / len;
+        for (uint32_t base = 0; base < n; base += len) {
+            for (uint32_t k = 0; k < half; k++) {
+                std::complex<float> t = twiddle_[k * step] * buf_[base + k + half];
+                buf_[base + k + half] = buf_[base + k] - t;
+                buf_[base + k] += t;
+            }
+        }
+    }
+
+    Frame f{n_ - n / 2, 0.0, 0.0};
+    for (uint32_t k = bin_low_; k <= bin_high_; k++) {
+        double p = std::norm(buf_[k]);
+        f.fp += p * k * cfg_.fs / n;
+        f.p += p;
+    }
+
+    frames_[frame_pos_] = f;
+    frame_pos_ = (frame_pos_ + 1) % frames_.size();
+    frame_count_ = std::min(frame_count_ + 1, frames_.size());
+
+    if (logging_ && f.centre >= start_) {
+        burst_fp_ += f.fp;
+        burst_p_ += f.p;
+    }
+}
+
+void Engine::end_burst(uint64_t end)
+{
+    logging_ = false;
+    below_ = 0;
+    if (burst_n_ < cfg_.min_burst) {
+        return;
+    }
+
+    /* The frames of the hold time after the end are not part of the burst */
+    double fp = burst_fp_, p = burst_p_;
+    for (size_t k = 1; k <= frame_count_; k++) {
+        const Frame &f = frames_[(frame_pos_ + frames_.size() - k) % frames_.size()];
+        if (f.centre <= end) {
+            break;
+        }
+        if (f.centre >= start_) {
+            fp -= f.fp;
+            p -= f.p;
+        }
+    }
+
+    Burst b;
+    b.start = start_;
+    b.end = end;
+    b.vrms = static_cast<float>(std::sqrt(burst_sumsq_ / burst_n_));
+    b.mean_freq = p > 0 ? static_cast<float>(fp / p) : 0.0f;
+    if (bursts_.size() == kBurstHistory) {
+        bursts_.erase(bursts_.begin());
+    }
+    bursts_.push_back(b);
+    burst_total_++;
+    have_burst_ = true;
+    last_end_sample_ = n_;
+}
+
+void Engine::update_result()
+{
+    const uint64_t window = win_ring_.size();
+
+    /* Idle figures: RMS of the filtered signal and the frames of the last window */
+    double fp = 0, p = 0;
+    for (size_t k = 1; k <= frame_count_; k++) {
+        const Frame &f = frames_[(frame_pos_ + frames_.size() - k) % frames_.size()];
+        if (f.centre + window < n_) {
+            break;
+        }
+        fp += f.fp;
+        p += f.p;
+    }
+    const float idle_mnf = p > 0 ? static_cast<float>(fp / p) : 0.0f;
+    const float idle_vrms = n_ ? static_cast<float>(std::sqrt(win_sumsq_ / std::min(n_, window))) : 0.0f;
+
+    const bool recent = have_burst_ &&
+                        n_ - last_end_sample_ <= static_cast<uint64_t>(cfg_.report_hold_s * cfg_.fs);
+    if (recent) {
+        result_.vrms = bursts_.back().vrms;
+        result_.mean_freq = bursts_.back().mean_freq > 0 ? bursts_.back().mean_freq : idle_mnf;
+    } else {
+        result_.vrms = idle_vrms;
+        result_.mean_freq = idle_mnf;
+    }
+    result_.logging = logging_;
+    result_.resting = !(recent || logging_);
+    result_.bursts = burst_total_;
+}
+
+}  // namespace emg
@@ -0,0 +1,176 @@
+/*
+ * Streaming EMG analysis, the incremental counterpart of
+ * src/main/python/emg_analyzer.py.
+ *
+ * analyze_EMG_array() filters, rectifies and transforms its whole buffer on
+ * every call. This engine keeps the filter, moving-average and spectrum
+ * state between calls, so push() costs a fixed amount per new sample. The
+ * stages match the Python ones:
+ *
+ *   - process_ble_data() takes abs() of the raw values, so push() does too.
+ *   - Notch: iirnotch(notch_hz, notch_q). filtfilt() is zero phase, which
+ *     a stream cannot be. The same biquad runs twice, forward only. That
+ *     gives the same magnitude response, and the spectrum and RMS depend
+ *     only on magnitude.
+ *   - Mean removal: an exponential average with a time constant of dc_s
+ *     seconds instead of the mean of the whole buffer. For the first dc_s
+ *     seconds it is the exact running mean.
+ *   - Rectification and the micro noise floor as in Python.
+ *   - Moving average over mov_avg_s. It trails by half its window where
+ *     np.convolve(mode='same') is centred.
+ *   - Burst detection: the detectBursts() state machine, one sample at a
+ *     time.
+ *   - Mean frequency: Hann-windowed FFTs of fft_size samples every hop
+ *     samples, like the STFT in stftMeanFrequency(). A burst's mean
+ *     frequency is taken over the frames inside it, and the idle figure
+ *     over the last window_s seconds.
+ *
+ * Results follow analyze_EMG_array(). Right after a burst ends, vrms and
+ * mean_freq are that burst's, for report_hold_s seconds. Otherwise they
+ * cover the last window_s seconds.
+ *
+ * Plain C++ with no Android dependency, so it also builds for the host.
+ */
+#ifndef EMG_DSP_H
+#define EMG_DSP_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace emg {
+
+/* Defaults are emg_analyzer.py's constants. Counts are in samples, as there. */
+struct Config {
+    float fs = 13333.0f;
+    float notch_hz = 60.0f;
+    float notch_q = 50.0f;
+    float mov_avg_s = 0.150f;       /* MOVING_AVG_S */
+    uint32_t end_hold = 800;        /* END_HOLD_SAMPLES */
+    uint32_t min_burst = 5000;      /* MIN_LOG_LENGTH */
+    float noise_floor = 3.0f;       /* MICRO_NOISE_FLOOR */
+    float threshold = 25.0f;
+    float f_low = 20.0f;
+    float f_high = 450.0f;
+    uint32_t fft_size = 2048;       /* STFT_WIN, a power of two */
+    uint32_t hop = 512;             /* STFT_WIN - STFT_OVERLAP */
+    float dc_s = 1.0f;
+    float window_s = 1.0f;
+    float report_hold_s = 2.0f;
+};
+
+struct Burst {
+    uint64_t start;                 /* sample index, as in startTimeLog */
+    uint64_t end;
+    float vrms;
+    float mean_freq;                /* 0 if the burst held no whole FFT frame */
+};
+
+struct Result {
+    float vrms = 0.0f;
+    float mean_freq = 0.0f;
+    bool resting = true;
+    bool logging = false;           /* inside a burst that has not ended yet */
+    float envelope = 0.0f;          /* latest moving average */
+    uint32_t bursts = 0;            /* bursts completed since reset() */
+};
+
+class Biquad {
+public:
+    void set(double b0, double b1, double b2, double a1, double a2);
+    /* Start in the steady state for a constant input x, as lfilter_zi does */
+    void prime(double x);
+    double step(double x)
+    {
+        double y = b0_ * x + z1_;
+        z1_ = b1_ * x - a1_ * y + z2_;
+        z2_ = b2_ * x - a2_ * y;
+        return y;
+    }
+
+private:
+    double b0_ = 1, b1_ = 0, b2_ = 0, a1_ = 0, a2_ = 0;
+    double z1_ = 0, z2_ = 0;
+};
+
+class Engine {
+public:
+    explicit Engine(const Config &cfg = Config());
+
+    void reset();
+    void push(const float *samples, size_t n);
+
+    const Result &result() const { return result_; }
+    const Config &config() const { return cfg_; }
+    /* Samples pushed since reset() */
+    uint64_t samples() const { return n_; }
+    /* The last completed bursts, oldest first, at most kBurstHistory */
+    const std::vector<Burst> &bursts() const { return bursts_; }
+
+    static constexpr size_t kBurstHistory = 32;
+
+private:
+    struct Frame {
+        uint64_t centre;
+        double fp;                  /* sum of f * P over the band */
+        double p;                   /* sum of P over the band */
+    };
+
+    void step(float x);
+    void spectrum_frame();
+    void end_burst(uint64_t end);
+    void update_result();
+
+    Config cfg_;
+    Biquad notch_[2];
+    uint64_t n_ = 0;
+
+    /* Mean removal */
+    uint32_t dc_len_;
+    uint32_t dc_n_ = 0;
+    double mean_ = 0;
+
+    /* Moving average of the rectified signal */
+    std::vector<float> mov_ring_;
+    size_t mov_pos_ = 0;
+    double mov_sum_ = 0;
+
+    /* Filtered signal for the idle RMS and the FFT */
+    std::vector<float> win_ring_;
+    size_t win_pos_ = 0;
+    double win_sumsq_ = 0;
+    std::vector<float> fft_ring_;
+    size_t fft_pos_ = 0;
+    uint32_t since_frame_ = 0;
+
+    /* FFT tables and scratch */
+    std::vector<float> hann_;
+    std::vector<std::complex<float>> twiddle_;
+    std::vector<uint32_t> bitrev_;
+    std::vector<std::complex<float>> buf_;
+    uint32_t bin_low_, bin_high_;
+
+    /* Recent spectrum frames; enough for window_s and for end_hold */
+    std::vector<Frame> frames_;
+    size_t frame_pos_ = 0;
+    size_t frame_count_ = 0;
+
+    /* detectBursts() state */
+    bool logging_ = false;
+    uint64_t start_ = 0;
+    uint32_t below_ = 0;
+    double burst_sumsq_ = 0;
+    uint64_t burst_n_ = 0;
+    double burst_fp_ = 0, burst_p_ = 0;
+    uint64_t last_end_sample_ = 0;
+    bool have_burst_ = false;
+
+    std::vector<Burst> bursts_;
+    uint32_t burst_total_ = 0;
+    Result result_;
+};
+
+}  // namespace emg
+
+#endif  // EMG_DSP_H
@@ -0,0 +1,91 @@
+/*
+ * JNI bindings for EmgDsp.kt. The handle is an emg::Engine owned by the
+ * Kotlin object.
+ */
+#include <jni.h>
+
+#include <algorithm>
+
+#include "emg_dsp.h"
+
+namespace {
+
+/* Layout of the result array, mirrored in EmgDsp.kt */
+enum ResultIndex {
+    RESULT_VRMS,
+    RESULT_MEAN_FREQ,
+    RESULT_RESTING,
+    RESULT_LOGGING,
+    RESULT_ENVELOPE,
+    RESULT_BURSTS,
+    RESULT_SIZE,
+};
+
+emg::Engine *engine(jlong handle)
+{
+    return reinterpret_cast<emg::Engine *>(handle);
+}
+
+}  // namespace
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_biobanddisplay_EmgDsp_nativeCreate(JNIEnv *, jobject, jfloat fs)
+{
+    emg::Config cfg;
+    cfg.fs = fs;
+    return reinterpret_cast<jlong>(new emg::Engine(cfg));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_biobanddisplay_EmgDsp_nativeDestroy(JNIEnv *, jobject, jlong handle)
+{
+    delete engine(handle);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_biobanddisplay_EmgDsp_nativeReset(JNIEnv *, jobject, jlong handle)
+{
+    engine(handle)->reset();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_biobanddisplay_EmgDsp_nativePush(JNIEnv *env, jobject, jlong handle,
+                                                  jfloatArray samples, jint count,
+                                                  jfloatArray out)
+{
+    /* Critical access avoids copying the samples; push() does not call back into Java */
+    auto *x = static_cast<jfloat *>(env->GetPrimitiveArrayCritical(samples, nullptr));
+    if (x == nullptr) {
+        return;
+    }
+    engine(handle)->push(x, static_cast<size_t>(count));
+    env->ReleasePrimitiveArrayCritical(samples, x, JNI_ABORT);
+
+    const emg::Result &r = engine(handle)->result();
+    jfloat v[RESULT_SIZE];
+    v[RESULT_VRMS] = r.vrms;
+    v[RESULT_MEAN_FREQ] = r.mean_freq;
+    v[RESULT_RESTING] = r.resting ? 1.0f : 0.0f;
+    v[RESULT_LOGGING] = r.logging ? 1.0f : 0.0f;
+    v[RESULT_ENVELOPE] = r.envelope;
+    v[RESULT_BURSTS] = static_cast<jfloat>(r.bursts);
+    env->SetFloatArrayRegion(out, 0, RESULT_SIZE, v);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_biobanddisplay_EmgDsp_nativeBursts(JNIEnv *env, jobject, jlong handle,
+                                                    jdoubleArray out)
+{
+    const std::vector<emg::Burst> &bursts = engine(handle)->bursts();
+    const jsize room = env->GetArrayLength(out) / 4;
+    const jsize n = std::min(room, static_cast<jsize>(bursts.size()));
+
+    for (jsize i = 0; i < n; i++) {
+        const emg::Burst &b = bursts[i];
+        const jdouble row[4] = {
+            static_cast<jdouble>(b.start), static_cast<jdouble>(b.end), b.vrms, b.mean_freq,
+        };
+        env->SetDoubleArrayRegion(out, 4 * i, 4, row);
+    }
+    return n;
+}
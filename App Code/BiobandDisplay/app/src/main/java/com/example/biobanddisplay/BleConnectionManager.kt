@@ -2,35 +2,118 @@ package com.example.biobanddisplay
 
 import android.annotation.SuppressLint
 import android.bluetooth.*
+import android.content.Context
+import android.os.BatteryManager
 import android.os.Build
 import android.os.Handler
+import android.os.HandlerThread
 import android.os.Looper
+import android.os.Process
+import android.os.SystemClock
 import android.util.Log
+import java.io.File
+import java.io.IOException
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.util.UUID
-import kotlin.text.Charsets
 
 // This Handler will run tasks on the main UI thread
 private val mainHandler = Handler(Looper.getMainLooper())
 
+// Decoded blocks are recorded and analysed on this thread, not the UI thread
+private val workerThread = HandlerThread("ble-worker").apply { start() }
+private val workerHandler = Handler(workerThread.looper)
+
 // Listener for connection state changes, implemented by MainActivity
 interface ConnectionStateListener {
     fun onConnectionStateChanged(state: Int, status: Int)
 }
 
-// A generic listener for incoming data, implemented by both Graph Activities
+// A generic listener for incoming data, implemented by both Graph Activities.
+// Called on the main thread.
 interface BleDataListener {
     fun onDataReceived(data: String)
+
+    // This channel's frames from one UI tick, with their samples decoded (see
+    // StreamIngest.kt). The block is only valid during the call. By default
+    // each frame is passed to onFrame.
+    fun onSamples(block: SampleBlock) {
+        block.forEachFrame { onFrame(it) }
+    }
+
+    // Binary stream frames (see StreamFrame.kt). The frame is only valid during
+    // the call. Listeners that still parse text get the samples as CSV.
+    fun onFrame(frame: StreamFrame) {
+        onDataReceived(frame.toCsv())
+    }
+
+    // Frames the device recorded while disconnected, sent after it reconnects.
+    // They are older than the live stream, so they are not fed to onSamples.
+    fun onBacklogSamples(block: SampleBlock) {
+        block.forEachFrame { onBacklogFrame(it) }
+    }
+
+    fun onBacklogFrame(frame: StreamFrame) {}
+
+    // The device changed this channel's stream tier (StreamProto.TIER_*)
+    // because of link capacity. Frames after this use the new tier.
+    fun onStreamTier(tier: Int, decimation: Int) {}
+
+    // A detected event opened (StreamProto.EVENT_BEGIN, samples = pre-trigger
+    // count) or closed (EVENT_END, samples = event length) on this channel.
+    fun onStreamEvent(id: Int, triggers: Int, phase: Int, samples: Int) {}
+}
+
+// What one connection's setup asked for and what the phone and device granted,
+// with the notifications received since. Set on the main thread, except the
+// notification counters, which the Binder callback updates.
+class LinkInfo(val optimized: Boolean, val connectedNs: Long) {
+    var mtu = 23            // the ATT default until onMtuChanged
+    var txPhy = 1           // BluetoothDevice.PHY_LE_1M
+    var rxPhy = 1
+    var highPriority = false
+    var subscriptions = 0
+    var setupMs = -1L
+    @Volatile var notifyPackets = 0L
+    @Volatile var notifyBytes = 0L
+
+    fun summary(): String = "%s: MTU %d, PHY %s/%s, %s priority, %d subscriptions, ready %d ms after connecting".format(
+        if (optimized) "optimised" else "defaults", mtu, phyName(txPhy), phyName(rxPhy),
+        if (highPriority) "high" else "balanced", subscriptions, setupMs)
+
+    /** Notification goodput since the connection was made. */
+    fun throughput(nowNs: Long): String {
+        val seconds = (nowNs - connectedNs) / 1e9
+        return "%d notifications, %d bytes in %.1f s (%.1f kB/s)".format(
+            notifyPackets, notifyBytes, seconds, notifyBytes / 1e3 / seconds.coerceAtLeast(1e-3))
+    }
+
+    private fun phyName(phy: Int) = when (phy) {
+        2 -> "2M"
+        3 -> "coded"
+        else -> "1M"
+    }
 }
 
 object BleConnectionManager {
     var gatt: BluetoothGatt? = null
 
-    // Listeners
+    // Listeners. The data listeners are set on the main thread and read on the worker.
     var connectionListener: ConnectionStateListener? = null
-    var emgDataListener: BleDataListener? = null
-    var ppgDataListener: BleDataListener? = null
-    var sweatDataListener: BleDataListener? = null
-    var testDataListener: BleDataListener? = null // New listener for Test Data
+    // MonitorService, which reconnects when the link drops
+    var serviceConnectionListener: ConnectionStateListener? = null
+    @Volatile var emgDataListener: BleDataListener? = null
+        set(value) { field = value; updateIngestInterval() }
+    @Volatile var ppgDataListener: BleDataListener? = null
+        set(value) { field = value; updateIngestInterval() }
+    @Volatile var sweatDataListener: BleDataListener? = null
+        set(value) { field = value; updateIngestInterval() }
+    @Volatile var testDataListener: BleDataListener? = null // New listener for Test Data
+        set(value) { field = value; updateIngestInterval() }
+
+    // Runs on the worker thread with every live block, before any screen gets
+    // it; this is where MonitorService analyses the stream
+    @Volatile var blockAnalysis: ((SampleBlock) -> Unit)? = null
 
     // GATT constants that must match your nRF52840 firmware
     // will need to change these UUID values based on the particular dongle that is being used
@@ -39,87 +122,777 @@ object BleConnectionManager {
     val NOTIFY_CHARACTERISTIC_UUID: UUID = UUID.fromString("d3d46a35-4394-e9aa-5ae7-921120aad4ed")
     private val CCCD_UUID: UUID = UUID.fromString("00002902-0000-1000-8000-00805f9b34fb")
 
+    // Time-sync service (nRF52840_code/common/include/time_sync.h)
+    val TIME_SYNC_SERVICE_UUID: UUID = UUID.fromString("6e2b0a10-7c31-4d8e-9a51-2f0c7d3e5b00")
+    val TIME_SYNC_CHARACTERISTIC_UUID: UUID = UUID.fromString("6e2b0a10-7c31-4d8e-9a51-2f0c7d3e5b01")
+    private const val TIME_SYNC_OP_REQ: Byte = 0x01
+    private const val TIME_SYNC_OP_RSP = 0x81
+    private const val TIME_SYNC_FAST_MS = 1000L   // first exchanges, to get an offset quickly
+    private const val TIME_SYNC_FAST_COUNT = 8
+    private const val TIME_SYNC_SLOW_MS = 10_000L
+
+    // L2CAP stream channel (nRF52840_code/common/include/l2cap_stream.h). The
+    // firmware publishes its PSM here; without the service everything stays on GATT.
+    val L2CAP_STREAM_SERVICE_UUID: UUID = UUID.fromString("6e2b0a20-7c31-4d8e-9a51-2f0c7d3e5b00")
+    val L2CAP_STREAM_PSM_UUID: UUID = UUID.fromString("6e2b0a20-7c31-4d8e-9a51-2f0c7d3e5b01")
+    @Volatile private var l2capSocket: BluetoothSocket? = null
+
+    // Throughput benchmark firmware (nRF52840_code/ble_throughput_bench,
+    // include/bench_proto.h). When a device has this service, a notification
+    // run starts once the link is set up, for comparing link settings.
+    val BENCH_SERVICE_UUID: UUID = UUID.fromString("fedcba98-7654-3210-fedc-ba9876543220")
+    val BENCH_DATA_UUID: UUID = UUID.fromString("fedcba98-7654-3210-fedc-ba9876543221")
+    val BENCH_CONTROL_UUID: UUID = UUID.fromString("fedcba98-7654-3210-fedc-ba9876543222")
+    private const val BENCH_OP_START: Byte = 0x01
+    private const val BENCH_REPORT_ACK = 0x81
+    private const val BENCH_REPORT_DONE = 0x82
+    private const val BENCH_DURATION_MS = 10_000
+    @Volatile private var benchPackets = 0L
+    @Volatile private var benchBytes = 0L
+
+    // Link setup (setUpLink). Without optimizeLink the phone keeps Android's
+    // defaults: 23-byte MTU, 1M PHY, balanced connection interval.
+    @Volatile var optimizeLink = true
+    @Volatile var link = LinkInfo(false, 0)
+        private set
+    private const val MAX_MTU = 517
+    private const val GATT_TIMEOUT_MS = 2_000L
+    private const val OP_PRIORITY = "connection priority"
+    private const val OP_PHY = "PHY"
+    private const val OP_MTU = "MTU"
+    private const val OP_READ_PSM = "L2CAP PSM read"
+    private const val OP_SETUP_DONE = "setup done"
+    private const val OP_TIME_SYNC = "time-sync write"
+    private const val OP_BENCH_START = "bench start"
+    // GAP and GATT: the stack's own, nothing to subscribe to
+    private val STANDARD_SERVICES = setOf(
+        UUID.fromString("00001800-0000-1000-8000-00805f9b34fb"),
+        UUID.fromString("00001801-0000-1000-8000-00805f9b34fb"),
+    )
+    // Main thread
+    private val gattQueue = GattQueue(GATT_TIMEOUT_MS,
+        { r, delayMs -> mainHandler.postDelayed(r, delayMs) },
+        { mainHandler.removeCallbacks(it) },
+        { Log.w("BLE_MANAGER", it) })
+
+    // Stream payload received per transport, for comparing the two
+    @Volatile var notifyStreamBytes = 0L
+        private set
+    @Volatile var l2capStreamBytes = 0L
+        private set
+
+    // Maps device timestamps in stream frames to SystemClock.elapsedRealtimeNanos
+    val clockSync = ClockSync()
+
+    // Cold-start timeline, from process start to the first sample and metric
+    val startup = StartupTrace(Process.getStartElapsedRealtime(), SystemClock::elapsedRealtime) {
+        Log.i("STARTUP", it)
+    }
+
+    // Received packets are copied into this ring on the callback thread and
+    // decoded on its own thread. The worker gets one block per channel per
+    // tick: every UI_TICK_MS while a screen plots live data, otherwise every
+    // batchIntervalMs, so with the screen off the CPU wakes once per batch.
+    private const val INGEST_SLOTS = 256
+    private const val INGEST_SLOT_SIZE = 2048    // the largest L2CAP read below
+    private const val UI_TICK_MS = 33L
+    const val DEFAULT_BATCH_INTERVAL_MS = 1000L
+    val ingest = StreamIngest(INGEST_SLOTS, INGEST_SLOT_SIZE, DEFAULT_BATCH_INTERVAL_MS,
+        { workerHandler.post(it) }, clockSync, ::onBlock).also { it.start() }
+    var batchIntervalMs = DEFAULT_BATCH_INTERVAL_MS
+        set(value) { field = value; updateIngestInterval() }
+
+    val workerLooper: Looper get() = workerThread.looper
+
+    // Blocks posted to screens on the main thread, one reusable Runnable per channel
+    private val deliveries = arrayOfNulls<Delivery>(256)
+    @Volatile var uiPosts = 0L
+        private set
+
+    // Recorded data played through the receive path instead of a band
+    @Volatile var playback: SessionPlayback? = null
+        private set
+    /** Status of the disconnect that ends a playback which played to the end. */
+    const val STATUS_PLAYBACK_DONE = -1
+
+    /** A band is connected or a session is playing back. */
+    val isStreaming: Boolean get() = gatt != null || playback != null
+
+    // Per connection, for the pipeline overlay: receive to end of analysis of
+    // each live block, and frames lost on the way
+    @Volatile var lostFrames = 0L
+        private set
+    @Volatile var lastLatencyNs = 0L
+        private set
+    @Volatile var maxLatencyNs = 0L
+        private set
+    @Volatile private var latencySumNs = 0L
+    @Volatile private var latencyBlocks = 0L
+
+    // Everything received while connected goes to disk through this, off the
+    // main thread; session_export.py makes CSV from it afterwards
+    @Volatile var recorder: SessionRecorder? = null
+        private set
+    private const val RECORDER_LOG_MS = 60_000L
+    private var batteryManager: BatteryManager? = null
+    private var recordStartChargeUah = 0L
+    private var textSeq = 0
+    private val textFrame = ByteArray(StreamProto.HDR_LEN + 255)
+    private val recorderLogRunnable = object : Runnable {
+        override fun run() {
+            recorder?.let { logRecorder(it) }
+            mainHandler.postDelayed(this, RECORDER_LOG_MS)
+        }
+    }
+
+    // Frames replayed from the device's flash recorder since the app started
+    var backlogFrames = 0L
+        private set
+
+    // Last tier announced by the device per stream channel
+    val streamTiers = IntArray(StreamProto.CH_REPLAY)
+    var tierSwitches = 0L
+        private set
+    private var timeSyncSeq = 0
+    private var timeSyncSent = 0
+    private val timeSyncT1 = LongArray(256)
+    private val timeSyncRunnable = object : Runnable {
+        override fun run() {
+            sendTimeSyncRequest()
+            val delay = if (timeSyncSent < TIME_SYNC_FAST_COUNT) TIME_SYNC_FAST_MS else TIME_SYNC_SLOW_MS
+            mainHandler.postDelayed(this, delay)
+        }
+    }
+
     // A single, shared callback that forwards events to the active listeners
     @SuppressLint("MissingPermission")
     val gattCallback = object : BluetoothGattCallback() {
         override fun onConnectionStateChange(gatt: BluetoothGatt, status: Int, newState: Int) {
             Log.d("BLE_MANAGER", "onConnectionStateChange: status=$status, newState=$newState")
-            // Use the handler to post the event to the main thread safely
-            mainHandler.post {
-                connectionListener?.onConnectionStateChanged(newState, status)
+            if (newState == BluetoothProfile.STATE_CONNECTED) {
+                startup.mark("connected")
+                link = LinkInfo(optimizeLink, SystemClock.elapsedRealtimeNanos())
             }
             if (newState == BluetoothProfile.STATE_DISCONNECTED) {
+                releaseConnection()
                 // When disconnected, clean up the GATT object
-                this@BleConnectionManager.gatt?.close()
-                this@BleConnectionManager.gatt = null
+                gatt.close()
+                if (this@BleConnectionManager.gatt === gatt) this@BleConnectionManager.gatt = null
+            }
+            // Use the handler to post the event to the main thread safely. After
+            // the cleanup above, so a listener can reconnect straight away.
+            mainHandler.post {
+                connectionListener?.onConnectionStateChanged(newState, status)
+                serviceConnectionListener?.onConnectionStateChanged(newState, status)
             }
         }
 
         override fun onServicesDiscovered(gatt: BluetoothGatt, status: Int) {
             if (status == BluetoothGatt.GATT_SUCCESS) {
-                Log.d("BLE_MANAGER", "Services discovered successfully. Enabling notifications.")
-                val service = gatt.getService(SERVICE_UUID)
-                service?.getCharacteristic(NOTIFY_CHARACTERISTIC_UUID)?.let { characteristic ->
-                    enableNotifications(gatt, characteristic)
-                } ?: run {
-                    Log.e("BLE_MANAGER", "Notify characteristic not found on service ${SERVICE_UUID}.")
-                }
+                Log.d("BLE_MANAGER", "Services discovered successfully. Setting up the link.")
+                mainHandler.post { setUpLink(gatt) }
             } else {
                 Log.w("BLE_MANAGER", "onServicesDiscovered received error: $status")
             }
         }
 
+        override fun onMtuChanged(gatt: BluetoothGatt, mtu: Int, status: Int) {
+            mainHandler.post {
+                if (status == BluetoothGatt.GATT_SUCCESS) link.mtu = mtu
+                gattQueue.complete(OP_MTU)
+            }
+        }
+
+        // Also called when the device changes the PHY itself
+        override fun onPhyUpdate(gatt: BluetoothGatt, txPhy: Int, rxPhy: Int, status: Int) {
+            mainHandler.post {
+                if (status == BluetoothGatt.GATT_SUCCESS) {
+                    link.txPhy = txPhy
+                    link.rxPhy = rxPhy
+                }
+                gattQueue.complete(OP_PHY)
+            }
+        }
+
+        override fun onCharacteristicWrite(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic, status: Int) {
+            val op = when (characteristic.uuid) {
+                TIME_SYNC_CHARACTERISTIC_UUID -> OP_TIME_SYNC
+                BENCH_CONTROL_UUID -> OP_BENCH_START
+                else -> return
+            }
+            mainHandler.post { gattQueue.complete(op) }
+        }
+
         override fun onCharacteristicChanged(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic) {
-            val rawDataString = characteristic.value.toString(Charsets.UTF_8)
-            Log.d("BLE_MANAGER", "Received raw data: $rawDataString")
+            // t4 of a time-sync exchange: take it before anything else
+            val rxNs = SystemClock.elapsedRealtimeNanos()
+            val value = characteristic.value ?: return
+
+            val l = link
+            l.notifyPackets++
+            l.notifyBytes += value.size
+
+            when (characteristic.uuid) {
+                TIME_SYNC_CHARACTERISTIC_UUID -> {
+                    mainHandler.post { onTimeSyncResponse(value, rxNs) }
+                    return
+                }
+                // Benchmark payload is only counted
+                BENCH_DATA_UUID -> {
+                    benchPackets++
+                    benchBytes += value.size
+                    return
+                }
+                BENCH_CONTROL_UUID -> {
+                    mainHandler.post { onBenchReport(value) }
+                    return
+                }
+            }
+
+            if (StreamProto.isStream(value)) {
+                notifyStreamBytes += value.size
+            }
+            // Stream frames and text packets from older firmware alike: copy and return
+            ingest.offer(value, value.size, rxNs)
+        }
 
-            // Route the data to the correct listener based on its prefix
+        override fun onDescriptorWrite(gatt: BluetoothGatt, descriptor: BluetoothGattDescriptor, status: Int) {
+            val characteristic = descriptor.characteristic
+            if (status == BluetoothGatt.GATT_SUCCESS) {
+                Log.i("BLE_MANAGER", "Notifications enabled on ${characteristic.uuid}.")
+            } else {
+                Log.e("BLE_MANAGER", "Failed to write descriptor of ${characteristic.uuid}, status: $status")
+            }
             mainHandler.post {
+                if (status == BluetoothGatt.GATT_SUCCESS) link.subscriptions++
+                gattQueue.complete(cccdOp(characteristic))
+            }
+        }
+
+        override fun onCharacteristicRead(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic, status: Int) {
+            if (characteristic.uuid != L2CAP_STREAM_PSM_UUID) return
+            val value = characteristic.value
+            if (status == BluetoothGatt.GATT_SUCCESS && value != null && value.size >= 2) {
+                val psm = (value[0].toInt() and 0xFF) or ((value[1].toInt() and 0xFF) shl 8)
+                openStreamChannel(gatt.device, psm)
+            }
+            mainHandler.post { gattQueue.complete(OP_READ_PSM) }
+        }
+    }
+
+    // Called on the worker thread with each channel's block from the ingest thread.
+    // Control messages of a tick reach listeners before that tick's samples.
+    private fun onBlock(block: SampleBlock) {
+        val channel = block.channel
+        recorder?.let { r ->
+            if (block.frameCount > 0) r.write(block.frameBytes, 0, block.frameBytesLength)
+            for (i in block.text.indices) recordText(r, channel, block.text[i], block.lastRxNs)
+        }
+        when {
+            channel == StreamProto.CH_CONTROL -> block.forEachFrame { onControlFrame(it) }
+            (channel and StreamProto.CH_REPLAY) != 0 -> {
+                backlogFrames += block.frameCount
+                deliver(block)
+            }
+            else -> {
+                if (block.size > 0 || block.text.isNotEmpty()) startup.mark(StartupTrace.FIRST_SAMPLE)
+                blockAnalysis?.invoke(block)
+                if (block.frameCount > 0 || block.text.isNotEmpty()) {
+                    val latencyNs = SystemClock.elapsedRealtimeNanos() - block.firstRxNs
+                    lastLatencyNs = latencyNs
+                    if (latencyNs > maxLatencyNs) maxLatencyNs = latencyNs
+                    latencySumNs += latencyNs
+                    latencyBlocks++
+                    lostFrames += block.lostFrames
+                }
+                deliver(block)
+            }
+        }
+    }
+
+    // Hands the block to its screen on the main thread; it is not reused until that is done
+    private fun deliver(block: SampleBlock) {
+        if (listenerForChannel(block.channel and StreamProto.CH_REPLAY.inv()) == null) return
+        val delivery = deliveries[block.channel] ?: Delivery().also { deliveries[block.channel] = it }
+        block.retain()
+        delivery.block = block
+        uiPosts++
+        mainHandler.post(delivery)
+    }
+
+    private class Delivery : Runnable {
+        @Volatile var block: SampleBlock? = null
+
+        override fun run() {
+            val b = block ?: return
+            block = null
+            try {
+                // The screen may have gone since the post
+                val replay = (b.channel and StreamProto.CH_REPLAY) != 0
+                val listener = BleConnectionManager.listenerForChannel(b.channel and StreamProto.CH_REPLAY.inv()) ?: return
                 when {
-                    rawDataString.startsWith("EMG,") -> {
-                        val emgValue = rawDataString.removePrefix("EMG,")
-                        emgDataListener?.onDataReceived(emgValue)
-                    }
-                    rawDataString.startsWith("PPG,") -> {
-                        val ppgValue = rawDataString.removePrefix("PPG,")
-                        ppgDataListener?.onDataReceived(ppgValue)
-                    }
-                    rawDataString.startsWith("SWEAT,") -> {
-                        val sweatValue = rawDataString.removePrefix("SWEAT,")
-                        sweatDataListener?.onDataReceived(sweatValue)
-                    }
-                    // Handle Test data
-                    rawDataString.startsWith("TEST,") -> {
-                        val testValue = rawDataString.removePrefix("TEST,")
-                        testDataListener?.onDataReceived(testValue)
+                    replay -> listener.onBacklogSamples(b)
+                    else -> {
+                        for (i in b.text.indices) listener.onDataReceived(b.text[i])
+                        if (b.frameCount > 0) listener.onSamples(b)
                     }
                 }
+            } finally {
+                b.release()
             }
         }
+    }
 
-        override fun onDescriptorWrite(gatt: BluetoothGatt, descriptor: BluetoothGattDescriptor, status: Int) {
-            if (status == BluetoothGatt.GATT_SUCCESS) {
-                Log.i("BLE_MANAGER", "Notifications enabled successfully.")
+    // Short ticks only while a screen plots the stream
+    private fun updateIngestInterval() {
+        val live = emgDataListener != null || ppgDataListener != null ||
+            sweatDataListener != null || testDataListener != null
+        ingest.publishIntervalMs = if (live) UI_TICK_MS else batchIntervalMs
+    }
+
+    private fun onControlFrame(frame: StreamFrame) {
+        if (frame.format != StreamProto.FMT_BYTES || frame.count < 4) return
+        when (frame.getInt(0)) {
+            StreamProto.CTRL_TIER -> onTierChange(frame)
+            StreamProto.CTRL_EVENT -> onEventMarker(frame)
+        }
+    }
+
+    private fun onTierChange(frame: StreamFrame) {
+        val channel = frame.getInt(1) and StreamProto.CH_REPLAY.inv()
+        val tier = frame.getInt(2)
+        val decimation = frame.getInt(3)
+        streamTiers[channel] = tier
+        tierSwitches++
+        Log.i("BLE_MANAGER", "Channel $channel now on stream tier $tier (decimation $decimation)")
+        mainHandler.post { listenerForChannel(channel)?.onStreamTier(tier, decimation) }
+    }
+
+    private fun onEventMarker(frame: StreamFrame) {
+        if (frame.count < 8) return
+        val channel = frame.getInt(1) and StreamProto.CH_REPLAY.inv()
+        val triggers = frame.getInt(2)
+        val phase = frame.getInt(3)
+        val id = frame.getInt(4) or (frame.getInt(5) shl 8)
+        val samples = frame.getInt(6) or (frame.getInt(7) shl 8)
+        if (phase == StreamProto.EVENT_END) {
+            Log.i("BLE_MANAGER", "Event $id on channel $channel: $samples samples, triggers 0x%02x".format(triggers))
+        }
+        mainHandler.post { listenerForChannel(channel)?.onStreamEvent(id, triggers, phase, samples) }
+    }
+
+    /*
+     * Main thread, once services are discovered. Android's defaults (23-byte
+     * MTU, 1M PHY, a balanced connection interval of 30-50 ms) cap the
+     * stream far below what the radio can carry. Unless optimizeLink is off,
+     * this asks for the high-priority interval first, so the rest of setup
+     * is quicker too, then the 2M PHY and the largest MTU. It then
+     * subscribes to every notifying characteristic of the device's services
+     * and reads the L2CAP PSM. The steps go through gattQueue, one at a
+     * time, and what was granted ends up in link.
+     */
+    @SuppressLint("MissingPermission")
+    private fun setUpLink(gatt: BluetoothGatt) {
+        if (this.gatt !== gatt) return
+        gattQueue.clear()
+        val l = link
+        if (l.optimized) {
+            gattQueue.enqueue(OP_PRIORITY, awaitsCallback = false) {
+                gatt.requestConnectionPriority(BluetoothGatt.CONNECTION_PRIORITY_HIGH).also { l.highPriority = it }
+            }
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+                gattQueue.enqueue(OP_PHY) {
+                    gatt.setPreferredPhy(BluetoothDevice.PHY_LE_2M_MASK, BluetoothDevice.PHY_LE_2M_MASK,
+                        BluetoothDevice.PHY_OPTION_NO_PREFERRED)
+                    true
+                }
+            }
+            gattQueue.enqueue(OP_MTU) { gatt.requestMtu(MAX_MTU) }
+        }
+
+        for (service in gatt.services) {
+            if (service.uuid in STANDARD_SERVICES) continue
+            for (characteristic in service.characteristics) {
+                val props = characteristic.properties
+                if ((props and (BluetoothGattCharacteristic.PROPERTY_NOTIFY or BluetoothGattCharacteristic.PROPERTY_INDICATE)) == 0) continue
+                gattQueue.enqueue(cccdOp(characteristic)) { enableNotifications(gatt, characteristic) }
+            }
+        }
+        if (gatt.getService(SERVICE_UUID)?.getCharacteristic(NOTIFY_CHARACTERISTIC_UUID) == null) {
+            Log.w("BLE_MANAGER", "Notify characteristic not found on service ${SERVICE_UUID}.")
+        }
+        if (gatt.getService(TIME_SYNC_SERVICE_UUID) == null) {
+            Log.w("BLE_MANAGER", "No time-sync service, sample times stay in device time.")
+        }
+        gatt.getService(L2CAP_STREAM_SERVICE_UUID)?.getCharacteristic(L2CAP_STREAM_PSM_UUID)?.let { psm ->
+            gattQueue.enqueue(OP_READ_PSM) { gatt.readCharacteristic(psm) }
+        }
+
+        gattQueue.enqueue(OP_SETUP_DONE, awaitsCallback = false) {
+            l.setupMs = (SystemClock.elapsedRealtimeNanos() - l.connectedNs) / 1_000_000
+            Log.i("BLE_MANAGER", "Link ${l.summary()}")
+            startTimeSync()
+            gatt.getService(BENCH_SERVICE_UUID)?.getCharacteristic(BENCH_CONTROL_UUID)?.let { startBench(gatt, it) }
+            true
+        }
+    }
+
+    private fun cccdOp(characteristic: BluetoothGattCharacteristic) = "CCCD ${characteristic.uuid}"
+
+    // A back-to-back notification run of BENCH_DURATION_MS at the payload the MTU allows,
+    // leaving PHY and interval as the link setup left them
+    @SuppressLint("MissingPermission")
+    private fun startBench(gatt: BluetoothGatt, control: BluetoothGattCharacteristic) {
+        val command = ByteBuffer.allocate(17).order(ByteOrder.LITTLE_ENDIAN)
+            .put(BENCH_OP_START).put(0.toByte())                 // op, PHY: keep
+            .putShort((link.mtu - 3).toShort())                  // payload_len
+            .putShort(0.toShort()).putShort(0.toShort())         // conn_interval, att_mtu cap: keep
+            .putInt(0).putInt(BENCH_DURATION_MS)                 // interval_us: back to back, duration_ms
+            .put(0.toByte())                                     // transport: notifications
+            .array()
+        gattQueue.enqueue(OP_BENCH_START) {
+            benchPackets = 0
+            benchBytes = 0
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+                gatt.writeCharacteristic(control, command,
+                    BluetoothGattCharacteristic.WRITE_TYPE_DEFAULT) == BluetoothStatusCodes.SUCCESS
             } else {
-                Log.e("BLE_MANAGER", "Failed to write descriptor, status: $status")
+                control.writeType = BluetoothGattCharacteristic.WRITE_TYPE_DEFAULT
+                control.value = command
+                gatt.writeCharacteristic(control)
+            }
+        }
+    }
+
+    // Main thread. ACK: the run starts with these link parameters; DONE: the device's counters
+    private fun onBenchReport(value: ByteArray) {
+        if (value.size < 25) return
+        val buf = ByteBuffer.wrap(value).order(ByteOrder.LITTLE_ENDIAN)
+        val phy = value[1].toInt() and 0xFF
+        val mtu = buf.getShort(2).toInt() and 0xFFFF
+        val intervalMs = (buf.getShort(4).toInt() and 0xFFFF) * 1.25
+        val payload = buf.getShort(6).toInt() and 0xFFFF
+        when (value[0].toInt() and 0xFF) {
+            BENCH_REPORT_ACK -> {
+                Log.i("BLE_MANAGER", "Bench run: %d-byte notifications, MTU %d, PHY %d, interval %.2f ms (%s)".format(
+                    payload, mtu, phy, intervalMs, if (link.optimized) "optimised" else "defaults"))
+            }
+            BENCH_REPORT_DONE -> {
+                val sent = buf.getInt(8).toLong() and 0xFFFFFFFFL
+                val txErrors = buf.getInt(12).toLong() and 0xFFFFFFFFL
+                val seconds = (buf.getInt(16).toLong() and 0xFFFFFFFFL) / 1e6
+                Log.i("BLE_MANAGER", ("Bench done (%s): %.1f kB/s, %d of %d notifications received, " +
+                    "%d not queued by the device, MTU %d, PHY %d, interval %.2f ms").format(
+                    if (link.optimized) "optimised" else "defaults", benchBytes / 1e3 / seconds.coerceAtLeast(1e-3),
+                    benchPackets, sent, txErrors, mtu, phy, intervalMs))
+            }
+        }
+    }
+
+    /*
+     * Opens the firmware's L2CAP channel (Android 10+). While it is open the
+     * device sends live frames and the flash backlog there as large SDUs
+     * instead of notifications. Each read returns one SDU, which holds whole
+     * frames, so it takes the same path as a notification.
+     */
+    @SuppressLint("MissingPermission")
+    private fun openStreamChannel(device: BluetoothDevice, psm: Int) {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.Q) return
+        closeStreamChannel()
+
+        Thread({
+            val socket = try {
+                device.createInsecureL2capChannel(psm).also { it.connect() }
+            } catch (e: IOException) {
+                Log.w("BLE_MANAGER", "L2CAP channel on PSM $psm not opened, staying on notifications", e)
+                return@Thread
             }
+            l2capSocket = socket
+            Log.i("BLE_MANAGER", "L2CAP stream channel open on PSM $psm, max SDU ${socket.maxReceivePacketSize}")
+
+            val startNs = SystemClock.elapsedRealtimeNanos()
+            val startBytes = l2capStreamBytes
+            val buf = ByteArray(maxOf(socket.maxReceivePacketSize, 2048))
+            try {
+                val input = socket.inputStream
+                while (true) {
+                    val n = input.read(buf)
+                    if (n < 0) break
+                    if (n == 0) continue
+                    l2capStreamBytes += n
+                    if (StreamProto.isStream(buf, n) &&
+                        !ingest.offer(buf, n, SystemClock.elapsedRealtimeNanos()) && n > INGEST_SLOT_SIZE) {
+                        Log.w("BLE_MANAGER", "L2CAP SDU of $n bytes does not fit an ingest slot")
+                    }
+                }
+            } catch (e: IOException) {
+                // Closed by closeStreamChannel() or the link went down
+            } finally {
+                val seconds = (SystemClock.elapsedRealtimeNanos() - startNs) / 1e9
+                Log.i("BLE_MANAGER", "L2CAP stream channel closed: %d bytes in %.1f s".format(
+                    l2capStreamBytes - startBytes, seconds))
+                if (l2capSocket === socket) l2capSocket = null
+                try { socket.close() } catch (_: IOException) {}
+            }
+        }, "l2cap-stream").start()
+    }
+
+    /**
+     * Closes the connection at once, without waiting for the callback. The
+     * screens' listener hears of it; the service's does not, so it does not
+     * reconnect.
+     */
+    @SuppressLint("MissingPermission")
+    fun disconnect() {
+        val g = gatt
+        if (g == null && playback == null) return
+        gatt = null
+        g?.close()
+        releaseConnection()
+        mainHandler.post {
+            connectionListener?.onConnectionStateChanged(BluetoothProfile.STATE_DISCONNECTED, BluetoothGatt.GATT_SUCCESS)
+        }
+    }
+
+    private fun releaseConnection() {
+        mainHandler.post {
+            stopTimeSync()
+            gattQueue.clear()
+        }
+        val l = link
+        if (l.connectedNs > 0) {
+            Log.i("BLE_MANAGER", "Link ${l.summary()}; ${l.throughput(SystemClock.elapsedRealtimeNanos())}")
+            link = LinkInfo(false, 0)
         }
+        stopPlayback()
+        ingest.reset()
+        stopRecording()
+        Log.i("BLE_MANAGER", "Ingest: %d packets, %d dropped, %d malformed, %d batches, %d wakeups".format(
+            ingest.packets, ingest.droppedPackets, ingest.malformedPackets, ingest.publishes, ingest.wakeups))
+        Log.i("BLE_MANAGER", pipelineSummary().replace('\n', ' '))
+        workerHandler.post {
+            streamTiers.fill(StreamProto.TIER_FULL)
+            lostFrames = 0
+            lastLatencyNs = 0
+            maxLatencyNs = 0
+            latencySumNs = 0
+            latencyBlocks = 0
+        }
+        closeStreamChannel()
+    }
+
+    /**
+     * Plays [files] (SessionRecorder .bin files or CSV logs) through the
+     * receive path in place of a band, at [speed] times real time or
+     * [SessionPlayback.FASTEST]. Listeners hear STATE_CONNECTED now and
+     * STATE_DISCONNECTED with [STATUS_PLAYBACK_DONE] once the last packet has
+     * been analysed. It is recorded like a connection, with the prefix
+     * "playback", so a run can be compared with its source.
+     */
+    fun startPlayback(context: Context, files: List<File>, speed: Double) {
+        disconnect()
+        startRecording(context, "playback")
+        val p = SessionPlayback(files, speed, SystemClock::elapsedRealtimeNanos) { data, length, rxNs ->
+            // At full speed a full ring means wait, not a dropped packet
+            if (speed <= 0 && ingest.queueDepth >= ingest.capacity) false else ingest.offer(data, length, rxNs)
+        }
+        p.onFinished = { mainHandler.post { finishPlayback(it, 0) } }
+        playback = p.start()
+        Log.i("BLE_MANAGER", "Playing ${files.joinToString { it.name }} at ${if (speed > 0) "${speed}x" else "full speed"}")
+        mainHandler.post {
+            connectionListener?.onConnectionStateChanged(BluetoothProfile.STATE_CONNECTED, BluetoothGatt.GATT_SUCCESS)
+            serviceConnectionListener?.onConnectionStateChanged(BluetoothProfile.STATE_CONNECTED, BluetoothGatt.GATT_SUCCESS)
+        }
+    }
+
+    // Main thread, polling until the ring is empty and a tick later nothing is
+    // in flight, so the last packets have been through analysis
+    private fun finishPlayback(p: SessionPlayback, idleSinceMs: Long) {
+        if (playback !== p) return
+        val now = SystemClock.uptimeMillis()
+        val idle = ingest.queueDepth == 0 && ingest.blocksInFlight == 0
+        val since = if (!idle) 0L else if (idleSinceMs == 0L) now else idleSinceMs
+        if (since == 0L || now - since <= ingest.publishIntervalMs + UI_TICK_MS) {
+            mainHandler.postDelayed({ finishPlayback(p, since) }, UI_TICK_MS)
+            return
+        }
+        releaseConnection()
+        connectionListener?.onConnectionStateChanged(BluetoothProfile.STATE_DISCONNECTED, STATUS_PLAYBACK_DONE)
+        serviceConnectionListener?.onConnectionStateChanged(BluetoothProfile.STATE_DISCONNECTED, STATUS_PLAYBACK_DONE)
+    }
+
+    private fun stopPlayback() {
+        val p = playback ?: return
+        playback = null
+        p.stop()
+        Log.i("BLE_MANAGER", "Playback %s: %.1f s of data in %.1f s, %d packets, %d dropped, max lag %d ms".format(
+            if (p.finished) "done" else "stopped", p.sessionUs / 1e6, p.elapsedNs / 1e9,
+            p.packets, p.droppedPackets, p.maxLagMs))
+    }
+
+    /** Queue depths, latency and losses of the receive path, a few short lines. */
+    fun pipelineSummary(): String {
+        val blocks = latencyBlocks
+        val mean = if (blocks > 0) latencySumNs / 1e6 / blocks else 0.0
+        val uiPending = deliveries.count { it?.block != null }
+        val lines = arrayListOf(
+            "Queue %d/%d packets, %d blocks on worker, %d UI posts waiting".format(
+                ingest.queueDepth, ingest.capacity, ingest.blocksInFlight, uiPending),
+            "Latency %.1f ms (mean %.1f, max %.1f) over %d blocks".format(
+                lastLatencyNs / 1e6, mean, maxLatencyNs / 1e6, blocks),
+            "Lost %d frames, %d packets dropped, %d malformed".format(
+                lostFrames, ingest.droppedPackets, ingest.malformedPackets),
+        )
+        if (gatt != null) lines.add("Link " + link.summary())
+        playback?.let { p ->
+            lines.add("Playback %.1f s in %.1f s, %d dropped, lag %d ms".format(
+                p.sessionUs / 1e6, p.elapsedNs / 1e9, p.droppedPackets, p.maxLagMs))
+        }
+        return lines.joinToString("\n")
+    }
+
+    private fun closeStreamChannel() {
+        val socket = l2capSocket ?: return
+        l2capSocket = null
+        try { socket.close() } catch (_: IOException) {}
+    }
+
+    /** Starts a new session file set in filesDir/sessions; called when connecting. */
+    fun startRecording(context: Context, prefix: String = "session") {
+        stopRecording()
+        batteryManager = context.getSystemService(Context.BATTERY_SERVICE) as BatteryManager
+        recordStartChargeUah = batteryManager?.getLongProperty(BatteryManager.BATTERY_PROPERTY_CHARGE_COUNTER) ?: 0L
+        recorder = SessionRecorder(File(context.filesDir, "sessions"), prefix).start()
+        mainHandler.postDelayed(recorderLogRunnable, RECORDER_LOG_MS)
+        Log.i("BLE_MANAGER", "Recording to ${recorder?.files()?.last()}")
+    }
+
+    fun stopRecording() {
+        val r = recorder ?: return
+        recorder = null
+        mainHandler.removeCallbacks(recorderLogRunnable)
+        r.close()
+        logRecorder(r)
+    }
+
+    // Throughput and battery drain so far, for judging the recorder over long sessions
+    private fun logRecorder(r: SessionRecorder) {
+        val seconds = (System.nanoTime() - r.startNs) / 1e9
+        val charge = batteryManager?.getLongProperty(BatteryManager.BATTERY_PROPERTY_CHARGE_COUNTER) ?: 0L
+        // Some devices report no charge counter (0 or Long.MIN_VALUE)
+        val usedMah = if (charge > 0 && recordStartChargeUah > 0) (recordStartChargeUah - charge) / 1000.0 else Double.NaN
+        Log.i("BLE_MANAGER", ("Recorder: %.1f MB in %.0f s (%.1f kB/s), %d files, write %.0f ms, " +
+            "%d fsyncs %.0f ms, %d B dropped, battery %.1f mAh (%.1f mAh/h)").format(
+            r.bytesWritten / 1e6, seconds, r.throughput() / 1e3, r.files().size, r.writeNs / 1e6,
+            r.syncs, r.syncNs / 1e6, r.droppedBytes, usedMah, usedMah * 3600 / seconds))
+    }
+
+    // Text packets from older firmware are kept as FMT_BYTES frames of their
+    // channel, t0 being the phone's receive time; longer lines span several
+    // frames with the same seq
+    private fun recordText(r: SessionRecorder, channel: Int, line: String, rxNs: Long) {
+        val bytes = line.toByteArray(Charsets.UTF_8)
+        val seq = textSeq
+        textSeq = (textSeq + 1) and 0xFFFF
+        var pos = 0
+        do {
+            val n = minOf(255, bytes.size - pos)
+            StreamProto.writeHeader(textFrame, 0, channel, StreamProto.FMT_BYTES, n, seq, rxNs / 1000, 0)
+            System.arraycopy(bytes, pos, textFrame, StreamProto.HDR_LEN, n)
+            r.write(textFrame, 0, StreamProto.HDR_LEN + n)
+            pos += n
+        } while (pos < bytes.size)
+    }
+
+    // Time-sync state is only touched on the main thread
+    private fun startTimeSync() {
+        stopTimeSync()
+        mainHandler.post(timeSyncRunnable)
+    }
+
+    private fun stopTimeSync() {
+        mainHandler.removeCallbacks(timeSyncRunnable)
+        clockSync.reset()
+        timeSyncSent = 0
+    }
+
+    @SuppressLint("MissingPermission")
+    private fun sendTimeSyncRequest() {
+        val g = gatt ?: return
+        val characteristic = g.getService(TIME_SYNC_SERVICE_UUID)
+            ?.getCharacteristic(TIME_SYNC_CHARACTERISTIC_UUID) ?: return
+        // Behind any GATT operation still running; t1 is taken when the write is issued
+        gattQueue.enqueue(OP_TIME_SYNC) { writeTimeSyncRequest(g, characteristic) }
     }
 
     @SuppressLint("MissingPermission")
-    private fun enableNotifications(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic) {
+    private fun writeTimeSyncRequest(g: BluetoothGatt, characteristic: BluetoothGattCharacteristic): Boolean {
+        val seq = timeSyncSeq
+        timeSyncSeq = (timeSyncSeq + 1) and 0xFF
+        val request = byteArrayOf(TIME_SYNC_OP_REQ, seq.toByte(), 0, 0)
+
+        // t1: as close to the write as the API allows
+        timeSyncT1[seq] = SystemClock.elapsedRealtimeNanos()
+        val queued = if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+            g.writeCharacteristic(characteristic, request,
+                BluetoothGattCharacteristic.WRITE_TYPE_NO_RESPONSE) == BluetoothStatusCodes.SUCCESS
+        } else {
+            characteristic.writeType = BluetoothGattCharacteristic.WRITE_TYPE_NO_RESPONSE
+            characteristic.value = request
+            g.writeCharacteristic(characteristic)
+        }
+        if (queued) {
+            timeSyncSent++
+        } else {
+            timeSyncT1[seq] = 0L
+        }
+        return queued
+    }
+
+    private fun onTimeSyncResponse(value: ByteArray, t4Ns: Long) {
+        if (value.size < 12 || (value[0].toInt() and 0xFF) != TIME_SYNC_OP_RSP) return
+        val buf = ByteBuffer.wrap(value).order(ByteOrder.LITTLE_ENDIAN)
+        val seq = value[1].toInt() and 0xFF
+        val t1Ns = timeSyncT1[seq]
+        if (t1Ns == 0L) return
+        timeSyncT1[seq] = 0L
+
+        val t2Us = buf.getInt(4).toLong() and 0xFFFFFFFFL
+        val t3Us = buf.getInt(8).toLong() and 0xFFFFFFFFL
+        clockSync.addExchange(t1Ns, t2Us, t3Us, t4Ns)
+        Log.d("BLE_MANAGER", "Time sync: drift=%.1f ppm, min delay=%.2f ms, n=%d".format(
+            clockSync.driftPpm, clockSync.minDelayNs / 1e6, clockSync.size))
+    }
+
+    private fun listenerForChannel(channel: Int): BleDataListener? = when (channel) {
+        StreamProto.CH_EMG -> emgDataListener
+        StreamProto.CH_PPG -> ppgDataListener
+        StreamProto.CH_SWEAT -> sweatDataListener
+        // The ADC demo boards have no analyzer of their own; plot them raw
+        StreamProto.CH_TEST, StreamProto.CH_ADC, StreamProto.CH_ADC_EVENT -> testDataListener
+        else -> null
+    }
+
+    // Returns false if the descriptor write was not queued
+    @SuppressLint("MissingPermission")
+    private fun enableNotifications(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic): Boolean {
         val descriptor = characteristic.getDescriptor(CCCD_UUID)
         if (descriptor == null) {
             Log.e("BLE_MANAGER", "Could not find CCCD descriptor for characteristic: ${characteristic.uuid}")
-            return
+            return false
         }
 
         gatt.setCharacteristicNotification(characteristic, true)
+        val value = if ((characteristic.properties and BluetoothGattCharacteristic.PROPERTY_NOTIFY) != 0) {
+            BluetoothGattDescriptor.ENABLE_NOTIFICATION_VALUE
+        } else {
+            BluetoothGattDescriptor.ENABLE_INDICATION_VALUE
+        }
 
-        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
-            gatt.writeDescriptor(descriptor, BluetoothGattDescriptor.ENABLE_NOTIFICATION_VALUE)
+        return if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+            gatt.writeDescriptor(descriptor, value) == BluetoothStatusCodes.SUCCESS
         } else {
-            descriptor.value = BluetoothGattDescriptor.ENABLE_NOTIFICATION_VALUE
+            descriptor.value = value
             gatt.writeDescriptor(descriptor)
         }
     }
@@ -0,0 +1,133 @@
+package com.example.biobanddisplay
+
+/**
+ * Maps device timestamps (µs, wrapping at 2^32) onto the phone clock
+ * (SystemClock.elapsedRealtimeNanos) from time-sync round trips
+ * (nRF52840_code/common/include/time_sync.h).
+ *
+ * Each exchange gives phone send/receive times t1/t4 and device
+ * receive/reply times t2/t3. Its midpoints pair one device time with one
+ * phone time, and its queueing delay (t4 - t1) - (t3 - t2) bounds how far
+ * that pair can be off. Of the last [window] exchanges, the lower half by
+ * delay is fitted with a straight line, which gives offset and drift.
+ * With a single exchange the mapping is offset only.
+ *
+ * BLE makes the two directions asymmetric: the reply always waits for the
+ * next connection event, the request on average half of one. The mapping
+ * therefore lags true phone time by about half a connection interval. The
+ * lag is constant, so sample rates and intervals derived from mapped
+ * times are not affected.
+ *
+ * Thread-safe: exchanges are added on the main thread while StreamIngest
+ * maps frame times on its own thread.
+ */
+class ClockSync(private val window: Int = 64) {
+
+    private class Exchange(val delayNs: Long, val deviceUs: Long, val phoneNs: Long)
+
+    private val exchanges = ArrayDeque<Exchange>()
+    private var lastDeviceUs = Long.MIN_VALUE
+
+    // phone = phoneRefNs + nsPerUs * (device - deviceRefUs)
+    private var deviceRefUs = 0L
+    private var phoneRefNs = 0L
+    // Read by the analysis on the BLE worker thread
+    @Volatile private var nsPerUs = 1000.0
+
+    /** Number of exchanges in the current fit window. */
+    val size: Int @Synchronized get() = exchanges.size
+
+    val isSynced: Boolean @Synchronized get() = exchanges.isNotEmpty()
+
+    /** Device clock error in ppm: positive when the device runs fast. */
+    val driftPpm: Double get() = (1000.0 / nsPerUs - 1.0) * 1e6
+
+    /** Phone seconds per device second. */
+    val rate: Double get() = nsPerUs / 1000.0
+
+    /** Lowest queueing delay in the window, in ns. */
+    val minDelayNs: Long @Synchronized get() = exchanges.minOfOrNull { it.delayNs } ?: 0L
+
+    @Synchronized
+    fun reset() {
+        exchanges.clear()
+        lastDeviceUs = Long.MIN_VALUE
+        deviceRefUs = 0L
+        phoneRefNs = 0L
+        nsPerUs = 1000.0
+    }
+
+    /**
+     * Adds one round trip. [t2Us] and [t3Us] are the raw 32-bit device
+     * times from the response.
+     */
+    @Synchronized
+    fun addExchange(t1Ns: Long, t2Us: Long, t3Us: Long, t4Ns: Long) {
+        val t2 = unwrap(t2Us)
+        val t3 = t2 + ((t3Us - t2Us) and WRAP_MASK)
+        val delayNs = (t4Ns - t1Ns) - (t3 - t2) * 1000
+        if (delayNs < 0) return
+
+        if (exchanges.size == window) exchanges.removeFirst()
+        exchanges.addLast(Exchange(delayNs, (t2 + t3) / 2, t1Ns + (t4Ns - t1Ns) / 2))
+        fit()
+    }
+
+    /**
+     * Extends a 32-bit device time to 64 bits around the last device time
+     * seen. Valid for times within ±35 minutes of it.
+     */
+    @Synchronized
+    fun unwrap(deviceUs: Long): Long {
+        val raw = deviceUs and WRAP_MASK
+        if (lastDeviceUs == Long.MIN_VALUE) {
+            lastDeviceUs = raw
+            return raw
+        }
+        // Signed 32-bit difference to the reference
+        val delta = ((raw - lastDeviceUs) shl 32) shr 32
+        val result = lastDeviceUs + delta
+        if (delta > 0) lastDeviceUs = result
+        return result
+    }
+
+    /** Phone time (elapsedRealtimeNanos) of a raw 32-bit device time. */
+    @Synchronized
+    fun toPhoneNs(deviceUs: Long): Long =
+        phoneRefNs + (nsPerUs * (unwrap(deviceUs) - deviceRefUs)).toLong()
+
+    /** Phone time of sample [i] of [frame]. */
+    @Synchronized
+    fun toPhoneNs(frame: StreamFrame, i: Int = 0): Long =
+        toPhoneNs(frame.t0Us) + (rate * i * frame.periodNs).toLong()
+
+    private fun fit() {
+        val best = exchanges.sortedBy { it.delayNs }.take(maxOf(2, exchanges.size / 2))
+
+        // Centre on the means so the slope is well conditioned
+        val n = best.size
+        val meanX = best.sumOf { it.deviceUs.toDouble() } / n
+        val meanY = best.sumOf { it.phoneNs.toDouble() } / n
+        var sxx = 0.0
+        var sxy = 0.0
+        for (e in best) {
+            val dx = e.deviceUs - meanX
+            sxx += dx * dx
+            sxy += dx * (e.phoneNs - meanY)
+        }
+
+        deviceRefUs = meanX.toLong()
+        phoneRefNs = meanY.toLong()
+        // Over a short span the delay jitter swamps the drift; keep the last
+        // slope (nominal at first) until the exchanges cover enough time
+        val spreadUs = best.maxOf { it.deviceUs } - best.minOf { it.deviceUs }
+        if (spreadUs >= MIN_SPREAD_US) {
+            nsPerUs = sxy / sxx
+        }
+    }
+
+    companion object {
+        private const val WRAP_MASK = 0xFFFFFFFFL
+        private const val MIN_SPREAD_US = 30_000_000L
+    }
+}
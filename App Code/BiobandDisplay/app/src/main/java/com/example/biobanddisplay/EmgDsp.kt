@@ -0,0 +1,105 @@
+package com.example.biobanddisplay
+
+/**
+ * Streaming EMG analysis in native code (src/main/cpp/emg_dsp.h).
+ *
+ * The engine keeps its filter, moving-average and spectrum state between
+ * [push] calls, so each call costs a fixed amount per new sample. Results
+ * come back in one reused float array.
+ *
+ * emg_analyzer.py is the reference. EmgDspEquivalenceTest checks the
+ * engine against it on the device.
+ *
+ * Not thread safe; use one instance per stream and [close] it when done.
+ */
+class EmgDsp(val fs: Float) : AutoCloseable {
+
+    private var handle = nativeCreate(fs)
+    private val out = FloatArray(RESULT_SIZE)
+
+    /** RMS of the last burst right after it ends, otherwise of the last second. */
+    var vrms = 0f
+        private set
+    /** Mean frequency in the 20-450 Hz band, over the same span as [vrms]. */
+    var meanFrequency = 0f
+        private set
+    var isResting = true
+        private set
+    /** Inside a burst that has not ended yet. */
+    var isActive = false
+        private set
+    /** Latest 150 ms moving average of the rectified signal. */
+    var envelope = 0f
+        private set
+    /** Bursts completed since the engine was created or reset. */
+    var bursts = 0
+        private set
+
+    /** Feeds the first [count] raw samples of [samples] and updates the results. */
+    fun push(samples: FloatArray, count: Int = samples.size) {
+        check(handle != 0L) { "EmgDsp is closed" }
+        require(count in 0..samples.size)
+        if (count == 0) return
+        nativePush(handle, samples, count, out)
+        vrms = out[RESULT_VRMS]
+        meanFrequency = out[RESULT_MEAN_FREQ]
+        isResting = out[RESULT_RESTING] != 0f
+        isActive = out[RESULT_LOGGING] != 0f
+        envelope = out[RESULT_ENVELOPE]
+        bursts = out[RESULT_BURSTS].toInt()
+    }
+
+    fun reset() {
+        check(handle != 0L) { "EmgDsp is closed" }
+        nativeReset(handle)
+        out.fill(0f)
+        vrms = 0f
+        meanFrequency = 0f
+        isResting = true
+        isActive = false
+        envelope = 0f
+        bursts = 0
+    }
+
+    /**
+     * The last completed bursts, oldest first, as rows of start sample, end
+     * sample, Vrms and mean frequency (0 if the burst was shorter than one FFT).
+     */
+    fun burstTable(): Array<DoubleArray> {
+        check(handle != 0L) { "EmgDsp is closed" }
+        val rows = DoubleArray(4 * MAX_BURSTS)
+        val n = nativeBursts(handle, rows)
+        return Array(n) { rows.copyOfRange(4 * it, 4 * it + 4) }
+    }
+
+    override fun close() {
+        if (handle != 0L) {
+            nativeDestroy(handle)
+            handle = 0L
+        }
+    }
+
+    private external fun nativeCreate(fs: Float): Long
+    private external fun nativeDestroy(handle: Long)
+    private external fun nativeReset(handle: Long)
+    private external fun nativePush(handle: Long, samples: FloatArray, count: Int, out: FloatArray)
+    private external fun nativeBursts(handle: Long, out: DoubleArray): Int
+
+    companion object {
+        // Layout of the result array, as in emg_dsp_jni.cpp
+        private const val RESULT_VRMS = 0
+        private const val RESULT_MEAN_FREQ = 1
+        private const val RESULT_RESTING = 2
+        private const val RESULT_LOGGING = 3
+        private const val RESULT_ENVELOPE = 4
+        private const val RESULT_BURSTS = 5
+        private const val RESULT_SIZE = 6
+
+        // emg::Engine::kBurstHistory
+        private const val MAX_BURSTS = 32
+
+        init {
+            System.loadLibrary("emg_dsp")
+        }
+    }
+}
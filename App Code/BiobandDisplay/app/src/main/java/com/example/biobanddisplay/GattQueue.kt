@@ -0,0 +1,105 @@
+package com.example.biobanddisplay
+
+/**
+ * Runs GATT operations one at a time.
+ *
+ * BluetoothGatt allows one outstanding request. A writeDescriptor() or
+ * readCharacteristic() issued before the previous one's callback returns
+ * false and is lost. Steps are queued with [enqueue], and each one
+ * starts when the one before it has finished: its callback calls
+ * [complete] with the same key, or [timeoutMs] passes. A stack that never
+ * answers (onPhyUpdate is not called on some phones when the PHY does not
+ * change) therefore delays setup instead of stopping it. An operation whose
+ * start returns false or throws is skipped. One without a callback
+ * (requestConnectionPriority) is enqueued with awaitsCallback = false and
+ * counts as done once started.
+ *
+ * Not thread-safe: BleConnectionManager calls it on the main thread and
+ * posts the GATT callbacks there. [schedule] and [cancel] run the timeout,
+ * on a Handler in the app.
+ */
+class GattQueue(
+    private val timeoutMs: Long,
+    private val schedule: (Runnable, Long) -> Unit,
+    private val cancel: (Runnable) -> Unit,
+    private val log: (String) -> Unit,
+) {
+    private class Op(val key: String, val awaitsCallback: Boolean, val start: () -> Boolean)
+
+    private val pending = ArrayDeque<Op>()
+    private var current: Op? = null
+    private val timeout = Runnable {
+        current?.let {
+            log("GATT ${it.key} timed out after $timeoutMs ms")
+            timedOut++
+            current = null
+            next()
+        }
+    }
+
+    /** Operations that finished through their callback, or had none. */
+    var completed = 0
+        private set
+    /** Operations whose start returned false or threw. */
+    var failed = 0
+        private set
+    var timedOut = 0
+        private set
+
+    /** True when nothing is running or waiting. */
+    val isIdle: Boolean get() = current == null && pending.isEmpty()
+
+    /** Key of the operation waiting for its callback, if any. */
+    val currentKey: String? get() = current?.key
+
+    fun enqueue(key: String, awaitsCallback: Boolean = true, start: () -> Boolean) {
+        pending.addLast(Op(key, awaitsCallback, start))
+        if (current == null) next()
+    }
+
+    /**
+     * Ends the running operation if its key is [key] and starts the next
+     * one. Returns false for a callback the queue did not wait for, such as
+     * one that arrives after its operation timed out.
+     */
+    fun complete(key: String): Boolean {
+        if (current?.key != key) return false
+        cancel(timeout)
+        completed++
+        current = null
+        next()
+        return true
+    }
+
+    /** Drops the running and waiting operations, for a closed connection. */
+    fun clear() {
+        cancel(timeout)
+        current = null
+        pending.clear()
+    }
+
+    private fun next() {
+        while (current == null) {
+            val op = pending.removeFirstOrNull() ?: return
+            current = op
+            val started = try {
+                op.start().also { if (!it) log("GATT ${op.key} not started") }
+            } catch (e: RuntimeException) {
+                // SecurityException when a permission was revoked
+                log("GATT ${op.key} failed: $e")
+                false
+            }
+            when {
+                !started -> {
+                    failed++
+                    current = null
+                }
+                !op.awaitsCallback -> {
+                    completed++
+                    current = null
+                }
+                else -> schedule(timeout, timeoutMs)
+            }
+        }
+    }
+}
@@ -0,0 +1,147 @@
+package com.example.biobanddisplay
+
+/**
+ * Compression for one chunk of a time series, as in Facebook's Gorilla
+ * (Pelkonen et al., VLDB 2015). Used by [TimeSeriesStore].
+ *
+ * The first timestamp and value are stored whole. After that, each
+ * timestamp is stored as the change in its delta: 1 bit when samples are
+ * evenly spaced, 9 to 16 bits for jitter, 68 bits for anything larger. Each
+ * value is XORed with the previous one. An unchanged value costs 1 bit;
+ * otherwise only the bits between the leading and trailing zeros of the
+ * XOR are kept. Metrics stored once a second take a few bytes per point,
+ * against 20 or more as CSV text.
+ *
+ * The count is not stored; the caller keeps it next to the chunk.
+ */
+object GorillaCodec {
+
+    /** Encodes [count] points starting at [from]. Times must fit in a Long delta. */
+    fun encode(timesMs: LongArray, values: DoubleArray, from: Int, count: Int): ByteArray {
+        val w = BitWriter(count * 4 + 16)
+        if (count == 0) return w.toByteArray()
+        var prevT = timesMs[from]
+        var prevDelta = 0L
+        var prevV = values[from].toRawBits()
+        var prevLeading = -1
+        var prevTrailing = 0
+        w.write(prevT, 64)
+        w.write(prevV, 64)
+        for (i in from + 1 until from + count) {
+            val t = timesMs[i]
+            val delta = t - prevT
+            val dod = delta - prevDelta
+            when (dod) {
+                0L -> w.write(0, 1)
+                in -64L..63L -> { w.write(0b10, 2); w.write(dod, 7) }
+                in -256L..255L -> { w.write(0b110, 3); w.write(dod, 9) }
+                in -2048L..2047L -> { w.write(0b1110, 4); w.write(dod, 12) }
+                else -> { w.write(0b1111, 4); w.write(dod, 64) }
+            }
+            prevT = t
+            prevDelta = delta
+
+            val v = values[i].toRawBits()
+            val x = v xor prevV
+            if (x == 0L) {
+                w.write(0, 1)
+            } else {
+                val leading = minOf(java.lang.Long.numberOfLeadingZeros(x), 31)
+                val trailing = java.lang.Long.numberOfTrailingZeros(x)
+                if (prevLeading >= 0 && leading >= prevLeading && trailing >= prevTrailing) {
+                    // Fits the previous window of meaningful bits
+                    w.write(0b10, 2)
+                    w.write(x ushr prevTrailing, 64 - prevLeading - prevTrailing)
+                } else {
+                    val significant = 64 - leading - trailing
+                    w.write(0b11, 2)
+                    w.write(leading.toLong(), 5)
+                    // 64 does not fit 6 bits; it is stored as 0
+                    w.write((significant and 63).toLong(), 6)
+                    w.write(x ushr trailing, significant)
+                    prevLeading = leading
+                    prevTrailing = trailing
+                }
+            }
+            prevV = v
+        }
+        return w.toByteArray()
+    }
+
+    /** Decodes [count] points from [length] bytes of [bytes] into the arrays at [to]. */
+    fun decode(bytes: ByteArray, offset: Int, length: Int, count: Int,
+               timesMs: LongArray, values: DoubleArray, to: Int) {
+        if (count == 0) return
+        val r = BitReader(bytes, offset, length)
+        var t = r.read(64)
+        var delta = 0L
+        var v = r.read(64)
+        var leading = 0
+        var trailing = 0
+        timesMs[to] = t
+        values[to] = Double.fromBits(v)
+        for (i in to + 1 until to + count) {
+            val dod = when {
+                !r.readBit() -> 0L
+                !r.readBit() -> r.readSigned(7)
+                !r.readBit() -> r.readSigned(9)
+                !r.readBit() -> r.readSigned(12)
+                else -> r.read(64)
+            }
+            delta += dod
+            t += delta
+            timesMs[i] = t
+
+            if (r.readBit()) {
+                if (r.readBit()) {
+                    leading = r.read(5).toInt()
+                    val significant = r.read(6).toInt().let { if (it == 0) 64 else it }
+                    trailing = 64 - leading - significant
+                }
+                v = v xor (r.read(64 - leading - trailing) shl trailing)
+            }
+            values[i] = Double.fromBits(v)
+        }
+    }
+
+    private class BitWriter(initialBytes: Int) {
+        private var bytes = ByteArray(maxOf(initialBytes, 16))
+        private var bitPos = 0
+
+        /** Writes the low [bits] bits of [value], most significant first. */
+        fun write(value: Long, bits: Int) {
+            if ((bitPos + bits + 7) / 8 > bytes.size) {
+                bytes = bytes.copyOf(maxOf(bytes.size * 2, (bitPos + bits + 7) / 8))
+            }
+            for (i in bits - 1 downTo 0) {
+                if ((value ushr i) and 1L != 0L) {
+                    bytes[bitPos ushr 3] = (bytes[bitPos ushr 3].toInt() or (0x80 ushr (bitPos and 7))).toByte()
+                }
+                bitPos++
+            }
+        }
+
+        fun toByteArray(): ByteArray = bytes.copyOf((bitPos + 7) / 8)
+    }
+
+    private class BitReader(private val bytes: ByteArray, offset: Int, length: Int) {
+        private var bitPos = offset * 8L
+        private val endBit = (offset + length) * 8L
+
+        fun readBit(): Boolean {
+            check(bitPos < endBit) { "Chunk ends early" }
+            val bit = (bytes[(bitPos ushr 3).toInt()].toInt() ushr (7 - (bitPos and 7).toInt())) and 1
+            bitPos++
+            return bit != 0
+        }
+
+        fun read(bits: Int): Long {
+            var v = 0L
+            for (i in 0 until bits) v = (v shl 1) or (if (readBit()) 1L else 0L)
+            return v
+        }
+
+        /** [bits] bits in two's complement. */
+        fun readSigned(bits: Int): Long = (read(bits) shl (64 - bits)) shr (64 - bits)
+    }
+}
@@ -2,15 +2,24 @@ package com.example.biobanddisplay
 
 import android.content.Context
 import android.os.Bundle
+import android.util.Log
 import android.widget.Button
 import android.widget.EditText
+import android.widget.TextView
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
+import java.io.IOException
+import java.text.ParseException
 import java.text.SimpleDateFormat
 import java.util.*
+import kotlin.concurrent.thread
+import kotlin.math.sqrt
 
 class JournalActivity : AppCompatActivity() {
 
+    private val TAG = "JOURNAL"
+    private lateinit var correlationText: TextView
+
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
         setContentView(R.layout.activity_journal)
@@ -20,9 +29,10 @@ class JournalActivity : AppCompatActivity() {
         val dateInput = findViewById<EditText>(R.id.date_input)
         val saveButton = findViewById<Button>(R.id.save_journal_button)
         val backButton = findViewById<Button>(R.id.back_button)
+        correlationText = findViewById(R.id.correlation_text)
 
         // Set current date as default
-        val sdf = SimpleDateFormat("yyyy-MM-dd", Locale.getDefault())
+        val sdf = SimpleDateFormat("yyyy-MM-dd", Locale.getDefault()).apply { isLenient = false }
         dateInput.setText(sdf.format(Date()))
 
         saveButton.setOnClickListener {
@@ -47,16 +57,29 @@ class JournalActivity : AppCompatActivity() {
                 return@setOnClickListener
             }
 
-            // Save data using SharedPreferences
-            val sharedPref = getSharedPreferences("BiobandJournal", Context.MODE_PRIVATE)
-            with (sharedPref.edit()) {
-                putString("${date}_soreness", soreness)
-                putString("${date}_tiredness", tiredness)
-                apply()
+            // Noon of the entry's day, so it stays in that day's bucket across DST changes
+            val dayMs = try {
+                sdf.parse(date)!!.time + NOON_MS
+            } catch (e: ParseException) {
+                Toast.makeText(this, "Date must be YYYY-MM-DD", Toast.LENGTH_SHORT).show()
+                return@setOnClickListener
+            }
+
+            val context = applicationContext
+            thread(name = "journal-save") {
+                try {
+                    val store = MonitorService.store(context)
+                    store.append(MonitorService.SERIES_SORENESS, dayMs, sorenessInt.toDouble())
+                    store.append(MonitorService.SERIES_TIREDNESS, dayMs, tirednessInt.toDouble())
+                    store.flush()
+                } catch (e: IOException) {
+                    Log.e(TAG, "Journal save failed", e)
+                }
+                showCorrelation(context)
             }
 
             Toast.makeText(this, "Entry saved for $date", Toast.LENGTH_SHORT).show()
-            
+
             // Clear inputs after saving
             sorenessInput.text.clear()
             tirednessInput.text.clear()
@@ -65,5 +88,100 @@ class JournalActivity : AppCompatActivity() {
         backButton.setOnClickListener {
             finish()
         }
+
+        val context = applicationContext
+        thread(name = "journal-load") {
+            migratePreferences(context)
+            showCorrelation(context)
+        }
+    }
+
+    // Entries saved before the store was added, once
+    private fun migratePreferences(context: Context) {
+        val sdf = SimpleDateFormat("yyyy-MM-dd", Locale.getDefault()).apply { isLenient = false }
+        val prefs = context.getSharedPreferences("BiobandJournal", Context.MODE_PRIVATE)
+        val entries = prefs.all
+        if (entries.isEmpty()) return
+        try {
+            val store = MonitorService.store(context)
+            for ((key, value) in entries) {
+                val score = (value as? String)?.toDoubleOrNull() ?: continue
+                val dayMs = try {
+                    sdf.parse(key.substringBefore('_'))?.time?.plus(NOON_MS)
+                } catch (e: ParseException) {
+                    null
+                } ?: continue
+                when (key.substringAfter('_')) {
+                    "soreness" -> store.append(MonitorService.SERIES_SORENESS, dayMs, score)
+                    "tiredness" -> store.append(MonitorService.SERIES_TIREDNESS, dayMs, score)
+                }
+            }
+            store.flush()
+            prefs.edit().clear().apply()
+            Log.i(TAG, "Moved ${entries.size} journal values to the store")
+        } catch (e: IOException) {
+            Log.e(TAG, "Journal migration failed", e)
+        }
+    }
+
+    // Background thread: the last 30 days' scores against that day's mean EMG Vrms
+    private fun showCorrelation(context: Context) {
+        val text = try {
+            val store = MonitorService.store(context)
+            val before = store.bytesRead
+            val toMs = System.currentTimeMillis()
+            val fromMs = toMs - 30 * TimeSeriesStore.DAY_MS
+            val emg = store.rollup(MonitorService.SERIES_EMG_VRMS, TimeSeriesStore.DAY_MS, fromMs, toMs)
+            val soreness = correlate(store, store.range(MonitorService.SERIES_SORENESS, fromMs, toMs), emg)
+            val tiredness = correlate(store, store.range(MonitorService.SERIES_TIREDNESS, fromMs, toMs), emg)
+            Log.d(TAG, "Correlation read ${store.bytesRead - before} bytes")
+            "Last 30 days, against daily EMG Vrms:\n" +
+                "Soreness: ${describe(soreness)}\nTiredness: ${describe(tiredness)}"
+        } catch (e: IOException) {
+            Log.e(TAG, "Journal correlation failed", e)
+            "Correlation unavailable"
+        }
+        runOnUiThread { correlationText.text = text }
+    }
+
+    private fun describe(r: Pair<Double, Int>): String =
+        if (r.second < MIN_DAYS) "not enough days yet (${r.second} of $MIN_DAYS)"
+        else "r = %.2f over %d days".format(Locale.US, r.first, r.second)
+
+    // Pearson's r and the number of days with both a score and EMG
+    private fun correlate(store: TimeSeriesStore, scores: SeriesPoints, daily: SeriesRollup): Pair<Double, Int> {
+        val emgByDay = HashMap<Long, Double>()
+        for (i in 0 until daily.size) emgByDay[daily.startsMs[i]] = daily.mean(i)
+        // Points come in time order, so a rewritten day keeps its last score
+        val scoreByDay = HashMap<Long, Double>()
+        for (i in 0 until scores.size) {
+            scoreByDay[store.bucketStart(scores.timesMs[i], TimeSeriesStore.DAY_MS)] = scores.values[i]
+        }
+        val xs = ArrayList<Double>()
+        val ys = ArrayList<Double>()
+        for ((day, score) in scoreByDay) {
+            val emg = emgByDay[day] ?: continue
+            xs.add(score)
+            ys.add(emg)
+        }
+        val n = xs.size
+        if (n < 2) return 0.0 to n
+        val mx = xs.average()
+        val my = ys.average()
+        var sxy = 0.0
+        var sxx = 0.0
+        var syy = 0.0
+        for (i in 0 until n) {
+            sxy += (xs[i] - mx) * (ys[i] - my)
+            sxx += (xs[i] - mx) * (xs[i] - mx)
+            syy += (ys[i] - my) * (ys[i] - my)
+        }
+        val r = if (sxx > 0 && syy > 0) sxy / sqrt(sxx * syy) else 0.0
+        return r to n
+    }
+
+    companion object {
+        private const val MIN_DAYS = 3
+        private const val NOON_MS = 12 * TimeSeriesStore.HOUR_MS
     }
 }
@@ -18,10 +18,10 @@ import android.widget.Button
 import android.widget.TextView
 import android.widget.Toast
 import androidx.activity.result.contract.ActivityResultContracts
+import androidx.appcompat.app.AlertDialog
 import androidx.appcompat.app.AppCompatActivity
 import androidx.core.app.ActivityCompat
-import com.chaquo.python.Python
-import com.chaquo.python.android.AndroidPlatform
+import java.io.File
 import kotlin.concurrent.thread
 
 class MainActivity : AppCompatActivity(), ConnectionStateListener {
@@ -37,9 +37,11 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
     }
 
     // App State
-    private var isPythonReady = false
+    private var isInitialized = false
     private var isBleReady = false
     private var scanning = false
+    // Set from a playback request until it ends, so nothing scans meanwhile
+    private var playbackRequested = false
 
     // UI and Threading
     private val handler = Handler(Looper.getMainLooper())
@@ -50,15 +52,19 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
     private lateinit var testDataButton: Button
     private lateinit var realTimeButton: Button
     private lateinit var journalButton: Button
+    private lateinit var playbackButton: Button
     private lateinit var buttonsContainer: View
 
     // Constants
     private val SCAN_PERIOD: Long = 15000
     private val DEVICE_NAME = "Test Device"
+    // nRF52840_code/ble_throughput_bench, which runs a benchmark once connected
+    private val BENCH_DEVICE_NAME = "BLE_BENCH"
 
     private val requestPermissionLauncher =
         registerForActivityResult(ActivityResultContracts.RequestMultiplePermissions()) { permissions ->
-            val allGranted = permissions.all { it.value }
+            // Without notifications the monitor still runs, its notification is just hidden
+            val allGranted = permissions.filterKeys { it != Manifest.permission.POST_NOTIFICATIONS }.all { it.value }
             if (allGranted) {
                 Log.d(TAG, "Permissions granted.")
                 startAppInitialization()
@@ -71,6 +77,7 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
         super.onCreate(savedInstanceState)
         setContentView(R.layout.activity_main)
         Log.d(TAG, "onCreate: Activity starting.")
+        BleConnectionManager.startup.mark("activity")
 
         // --- Initialize UI ---
         statusText = findViewById(R.id.status_text)
@@ -80,11 +87,12 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
         testDataButton = findViewById(R.id.test_data_button)
         realTimeButton = findViewById(R.id.real_time_button)
         journalButton = findViewById(R.id.journal_button)
+        playbackButton = findViewById(R.id.playback_button)
         buttonsContainer = findViewById(R.id.buttons_container)
 
         // --- Setup Click Listeners ---
         showGraphButton.setOnClickListener {
-            if (BleConnectionManager.gatt != null) {
+            if (BleConnectionManager.isStreaming) {
                 val intent = Intent(this, GraphActivity::class.java)
                 startActivity(intent)
             } else {
@@ -118,6 +126,13 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
             val intent = Intent(this, JournalActivity::class.java)
             startActivity(intent)
         }
+
+        playbackButton.setOnClickListener {
+            thread(name = "playback-sources") {
+                val sources = playbackSources()
+                runOnUiThread { choosePlayback(sources) }
+            }
+        }
         // --- End of Setup ---
 
 
@@ -127,7 +142,14 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
     }
 
     private fun requestPermissions() {
-        val permissionsToRequest = if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
+        val permissionsToRequest = if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+            arrayOf(
+                Manifest.permission.BLUETOOTH_SCAN,
+                Manifest.permission.BLUETOOTH_CONNECT,
+                Manifest.permission.ACCESS_FINE_LOCATION,
+                Manifest.permission.POST_NOTIFICATIONS
+            )
+        } else if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
             arrayOf(
                 Manifest.permission.BLUETOOTH_SCAN,
                 Manifest.permission.BLUETOOTH_CONNECT,
@@ -157,26 +179,14 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
             return
         }
 
-        if (!isPythonReady) {
-            thread(start = true) {
-                if (!Python.isStarted()) {
-                    Python.start(AndroidPlatform(this@MainActivity))
-                    Log.d(TAG, "Python started successfully.")
-                }
-                isPythonReady = true
-                handler.post { startBleSetup() }
-            }
-        } else {
-            startBleSetup()
-        }
+        // The interpreter starts in the background; scanning does not wait for it
+        PythonRuntime.warmUp(applicationContext)
+        isInitialized = true
+        if (playbackFromIntent()) return
+        startBleSetup()
     }
 
     private fun startBleSetup() {
-        if (!isPythonReady) {
-            Log.e(TAG, "Cannot start BLE setup until Python is ready.")
-            return
-        }
-
         isBleReady = false
         if (!bluetoothAdapter.isEnabled) {
             val enableBtIntent = Intent(BluetoothAdapter.ACTION_REQUEST_ENABLE)
@@ -195,7 +205,7 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
         super.onResume()
         BleConnectionManager.connectionListener = this
 
-        if (isPythonReady && bluetoothAdapter.isEnabled && !isBleReady && BleConnectionManager.gatt == null) {
+        if (isInitialized && bluetoothAdapter.isEnabled && !BleConnectionManager.isStreaming && !MonitorService.isRunning) {
             isBleReady = true
             startBleScan()
         }
@@ -210,9 +220,10 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
 
     @SuppressLint("MissingPermission")
     private fun startBleScan() {
-        if (scanning || !isBleReady) return
+        if (scanning || !isBleReady || playbackRequested) return
         scanning = true
         Log.i(TAG, "Starting BLE scan...")
+        BleConnectionManager.startup.mark("scan")
         handler.post { statusText.text = "Scanning for $DEVICE_NAME..." }
         handler.postDelayed({
             if (scanning) stopBleScan()
@@ -231,8 +242,10 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
     private val leScanCallback: ScanCallback = object : ScanCallback() {
         @SuppressLint("MissingPermission")
         override fun onScanResult(callbackType: Int, result: ScanResult) {
-            if (result.device.name == DEVICE_NAME) {
+            val name = result.device.name
+            if (name == DEVICE_NAME || name == BENCH_DEVICE_NAME) {
                 Log.i(TAG, "Found device: ${result.device.name} @ ${result.device.address}")
+                BleConnectionManager.startup.mark("device_found")
                 stopBleScan()
                 connectToDevice(result.device)
             }
@@ -247,7 +260,10 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
     private fun connectToDevice(device: BluetoothDevice) {
         Log.i(TAG, "Connecting to ${device.address}...")
         handler.post { statusText.text = "Connecting..." }
-        BleConnectionManager.gatt = device.connectGatt(this, false, BleConnectionManager.gattCallback)
+        // The service owns the connection, so monitoring goes on with the screen off.
+        // "--ez optimize_link false" on the launch intent keeps Android's link defaults.
+        MonitorService.connect(applicationContext, device,
+            optimizeLink = intent.getBooleanExtra(MonitorService.EXTRA_OPTIMIZE_LINK, true))
     }
 
     override fun onConnectionStateChanged(state: Int, status: Int) {
@@ -255,35 +271,116 @@ class MainActivity : AppCompatActivity(), ConnectionStateListener {
             when (state) {
                 BluetoothProfile.STATE_CONNECTED -> {
                     if (status == BluetoothGatt.GATT_SUCCESS) {
-                        Log.i(TAG, "Device connected successfully. Discovering services...")
-                        statusText.text = "Device Connected!"
+                        Log.i(TAG, "Device connected successfully.")
+                        statusText.text = if (BleConnectionManager.playback != null) "Playing back..." else "Device Connected!"
                         buttonsContainer.visibility = View.VISIBLE
-
-                        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S && ActivityCompat.checkSelfPermission(
-                                this, Manifest.permission.BLUETOOTH_CONNECT
-                            ) != PackageManager.PERMISSION_GRANTED
-                        ) {
-                            return@post
-                        }
-                        BleConnectionManager.gatt?.discoverServices()
                     }
                 }
                 BluetoothProfile.STATE_DISCONNECTED -> {
                     Log.w(TAG, "Device disconnected.")
-                    statusText.text = "Disconnected. Scanning again..."
                     buttonsContainer.visibility = View.GONE
-                    isBleReady = true
-                    startBleScan()
+                    when {
+                        status == BleConnectionManager.STATUS_PLAYBACK_DONE -> {
+                            playbackRequested = false
+                            statusText.text = "Playback finished."
+                        }
+                        // The band's connection, closed to start a playback
+                        BleConnectionManager.playback != null -> {}
+                        // MonitorService reconnects when the device is back in range
+                        MonitorService.isRunning -> statusText.text = "Disconnected. Waiting for the device..."
+                        else -> {
+                            playbackRequested = false
+                            statusText.text = "Disconnected. Scanning again..."
+                            isBleReady = true
+                            startBleScan()
+                        }
+                    }
                 }
             }
         }
     }
 
-    @SuppressLint("MissingPermission")
+    // Recorded sessions, files pushed to the app's playback folder, then the bundled CSVs.
+    // Not on the main thread: finding the bundled files waits for the Python runtime.
+    private fun playbackSources(): List<File> {
+        val sessions = File(filesDir, "sessions").listFiles { f -> f.name.endsWith(".bin") }.orEmpty()
+        val pushed = getExternalFilesDir(PLAYBACK_DIR)?.listFiles { f -> f.isFile }.orEmpty()
+        val bundled = try {
+            val path = PythonRuntime.module(applicationContext, "sys")["path"]?.asList().orEmpty()
+            BUNDLED_CSVS.mapNotNull { name -> path.map { File(it.toString(), name) }.firstOrNull { it.exists() } }
+        } catch (e: Exception) {
+            Log.e(TAG, "Bundled CSVs not found", e)
+            emptyList()
+        }
+        return sessions.sortedBy { it.name } + pushed.sortedBy { it.name } + bundled
+    }
+
+    private fun choosePlayback(sources: List<File>) {
+        if (sources.isEmpty()) {
+            Toast.makeText(this, "No recorded sessions to play.", Toast.LENGTH_SHORT).show()
+            return
+        }
+        val checked = BooleanArray(sources.size)
+        AlertDialog.Builder(this)
+            .setTitle("Sessions to play, in order")
+            .setMultiChoiceItems(sources.map { it.name }.toTypedArray(), checked) { _, i, on -> checked[i] = on }
+            .setPositiveButton("Next") { _, _ ->
+                val files = sources.filterIndexed { i, _ -> checked[i] }
+                if (files.isNotEmpty()) chooseSpeed(files)
+            }
+            .setNegativeButton("Cancel", null)
+            .show()
+    }
+
+    private fun chooseSpeed(files: List<File>) {
+        AlertDialog.Builder(this)
+            .setTitle("Playback speed")
+            .setItems(PLAYBACK_SPEED_NAMES) { _, i -> startPlayback(files, PLAYBACK_SPEEDS[i]) }
+            .show()
+    }
+
+    private fun startPlayback(files: List<File>, speed: Double) {
+        playbackRequested = true
+        stopBleScan()
+        statusText.text = "Starting playback..."
+        MonitorService.playback(applicationContext, files, speed)
+    }
+
+    /**
+     * For scripted runs, e.g.
+     * adb shell am start -n com.example.biobanddisplay/.MainActivity
+     *   --es playback session_20250101_120000_000.bin --es playback_speed 0
+     * Names are comma separated, looked up in the playback folder, then in
+     * filesDir/sessions; speed 0 is as fast as possible.
+     */
+    private fun playbackFromIntent(): Boolean {
+        val names = intent.getStringExtra(MonitorService.EXTRA_PLAYBACK) ?: return false
+        val speed = intent.getStringExtra(MonitorService.EXTRA_PLAYBACK_SPEED)?.toDoubleOrNull() ?: 1.0
+        val dirs = listOfNotNull(getExternalFilesDir(PLAYBACK_DIR), File(filesDir, "sessions"))
+        val files = names.split(',').map { name ->
+            val file = File(name.trim())
+            if (file.isAbsolute) file else dirs.map { File(it, name.trim()) }.firstOrNull { it.exists() } ?: file
+        }
+        val missing = files.filterNot { it.exists() }
+        if (missing.isNotEmpty()) {
+            Log.e(TAG, "Playback files not found: $missing")
+            return false
+        }
+        startPlayback(files, speed)
+        return true
+    }
+
+    // The connection stays with MonitorService; it is stopped from its notification
     override fun onDestroy() {
         super.onDestroy()
         stopBleScan()
-        BleConnectionManager.gatt?.close()
-        BleConnectionManager.gatt = null
+    }
+
+    private companion object {
+        // Pushed with adb to Android/data/<package>/files/playback
+        const val PLAYBACK_DIR = "playback"
+        val BUNDLED_CSVS = listOf("sample_data.csv", "ppg_filtered_data.csv")
+        val PLAYBACK_SPEED_NAMES = arrayOf("Real time", "10x", "As fast as possible")
+        val PLAYBACK_SPEEDS = doubleArrayOf(1.0, 10.0, SessionPlayback.FASTEST)
     }
 }
@@ -0,0 +1,610 @@
+package com.example.biobanddisplay
+
+import android.annotation.SuppressLint
+import android.app.Notification
+import android.app.NotificationManager
+import android.app.PendingIntent
+import android.app.Service
+import android.bluetooth.BluetoothDevice
+import android.bluetooth.BluetoothGatt
+import android.bluetooth.BluetoothProfile
+import android.content.Context
+import android.content.Intent
+import android.content.pm.ServiceInfo
+import android.os.BatteryManager
+import android.os.Build
+import android.os.Handler
+import android.os.IBinder
+import android.os.Looper
+import android.os.PowerManager
+import android.os.Process
+import android.os.SystemClock
+import android.util.Log
+import androidx.core.app.NotificationChannelCompat
+import androidx.core.app.NotificationCompat
+import androidx.core.app.NotificationManagerCompat
+import androidx.core.app.ServiceCompat
+import androidx.core.content.ContextCompat
+import androidx.core.content.IntentCompat
+import com.chaquo.python.PyObject
+import java.io.File
+import java.io.IOException
+import java.util.Locale
+import java.util.concurrent.CopyOnWriteArrayList
+import java.util.concurrent.Future
+import kotlin.math.abs
+import kotlin.math.sqrt
+
+/** The monitor's latest analysis, as screens get it. */
+class MonitorResult(
+    val emgVrms: Float = 0f,
+    val emgMeanFrequency: Float = 0f,
+    val emgResting: Boolean = true,
+    val emgBursts: Int = 0,
+    /** Only per-window features arrive (stream tier), so there is no TDMF. */
+    val emgFeaturesOnly: Boolean = false,
+    val ppgBpm: Float = 0f,
+    val ppgSpo2: Float = 0f,
+    /** PPG analyses so far; 0 until the first one. */
+    val ppgUpdates: Int = 0,
+    /** Filtered red PPG samples added since the previous result. */
+    val ppgPoints: FloatArray = FloatArray(0),
+)
+
+fun interface MonitorResultListener {
+    // Called on the main thread
+    fun onMonitorResult(result: MonitorResult)
+}
+
+/**
+ * Foreground service that keeps monitoring while the screen is off.
+ *
+ * The service owns the GATT connection ([connect]), the session recording
+ * and the analysis. BleConnectionManager hands it each channel's block on
+ * the "ble-worker" thread. EMG goes through [EmgDsp], PPG through
+ * ppg_analyzer.PpgSession, once per block. The worker never waits for
+ * Python: until PythonRuntime has imported ppg_analyzer, PPG text is kept
+ * and analysed once it is there. While no screen plots live data a block
+ * comes every [EXTRA_BATCH_MS] (1 s by default).
+ *
+ * Screens subscribe with [addResultListener] and get a [MonitorResult] on
+ * the main thread at most every [EXTRA_RESULT_MS]. Without subscribers
+ * nothing is posted to the main thread.
+ *
+ * About once a second the metrics also go into the long-term
+ * [TimeSeriesStore] ([store]), as the SERIES_* series, for day and week
+ * views and the journal. The store is flushed every minute, so a killed
+ * process loses at most a minute of metrics.
+ *
+ * If the link drops, the service reconnects with autoConnect, which waits
+ * for the device without scanning. The notification's Stop action ends
+ * monitoring.
+ *
+ * [playback] runs the same way with recorded files in place of a band
+ * (BleConnectionManager.startPlayback). Metrics then go to a store of their
+ * own, so test runs stay out of the user's history. Analysis starts from a
+ * clean state, and the service stops when the files have been played, after
+ * logging the session figures below.
+ *
+ * Every minute it logs, under "MONITOR", the app's wakeups, CPU time and
+ * battery drain: ingest thread wakeups, worker batches and main-thread
+ * posts. Binder callbacks for each notification are not counted. When it
+ * stops, it logs the screen-off totals for the whole session.
+ */
+class MonitorService : Service(), ConnectionStateListener {
+
+    private val TAG = "MONITOR"
+    private val handler = Handler(Looper.getMainLooper())
+    private val worker = Handler(BleConnectionManager.workerLooper)
+    private var device: BluetoothDevice? = null
+    private var playing = false
+    @Volatile private var resultIntervalMs = DEFAULT_RESULT_INTERVAL_MS
+
+    // Analysis state, only touched on the worker thread
+    private var emgDsp: EmgDsp? = null
+    private var emgScratch = FloatArray(256)
+    private var emgFeaturesOnly = false
+    private var featureVrms = 0f
+    private var featureResting = true
+    private val ppgText = StringBuilder()
+    private var ppgPoints = FloatArray(256)
+    private var ppgPointCount = 0
+    private var ppgUpdates = 0
+    private var ppgBpm = 0f
+    private var ppgSpo2 = 0f
+    private var lastResultNs = 0L
+    private var metricsStore: TimeSeriesStore? = null
+    private var emgSinceStored = false
+    private var storedPpgUpdates = 0
+    private var lastStoredMs = 0L
+    @Volatile private var batches = 0L
+    @Volatile private var resultPosts = 0L
+
+    private var ppgModule: Future<PyObject>? = null
+    private var ppgSession: PyObject? = null
+    private var ppgUnavailable = false
+
+    // Power figures, on the main thread
+    private lateinit var batteryManager: BatteryManager
+    private lateinit var powerManager: PowerManager
+    private val total = Usage()
+    private val screenOff = Usage()
+    private val last = Usage()
+    private var startChargeUah = 0L
+    private val statsRunnable = object : Runnable {
+        override fun run() {
+            logMinute()
+            worker.post { flushStore() }
+            handler.postDelayed(this, STATS_INTERVAL_MS)
+        }
+    }
+
+    private val analysis: (SampleBlock) -> Unit = { block -> analyze(block) }
+
+    override fun onCreate() {
+        super.onCreate()
+        batteryManager = getSystemService(Context.BATTERY_SERVICE) as BatteryManager
+        powerManager = getSystemService(Context.POWER_SERVICE) as PowerManager
+        NotificationManagerCompat.from(this).createNotificationChannel(
+            NotificationChannelCompat.Builder(CHANNEL_ID, NotificationManagerCompat.IMPORTANCE_LOW)
+                .setName("Monitoring")
+                .build())
+    }
+
+    override fun onStartCommand(intent: Intent?, flags: Int, startId: Int): Int {
+        // Must be foreground within a few seconds of startForegroundService()
+        ServiceCompat.startForeground(this, NOTIFICATION_ID, notification("Connecting..."),
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) ServiceInfo.FOREGROUND_SERVICE_TYPE_CONNECTED_DEVICE else 0)
+
+        val start = intent?.takeIf { it.action != ACTION_STOP }
+        val target = start?.let { IntentCompat.getParcelableExtra(it, EXTRA_DEVICE, BluetoothDevice::class.java) }
+        val files = start?.getStringArrayExtra(EXTRA_PLAYBACK)?.map { File(it) }
+        if (intent == null || (target == null && files.isNullOrEmpty())) {
+            stopSelf()
+            return START_NOT_STICKY
+        }
+
+        BleConnectionManager.batchIntervalMs = intent.getLongExtra(EXTRA_BATCH_MS, BleConnectionManager.DEFAULT_BATCH_INTERVAL_MS)
+        resultIntervalMs = intent.getLongExtra(EXTRA_RESULT_MS, DEFAULT_RESULT_INTERVAL_MS)
+        BleConnectionManager.optimizeLink = intent.getBooleanExtra(EXTRA_OPTIMIZE_LINK, true)
+        if (!isRunning) {
+            isRunning = true
+            BleConnectionManager.serviceConnectionListener = this
+            BleConnectionManager.blockAnalysis = analysis
+            startChargeUah = chargeUah()
+            last.set(sample())
+            handler.postDelayed(statsRunnable, STATS_INTERVAL_MS)
+        }
+        if (files != null && target == null) {
+            val speed = intent.getDoubleExtra(EXTRA_PLAYBACK_SPEED, 1.0)
+            device = null
+            playing = true
+            startAnalysis(PLAYBACK_STORE_DIR)
+            BleConnectionManager.startPlayback(applicationContext, files, speed)
+            return START_NOT_STICKY
+        }
+        if (playing) {
+            playing = false
+            startAnalysis(STORE_DIR)
+        }
+        connectGatt(target!!, autoConnect = false)
+        Log.i(TAG, "Monitoring ${target.address}, batches every ${BleConnectionManager.batchIntervalMs} ms")
+        return START_NOT_STICKY
+    }
+
+    override fun onBind(intent: Intent?): IBinder? = null
+
+    override fun onDestroy() {
+        super.onDestroy()
+        if (isRunning) {
+            isRunning = false
+            handler.removeCallbacks(statsRunnable)
+            logMinute()
+            logSession()
+        }
+        BleConnectionManager.serviceConnectionListener = null
+        BleConnectionManager.blockAnalysis = null
+        BleConnectionManager.disconnect()
+        // After any analysis still queued on the worker
+        worker.post {
+            emgDsp?.close()
+            emgDsp = null
+            flushStore()
+        }
+    }
+
+    override fun onConnectionStateChanged(state: Int, status: Int) {
+        when (state) {
+            BluetoothProfile.STATE_CONNECTED -> if (status == BluetoothGatt.GATT_SUCCESS) {
+                if (playing) {
+                    updateNotification("Playing back a recorded session")
+                    return
+                }
+                updateNotification("Monitoring ${device?.address}")
+                discoverServices()
+            }
+            BluetoothProfile.STATE_DISCONNECTED -> {
+                if (status == BleConnectionManager.STATUS_PLAYBACK_DONE) {
+                    stopSelf()
+                    return
+                }
+                updateNotification("Waiting for the device...")
+                device?.let { connectGatt(it, autoConnect = true) }
+            }
+        }
+    }
+
+    @SuppressLint("MissingPermission")
+    private fun connectGatt(target: BluetoothDevice, autoConnect: Boolean) {
+        device = target
+        BleConnectionManager.disconnect()
+        BleConnectionManager.startRecording(applicationContext)
+        BleConnectionManager.gatt = target.connectGatt(applicationContext, autoConnect, BleConnectionManager.gattCallback)
+    }
+
+    @SuppressLint("MissingPermission")
+    private fun discoverServices() {
+        BleConnectionManager.gatt?.discoverServices()
+    }
+
+    // A fresh analysis into the store in filesDir/[storeDir], after any block still queued
+    private fun startAnalysis(storeDir: String) {
+        worker.post {
+            emgDsp?.close()
+            emgDsp = null
+            emgFeaturesOnly = false
+            ppgSession = null
+            ppgText.setLength(0)
+            ppgPointCount = 0
+            ppgUpdates = 0
+            storedPpgUpdates = 0
+            ppgBpm = 0f
+            ppgSpo2 = 0f
+            emgSinceStored = false
+            flushStore()
+            metricsStore = TimeSeriesStore.shared(File(filesDir, storeDir))
+        }
+    }
+
+    // Worker thread, once per block
+    private fun analyze(block: SampleBlock) {
+        batches++
+        when (block.channel) {
+            StreamProto.CH_EMG -> {
+                analyzeEmg(block)
+                emgSinceStored = true
+            }
+            StreamProto.CH_PPG -> analyzePpg(block)
+            else -> return
+        }
+        publish()
+        storeMetrics()
+    }
+
+    private fun analyzeEmg(block: SampleBlock) {
+        // Text packets from older firmware: comma separated raw values at the nominal rate
+        for (line in block.text) {
+            var n = 0
+            for (v in line.split(',')) {
+                val x = v.trim().toFloatOrNull() ?: continue
+                if (n == emgScratch.size) emgScratch = emgScratch.copyOf(n * 2)
+                emgScratch[n++] = x
+            }
+            if (n > 0) emgEngine(DEFAULT_EMG_FS).push(emgScratch, n)
+            emgFeaturesOnly = false
+        }
+        if (block.frameCount == 0) return
+
+        var periodNs = 0L
+        var features = 0
+        var sumSquares = 0.0
+        var lastRms = 0
+        block.forEachFrame { frame ->
+            if (periodNs == 0L) periodNs = frame.periodNs
+            if (frame.format == StreamProto.FMT_I16_STATS && frame.count >= 4) {
+                lastRms = frame.getInt(3)
+                sumSquares += lastRms.toDouble() * lastRms
+                features++
+            }
+        }
+        // A features frame carries one window's min/max/mean/rms, not samples to filter
+        if (features > 0) {
+            emgFeaturesOnly = true
+            featureVrms = sqrt(sumSquares / features).toFloat()
+            featureResting = lastRms < EMG_THRESHOLD
+            return
+        }
+        if (block.size == 0) return
+        emgFeaturesOnly = false
+        val fs = if (periodNs > 0) (1e9 / (periodNs * BleConnectionManager.clockSync.rate)).toFloat() else DEFAULT_EMG_FS
+        emgEngine(fs).push(block.values, block.size)
+    }
+
+    private fun emgEngine(fs: Float): EmgDsp {
+        val current = emgDsp
+        if (current != null && abs(current.fs - fs) <= current.fs * 0.01f) return current
+        current?.close()
+        Log.d(TAG, "EMG analysis at %.1f Hz".format(Locale.US, fs))
+        return EmgDsp(fs).also { emgDsp = it }
+    }
+
+    // One Python call per block: its "red,ir" packets and frames joined into one
+    private fun analyzePpg(block: SampleBlock) {
+        if (ppgText.length > PPG_BACKLOG_CHARS) {
+            Log.w(TAG, "PPG analysis not ready, dropping ${ppgText.length} chars")
+            ppgText.setLength(0)
+        }
+        for (line in block.text) {
+            if (ppgText.isNotEmpty()) ppgText.append(',')
+            ppgText.append(line)
+        }
+        block.forEachFrame { frame ->
+            // A features frame has no red/IR pairs
+            if (frame.format != StreamProto.FMT_I16_STATS) {
+                if (ppgText.isNotEmpty()) ppgText.append(',')
+                ppgText.append(frame.toCsv())
+            }
+        }
+        if (ppgText.isEmpty()) return
+        val session = readyPpgSession() ?: return
+        try {
+            val result = session.callAttr("process", ppgText.toString()).asMap()
+            // Between updates the session returns the previous result unchanged
+            val updates = result[PyObject.fromJava("updates")]?.toInt() ?: 0
+            if (updates == ppgUpdates) return
+            ppgUpdates = updates
+
+            val pointsRed = result[PyObject.fromJava("points_red")]?.toJava(FloatArray::class.java) ?: floatArrayOf()
+            val newSamples = result[PyObject.fromJava("new_samples")]?.toInt() ?: pointsRed.size
+            ppgBpm = result[PyObject.fromJava("bpm")]?.toFloat() ?: 0f
+            ppgSpo2 = result[PyObject.fromJava("SpO2")]?.toFloat() ?: 0f
+
+            for (i in maxOf(0, pointsRed.size - newSamples) until pointsRed.size) {
+                if (ppgPointCount == ppgPoints.size) ppgPoints = ppgPoints.copyOf(ppgPointCount * 2)
+                ppgPoints[ppgPointCount++] = pointsRed[i]
+            }
+        } catch (e: Exception) {
+            Log.e(TAG, "PPG error", e)
+        } finally {
+            ppgText.setLength(0)
+        }
+    }
+
+    // Null until ppg_analyzer is imported; the import runs on python-init
+    private fun readyPpgSession(): PyObject? {
+        ppgSession?.let { return it }
+        val module = ppgModule ?: PythonRuntime.load(applicationContext, "ppg_analyzer").also { ppgModule = it }
+        if (!module.isDone) return null
+        return try {
+            module.get().callAttr("PpgSession").also { ppgSession = it }
+        } catch (e: Exception) {
+            // Logged once; the text is dropped from then on
+            if (!ppgUnavailable) Log.e(TAG, "PPG analysis unavailable", e)
+            ppgUnavailable = true
+            ppgText.setLength(0)
+            null
+        }
+    }
+
+    private fun publish() {
+        val now = System.nanoTime()
+        if (now - lastResultNs < resultIntervalMs * 1_000_000) return
+        lastResultNs = now
+        val dsp = emgDsp
+        val result = MonitorResult(
+            emgVrms = if (emgFeaturesOnly) featureVrms else dsp?.vrms ?: 0f,
+            emgMeanFrequency = if (emgFeaturesOnly) 0f else dsp?.meanFrequency ?: 0f,
+            emgResting = if (emgFeaturesOnly) featureResting else dsp?.isResting ?: true,
+            emgBursts = dsp?.bursts ?: 0,
+            emgFeaturesOnly = emgFeaturesOnly,
+            ppgBpm = ppgBpm,
+            ppgSpo2 = ppgSpo2,
+            ppgUpdates = ppgUpdates,
+            ppgPoints = ppgPoints.copyOf(ppgPointCount),
+        )
+        ppgPointCount = 0
+        latestResult = result
+        if (dsp != null || emgFeaturesOnly || ppgUpdates > 0) BleConnectionManager.startup.mark(StartupTrace.FIRST_METRIC)
+        if (resultListeners.isEmpty()) return
+        resultPosts++
+        handler.post {
+            for (l in resultListeners) l.onMonitorResult(result)
+        }
+    }
+
+    // Only metrics that changed since the previous point
+    private fun storeMetrics() {
+        val now = System.currentTimeMillis()
+        if (now - lastStoredMs < STORE_INTERVAL_MS) return
+        lastStoredMs = now
+        try {
+            val s = metricsStore ?: store(applicationContext).also { metricsStore = it }
+            val dsp = emgDsp
+            if (emgSinceStored) {
+                if (emgFeaturesOnly) {
+                    s.append(SERIES_EMG_VRMS, now, featureVrms.toDouble())
+                } else if (dsp != null) {
+                    s.append(SERIES_EMG_VRMS, now, dsp.vrms.toDouble())
+                    s.append(SERIES_EMG_MEAN_FREQUENCY, now, dsp.meanFrequency.toDouble())
+                }
+                emgSinceStored = false
+            }
+            if (ppgUpdates != storedPpgUpdates) {
+                storedPpgUpdates = ppgUpdates
+                s.append(SERIES_PPG_BPM, now, ppgBpm.toDouble())
+                s.append(SERIES_PPG_SPO2, now, ppgSpo2.toDouble())
+            }
+        } catch (e: IOException) {
+            Log.e(TAG, "Store write failed", e)
+        }
+    }
+
+    // Worker thread. Writes out the open chunks, which are only in memory until then
+    private fun flushStore() {
+        try {
+            metricsStore?.flush()
+        } catch (e: IOException) {
+            Log.e(TAG, "Store flush failed", e)
+        }
+    }
+
+    private fun notification(text: String): Notification {
+        val flags = PendingIntent.FLAG_IMMUTABLE or PendingIntent.FLAG_UPDATE_CURRENT
+        val open = PendingIntent.getActivity(this, 0, Intent(this, MainActivity::class.java), flags)
+        val stop = PendingIntent.getService(this, 0,
+            Intent(this, MonitorService::class.java).setAction(ACTION_STOP), flags)
+        return NotificationCompat.Builder(this, CHANNEL_ID)
+            .setSmallIcon(android.R.drawable.stat_sys_data_bluetooth)
+            .setContentTitle(getString(R.string.app_name))
+            .setContentText(text)
+            .setOngoing(true)
+            .setOnlyAlertOnce(true)
+            .setContentIntent(open)
+            .addAction(0, "Stop", stop)
+            .build()
+    }
+
+    private fun updateNotification(text: String) {
+        getSystemService(NotificationManager::class.java).notify(NOTIFICATION_ID, notification(text))
+    }
+
+    // Counters behind the wakeup and CPU figures
+    private class Usage {
+        var ms = 0L
+        var ingestWakeups = 0L
+        var batches = 0L
+        var uiPosts = 0L
+        var cpuMs = 0L
+        var chargeUah = 0L
+
+        fun set(o: Usage) {
+            ms = o.ms; ingestWakeups = o.ingestWakeups; batches = o.batches
+            uiPosts = o.uiPosts; cpuMs = o.cpuMs; chargeUah = o.chargeUah
+        }
+
+        fun add(now: Usage, before: Usage) {
+            ms += now.ms - before.ms
+            ingestWakeups += now.ingestWakeups - before.ingestWakeups
+            batches += now.batches - before.batches
+            uiPosts += now.uiPosts - before.uiPosts
+            cpuMs += now.cpuMs - before.cpuMs
+            chargeUah += now.chargeUah - before.chargeUah
+        }
+    }
+
+    private fun sample() = Usage().apply {
+        ms = SystemClock.elapsedRealtime()
+        ingestWakeups = BleConnectionManager.ingest.wakeups
+        batches = this@MonitorService.batches
+        uiPosts = BleConnectionManager.uiPosts + resultPosts
+        cpuMs = Process.getElapsedCpuTime()
+        // Charge left, so the drain is before - now
+        chargeUah = -chargeUah()
+    }
+
+    // Some devices report no charge counter (0 or Long.MIN_VALUE)
+    private fun chargeUah(): Long =
+        batteryManager.getLongProperty(BatteryManager.BATTERY_PROPERTY_CHARGE_COUNTER).coerceAtLeast(0)
+
+    private fun logMinute() {
+        val now = sample()
+        val minute = Usage().apply { add(now, last) }
+        val interactive = powerManager.isInteractive
+        if (!interactive) screenOff.add(now, last)
+        total.add(now, last)
+        last.set(now)
+        log("Monitor (screen ${if (interactive) "on" else "off"})", minute)
+    }
+
+    private fun logSession() {
+        log("Monitor session", total)
+        if (screenOff.ms > 0) log("Monitor session, screen off", screenOff)
+    }
+
+    private fun log(label: String, u: Usage) {
+        val minutes = u.ms / 60_000.0
+        val hours = minutes / 60
+        val wakeups = u.ingestWakeups + u.batches + u.uiPosts
+        val mah = if (startChargeUah > 0) u.chargeUah / 1000.0 else Double.NaN
+        Log.i(TAG, ("%s: %.2f h, %.0f wakeups/min (ingest %.0f, batches %.0f, UI posts %.0f), " +
+            "CPU %.0f ms/min (%.2f %%), battery %.1f mAh (%.1f mAh/h)").format(Locale.US,
+            label, hours, wakeups / minutes, u.ingestWakeups / minutes, u.batches / minutes,
+            u.uiPosts / minutes, u.cpuMs / minutes, u.cpuMs * 100.0 / u.ms.coerceAtLeast(1),
+            mah, mah / hours))
+    }
+
+    companion object {
+        const val EXTRA_DEVICE = "device"
+        /** Time between analysis batches while no screen plots live data, in ms. */
+        const val EXTRA_BATCH_MS = "batch_ms"
+        /** Shortest time between results sent to screens, in ms. */
+        const val EXTRA_RESULT_MS = "result_ms"
+        /** False to keep Android's default MTU, PHY and connection interval, for comparison. */
+        const val EXTRA_OPTIMIZE_LINK = "optimize_link"
+        /** Paths of files to play instead of connecting, see BleConnectionManager.startPlayback. */
+        const val EXTRA_PLAYBACK = "playback"
+        /** Playback speed, times real time; 0 for as fast as possible. */
+        const val EXTRA_PLAYBACK_SPEED = "playback_speed"
+        private const val ACTION_STOP = "com.example.biobanddisplay.STOP_MONITORING"
+        private const val CHANNEL_ID = "monitoring"
+        private const val NOTIFICATION_ID = 1
+        private const val DEFAULT_RESULT_INTERVAL_MS = 250L
+        private const val STATS_INTERVAL_MS = 60_000L
+        private const val STORE_INTERVAL_MS = 1_000L
+        private const val STORE_DIR = "timeseries"
+        private const val PLAYBACK_STORE_DIR = "playback_timeseries"
+        // About a minute of "red,ir" text at 100 Hz
+        private const val PPG_BACKLOG_CHARS = 1 shl 16
+
+        // Series in the long-term store
+        const val SERIES_EMG_VRMS = "emg_vrms"
+        const val SERIES_EMG_MEAN_FREQUENCY = "emg_mean_freq"
+        const val SERIES_PPG_BPM = "ppg_bpm"
+        const val SERIES_PPG_SPO2 = "ppg_spo2"
+        const val SERIES_SORENESS = "journal_soreness"
+        const val SERIES_TIREDNESS = "journal_tiredness"
+
+        // emg_analyzer.FS and THRESHOLD
+        const val DEFAULT_EMG_FS = 13333f
+        private const val EMG_THRESHOLD = 25
+
+        private val resultListeners = CopyOnWriteArrayList<MonitorResultListener>()
+
+        @Volatile var isRunning = false
+            private set
+        /** The newest result, for screens to show before the next one arrives. */
+        @Volatile var latestResult = MonitorResult()
+            private set
+
+        /** Starts monitoring [device] in the foreground, until stopped from the notification. */
+        fun connect(context: Context, device: BluetoothDevice,
+                    batchIntervalMs: Long = BleConnectionManager.DEFAULT_BATCH_INTERVAL_MS,
+                    optimizeLink: Boolean = true) {
+            val intent = Intent(context, MonitorService::class.java)
+                .putExtra(EXTRA_DEVICE, device)
+                .putExtra(EXTRA_BATCH_MS, batchIntervalMs)
+                .putExtra(EXTRA_OPTIMIZE_LINK, optimizeLink)
+            ContextCompat.startForegroundService(context, intent)
+        }
+
+        /** Plays [files] through the monitor in place of a band, then stops. */
+        fun playback(context: Context, files: List<File>, speed: Double) {
+            val intent = Intent(context, MonitorService::class.java)
+                .putExtra(EXTRA_PLAYBACK, files.map { it.absolutePath }.toTypedArray())
+                .putExtra(EXTRA_PLAYBACK_SPEED, speed)
+            ContextCompat.startForegroundService(context, intent)
+        }
+
+        /** The app's long-term metrics store, shared with the journal. */
+        fun store(context: Context): TimeSeriesStore =
+            TimeSeriesStore.shared(File(context.filesDir, STORE_DIR))
+
+        fun addResultListener(listener: MonitorResultListener) {
+            resultListeners.addIfAbsent(listener)
+        }
+
+        fun removeResultListener(listener: MonitorResultListener) {
+            resultListeners.remove(listener)
+        }
+    }
+}
@@ -0,0 +1,54 @@
+package com.example.biobanddisplay
+
+import android.content.Context
+import android.graphics.Color
+import android.graphics.Typeface
+import android.util.AttributeSet
+import androidx.appcompat.widget.AppCompatTextView
+
+/**
+ * A few lines over a screen with the receive path's figures, from
+ * BleConnectionManager.pipelineSummary(): ring and worker queue depths,
+ * receive-to-analysis latency, and lost frames and dropped packets.
+ *
+ * It refreshes every [REFRESH_MS] while attached, and is shown during a
+ * session playback or when [alwaysShown] is set, otherwise hidden.
+ */
+class PipelineOverlayView @JvmOverloads constructor(
+    context: Context,
+    attrs: AttributeSet? = null,
+) : AppCompatTextView(context, attrs) {
+
+    var alwaysShown = false
+
+    private val refresh = object : Runnable {
+        override fun run() {
+            val shown = alwaysShown || BleConnectionManager.playback != null
+            visibility = if (shown) VISIBLE else GONE
+            if (shown) text = BleConnectionManager.pipelineSummary()
+            postDelayed(this, REFRESH_MS)
+        }
+    }
+
+    init {
+        typeface = Typeface.MONOSPACE
+        textSize = 10f
+        setTextColor(Color.WHITE)
+        setBackgroundColor(0x99000000.toInt())
+        visibility = GONE
+    }
+
+    override fun onAttachedToWindow() {
+        super.onAttachedToWindow()
+        post(refresh)
+    }
+
+    override fun onDetachedFromWindow() {
+        removeCallbacks(refresh)
+        super.onDetachedFromWindow()
+    }
+
+    private companion object {
+        const val REFRESH_MS = 500L
+    }
+}
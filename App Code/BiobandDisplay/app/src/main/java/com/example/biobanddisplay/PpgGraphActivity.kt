@@ -9,11 +9,11 @@ import android.widget.Button
 import android.widget.TextView
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
-import com.chaquo.python.Python
 import java.io.File
 import java.util.Locale
+import kotlin.concurrent.thread
 
-class PpgGraphActivity : AppCompatActivity(), BleDataListener {
+class PpgGraphActivity : AppCompatActivity(), MonitorResultListener {
 
     private val TAG = "PPG_GRAPH_ACTIVITY"
     private lateinit var heartRateText: TextView
@@ -22,6 +22,7 @@ class PpgGraphActivity : AppCompatActivity(), BleDataListener {
     private lateinit var breathingRateText: TextView
     private lateinit var backButton: Button
     private val handler = Handler(Looper.getMainLooper())
+    private var liveShown = false
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
@@ -37,33 +38,37 @@ class PpgGraphActivity : AppCompatActivity(), BleDataListener {
             finish()
         }
 
-        if (BleConnectionManager.gatt == null) {
+        if (!BleConnectionManager.isStreaming) {
             Toast.makeText(this, "Device not connected. Showing stored data.", Toast.LENGTH_SHORT).show()
         }
         
-        // Initial process to load data from CSV
-        onDataReceived("INITIAL_LOAD")
+        // Initial process to load data from CSV, off the main thread as the runtime may still be starting
+        thread(name = "ppg-stored") { showStoredPpg() }
     }
 
     override fun onResume() {
         super.onResume()
-        BleConnectionManager.ppgDataListener = this
+        MonitorService.addResultListener(this)
+        if (MonitorService.isRunning) onMonitorResult(MonitorService.latestResult)
     }
 
     override fun onPause() {
         super.onPause()
-        if (BleConnectionManager.ppgDataListener == this) {
-            BleConnectionManager.ppgDataListener = null
-        }
+        MonitorService.removeResultListener(this)
+    }
+
+    // Live PPG is analysed by MonitorService; the stored values stay until its first update
+    override fun onMonitorResult(result: MonitorResult) {
+        if (result.ppgUpdates == 0) return
+        liveShown = true
+        heartRateText.text = String.format(Locale.US, "%.0f BPM", result.ppgBpm)
+        spo2Text.text = String.format(Locale.US, "%.1f %%", result.ppgSpo2)
     }
 
-    override fun onDataReceived(data: String) {
+    private fun showStoredPpg() {
         try {
-            val python = Python.getInstance()
-            val analyzerModule = python.getModule("ppg_analyzer")
-            
-            val csvFile = File(filesDir, "ppg_filtered_data.csv")
-            val result = analyzerModule.callAttr("process_ppg_data", data, csvFile.absolutePath).asMap()
+            val result = PythonRuntime.module(this, "ppg_analyzer").callAttr("PpgSession")
+                .callAttr("load_csv", File(filesDir, "ppg_filtered_data.csv").absolutePath).asMap()
 
             val heartRate = result[com.chaquo.python.PyObject.fromJava("bpm")]?.toFloat() ?: 0f
             val spo2 = result[com.chaquo.python.PyObject.fromJava("SpO2")]?.toFloat() ?: 0f
@@ -71,8 +76,10 @@ class PpgGraphActivity : AppCompatActivity(), BleDataListener {
             val breathingRate = result[com.chaquo.python.PyObject.fromJava("breathingRate")]?.toFloat() ?: 0f
 
             handler.post {
-                heartRateText.text = String.format(Locale.US, "%.0f BPM", heartRate)
-                spo2Text.text = String.format(Locale.US, "%.1f %%", spo2)
+                if (!liveShown) {
+                    heartRateText.text = String.format(Locale.US, "%.0f BPM", heartRate)
+                    spo2Text.text = String.format(Locale.US, "%.1f %%", spo2)
+                }
                 artStiffnessText.text = String.format(Locale.US, "%.2f m/s", artStiffness)
                 breathingRateText.text = String.format(Locale.US, "%.0f BrPM", breathingRate)
             }
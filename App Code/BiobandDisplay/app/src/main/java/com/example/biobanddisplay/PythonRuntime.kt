@@ -0,0 +1,75 @@
+package com.example.biobanddisplay
+
+import android.content.Context
+import android.util.Log
+import com.chaquo.python.PyObject
+import com.chaquo.python.Python
+import com.chaquo.python.android.AndroidPlatform
+import java.util.concurrent.Callable
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.ExecutionException
+import java.util.concurrent.Executors
+import java.util.concurrent.Future
+
+/**
+ * The Chaquopy interpreter, started off the critical path.
+ *
+ * [warmUp] starts it on a "python-init" thread and returns at once, so BLE
+ * scanning and connecting run in parallel. Analysis modules are imported
+ * only when first used: [load] imports one on the same thread and returns
+ * a Future. Callers that must not block, such as the ble-worker, check
+ * isDone and try again with the next block. [module] waits for the
+ * import, so it is for background threads only.
+ *
+ * Both steps are marked in BleConnectionManager.startup.
+ */
+object PythonRuntime {
+
+    private val TAG = "PYTHON"
+    private val executor = Executors.newSingleThreadExecutor { Thread(it, "python-init") }
+    private var started: Future<Python>? = null
+    private val modules = ConcurrentHashMap<String, Future<PyObject>>()
+
+    /** Starts the interpreter in the background if it is not running yet. */
+    @Synchronized
+    fun warmUp(context: Context): Future<Python> {
+        started?.let { return it }
+        val app = context.applicationContext
+        return executor.submit(Callable {
+            if (!Python.isStarted()) Python.start(AndroidPlatform(app))
+            BleConnectionManager.startup.mark("python_ready")
+            Python.getInstance()
+        }).also { started = it }
+    }
+
+    val isReady: Boolean
+        get() = started?.isDone == true
+
+    /** The interpreter; waits for [warmUp]. */
+    fun get(context: Context): Python = warmUp(context).await()
+
+    /** Imports [name] on the python-init thread on first use. */
+    fun load(context: Context, name: String): Future<PyObject> {
+        // Queued behind the start, on the same single thread
+        warmUp(context)
+        return modules.computeIfAbsent(name) {
+            executor.submit(Callable {
+                val start = System.nanoTime()
+                val module = Python.getInstance().getModule(name)
+                Log.d(TAG, "Imported $name in ${(System.nanoTime() - start) / 1_000_000} ms")
+                BleConnectionManager.startup.mark("import_$name")
+                module
+            })
+        }
+    }
+
+    /** Module [name], waiting for its import. Not on the main thread. */
+    fun module(context: Context, name: String): PyObject = load(context, name).await()
+
+    /** [Future.get], rethrowing what the task threw. */
+    private fun <T> Future<T>.await(): T = try {
+        get()
+    } catch (e: ExecutionException) {
+        throw e.cause ?: e
+    }
+}
@@ -9,34 +9,32 @@ import android.widget.Button
 import android.widget.TextView
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
-import com.chaquo.python.Python
-import com.github.mikephil.charting.charts.LineChart
-import com.github.mikephil.charting.data.Entry
-import com.github.mikephil.charting.data.LineData
-import com.github.mikephil.charting.data.LineDataSet
 import java.io.File
 import java.util.Locale
+import kotlin.concurrent.thread
+import kotlin.math.abs
 
-class RealTimeActivity : AppCompatActivity() {
+class RealTimeActivity : AppCompatActivity(), MonitorResultListener {
 
     private val TAG = "REAL_TIME_ACTIVITY"
-    private lateinit var ppgChart: LineChart
-    private lateinit var emgChart: LineChart
+    private lateinit var ppgChart: StripChartView
+    private lateinit var emgChart: StripChartView
     private lateinit var emgMetricsText: TextView
     private lateinit var ppgMetricsText: TextView
     private lateinit var backButton: Button
     private val handler = Handler(Looper.getMainLooper())
 
+    // Raw EMG for the chart; the analysis runs in MonitorService
+    private var emgScratch = FloatArray(256)
+    private var emgFs = MonitorService.DEFAULT_EMG_FS
+
     private val emgListener = object : BleDataListener {
         override fun onDataReceived(data: String) {
-            processEmgData(data)
+            plotEmgData(data)
         }
-    }
 
-    private val ppgListener = object : BleDataListener {
-        override fun onDataReceived(data: String) {
-            // Live data arrived, but we also refresh from the latest CSV state if desired
-            processPpgData(data)
+        override fun onSamples(block: SampleBlock) {
+            plotEmgSamples(block)
         }
     }
 
@@ -52,16 +50,19 @@ class RealTimeActivity : AppCompatActivity() {
 
         backButton.setOnClickListener { finish() }
 
-        setupChart(ppgChart, "PPG Data", Color.GREEN)
-        setupChart(emgChart, "EMG Data", Color.CYAN)
+        setupChart(ppgChart, "PPG Data", Color.GREEN, PPG_CAPACITY, PPG_VISIBLE)
+        setupChart(emgChart, "EMG Data", Color.CYAN, EMG_CAPACITY, (EMG_VISIBLE_S * emgFs).toInt())
 
-        // 1. Copy the bundled CSV to internal storage so Python can read it
-        copyCsvToInternalStorage()
+        // Off the main thread: both wait for the Python runtime, which may still be starting
+        thread(name = "ppg-stored") {
+            // 1. Copy the bundled CSV to internal storage so Python can read it
+            copyCsvToInternalStorage()
 
-        // 2. Perform an initial load of the CSV data to populate the graph immediately
-        processPpgData("INITIAL_LOAD")
+            // 2. Load the CSV data to populate the graph until live PPG arrives
+            showStoredPpg()
+        }
 
-        if (BleConnectionManager.gatt == null) {
+        if (!BleConnectionManager.isStreaming) {
             Toast.makeText(this, "Device not connected. Showing stored data.", Toast.LENGTH_SHORT).show()
         }
     }
@@ -72,8 +73,7 @@ class RealTimeActivity : AppCompatActivity() {
             val targetFile = File(filesDir, fileName)
             
             // Chaquopy bundles the 'python' folder. We can find the file using the Python instance.
-            val python = Python.getInstance()
-            val sys = python.getModule("sys")
+            val sys = PythonRuntime.module(this, "sys")
             val pyPath = sys["path"]?.asList() ?: emptyList()
             
             var sourceFile: File? = null
@@ -103,102 +103,91 @@ class RealTimeActivity : AppCompatActivity() {
     override fun onResume() {
         super.onResume()
         BleConnectionManager.emgDataListener = emgListener
-        BleConnectionManager.ppgDataListener = ppgListener
+        MonitorService.addResultListener(this)
+        if (MonitorService.isRunning) onMonitorResult(MonitorService.latestResult)
     }
 
     override fun onPause() {
         super.onPause()
         if (BleConnectionManager.emgDataListener == emgListener) BleConnectionManager.emgDataListener = null
-        if (BleConnectionManager.ppgDataListener == ppgListener) BleConnectionManager.ppgDataListener = null
+        MonitorService.removeResultListener(this)
     }
 
-    private fun processEmgData(data: String) {
-        try {
-            val python = Python.getInstance()
-            val analyzer = python.getModule("analyzer")
-            val result = analyzer.callAttr("process_ble_data", data).asMap()
-            
-            val voltages = result[com.chaquo.python.PyObject.fromJava("voltages")]?.toJava(FloatArray::class.java) ?: floatArrayOf()
-            val vrms = result[com.chaquo.python.PyObject.fromJava("vrms")]?.toFloat() ?: 0f
-            val tdmf = result[com.chaquo.python.PyObject.fromJava("tdmf")]?.toFloat() ?: 0f
-            val isResting = result[com.chaquo.python.PyObject.fromJava("is_resting")]?.toBoolean() ?: true
-            
-            handler.post {
-                emgMetricsText.text = String.format(Locale.US, "Vrms: %.2f mV | TDMF: %.0f Hz", vrms, tdmf)
-                emgMetricsText.setTextColor(if (isResting) Color.parseColor("#BDC3C7") else Color.GREEN)
-                
-                for (v in voltages) {
-                    addEntry(emgChart, v)
-                }
-            }
-        } catch (e: Exception) {
-            Log.e(TAG, "EMG error", e)
+    // Text packets from older firmware: comma separated raw values at the nominal rate
+    private fun plotEmgData(data: String) {
+        var n = 0
+        for (v in data.split(',')) {
+            val x = v.trim().toFloatOrNull() ?: continue
+            if (n == emgScratch.size) emgScratch = emgScratch.copyOf(n * 2)
+            emgScratch[n++] = x
         }
+        if (n > 0) emgChart.append(emgScratch, n)
     }
 
-    private fun processPpgData(data: String) {
+    // Stream frames: 5 s on screen at the rate from the frame period and the device clock rate
+    private fun plotEmgSamples(block: SampleBlock) {
+        var periodNs = 0L
+        block.forEachFrame { frame ->
+            if (periodNs == 0L && frame.format != StreamProto.FMT_I16_STATS) periodNs = frame.periodNs
+        }
+        emgChart.append(block.values, block.size)
+        if (periodNs == 0L) return
+        val fs = (1e9 / (periodNs * BleConnectionManager.clockSync.rate)).toFloat()
+        if (abs(emgFs - fs) > emgFs * 0.01f) {
+            emgFs = fs
+            emgChart.visibleSamples = (EMG_VISIBLE_S * fs).toInt()
+        }
+    }
+
+    // Down-sampled results from MonitorService, on the main thread
+    private var ppgUpdates = 0
+
+    override fun onMonitorResult(result: MonitorResult) {
+        emgMetricsText.text = String.format(Locale.US, "Vrms: %.2f mV | TDMF: %.0f Hz", result.emgVrms, result.emgMeanFrequency)
+        emgMetricsText.setTextColor(if (result.emgResting) Color.parseColor("#BDC3C7") else Color.GREEN)
+
+        // Until the first live PPG update, the stored recording stays on screen
+        if (result.ppgUpdates == 0 || result.ppgUpdates == ppgUpdates) return
+        ppgUpdates = result.ppgUpdates
+        ppgMetricsText.text = String.format(Locale.US, "BPM: %.0f | SpO2: %.1f%%", result.ppgBpm, result.ppgSpo2)
+        ppgChart.append(result.ppgPoints)
+    }
+
+    // The end of the bundled recording, shown until live PPG arrives
+    private fun showStoredPpg() {
         try {
-            val python = Python.getInstance()
-            val analyzer = python.getModule("ppg_analyzer")
-            
-            val csvFile = File(filesDir, "ppg_filtered_data.csv")
-            val csvPath = csvFile.absolutePath
-            
-            // Call Python to process the CSV file
-            val result = analyzer.callAttr("process_ppg_data", data, csvPath).asMap()
-            
+            val result = PythonRuntime.module(this, "ppg_analyzer").callAttr("PpgSession")
+                .callAttr("load_csv", File(filesDir, "ppg_filtered_data.csv").absolutePath).asMap()
+
             val pointsRed = result[com.chaquo.python.PyObject.fromJava("points_red")]?.toJava(FloatArray::class.java) ?: floatArrayOf()
             val bpm = result[com.chaquo.python.PyObject.fromJava("bpm")]?.toFloat() ?: 0f
             val spo2 = result[com.chaquo.python.PyObject.fromJava("SpO2")]?.toFloat() ?: 0f
 
             handler.post {
+                // Live PPG may have arrived while the runtime was starting
+                if (ppgUpdates > 0) return@post
                 ppgMetricsText.text = String.format(Locale.US, "BPM: %.0f | SpO2: %.1f%%", bpm, spo2)
-                
-                // Clear and plot all points from the CSV
-                if (data == "INITIAL_LOAD") {
-                    ppgChart.data?.clearValues()
-                }
-                
-                for (p in pointsRed) {
-                    addEntry(ppgChart, p)
-                }
+                ppgChart.clear()
+                ppgChart.append(pointsRed)
             }
         } catch (e: Exception) {
             Log.e(TAG, "PPG error", e)
         }
     }
 
-    private fun setupChart(chart: LineChart, label: String, color: Int) {
-        chart.description.isEnabled = false
-        chart.setNoDataText("Waiting for data...")
-        chart.setNoDataTextColor(Color.WHITE)
-        chart.xAxis.textColor = Color.WHITE
-        chart.axisLeft.textColor = Color.WHITE
-        chart.axisRight.isEnabled = false
-        chart.legend.textColor = Color.WHITE
-        chart.data = LineData()
+    private fun setupChart(chart: StripChartView, label: String, color: Int, capacity: Int, visible: Int) {
+        chart.label = label
+        chart.lineColor = color
+        chart.chartBackground = Color.parseColor("#2C3E50")
+        chart.capacity = capacity
+        chart.visibleSamples = visible
     }
 
-    private fun addEntry(chart: LineChart, value: Float) {
-        val data = chart.data ?: return
-        var set = data.getDataSetByIndex(0)
-        if (set == null) {
-            set = LineDataSet(null, "Data").apply {
-                this.color = if (chart.id == R.id.ppg_chart_realtime) Color.GREEN else Color.CYAN
-                setDrawCircles(false)
-                lineWidth = 2f
-                setDrawValues(false)
-                mode = if (chart.id == R.id.ppg_chart_realtime) LineDataSet.Mode.CUBIC_BEZIER else LineDataSet.Mode.LINEAR
-            }
-            data.addDataSet(set)
-        }
-        data.addEntry(Entry(set.entryCount.toFloat(), value), 0)
-        data.notifyDataChanged()
-        chart.notifyDataSetChanged()
-        
-        // Show more points for PPG if it's the initial load from CSV
-        val maxRange = if (chart.id == R.id.ppg_chart_realtime) 1000f else 100f
-        chart.setVisibleXRangeMaximum(maxRange)
-        chart.moveViewToX(data.entryCount.toFloat())
+    companion object {
+        // Raw EMG at full rate: 5 s shown, 10 s kept
+        private const val EMG_VISIBLE_S = 5f
+        private const val EMG_CAPACITY = 1 shl 17
+        private const val PPG_VISIBLE = 1000
+        private const val PPG_CAPACITY = 4096
     }
 }
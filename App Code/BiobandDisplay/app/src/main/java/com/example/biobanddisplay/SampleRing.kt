@@ -0,0 +1,93 @@
+package com.example.biobanddisplay
+
+/**
+ * Fixed-capacity ring of the most recent samples of one signal, for
+ * plotting. [append] never allocates. Writers and the render thread may
+ * use it at the same time.
+ */
+class SampleRing(val capacity: Int) {
+
+    private val values = FloatArray(capacity)
+    private var pos = 0
+
+    /** Samples held, at most [capacity]. */
+    var size = 0
+        private set
+    /** Samples ever appended; a renderer compares it to skip unchanged frames. */
+    @Volatile var total = 0L
+        private set
+
+    init {
+        require(capacity > 0)
+    }
+
+    /** Appends the first [count] values of [src]. */
+    @Synchronized
+    fun append(src: FloatArray, count: Int = src.size) {
+        require(count in 0..src.size)
+        // Only the newest capacity samples can survive
+        var from = maxOf(0, count - capacity)
+        while (from < count) {
+            val n = minOf(count - from, capacity - pos)
+            System.arraycopy(src, from, values, pos, n)
+            pos = (pos + n) % capacity
+            from += n
+        }
+        size = minOf(size + count, capacity)
+        total += count
+    }
+
+    @Synchronized
+    fun append(value: Float) {
+        values[pos] = value
+        pos = (pos + 1) % capacity
+        size = minOf(size + 1, capacity)
+        total++
+    }
+
+    @Synchronized
+    fun clear() {
+        pos = 0
+        size = 0
+        total++
+    }
+
+    /**
+     * Min/max decimation of the last [window] samples onto [columns] pixel
+     * columns, oldest first. Column c gets the min and max of its share of
+     * the window. It also includes the last sample of column c - 1, so
+     * neighbouring columns join up. Returns the number of columns filled:
+     * [columns], or fewer if fewer samples are held.
+     */
+    @Synchronized
+    fun decimate(window: Int, columns: Int, min: FloatArray, max: FloatArray): Int {
+        val n = minOf(window, size)
+        val cols = minOf(columns, n, min.size, max.size)
+        if (cols <= 0) return 0
+        val oldest = pos - n + capacity
+        var prev = values[oldest % capacity]
+        for (c in 0 until cols) {
+            val start = (c.toLong() * n / cols).toInt()
+            val end = ((c + 1L) * n / cols).toInt()
+            var lo = prev
+            var hi = prev
+            // Two straight runs instead of a modulo per sample
+            var i = (oldest + start) % capacity
+            var left = end - start
+            while (left > 0) {
+                val run = minOf(left, capacity - i)
+                for (k in i until i + run) {
+                    val v = values[k]
+                    if (v < lo) lo = v
+                    if (v > hi) hi = v
+                }
+                prev = values[i + run - 1]
+                left -= run
+                i = 0
+            }
+            min[c] = lo
+            max[c] = hi
+        }
+        return cols
+    }
+}
@@ -0,0 +1,257 @@
+package com.example.biobanddisplay
+
+import java.io.BufferedInputStream
+import java.io.DataInputStream
+import java.io.EOFException
+import java.io.File
+import java.io.FileInputStream
+import java.util.concurrent.locks.LockSupport
+
+/**
+ * Plays recorded data into the receive path as if a band were sending it,
+ * so performance can be measured on any phone, repeatably.
+ *
+ * Each packet goes to [sink] exactly where BleConnectionManager hands
+ * notifications to StreamIngest.offer(). From there, analysis, storage and
+ * the charts run as they would for a live band. [files] are played one
+ * after another:
+ *
+ *  - SessionRecorder files (.bin): every frame is sent as its own packet.
+ *    Text lines stored as FMT_BYTES frames are joined and sent as the text
+ *    packet they came from.
+ *  - CSV: the columns of [csvLayout] go out as text packets ("EMG,v,v,...")
+ *    as older firmware sent them. Non-numeric rows such as headers are
+ *    skipped.
+ *
+ * Packets keep their recorded spacing divided by [speed]. At [FASTEST] they
+ * are sent as fast as [sink] takes them. When [sink] refuses one (a full
+ * ring), a timed run drops it, as the radio would. A [FASTEST] run waits
+ * and tries again, so every packet is processed and runs can be compared.
+ * [maxLagMs] shows how far behind schedule the sender fell.
+ *
+ * Frame timestamps are device uptime and text frames carry the phone's
+ * receive time, so the two are paced separately. Gaps longer than
+ * [MAX_GAP_US] (a reconnect, a clock wrap) are skipped.
+ */
+class SessionPlayback(
+    private val files: List<File>,
+    val speed: Double,
+    private val clockNs: () -> Long = System::nanoTime,
+    private val sink: (ByteArray, Int, Long) -> Boolean,
+) {
+    /** How one CSV file becomes text packets. */
+    class CsvLayout(
+        val channel: Int,
+        /** Columns sent for each row, in order. */
+        val valueColumns: IntArray,
+        /** Column of the row time in ms, or -1 to use [rateHz]. */
+        val timeColumn: Int,
+        val rateHz: Double,
+        val rowsPerPacket: Int,
+    )
+
+    private val thread = Thread({ run() }, "session-playback").apply { isDaemon = true }
+    @Volatile private var stopped = false
+    private val buf = ByteArray(StreamProto.HDR_LEN + 255 * 4)
+    private val text = StringBuilder()
+    private var startNs = 0L
+    // Session time already played by earlier files
+    private var baseUs = 0L
+    private var endUs = 0L
+
+    /** Packets accepted by [sink]. */
+    @Volatile var packets = 0L
+        private set
+    /** Packets refused by [sink] in a timed run. */
+    @Volatile var droppedPackets = 0L
+        private set
+    /** Recorded time played so far. */
+    @Volatile var sessionUs = 0L
+        private set
+    /** Latest a packet was sent after its due time. */
+    @Volatile var maxLagMs = 0L
+        private set
+    /** Files cut short at a frame that does not parse. */
+    @Volatile var malformedFiles = 0
+        private set
+    @Volatile var finished = false
+        private set
+    /** Called on the playback thread when every file has been played, not after [stop]. */
+    var onFinished: ((SessionPlayback) -> Unit)? = null
+
+    val elapsedNs: Long get() = if (startNs == 0L) 0 else clockNs() - startNs
+
+    fun start(): SessionPlayback {
+        thread.start()
+        return this
+    }
+
+    fun stop() {
+        stopped = true
+        LockSupport.unpark(thread)
+        if (Thread.currentThread() !== thread) thread.join()
+    }
+
+    private fun run() {
+        startNs = clockNs()
+        for (file in files) {
+            if (stopped) return
+            baseUs = endUs
+            if (file.name.endsWith(".bin")) playSession(file) else playCsv(file, csvLayout(file))
+        }
+        if (stopped) return
+        finished = true
+        onFinished?.invoke(this)
+    }
+
+    private fun playSession(file: File) {
+        // Per clock: device uptime for stream frames, receive time for text
+        val prevUs = longArrayOf(-1, -1)
+        val clockUs = longArrayOf(0, 0)
+        var textChannel = -1
+        var textSeq = -1
+        var textUs = 0L
+        DataInputStream(BufferedInputStream(FileInputStream(file), 1 shl 16)).use { input ->
+            while (!stopped) {
+                try {
+                    input.readFully(buf, 0, StreamProto.HDR_LEN)
+                } catch (e: EOFException) {
+                    break
+                }
+                val format = buf[2].toInt() and 0xFF
+                val size = (buf[3].toInt() and 0xFF) * StreamProto.sampleSize(format)
+                if ((buf[0].toInt() and 0xF0) != 0xB0 || StreamProto.sampleSize(format) == 0) {
+                    malformedFiles++
+                    break
+                }
+                try {
+                    input.readFully(buf, StreamProto.HDR_LEN, size)
+                } catch (e: EOFException) {
+                    break
+                }
+                val channel = buf[1].toInt() and 0xFF
+                val seq = (buf[4].toInt() and 0xFF) or ((buf[5].toInt() and 0xFF) shl 8)
+                val t0Us = ((buf[6].toLong() and 0xFF) or ((buf[7].toLong() and 0xFF) shl 8) or
+                    ((buf[8].toLong() and 0xFF) shl 16) or ((buf[9].toLong() and 0xFF) shl 24))
+                val isText = format == StreamProto.FMT_BYTES && channel != StreamProto.CH_CONTROL
+
+                // A line continues in frames with the same channel and seq
+                if (textChannel >= 0 && !(isText && channel == textChannel && seq == textSeq)) {
+                    sendText(textChannel, textUs)
+                    textChannel = -1
+                }
+                val clock = if (isText) 1 else 0
+                val prev = prevUs[clock]
+                var delta = if (prev < 0) 0 else (t0Us - prev) and 0xFFFFFFFFL
+                if (delta > MAX_GAP_US) delta = 0
+                prevUs[clock] = t0Us
+                clockUs[clock] += delta
+
+                if (isText) {
+                    if (textChannel < 0) {
+                        textChannel = channel
+                        textSeq = seq
+                        textUs = clockUs[clock]
+                        text.setLength(0)
+                    }
+                    text.append(String(buf, StreamProto.HDR_LEN, size, Charsets.UTF_8))
+                } else {
+                    send(buf, StreamProto.HDR_LEN + size, baseUs + clockUs[clock])
+                }
+            }
+            if (textChannel >= 0) sendText(textChannel, textUs)
+        }
+    }
+
+    private fun sendText(channel: Int, atUs: Long) {
+        val prefix = StreamIngest.TEXT_PREFIXES.firstOrNull { it.second == channel }?.first ?: return
+        val bytes = (prefix + text).toByteArray(Charsets.UTF_8)
+        send(bytes, bytes.size, baseUs + atUs)
+    }
+
+    private fun playCsv(file: File, layout: CsvLayout) {
+        val prefix = StreamIngest.TEXT_PREFIXES.firstOrNull { it.second == layout.channel }?.first ?: return
+        val periodUs = 1e6 / layout.rateHz
+        var rows = 0L
+        var firstMs = Double.NaN
+        var packetUs = 0L
+        var inPacket = 0
+        text.setLength(0)
+        text.append(prefix)
+        file.bufferedReader().useLines { lines ->
+            for (line in lines) {
+                if (stopped) return
+                val cells = line.split(',')
+                val time = if (layout.timeColumn >= 0) cells.getOrNull(layout.timeColumn)?.trim()?.toDoubleOrNull() else 0.0
+                if (time == null || layout.valueColumns.any { cells.getOrNull(it)?.trim()?.toDoubleOrNull() == null }) continue
+                if (layout.timeColumn >= 0) {
+                    if (firstMs.isNaN()) firstMs = time
+                    packetUs = ((time - firstMs) * 1000).toLong()
+                } else {
+                    packetUs = (rows * periodUs).toLong()
+                }
+                rows++
+                for (c in layout.valueColumns) {
+                    if (text.length > prefix.length) text.append(',')
+                    text.append(cells[c].trim())
+                }
+                // Sent when its last row has been measured
+                if (++inPacket == layout.rowsPerPacket) {
+                    sendCsvPacket(packetUs)
+                    text.setLength(prefix.length)
+                    inPacket = 0
+                }
+            }
+        }
+        if (inPacket > 0) sendCsvPacket(packetUs)
+    }
+
+    private fun sendCsvPacket(atUs: Long) {
+        val bytes = text.toString().toByteArray(Charsets.UTF_8)
+        send(bytes, bytes.size, baseUs + atUs)
+    }
+
+    private fun send(data: ByteArray, length: Int, atUs: Long) {
+        if (atUs > endUs) endUs = atUs
+        sessionUs = endUs
+        if (speed > 0) {
+            val dueNs = startNs + (atUs * 1000 / speed).toLong()
+            var now = clockNs()
+            while (now < dueNs && !stopped) {
+                LockSupport.parkNanos(dueNs - now)
+                now = clockNs()
+            }
+            val lagMs = (now - dueNs) / 1_000_000
+            if (lagMs > maxLagMs) maxLagMs = lagMs
+            if (sink(data, length, now)) packets++ else droppedPackets++
+            return
+        }
+        while (!sink(data, length, clockNs())) {
+            if (stopped) return
+            LockSupport.parkNanos(100_000)
+        }
+        packets++
+    }
+
+    companion object {
+        /** Speed for sending as fast as the receive path takes packets. */
+        const val FASTEST = 0.0
+        const val MAX_GAP_US = 10_000_000L
+
+        /**
+         * Layout of the app's CSVs by file name: ppg_filtered_data.csv (red
+         * and IR per row, time in ms), sample_data.csv (test ECG at 500 Hz),
+         * sweat logs, and otherwise an EMG log with the raw value in the first
+         * column at the analysis rate.
+         */
+        fun csvLayout(file: File): CsvLayout {
+            val name = file.name.lowercase()
+            return when {
+                "ppg" in name -> CsvLayout(StreamProto.CH_PPG, intArrayOf(2, 3), 0, 125.0, 10)
+                "sample_data" in name || "test" in name -> CsvLayout(StreamProto.CH_TEST, intArrayOf(0), -1, 500.0, 25)
+                "sweat" in name -> CsvLayout(StreamProto.CH_SWEAT, intArrayOf(0), -1, 10.0, 1)
+                else -> CsvLayout(StreamProto.CH_EMG, intArrayOf(0), -1, MonitorService.DEFAULT_EMG_FS.toDouble(), 100)
+            }
+        }
+    }
+}
@@ -0,0 +1,181 @@
+package com.example.biobanddisplay
+
+import java.io.Closeable
+import java.io.File
+import java.io.FileOutputStream
+import java.nio.ByteBuffer
+import java.nio.channels.FileChannel
+import java.text.SimpleDateFormat
+import java.util.Date
+import java.util.Locale
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.locks.ReentrantLock
+import kotlin.concurrent.withLock
+
+/**
+ * Records a session's stream frames to disk without touching the file on the
+ * caller's thread.
+ *
+ * [write] copies the bytes into one of two [bufferBytes] buffers and
+ * returns. A "session-recorder" thread writes each full buffer through a
+ * FileChannel, so the disk sees a few large writes. Nothing is allocated
+ * per write.
+ *
+ * Every [syncIntervalMs] the writer also flushes the part-full buffer and
+ * fsyncs, so a crash loses at most that much data. When a file reaches
+ * [rotateBytes] it is closed and the next part is started. Files are named
+ * `<prefix>_<yyyyMMdd_HHmmss>_<part>.bin` in [dir]. Each file holds whole
+ * frames back to back, as stream_proto.iter_frames() reads them.
+ * session_export.py turns a session into CSV offline.
+ *
+ * If both buffers are full, [write] drops the data and counts it in
+ * [droppedBytes]. The same happens to a write larger than one buffer.
+ */
+class SessionRecorder(
+    private val dir: File,
+    private val prefix: String = "session",
+    private val bufferBytes: Int = 1 shl 20,
+    private val syncIntervalMs: Long = 5_000,
+    private val rotateBytes: Long = 64L shl 20,
+) : Closeable {
+
+    private val lock = ReentrantLock()
+    private val ready = lock.newCondition()
+    private var active = ByteBuffer.allocateDirect(bufferBytes)
+    private var free: ByteBuffer? = ByteBuffer.allocateDirect(bufferBytes)
+    private var pending: ByteBuffer? = null
+    private var closing = false
+
+    private val name = prefix + "_" + SimpleDateFormat("yyyyMMdd_HHmmss", Locale.US).format(Date())
+    private var part = 0
+    private var channel: FileChannel? = null
+    private var fileBytes = 0L
+    private var lastSyncNs = 0L
+
+    private val thread = Thread({ writerLoop() }, "session-recorder")
+
+    /** Bytes accepted by [write]. */
+    @Volatile var bytesRecorded = 0L
+        private set
+    /** Bytes on disk. */
+    @Volatile var bytesWritten = 0L
+        private set
+    @Volatile var droppedBytes = 0L
+        private set
+    @Volatile var syncs = 0
+        private set
+    /** Time the writer thread spent in write() and in fsync. */
+    @Volatile var writeNs = 0L
+        private set
+    @Volatile var syncNs = 0L
+        private set
+    private val files = ArrayList<File>()
+    val startNs = System.nanoTime()
+
+    fun start(): SessionRecorder {
+        dir.mkdirs()
+        openPart()
+        thread.start()
+        return this
+    }
+
+    /** Queues [length] bytes of [data]; returns false if they were dropped. */
+    fun write(data: ByteArray, offset: Int = 0, length: Int = data.size): Boolean {
+        lock.withLock {
+            if (closing) return false
+            if (active.remaining() < length) {
+                val next = free
+                if (next == null || length > bufferBytes) {
+                    droppedBytes += length
+                    return false
+                }
+                pending = active
+                active = next
+                free = null
+                ready.signal()
+            }
+            active.put(data, offset, length)
+            bytesRecorded += length
+        }
+        return true
+    }
+
+    /** Files started so far, the current one last. */
+    fun files(): List<File> = synchronized(files) { files.toList() }
+
+    /** Write throughput since [start], in bytes per second. */
+    fun throughput(): Double = bytesWritten * 1e9 / (System.nanoTime() - startNs).coerceAtLeast(1)
+
+    /** Writes out what is buffered, fsyncs and stops the writer thread. */
+    override fun close() {
+        lock.withLock {
+            if (closing) return
+            closing = true
+            ready.signal()
+        }
+        thread.join()
+    }
+
+    private fun writerLoop() {
+        lastSyncNs = System.nanoTime()
+        val intervalNs = TimeUnit.MILLISECONDS.toNanos(syncIntervalMs)
+        while (true) {
+            var buf: ByteBuffer? = null
+            var done = false
+            lock.withLock {
+                var wait = lastSyncNs + intervalNs - System.nanoTime()
+                while (pending == null && !closing && wait > 0) wait = ready.awaitNanos(wait)
+                buf = pending
+                pending = null
+                // On the sync tick or at close, take the part-full buffer too
+                if (buf == null && active.position() > 0) {
+                    buf = active
+                    active = free!!
+                    free = null
+                }
+                done = closing && buf == null
+            }
+            buf?.let {
+                drain(it)
+                lock.withLock { free = it }
+            }
+            if (done || System.nanoTime() - lastSyncNs >= intervalNs) sync()
+            if (done) break
+        }
+        channel?.close()
+        channel = null
+    }
+
+    private fun drain(buf: ByteBuffer) {
+        buf.flip()
+        val start = System.nanoTime()
+        val ch = channel!!
+        while (buf.hasRemaining()) {
+            val n = ch.write(buf)
+            fileBytes += n
+            bytesWritten += n
+        }
+        writeNs += System.nanoTime() - start
+        buf.clear()
+        if (fileBytes >= rotateBytes) {
+            sync()
+            ch.close()
+            openPart()
+        }
+    }
+
+    private fun sync() {
+        val start = System.nanoTime()
+        channel?.force(false)
+        syncNs += System.nanoTime() - start
+        syncs++
+        lastSyncNs = System.nanoTime()
+    }
+
+    private fun openPart() {
+        val file = File(dir, "%s_%03d.bin".format(Locale.US, name, part++))
+        channel = FileOutputStream(file, true).channel
+        fileBytes = 0
+        synchronized(files) { files.add(file) }
+    }
+}
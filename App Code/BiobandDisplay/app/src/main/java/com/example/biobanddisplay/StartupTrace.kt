@@ -0,0 +1,46 @@
+package com.example.biobanddisplay
+
+/**
+ * Times, from process start, of the steps between a cold start and the
+ * first data: the activity, the BLE scan and connection, the Python runtime
+ * and module imports, the first sample ([FIRST_SAMPLE]) and the first
+ * analysed metric ([FIRST_METRIC]).
+ *
+ * Each event is recorded once; repeated marks are ignored, so callers on
+ * hot paths can mark freely. [log] gets a line per event and, from the
+ * first metric on, a summary of all of them in time order. The app's trace is
+ * BleConnectionManager.startup, logged under "STARTUP".
+ */
+class StartupTrace(
+    private val originMs: Long,
+    private val clockMs: () -> Long,
+    private val log: (String) -> Unit,
+) {
+    private val marks = LinkedHashMap<String, Long>()
+
+    /** Records [event] the first time; returns false if it was already recorded. */
+    fun mark(event: String): Boolean {
+        val ms = clockMs() - originMs
+        val afterMetric = synchronized(marks) {
+            if (marks.containsKey(event)) return false
+            marks[event] = ms
+            marks.containsKey(FIRST_METRIC)
+        }
+        log("$event at $ms ms")
+        // Later steps, such as a slow import, update the summary
+        if (afterMetric) log(summary())
+        return true
+    }
+
+    /** Time of [event] since process start, or null if it has not happened. */
+    operator fun get(event: String): Long? = synchronized(marks) { marks[event] }
+
+    fun summary(): String = synchronized(marks) {
+        marks.entries.sortedBy { it.value }.joinToString(", ", "Startup: ") { "${it.key} ${it.value} ms" }
+    }
+
+    companion object {
+        const val FIRST_SAMPLE = "first_sample"
+        const val FIRST_METRIC = "first_metric"
+    }
+}
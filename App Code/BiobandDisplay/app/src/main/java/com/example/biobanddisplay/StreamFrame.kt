@@ -0,0 +1,218 @@
+package com.example.biobanddisplay
+
+import java.io.OutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Decoder for the binary sensor stream sent by the firmware
+ * (nRF52840_code/common/include/stream_proto.h).
+ *
+ * A notification holds one or more frames: a 14-byte little-endian header
+ * (version, channel, format, count, seq, t0_us, period_ns) followed by the
+ * samples. Nothing is copied: [forEachFrame] wraps the received ByteArray
+ * and moves a single [StreamFrame] view across it.
+ *
+ * Under congestion the device lowers a channel's tier: delta-packed frames
+ * ([FMT_I16_DELTA]), plain I16 frames with a longer period (decimated) or one
+ * min/max/mean/rms frame per batch ([FMT_I16_STATS]). Each switch is announced
+ * on [CH_CONTROL] with a [CTRL_TIER] message.
+ *
+ * Devices that only send samples around detected events mark each snippet
+ * with [CTRL_EVENT] messages: [EVENT_BEGIN] before the first frame and
+ * [EVENT_END] after the last, carrying the event's total sample count.
+ */
+object StreamProto {
+    const val VERSION = 1
+    const val HDR_LEN = 14
+
+    const val CH_CONTROL = 0x00
+    const val CH_EMG = 0x01
+    const val CH_PPG = 0x02
+    const val CH_SWEAT = 0x03
+    const val CH_TEST = 0x04
+    const val CH_ADC = 0x05
+    const val CH_EIS = 0x06
+    /** Full-rate ADC snippets around detected events, bracketed by [CTRL_EVENT]. */
+    const val CH_ADC_EVENT = 0x07
+
+    /** Set in the channel byte of frames replayed from the device's flash recorder. */
+    const val CH_REPLAY = 0x80
+
+    const val FMT_BYTES = 0x00
+    const val FMT_I16 = 0x01
+    const val FMT_U16 = 0x02
+    const val FMT_I32 = 0x03
+    const val FMT_F32 = 0x04
+    /** Payload byte 0 is the sample count, then zigzag-delta varints; count is payload bytes. */
+    const val FMT_I16_DELTA = 0x05
+    /** min, max, mean, rms of one window; periodNs is the window length. */
+    const val FMT_I16_STATS = 0x06
+
+    const val TIER_FULL = 0
+    const val TIER_PACKED = 1
+    const val TIER_DECIMATED = 2
+    const val TIER_FEATURES = 3
+
+    /** CONTROL payload [op, channel, tier, decimation]. */
+    const val CTRL_TIER = 0x01
+    /** CONTROL payload [op, channel, triggers, phase, id (u16), samples (u16)]. */
+    const val CTRL_EVENT = 0x02
+    const val EVENT_BEGIN = 0
+    const val EVENT_END = 1
+
+    fun sampleSize(format: Int): Int = when (format) {
+        FMT_BYTES, FMT_I16_DELTA -> 1
+        FMT_I16, FMT_U16, FMT_I16_STATS -> 2
+        FMT_I32, FMT_F32 -> 4
+        else -> 0
+    }
+
+    /** Writes a frame header at [pos] of [dst]; the caller puts [count] samples after it. */
+    fun writeHeader(dst: ByteArray, pos: Int, channel: Int, format: Int, count: Int, seq: Int, t0Us: Long, periodNs: Long) {
+        ByteBuffer.wrap(dst, pos, HDR_LEN).order(ByteOrder.LITTLE_ENDIAN)
+            .put((0xB0 or VERSION).toByte()).put(channel.toByte()).put(format.toByte()).put(count.toByte())
+            .putShort(seq.toShort()).putInt(t0Us.toInt()).putInt(periodNs.toInt())
+    }
+
+    /** True if the first [length] bytes of [value] start with a stream frame rather than a text packet. */
+    fun isStream(value: ByteArray, length: Int = value.size): Boolean =
+        length >= HDR_LEN && (value[0].toInt() and 0xF0) == 0xB0
+
+    /**
+     * Calls [block] for every frame in [value]. The frame is only valid inside
+     * the call. Returns false if the packet is truncated or uses an unknown
+     * version or format; frames before the bad one have been delivered.
+     */
+    inline fun forEachFrame(value: ByteArray, block: (StreamFrame) -> Unit): Boolean =
+        forEachFrame(StreamFrame(ByteBuffer.wrap(value).order(ByteOrder.LITTLE_ENDIAN)), value.size, block)
+
+    /**
+     * Like the above for the first [length] bytes of the array behind [frame],
+     * reusing the view instead of wrapping the array again.
+     */
+    inline fun forEachFrame(frame: StreamFrame, length: Int, block: (StreamFrame) -> Unit): Boolean {
+        frame.setLimit(length)
+        var offset = 0
+        while (offset < length) {
+            if (!frame.moveTo(offset)) return false
+            block(frame)
+            offset = frame.end
+        }
+        return true
+    }
+}
+
+/** View of one frame inside a received notification. */
+class StreamFrame(private val buf: ByteBuffer) {
+    var offset = 0
+        private set
+
+    val version: Int get() = buf.get(offset).toInt() and 0x0F
+    val channel: Int get() = buf.get(offset + 1).toInt() and 0xFF
+    /** True for recorded frames sent after a reconnect; [channel] includes the flag. */
+    val isReplay: Boolean get() = (channel and StreamProto.CH_REPLAY) != 0
+    val format: Int get() = buf.get(offset + 2).toInt() and 0xFF
+    val count: Int get() = buf.get(offset + 3).toInt() and 0xFF
+    val seq: Int get() = buf.getShort(offset + 4).toInt() and 0xFFFF
+    /** Device uptime of the first sample in µs, wraps at 2^32. */
+    val t0Us: Long get() = buf.getInt(offset + 6).toLong() and 0xFFFFFFFFL
+    /** Sample spacing in ns, 0 for a single or irregular sample. */
+    val periodNs: Long get() = buf.getInt(offset + 10).toLong() and 0xFFFFFFFFL
+
+    val payloadOffset: Int get() = offset + StreamProto.HDR_LEN
+    val payloadSize: Int get() = count * StreamProto.sampleSize(format)
+    val end: Int get() = payloadOffset + payloadSize
+
+    /** Number of samples, which differs from [count] for packed frames. */
+    val sampleCount: Int get() =
+        if (format == StreamProto.FMT_I16_DELTA && count > 0) buf.get(payloadOffset).toInt() and 0xFF else count
+
+    /** Bytes of the whole frame, header included. */
+    val length: Int get() = end - offset
+
+    /** Restricts the view to the first [length] bytes of its array. */
+    fun setLimit(length: Int) {
+        buf.limit(length)
+    }
+
+    /** Points the view at the frame starting at [pos] and validates it. */
+    fun moveTo(pos: Int): Boolean {
+        if (pos + StreamProto.HDR_LEN > buf.limit()) return false
+        offset = pos
+        return (buf.get(pos).toInt() and 0xF0) == 0xB0 &&
+            version == StreamProto.VERSION &&
+            StreamProto.sampleSize(format) != 0 &&
+            end <= buf.limit()
+    }
+
+    /** Device time of sample [i] in µs (not wrapped). */
+    fun sampleTimeUs(i: Int): Long = t0Us + i * periodNs / 1000
+
+    /**
+     * Decodes an [StreamProto.FMT_I16_DELTA] frame into [out] and returns the
+     * number of samples, or -1 if the payload is malformed or [out] is too short.
+     */
+    fun unpackI16(out: IntArray): Int {
+        val n = sampleCount
+        if (n > out.size) return -1
+        var pos = payloadOffset + 1
+        var prev = 0
+        for (i in 0 until n) {
+            var z = 0
+            var shift = 0
+            while (true) {
+                if (pos >= end || shift > 14) return -1
+                val b = buf.get(pos++).toInt() and 0xFF
+                z = z or ((b and 0x7F) shl shift)
+                shift += 7
+                if ((b and 0x80) == 0) break
+            }
+            prev = (prev + ((z ushr 1) xor -(z and 1))).toShort().toInt()
+            out[i] = prev
+        }
+        return n
+    }
+
+    /** Sample [i] of an integer frame. Packed frames need [unpackI16]. */
+    fun getInt(i: Int): Int = when (format) {
+        StreamProto.FMT_I16, StreamProto.FMT_I16_STATS -> buf.getShort(payloadOffset + 2 * i).toInt()
+        StreamProto.FMT_U16 -> buf.getShort(payloadOffset + 2 * i).toInt() and 0xFFFF
+        StreamProto.FMT_I32 -> buf.getInt(payloadOffset + 4 * i)
+        StreamProto.FMT_F32 -> buf.getFloat(payloadOffset + 4 * i).toInt()
+        else -> buf.get(payloadOffset + i).toInt() and 0xFF
+    }
+
+    /** Sample [i] as a float, whatever the format. */
+    fun getFloat(i: Int): Float =
+        if (format == StreamProto.FMT_F32) buf.getFloat(payloadOffset + 4 * i) else getInt(i).toFloat()
+
+    /** Copies the whole frame, header included, to [out]. */
+    fun writeTo(out: OutputStream) {
+        out.write(buf.array(), offset, end - offset)
+    }
+
+    /** Copies the whole frame, header included, into [dst] at [pos]. */
+    fun copyTo(dst: ByteArray, pos: Int) {
+        System.arraycopy(buf.array(), offset, dst, pos, end - offset)
+    }
+
+    /**
+     * Samples as "v0,v1,..." for listeners that still take text. A features
+     * frame gives its mean, once.
+     */
+    fun toCsv(): String {
+        if (format == StreamProto.FMT_I16_STATS) return getInt(2).toString()
+        if (format == StreamProto.FMT_I16_DELTA) {
+            val samples = IntArray(255)
+            val n = unpackI16(samples)
+            return if (n < 0) "" else samples.copyOf(n).joinToString(",")
+        }
+        val sb = StringBuilder(count * 6)
+        for (i in 0 until count) {
+            if (i > 0) sb.append(',')
+            if (format == StreamProto.FMT_F32) sb.append(getFloat(i)) else sb.append(getInt(i))
+        }
+        return sb.toString()
+    }
+}
@@ -0,0 +1,404 @@
+package com.example.biobanddisplay
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.Executor
+import java.util.concurrent.atomic.AtomicBoolean
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.concurrent.locks.LockSupport
+
+/**
+ * Receive path for BLE packets, kept off the Binder and UI threads.
+ *
+ * [offer] copies a notification or L2CAP SDU into a preallocated ring of
+ * [slotCount] slots and returns; that copy is all the receiving thread
+ * does. A dedicated thread drains the ring in batches, decodes the stream
+ * frames and gathers each channel's samples into a [SampleBlock]. Every
+ * [publishIntervalMs] it hands the blocks that have new data to [sink]
+ * through [executor], one post per channel. The receiving looper therefore
+ * sees a bounded number of messages whatever the packet rate. The interval
+ * can be changed while running: short while a screen shows live data, long
+ * while nothing does, so the CPU wakes once per batch.
+ *
+ * Nothing is allocated per packet once the blocks have grown to the
+ * stream's rate: slots, frame views, blocks and the posted Runnables are
+ * all reused. Each channel has two blocks. The ingest thread fills one
+ * while [sink] reads the other. If the sink has not finished with the
+ * previous block by the next tick, the new data waits for the tick after.
+ * A sink that passes the block to another thread keeps it with
+ * [SampleBlock.retain] until that thread is done.
+ *
+ * With a [clock], every sample also gets a phone time
+ * (elapsedRealtimeNanos) in [SampleBlock.phoneTimesNs]. Each frame's first
+ * sample is mapped through the clock, and the rest follow at its period
+ * scaled by [ClockSync.rate]. Until the first time-sync exchange, the
+ * packet's receive time stands in for the frame's first sample.
+ *
+ * Text packets from older firmware ("EMG,..." and so on) take the same
+ * path. They are decoded to strings on the ingest thread and delivered in
+ * the block of their channel.
+ *
+ * A full ring drops the new packet and counts it in [droppedPackets];
+ * so does a packet longer than [slotSize].
+ */
+class StreamIngest(
+    private val slotCount: Int,
+    private val slotSize: Int,
+    publishIntervalMs: Long,
+    private val executor: Executor,
+    private val clock: ClockSync? = null,
+    private val sink: (SampleBlock) -> Unit,
+) {
+    private val slots = Array(slotCount) { ByteArray(slotSize) }
+    private val views = Array(slotCount) { StreamFrame(ByteBuffer.wrap(slots[it]).order(ByteOrder.LITTLE_ENDIAN)) }
+    private val lengths = IntArray(slotCount)
+    private val rxTimes = LongArray(slotCount)
+
+    // head is written by producers under producerLock, tail by the ingest thread only
+    private val producerLock = Any()
+    @Volatile private var head = 0L
+    @Volatile private var tail = 0L
+
+    private val channels = arrayOfNulls<Channel>(256)
+    private val active = ArrayList<Channel>()
+    @Volatile private var resetPending = false
+
+    private val thread = Thread({ ingestLoop() }, "ble-ingest").apply { isDaemon = true }
+
+    /** Packets accepted by [offer]. */
+    @Volatile var packets = 0L
+        private set
+    /** Packets refused because the ring was full or they did not fit a slot. */
+    @Volatile var droppedPackets = 0L
+        private set
+    /** Packets whose frames did not parse; frames before the bad one were kept. */
+    @Volatile var malformedPackets = 0L
+        private set
+    /** Blocks handed to [sink]. */
+    @Volatile var publishes = 0L
+        private set
+    /** Times the ingest thread woke up, for judging the interval's power cost. */
+    @Volatile var wakeups = 0L
+        private set
+
+    /** Packets waiting in the ring to be decoded. */
+    val queueDepth: Int get() = (head - tail).toInt()
+    val capacity: Int get() = slotCount
+    private val inFlight = AtomicInteger()
+    /** Blocks handed to [sink] and not yet released. */
+    val blocksInFlight: Int get() = inFlight.get()
+
+    /** Time between hand-overs to [sink]; takes effect at once. */
+    @Volatile var publishIntervalMs = publishIntervalMs
+        set(value) {
+            field = value
+            LockSupport.unpark(thread)
+        }
+
+    fun start() {
+        thread.start()
+    }
+
+    /**
+     * Queues the first [length] bytes of [data], received at [rxNs]. Safe to
+     * call from several threads. Returns false if the packet was dropped.
+     */
+    fun offer(data: ByteArray, length: Int, rxNs: Long): Boolean {
+        synchronized(producerLock) {
+            val h = head
+            if (length > slotSize || h - tail >= slotCount) {
+                droppedPackets++
+                return false
+            }
+            val i = (h % slotCount).toInt()
+            System.arraycopy(data, 0, slots[i], 0, length)
+            lengths[i] = length
+            rxTimes[i] = rxNs
+            head = h + 1
+            packets++
+            // Past half full, decode now rather than at the next tick
+            if (h + 1 - tail == slotCount / 2L) LockSupport.unpark(thread)
+        }
+        return true
+    }
+
+    /** Forgets each channel's last sequence number, for a new connection. */
+    fun reset() {
+        resetPending = true
+    }
+
+    private fun ingestLoop() {
+        var lastPublish = System.nanoTime()
+        while (true) {
+            drain()
+            val now = System.nanoTime()
+            val nextPublish = lastPublish + publishIntervalMs * 1_000_000
+            if (now >= nextPublish) {
+                publish()
+                lastPublish = now
+            } else {
+                LockSupport.parkNanos(nextPublish - now)
+                wakeups++
+            }
+        }
+    }
+
+    private fun drain() {
+        if (resetPending) {
+            resetPending = false
+            for (ch in channels) ch?.lastSeq = -1
+        }
+        var t = tail
+        val h = head
+        while (t < h) {
+            val i = (t % slotCount).toInt()
+            decode(i)
+            t++
+            tail = t
+        }
+    }
+
+    private fun decode(i: Int) {
+        val data = slots[i]
+        val length = lengths[i]
+        val rxNs = rxTimes[i]
+        if (!StreamProto.isStream(data, length)) {
+            decodeText(data, length, rxNs)
+            return
+        }
+        val ok = StreamProto.forEachFrame(views[i], length) { frame ->
+            channel(frame.channel).add(frame, rxNs)
+        }
+        if (!ok) malformedPackets++
+    }
+
+    private fun decodeText(data: ByteArray, length: Int, rxNs: Long) {
+        val text = String(data, 0, length, Charsets.UTF_8)
+        for ((prefix, ch) in TEXT_PREFIXES) {
+            if (text.startsWith(prefix)) {
+                channel(ch).addText(text.substring(prefix.length), rxNs)
+                return
+            }
+        }
+    }
+
+    private fun channel(id: Int): Channel =
+        channels[id] ?: Channel(id).also {
+            channels[id] = it
+            active.add(it)
+        }
+
+    private fun publish() {
+        for (i in active.indices) active[i].publish()
+    }
+
+    private inner class Channel(id: Int) : Runnable {
+        private val blocks = arrayOf(SampleBlock(id), SampleBlock(id))
+        private var filling = 0
+        private var posted = 0
+        private val busy = AtomicBoolean(false)
+        private val released = Runnable {
+            busy.set(false)
+            inFlight.decrementAndGet()
+        }
+        var lastSeq = -1
+
+        init {
+            for (b in blocks) b.onReleased = released
+        }
+
+        fun add(frame: StreamFrame, rxNs: Long) {
+            val seq = frame.seq
+            val lost = if (lastSeq < 0) 0 else (seq - lastSeq - 1) and 0xFFFF
+            lastSeq = seq
+            val clock = clock
+            if (clock != null && clock.isSynced) {
+                blocks[filling].add(frame, lost, rxNs, clock.toPhoneNs(frame.t0Us), clock.rate)
+            } else {
+                blocks[filling].add(frame, lost, rxNs, rxNs, 1.0)
+            }
+        }
+
+        fun addText(text: String, rxNs: Long) {
+            blocks[filling].addText(text, rxNs)
+        }
+
+        // Ingest thread
+        fun publish() {
+            if (blocks[filling].isEmpty || !busy.compareAndSet(false, true)) return
+            posted = filling
+            filling = 1 - filling
+            blocks[filling].clear()
+            publishes++
+            inFlight.incrementAndGet()
+            executor.execute(this)
+        }
+
+        // Executor thread
+        override fun run() {
+            val block = blocks[posted]
+            block.retain()
+            try {
+                sink(block)
+            } finally {
+                block.release()
+            }
+        }
+    }
+
+    companion object {
+        internal val TEXT_PREFIXES = listOf(
+            "EMG," to StreamProto.CH_EMG,
+            "PPG," to StreamProto.CH_PPG,
+            "SWEAT," to StreamProto.CH_SWEAT,
+            "TEST," to StreamProto.CH_TEST,
+        )
+    }
+}
+
+/**
+ * One channel's data from one [StreamIngest] tick: the frames as received
+ * and their samples decoded onto one array. Only valid during the
+ * listener call, unless kept with [retain]; the next tick reuses it.
+ *
+ * [channel] includes [StreamProto.CH_REPLAY] for backlog frames, which are
+ * kept apart from the live stream.
+ */
+class SampleBlock(val channel: Int) {
+    /** Decoded samples. Packed frames are unpacked; a features frame gives its mean. */
+    var size = 0
+        private set
+    var values = FloatArray(INITIAL_SAMPLES)
+        private set
+    /** Device time of each sample in µs (see [StreamFrame.sampleTimeUs]). */
+    var timesUs = LongArray(INITIAL_SAMPLES)
+        private set
+    /** Phone time of each sample (elapsedRealtimeNanos), see [StreamIngest]. */
+    var phoneTimesNs = LongArray(INITIAL_SAMPLES)
+        private set
+
+    /** The frames, back to back, header included. */
+    var frameBytes = ByteArray(INITIAL_BYTES)
+        private set
+    var frameBytesLength = 0
+        private set
+    var frameCount = 0
+        private set
+
+    /** Frames missing from the sequence numbers, before and between these ones. */
+    var lostFrames = 0
+        private set
+    /** Receive time of the oldest packet in the block. */
+    var firstRxNs = 0L
+        private set
+    /** Receive time of the newest packet in the block. */
+    var lastRxNs = 0L
+        private set
+
+    /** Text packets from older firmware, prefix removed. */
+    val text = ArrayList<String>()
+
+    @PublishedApi internal var view = wrap(frameBytes)
+    private val unpacked = IntArray(256)
+    private val holds = AtomicInteger()
+    internal var onReleased: Runnable? = null
+
+    val isEmpty: Boolean get() = frameCount == 0 && text.isEmpty()
+
+    /** Calls [block] for every frame, as [StreamProto.forEachFrame] does. */
+    inline fun forEachFrame(block: (StreamFrame) -> Unit) {
+        StreamProto.forEachFrame(view, frameBytesLength, block)
+    }
+
+    fun writeFramesTo(out: java.io.OutputStream) {
+        out.write(frameBytes, 0, frameBytesLength)
+    }
+
+    /**
+     * Keeps the block from being reused after the listener call returns, so
+     * it can be handed to another thread. Each call needs one [release].
+     */
+    fun retain() {
+        holds.incrementAndGet()
+    }
+
+    fun release() {
+        if (holds.decrementAndGet() == 0) onReleased?.run()
+    }
+
+    internal fun clear() {
+        size = 0
+        frameBytesLength = 0
+        frameCount = 0
+        lostFrames = 0
+        text.clear()
+    }
+
+    /**
+     * Adds [frame]. Its first sample is at phone time [t0Ns], and its
+     * period is scaled by [rate] phone seconds per device second.
+     */
+    internal fun add(frame: StreamFrame, lost: Int, rxNs: Long, t0Ns: Long, rate: Double) {
+        val length = frame.length
+        if (frameBytesLength + length > frameBytes.size) {
+            frameBytes = frameBytes.copyOf(maxOf(frameBytes.size * 2, frameBytesLength + length))
+            view = wrap(frameBytes)
+        }
+        if (isEmpty) firstRxNs = rxNs
+        frame.copyTo(frameBytes, frameBytesLength)
+        frameBytesLength += length
+        frameCount++
+        lostFrames += lost
+        lastRxNs = rxNs
+        val periodNs = frame.periodNs
+
+        when (frame.format) {
+            StreamProto.FMT_I16_DELTA -> {
+                val n = frame.unpackI16(unpacked)
+                ensureSamples(n)
+                for (i in 0 until n) {
+                    append(unpacked[i].toFloat(), frame.sampleTimeUs(i), t0Ns + (rate * i * periodNs).toLong())
+                }
+            }
+            StreamProto.FMT_I16_STATS -> if (frame.count >= 3) {
+                ensureSamples(1)
+                append(frame.getInt(2).toFloat(), frame.t0Us, t0Ns)
+            }
+            else -> {
+                val n = frame.count
+                ensureSamples(n)
+                for (i in 0 until n) {
+                    append(frame.getFloat(i), frame.sampleTimeUs(i), t0Ns + (rate * i * periodNs).toLong())
+                }
+            }
+        }
+    }
+
+    internal fun addText(line: String, rxNs: Long) {
+        if (isEmpty) firstRxNs = rxNs
+        text.add(line)
+        lastRxNs = rxNs
+    }
+
+    private fun append(value: Float, timeUs: Long, phoneNs: Long) {
+        values[size] = value
+        timesUs[size] = timeUs
+        phoneTimesNs[size] = phoneNs
+        size++
+    }
+
+    private fun ensureSamples(n: Int) {
+        if (size + n <= values.size) return
+        val capacity = maxOf(values.size * 2, size + n)
+        values = values.copyOf(capacity)
+        timesUs = timesUs.copyOf(capacity)
+        phoneTimesNs = phoneTimesNs.copyOf(capacity)
+    }
+
+    private companion object {
+        const val INITIAL_SAMPLES = 1024
+        const val INITIAL_BYTES = 4096
+
+        fun wrap(bytes: ByteArray) = StreamFrame(ByteBuffer.wrap(bytes).order(ByteOrder.LITTLE_ENDIAN))
+    }
+}
@@ -0,0 +1,185 @@
+package com.example.biobanddisplay
+
+import android.content.Context
+import android.graphics.Canvas
+import android.graphics.Color
+import android.graphics.Paint
+import android.os.Build
+import android.os.Handler
+import android.os.HandlerThread
+import android.util.AttributeSet
+import android.util.Log
+import android.view.Choreographer
+import android.view.SurfaceHolder
+import android.view.SurfaceView
+import java.util.Locale
+
+/**
+ * Scrolling plot of one high-rate signal, for EMG at full rate and for PPG.
+ *
+ * Samples go into a [SampleRing] of [capacity] floats with [append]. A
+ * render thread draws the last [visibleSamples] once per display frame,
+ * driven by Choreographer, and skips frames in which nothing new arrived.
+ * Each pixel column is drawn as one vertical line from the min to the max
+ * of its samples, so a frame costs one pass over the visible samples plus
+ * one line per pixel, whatever the sample rate. Nothing is allocated per
+ * frame.
+ *
+ * The y axis follows the visible min and max. Frame times are logged every
+ * few seconds under "STRIP_CHART" and kept in [meanFrameMs] / [maxFrameMs].
+ */
+class StripChartView @JvmOverloads constructor(
+    context: Context,
+    attrs: AttributeSet? = null,
+) : SurfaceView(context, attrs), SurfaceHolder.Callback {
+
+    var capacity = DEFAULT_CAPACITY
+        set(value) {
+            field = value
+            ring = SampleRing(value)
+        }
+    @Volatile var visibleSamples = DEFAULT_CAPACITY
+    @Volatile var lineColor = Color.CYAN
+    @Volatile var chartBackground = Color.BLACK
+    @Volatile var label = ""
+
+    @Volatile private var ring = SampleRing(capacity)
+
+    private val linePaint = Paint().apply { strokeWidth = 1f; isAntiAlias = false }
+    private val textPaint = Paint().apply { color = Color.WHITE; textSize = 28f; isAntiAlias = true }
+    private var mins = FloatArray(0)
+    private var maxs = FloatArray(0)
+    private var lines = FloatArray(0)
+
+    private var renderThread: HandlerThread? = null
+    private var renderHandler: Handler? = null
+    @Volatile private var running = false
+    private var drawnTotal = -1L
+    private var surfaceWidth = 0
+    private var surfaceHeight = 0
+
+    private var frames = 0
+    private var frameNsSum = 0L
+    private var frameNsMax = 0L
+    private var lastLogNs = 0L
+
+    /** Mean and worst render time over the last logging period, in ms. */
+    @Volatile var meanFrameMs = 0f
+        private set
+    @Volatile var maxFrameMs = 0f
+        private set
+
+    init {
+        holder.addCallback(this)
+    }
+
+    fun append(values: FloatArray, count: Int = values.size) = ring.append(values, count)
+
+    fun append(value: Float) = ring.append(value)
+
+    fun clear() = ring.clear()
+
+    override fun surfaceCreated(holder: SurfaceHolder) {
+        val thread = HandlerThread("chart-render").apply { start() }
+        renderThread = thread
+        running = true
+        renderHandler = Handler(thread.looper).apply {
+            post { Choreographer.getInstance().postFrameCallback(frameCallback) }
+        }
+    }
+
+    override fun surfaceChanged(holder: SurfaceHolder, format: Int, w: Int, h: Int) {
+        renderHandler?.post {
+            surfaceWidth = w
+            surfaceHeight = h
+            mins = FloatArray(w)
+            maxs = FloatArray(w)
+            lines = FloatArray(4 * w)
+            drawnTotal = -1
+        }
+    }
+
+    override fun surfaceDestroyed(holder: SurfaceHolder) {
+        running = false
+        renderThread?.quitSafely()
+        // The surface must not be drawn on once this returns
+        renderThread?.join()
+        renderThread = null
+        renderHandler = null
+    }
+
+    private val frameCallback = object : Choreographer.FrameCallback {
+        override fun doFrame(frameTimeNanos: Long) {
+            if (!running) return
+            val r = ring
+            if (r.total != drawnTotal && surfaceWidth > 0) {
+                drawnTotal = r.total
+                val start = System.nanoTime()
+                render(r)
+                record(System.nanoTime() - start)
+            }
+            Choreographer.getInstance().postFrameCallback(this)
+        }
+    }
+
+    private fun render(r: SampleRing) {
+        val cols = r.decimate(visibleSamples, surfaceWidth, mins, maxs)
+        val canvas = lockSurface() ?: return
+        try {
+            canvas.drawColor(chartBackground)
+            if (cols > 0) drawColumns(canvas, cols)
+        } finally {
+            holder.unlockCanvasAndPost(canvas)
+        }
+    }
+
+    private fun drawColumns(canvas: Canvas, cols: Int) {
+        var lo = Float.MAX_VALUE
+        var hi = -Float.MAX_VALUE
+        for (c in 0 until cols) {
+            if (mins[c] < lo) lo = mins[c]
+            if (maxs[c] > hi) hi = maxs[c]
+        }
+        val span = if (hi > lo) hi - lo else 1f
+        val top = PADDING
+        val scale = (surfaceHeight - 2 * PADDING) / span
+        val dx = surfaceWidth.toFloat() / cols
+        for (c in 0 until cols) {
+            val x = c * dx
+            lines[4 * c] = x
+            lines[4 * c + 1] = top + (hi - maxs[c]) * scale
+            lines[4 * c + 2] = x
+            // A flat column still needs one pixel to show
+            lines[4 * c + 3] = top + (hi - mins[c]) * scale + 1f
+        }
+        linePaint.color = lineColor
+        canvas.drawLines(lines, 0, 4 * cols, linePaint)
+        if (label.isNotEmpty()) canvas.drawText(label, PADDING, textPaint.textSize, textPaint)
+    }
+
+    private fun lockSurface(): Canvas? =
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) holder.lockHardwareCanvas() else holder.lockCanvas()
+
+    private fun record(ns: Long) {
+        frames++
+        frameNsSum += ns
+        if (ns > frameNsMax) frameNsMax = ns
+        val now = System.nanoTime()
+        if (now - lastLogNs >= LOG_INTERVAL_NS) {
+            meanFrameMs = frameNsSum / 1e6f / frames
+            maxFrameMs = frameNsMax / 1e6f
+            Log.d("STRIP_CHART", String.format(Locale.US, "%s: %d frames, %.2f ms mean, %.2f ms max, %d samples shown",
+                label, frames, meanFrameMs, maxFrameMs, minOf(visibleSamples, ring.size)))
+            frames = 0
+            frameNsSum = 0
+            frameNsMax = 0
+            lastLogNs = now
+        }
+    }
+
+    private companion object {
+        const val DEFAULT_CAPACITY = 1 shl 16
+        const val PADDING = 8f
+        const val LOG_INTERVAL_NS = 5_000_000_000L
+    }
+}
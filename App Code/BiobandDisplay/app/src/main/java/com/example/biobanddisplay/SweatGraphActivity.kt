@@ -9,11 +9,12 @@ import android.widget.Button
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
 import com.chaquo.python.PyException
-import com.chaquo.python.Python
+import com.chaquo.python.PyObject
 import com.github.mikephil.charting.charts.LineChart
 import com.github.mikephil.charting.data.Entry
 import com.github.mikephil.charting.data.LineData
 import com.github.mikephil.charting.data.LineDataSet
+import java.util.concurrent.Future
 
 class SweatGraphActivity : AppCompatActivity(), BleDataListener {
 
@@ -21,17 +22,20 @@ class SweatGraphActivity : AppCompatActivity(), BleDataListener {
     private lateinit var lineChart: LineChart
     private lateinit var backButton: Button
     private val handler = Handler(Looper.getMainLooper())
+    private lateinit var analyzer: Future<PyObject>
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
         setContentView(R.layout.activity_sweat_graph)
+        // Imported in the background; packets before that are skipped
+        analyzer = PythonRuntime.load(this, "sweat_analyzer")
         lineChart = findViewById(R.id.sweat_line_chart)
         backButton = findViewById(R.id.back_button_sweat)
         backButton.setOnClickListener {
             finish()
         }
         setupChart()
-        if (BleConnectionManager.gatt == null) {
+        if (!BleConnectionManager.isStreaming) {
             Toast.makeText(this, "Connection lost, returning to main screen.", Toast.LENGTH_LONG).show()
             finish()
             return
@@ -41,7 +45,7 @@ class SweatGraphActivity : AppCompatActivity(), BleDataListener {
     override fun onResume() {
         super.onResume()
         BleConnectionManager.sweatDataListener = this
-        if (BleConnectionManager.gatt == null) {
+        if (!BleConnectionManager.isStreaming) {
             Toast.makeText(this, "Device Disconnected", Toast.LENGTH_SHORT).show()
             finish()
         }
@@ -56,9 +60,12 @@ class SweatGraphActivity : AppCompatActivity(), BleDataListener {
 
     override fun onDataReceived(data: String) {
         Log.d(TAG, "onDataReceived: Attempting to process sweat data string: '$data'")
+        if (!analyzer.isDone) {
+            Log.d(TAG, "sweat_analyzer still loading, packet skipped")
+            return
+        }
         try {
-            val python = Python.getInstance()
-            val analyzerModule = python.getModule("sweat_analyzer")
+            val analyzerModule = analyzer.get()
             val processedDataPyObject = analyzerModule.callAttr("process_sweat_data", data)
             @Suppress("UNCHECKED_CAST")
             val processedData: List<Float> = processedDataPyObject.toJava(List::class.java) as List<Float>
@@ -6,7 +6,7 @@ import android.view.View
 import android.widget.Button
 import android.widget.ProgressBar
 import androidx.appcompat.app.AppCompatActivity
-import com.chaquo.python.Python
+import com.chaquo.python.PyObject
 import com.github.mikephil.charting.charts.LineChart
 import com.github.mikephil.charting.components.XAxis
 import com.github.mikephil.charting.data.Entry
@@ -14,32 +14,40 @@ import com.github.mikephil.charting.data.LineData
 import com.github.mikephil.charting.data.LineDataSet
 import com.github.mikephil.charting.interfaces.datasets.ILineDataSet
 import java.util.*
+import java.util.concurrent.Future
 import kotlin.concurrent.thread
 
 class TestGraphActivity : AppCompatActivity(), BleDataListener {
 
     private lateinit var chart: LineChart
+    private lateinit var liveChart: StripChartView
     private lateinit var backButton: Button
     private lateinit var loadCsvButton: Button
     private lateinit var loadingIndicator: ProgressBar
+    private lateinit var analyzer: Future<PyObject>
 
     // Data handling
     private val entries1 = ArrayList<Entry>()
     private val entries2 = ArrayList<Entry>()
     private val entries3 = ArrayList<Entry>()
-    
-    private var xValueCounter = 0f
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
         setContentView(R.layout.activity_test_graph)
+        // Imported in the background; live packets before that are skipped
+        analyzer = PythonRuntime.load(this, "test_analyzer")
 
         chart = findViewById(R.id.chart)
+        liveChart = findViewById(R.id.liveChart)
         backButton = findViewById(R.id.btnBack)
         loadCsvButton = findViewById(R.id.btnLoadCsv)
         loadingIndicator = findViewById(R.id.loadingIndicator)
 
         setupChart()
+        liveChart.label = "Real-time"
+        liveChart.lineColor = Color.YELLOW
+        liveChart.chartBackground = Color.parseColor("#1B1B1B")
+        liveChart.visibleSamples = LIVE_VISIBLE
 
         backButton.setOnClickListener {
             finish()
@@ -90,14 +98,18 @@ class TestGraphActivity : AppCompatActivity(), BleDataListener {
         processAndPlotData(data)
     }
 
+    // Stream frames come with their samples decoded; no need for Python
+    override fun onSamples(block: SampleBlock) {
+        liveChart.append(block.values, block.size)
+    }
+
     private fun processAndPlotData(rawString: String) {
-        val python = Python.getInstance()
-        val pyModule = python.getModule("test_analyzer")
+        if (!analyzer.isDone) return
+        val pyModule = analyzer.get()
         val resultList = pyModule.callAttr("process_test_data", rawString).asList()
         
         for (item in resultList) {
-            val value = item.toFloat()
-            addEntryToChart(value, 0)
+            liveChart.append(item.toFloat())
         }
     }
     
@@ -108,8 +120,7 @@ class TestGraphActivity : AppCompatActivity(), BleDataListener {
         // Use a background thread to prevent the UI from freezing
         thread {
             try {
-                val python = Python.getInstance()
-                val pyModule = python.getModule("test_analyzer")
+                val pyModule = analyzer.get()
                 val resultList = pyModule.callAttr("get_csv_data").asList()
                 
                 val newEntries1 = ArrayList<Entry>()
@@ -156,24 +167,6 @@ class TestGraphActivity : AppCompatActivity(), BleDataListener {
         }
     }
 
-    private fun addEntryToChart(value: Float, datasetIndex: Int) {
-        val data = chart.data
-        if (data != null) {
-            var set = data.getDataSetByIndex(datasetIndex)
-            if (set == null) {
-                set = createSet(ArrayList(), "Real-time", Color.YELLOW)
-                data.addDataSet(set)
-            }
-
-            data.addEntry(Entry(xValueCounter, value), datasetIndex)
-            if (datasetIndex == 0) xValueCounter++
-
-            data.notifyDataChanged()
-            chart.notifyDataSetChanged()
-            chart.moveViewToX(data.entryCount.toFloat())
-        }
-    }
-
     private fun createSet(entries: ArrayList<Entry>, label: String, color: Int): LineDataSet {
         val set = LineDataSet(entries, label)
         set.color = color
@@ -183,4 +176,8 @@ class TestGraphActivity : AppCompatActivity(), BleDataListener {
         set.axisDependency = com.github.mikephil.charting.components.YAxis.AxisDependency.LEFT
         return set
     }
+
+    companion object {
+        private const val LIVE_VISIBLE = 2000
+    }
 }
@@ -0,0 +1,363 @@
+package com.example.biobanddisplay
+
+import java.io.Closeable
+import java.io.EOFException
+import java.io.File
+import java.io.RandomAccessFile
+import java.nio.ByteBuffer
+import java.nio.channels.FileChannel
+import java.util.TimeZone
+import java.util.TreeMap
+
+/** Points of one series, in time order. */
+class SeriesPoints(val timesMs: LongArray, val values: DoubleArray) {
+    val size get() = timesMs.size
+}
+
+/** One series summarised per bucket of [resolutionMs], oldest first. Empty buckets are left out. */
+class SeriesRollup(
+    val resolutionMs: Long,
+    val startsMs: LongArray,
+    val counts: IntArray,
+    val mins: DoubleArray,
+    val maxs: DoubleArray,
+    val sums: DoubleArray,
+) {
+    val size get() = startsMs.size
+    fun mean(i: Int) = sums[i] / counts[i]
+}
+
+/**
+ * Long-term store for the monitor's metrics and the journal: EMG Vrms and
+ * mean frequency, heart rate, SpO2 and the daily scores.
+ *
+ * Each series is a directory in [dir] with append-only files:
+ *
+ *  - chunks.bin: up to [chunkPoints] points or [chunkMs] of time per chunk,
+ *    compressed by [GorillaCodec].
+ *  - rollup_<ms>.bin: each chunk's count/min/max/sum per minute, hour and
+ *    local day ([RESOLUTIONS]).
+ *  - index.bin: one [INDEX_BYTES] record per chunk, with its time span and
+ *    where its data and rollups are. It is loaded once, when the series is
+ *    first used.
+ *
+ * [range] decodes only the chunks that overlap the query. [rollup] reads
+ * only those chunks' rollup records, so a week of hourly means reads a few
+ * KB whatever the sample rate. Points of the open chunk are held in memory
+ * until it fills or [flush] is called, and queries include them.
+ *
+ * Points may be appended out of order, for example a journal entry for an
+ * earlier day. The open chunk is closed first, so each chunk stays in time
+ * order. Queries sort what they return and merge buckets that appear in
+ * more than one chunk.
+ *
+ * The index record is written last. If the app dies between writes, the
+ * orphaned bytes are never referenced and a partial index record is cut
+ * off on open.
+ *
+ * Thread safe.
+ */
+class TimeSeriesStore(
+    private val dir: File,
+    private val chunkPoints: Int = 1024,
+    private val chunkMs: Long = 15 * 60_000L,
+    /** Added to times before day buckets are cut, so days start at local midnight. */
+    private val zoneOffsetMs: Long = TimeZone.getDefault().getOffset(System.currentTimeMillis()).toLong(),
+) : Closeable {
+
+    private class Entry(
+        val startMs: Long,
+        val endMs: Long,
+        val offset: Long,
+        val length: Int,
+        val count: Int,
+        val rollupOffsets: LongArray,
+        val rollupCounts: IntArray,
+    )
+
+    private inner class Series(name: String) {
+        val path = File(dir, name)
+        val chunks: FileChannel
+        val index: FileChannel
+        val rollups: Array<FileChannel>
+        val entries = ArrayList<Entry>()
+        // Chunks follow each other without overlap, so spans can be binary searched
+        var ordered = true
+        // The open chunk
+        val times = LongArray(chunkPoints)
+        val values = DoubleArray(chunkPoints)
+        var count = 0
+
+        init {
+            path.mkdirs()
+            chunks = channel("chunks.bin")
+            index = channel("index.bin")
+            rollups = Array(RESOLUTIONS.size) { channel("rollup_${RESOLUTIONS[it]}.bin") }
+            val records = (index.size() / INDEX_BYTES).toInt()
+            index.truncate(records.toLong() * INDEX_BYTES)
+            if (records > 0) {
+                val buf = read(index, 0, records * INDEX_BYTES)
+                repeat(records) {
+                    val e = Entry(buf.long, buf.long, buf.long, buf.int, buf.int,
+                        LongArray(RESOLUTIONS.size), IntArray(RESOLUTIONS.size))
+                    for (r in RESOLUTIONS.indices) {
+                        e.rollupOffsets[r] = buf.long
+                        e.rollupCounts[r] = buf.int
+                    }
+                    add(e)
+                }
+            }
+        }
+
+        private fun channel(file: String) = RandomAccessFile(File(path, file), "rw").channel
+
+        fun add(e: Entry) {
+            if (entries.isNotEmpty() && e.startMs < entries.last().endMs) ordered = false
+            entries.add(e)
+        }
+
+        // Chunks holding anything in [fromMs, toMs)
+        inline fun forEachOverlapping(fromMs: Long, toMs: Long, action: (Entry) -> Unit) {
+            if (!ordered) {
+                for (e in entries) if (e.endMs >= fromMs && e.startMs < toMs) action(e)
+                return
+            }
+            var lo = 0
+            var hi = entries.size
+            while (lo < hi) {
+                val mid = (lo + hi) ushr 1
+                if (entries[mid].endMs < fromMs) lo = mid + 1 else hi = mid
+            }
+            for (i in lo until entries.size) {
+                val e = entries[i]
+                if (e.startMs >= toMs) break
+                action(e)
+            }
+        }
+
+        fun close() {
+            chunks.close()
+            index.close()
+            for (ch in rollups) ch.close()
+        }
+    }
+
+    private class Bucket(var count: Int, var min: Double, var max: Double, var sum: Double) {
+        fun add(count: Int, min: Double, max: Double, sum: Double) {
+            this.count += count
+            if (min < this.min) this.min = min
+            if (max > this.max) this.max = max
+            this.sum += sum
+        }
+    }
+
+    private val series = HashMap<String, Series>()
+
+    /** File bytes read so far, index loads included. */
+    @Volatile var bytesRead = 0L
+        private set
+
+    /** Adds one point to series [name]. Lowercase letters, digits and '_' only. */
+    @Synchronized
+    fun append(name: String, timeMs: Long, value: Double) {
+        val s = open(name)
+        if (s.count > 0 && (s.count == chunkPoints || timeMs < s.times[s.count - 1] || timeMs - s.times[0] >= chunkMs)) {
+            seal(s)
+        }
+        s.times[s.count] = timeMs
+        s.values[s.count] = value
+        s.count++
+    }
+
+    /** Writes out the open chunks and syncs them to disk. */
+    @Synchronized
+    fun flush() {
+        for (s in series.values) {
+            seal(s)
+            s.chunks.force(false)
+            for (ch in s.rollups) ch.force(false)
+            s.index.force(false)
+        }
+    }
+
+    /** Points of [name] with times in [fromMs, toMs). */
+    @Synchronized
+    fun range(name: String, fromMs: Long, toMs: Long): SeriesPoints {
+        val s = open(name)
+        var times = LongArray(64)
+        var values = DoubleArray(64)
+        var n = 0
+        fun add(t: Long, v: Double) {
+            if (t < fromMs || t >= toMs) return
+            if (n == times.size) {
+                times = times.copyOf(n * 2)
+                values = values.copyOf(n * 2)
+            }
+            times[n] = t
+            values[n++] = v
+        }
+
+        var chunkTimes = LongArray(0)
+        var chunkValues = DoubleArray(0)
+        s.forEachOverlapping(fromMs, toMs) { e ->
+            if (chunkTimes.size < e.count) {
+                chunkTimes = LongArray(e.count)
+                chunkValues = DoubleArray(e.count)
+            }
+            val buf = read(s.chunks, e.offset, e.length)
+            GorillaCodec.decode(buf.array(), 0, e.length, e.count, chunkTimes, chunkValues, 0)
+            for (i in 0 until e.count) add(chunkTimes[i], chunkValues[i])
+        }
+        for (i in 0 until s.count) add(s.times[i], s.values[i])
+
+        for (i in 1 until n) {
+            if (times[i] < times[i - 1]) {
+                // Out-of-order appends; stable, so the later write of a time comes last
+                val order = (0 until n).sortedBy { times[it] }
+                return SeriesPoints(LongArray(n) { times[order[it]] }, DoubleArray(n) { values[order[it]] })
+            }
+        }
+        return SeriesPoints(times.copyOf(n), values.copyOf(n))
+    }
+
+    /** Buckets of [resolutionMs], one of [RESOLUTIONS], that start in [bucketStart] of [fromMs] until [toMs]. */
+    @Synchronized
+    fun rollup(name: String, resolutionMs: Long, fromMs: Long, toMs: Long): SeriesRollup {
+        val r = RESOLUTIONS.indexOf(resolutionMs)
+        require(r >= 0) { "No rollup at $resolutionMs ms" }
+        val s = open(name)
+        val first = bucketStart(fromMs, resolutionMs)
+        val buckets = TreeMap<Long, Bucket>()
+        fun add(start: Long, count: Int, min: Double, max: Double, sum: Double) {
+            if (start < first || start >= toMs) return
+            val b = buckets[start]
+            if (b == null) buckets[start] = Bucket(count, min, max, sum) else b.add(count, min, max, sum)
+        }
+
+        s.forEachOverlapping(first, toMs) { e ->
+            val records = e.rollupCounts[r]
+            val buf = read(s.rollups[r], e.rollupOffsets[r], records * ROLLUP_BYTES)
+            repeat(records) { add(buf.long, buf.int, buf.double, buf.double, buf.double) }
+        }
+        for (i in 0 until s.count) {
+            val v = s.values[i]
+            add(bucketStart(s.times[i], resolutionMs), 1, v, v, v)
+        }
+
+        val n = buckets.size
+        val out = SeriesRollup(resolutionMs, LongArray(n), IntArray(n), DoubleArray(n), DoubleArray(n), DoubleArray(n))
+        var i = 0
+        for ((start, b) in buckets) {
+            out.startsMs[i] = start
+            out.counts[i] = b.count
+            out.mins[i] = b.min
+            out.maxs[i] = b.max
+            out.sums[i] = b.sum
+            i++
+        }
+        return out
+    }
+
+    /** Start of the bucket of [resolutionMs] holding [timeMs]; days start at local midnight. */
+    fun bucketStart(timeMs: Long, resolutionMs: Long): Long =
+        Math.floorDiv(timeMs + zoneOffsetMs, resolutionMs) * resolutionMs - zoneOffsetMs
+
+    /** Bytes on disk for series [name]. */
+    @Synchronized
+    fun diskBytes(name: String): Long =
+        open(name).path.listFiles()?.sumOf { it.length() } ?: 0L
+
+    @Synchronized
+    override fun close() {
+        flush()
+        for (s in series.values) s.close()
+        series.clear()
+    }
+
+    private fun open(name: String): Series {
+        require(NAME.matches(name)) { "Bad series name: $name" }
+        return series.getOrPut(name) { Series(name) }
+    }
+
+    // Writes the open chunk, its rollups and then its index record
+    private fun seal(s: Series) {
+        if (s.count == 0) return
+        val body = GorillaCodec.encode(s.times, s.values, 0, s.count)
+        val offset = s.chunks.size()
+        write(s.chunks, ByteBuffer.wrap(body), offset)
+
+        val rollupOffsets = LongArray(RESOLUTIONS.size)
+        val rollupCounts = IntArray(RESOLUTIONS.size)
+        val buf = ByteBuffer.allocate(s.count * ROLLUP_BYTES)
+        for (r in RESOLUTIONS.indices) {
+            val res = RESOLUTIONS[r]
+            buf.clear()
+            var i = 0
+            while (i < s.count) {
+                // The chunk is in time order, so a bucket's points are consecutive
+                val start = bucketStart(s.times[i], res)
+                var min = s.values[i]
+                var max = min
+                var sum = 0.0
+                var count = 0
+                while (i < s.count && s.times[i] < start + res) {
+                    val v = s.values[i++]
+                    if (v < min) min = v
+                    if (v > max) max = v
+                    sum += v
+                    count++
+                }
+                buf.putLong(start).putInt(count).putDouble(min).putDouble(max).putDouble(sum)
+                rollupCounts[r]++
+            }
+            buf.flip()
+            rollupOffsets[r] = s.rollups[r].size()
+            write(s.rollups[r], buf, rollupOffsets[r])
+        }
+
+        val e = Entry(s.times[0], s.times[s.count - 1], offset, body.size, s.count, rollupOffsets, rollupCounts)
+        val record = ByteBuffer.allocate(INDEX_BYTES)
+            .putLong(e.startMs).putLong(e.endMs).putLong(e.offset).putInt(e.length).putInt(e.count)
+        for (r in RESOLUTIONS.indices) record.putLong(rollupOffsets[r]).putInt(rollupCounts[r])
+        record.flip()
+        write(s.index, record, s.entries.size.toLong() * INDEX_BYTES)
+        s.add(e)
+        s.count = 0
+    }
+
+    private fun write(ch: FileChannel, buf: ByteBuffer, position: Long) {
+        var pos = position
+        while (buf.hasRemaining()) pos += ch.write(buf, pos)
+    }
+
+    private fun read(ch: FileChannel, position: Long, length: Int): ByteBuffer {
+        val buf = ByteBuffer.allocate(length)
+        while (buf.hasRemaining()) {
+            if (ch.read(buf, position + buf.position()) < 0) throw EOFException("Store file ends early")
+        }
+        bytesRead += length
+        buf.flip()
+        return buf
+    }
+
+    companion object {
+        const val MINUTE_MS = 60_000L
+        const val HOUR_MS = 60 * MINUTE_MS
+        const val DAY_MS = 24 * HOUR_MS
+        /** Rollup resolutions kept for every series. */
+        val RESOLUTIONS = longArrayOf(MINUTE_MS, HOUR_MS, DAY_MS)
+
+        // start, count, min, max, sum
+        private const val ROLLUP_BYTES = 8 + 4 + 8 + 8 + 8
+        // start, end, offset, length, count, then offset and count per resolution
+        private const val INDEX_BYTES = 8 + 8 + 8 + 4 + 4 + 3 * (8 + 4)
+        private val NAME = Regex("[a-z0-9_]+")
+
+        private val stores = HashMap<String, TimeSeriesStore>()
+
+        /** One store per directory for the whole process, so writers and readers share open chunks. */
+        fun shared(dir: File): TimeSeriesStore = synchronized(stores) {
+            stores.getOrPut(dir.absolutePath) { TimeSeriesStore(dir) }
+        }
+    }
+}
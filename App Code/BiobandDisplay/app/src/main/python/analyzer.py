@@ -1,7 +1,8 @@
 import csv
 import os
 import numpy as np
-from emg_analyzer import analyze_EMG, analyze_EMG_array
+from emg_analyzer import FS, THRESHOLD, analyze_EMG, analyze_EMG_array
+import stream_proto
 
 def process_ble_data(raw_data_string, csv_path=None):
     try:
@@ -21,5 +22,33 @@ def process_ble_data(raw_data_string, csv_path=None):
     except Exception as e:
         return {"error": str(e), "vrms": 0.0, "tdmf": 0.0, "is_resting": True, "mov_avg": [], "rectified": []}
     
+def process_ble_frames(frames, clock_rate=1.0):
+    """
+    EMG samples from binary stream frames (a Java byte[] from GraphActivity).
+    The sample rate is measured from the frame timestamps, corrected by the
+    device clock rate from the app's time sync, instead of assuming FS.
+    When the link only carries the features tier there are no samples to
+    filter; VRMS then comes from the per-window RMS and TDMF is unknown.
+    """
+    empty = {"vrms": 0.0, "tdmf": 0.0, "is_resting": True, "mov_avg": [], "rectified": []}
+    try:
+        data = bytes(frames)
+        if all(f.format == stream_proto.FMT_I16_STATS
+               for f in stream_proto.iter_frames(data) if f.channel == stream_proto.CH_EMG):
+            feats, windows = stream_proto.channel_features(data, stream_proto.CH_EMG)
+            if len(feats) == 0:
+                return empty
+            vrms = float(np.sqrt(np.sum(feats[:, 3] ** 2 * windows) / np.sum(windows)))
+            return dict(empty, vrms=vrms, is_resting=bool(feats[-1, 3] < THRESHOLD), features_only=True)
+        voltage_data = np.abs(stream_proto.channel_samples(data, stream_proto.CH_EMG))
+        if len(voltage_data) == 0:
+            return empty
+        fs = stream_proto.channel_rate(data, stream_proto.CH_EMG, clock_rate)
+        result = analyze_EMG_array(voltage_data.astype(float), fs or FS)
+        result["fs"] = float(fs or FS)
+        return result
+    except Exception as e:
+        return dict(empty, error=str(e))
+
 if __name__ == "__main__":
     print(process_ble_data(raw_data_string=None, csv_path=r'C:\Users\caitl\OneDrive - Carleton University\Capstone\teraterm_log_jan14.csv'))
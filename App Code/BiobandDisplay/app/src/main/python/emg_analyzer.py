@@ -6,7 +6,7 @@ FS = 13333
 NOTCH_FREQ = 60
 NOTCH_Q = 50
 
-MOVING_AVG_WIN = int(0.150 * FS)
+MOVING_AVG_S = 0.150
 END_HOLD_SAMPLES = 800
 MICRO_NOISE_FLOOR = 3
 
@@ -94,26 +94,30 @@ def stftMeanFrequency(voltage, fs, f_low, f_high, nperseg, noverlap):
     mnf = np.sum(f_band[:, None] * P_band, axis=0) / np.sum(P_band, axis=0)
     return t, mnf
 
-def analyze_EMG_array(raw_voltage):
-    if len(raw_voltage) == 0:
-        return {"vrms": 0.0, "tdmf": 0.0, "is_resting": True, "mov_avg": [], "rectified": [], "mnf_stft": [], "t_stft": []}
-
-    filtered_voltage = notchFilter(raw_voltage, FS, NOTCH_FREQ, NOTCH_Q)
+def filterAndDetect(raw_voltage, fs):
+    filtered_voltage = notchFilter(raw_voltage, fs, NOTCH_FREQ, NOTCH_Q)
     rectified_voltage = np.abs(filtered_voltage - np.mean(filtered_voltage))
     rectified_voltage[rectified_voltage < MICRO_NOISE_FLOOR] = 0
-    mov_avg = movingAverage(rectified_voltage, MOVING_AVG_WIN)
+    mov_avg = movingAverage(rectified_voltage, max(1, int(MOVING_AVG_S * fs)))
+    bursts = detectBursts(rectified_voltage, mov_avg, THRESHOLD)
+    return filtered_voltage, rectified_voltage, mov_avg, bursts
 
-    VrmsLog, startTimeLog, endTimeLog, logging = detectBursts(rectified_voltage, mov_avg, THRESHOLD)
+def analyze_EMG_array(raw_voltage, fs=FS):
+    if len(raw_voltage) == 0:
+        return {"vrms": 0.0, "tdmf": 0.0, "is_resting": True, "mov_avg": [], "rectified": [], "mnf_stft": [], "t_stft": []}
+
+    filtered_voltage, rectified_voltage, mov_avg, bursts = filterAndDetect(raw_voltage, fs)
+    VrmsLog, startTimeLog, endTimeLog, logging = bursts
 
-    t_stft, mnf_stft = stftMeanFrequency(filtered_voltage, FS, FREQ_LOW, FREQ_HIGH, STFT_WIN, STFT_OVERLAP)
+    t_stft, mnf_stft = stftMeanFrequency(filtered_voltage, fs, FREQ_LOW, FREQ_HIGH, STFT_WIN, STFT_OVERLAP)
 
     active_burst = len(VrmsLog) > 0
     if active_burst:
         last_vrms = VrmsLog[-1]
-        last_mnf = meanFrequencyFFT(filtered_voltage[startTimeLog[-1]:endTimeLog[-1]], FS, FREQ_LOW, FREQ_HIGH)
+        last_mnf = meanFrequencyFFT(filtered_voltage[startTimeLog[-1]:endTimeLog[-1]], fs, FREQ_LOW, FREQ_HIGH)
     else:
         last_vrms = rms(filtered_voltage)
-        last_mnf = meanFrequencyFFT(filtered_voltage, FS, FREQ_LOW, FREQ_HIGH)
+        last_mnf = meanFrequencyFFT(filtered_voltage, fs, FREQ_LOW, FREQ_HIGH)
 
     step = max(1, len(mov_avg) // 2000)
     return {
@@ -126,5 +130,16 @@ def analyze_EMG_array(raw_voltage):
         #"mnf_stft": [float(v) for v in mnf_stft],
     }
 
+def burst_table(raw_voltage, fs=FS):
+    """
+    (start, end, vrms, mean frequency) of every burst analyze_EMG_array()
+    would find, for checking the native engine against this reference.
+    """
+    filtered_voltage, _, _, bursts = filterAndDetect(raw_voltage, fs)
+    VrmsLog, startTimeLog, endTimeLog, _ = bursts
+    return [[float(s), float(e), float(v),
+             float(meanFrequencyFFT(filtered_voltage[s:e], fs, FREQ_LOW, FREQ_HIGH))]
+            for v, s, e in zip(VrmsLog, startTimeLog, endTimeLog)]
+
 def analyze_EMG(csvfile):
     return analyze_EMG_array(importCSV(csvfile))
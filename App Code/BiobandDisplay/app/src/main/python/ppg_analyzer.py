@@ -2,31 +2,97 @@ import numpy as np
 from scipy.signal import find_peaks, butter, filtfilt
 import csv
 import os
+import time
+from collections import deque
 
-def peaks_function(signal, time, sign):
-    peaks = []
-    peaks_time = []
-    peaks_index, garbage = find_peaks(sign*signal, prominence=0.2)
-    for i in range(len(peaks_index)):
-        peaks.append(signal[peaks_index[i]])
-        peaks_time.append(time[peaks_index[i]])
+FS = 123.6             # sampling frequency (Hz)
+WINDOW_SAMPLES = 600   # ~4.9 s analysed per update: at least 3 beats at 40 bpm
+MIN_BPM = 40
+MAX_BPM = 180
+BPM_STEP = 5           # displayed bpm only follows changes larger than this
+SPO2_STEP = 2          # and SpO2 larger than this
+MIN_PERFUSION = 1e-4   # smallest pulse counted as a beat, as a fraction of DC
 
-    return peaks, peaks_time
-    
-def process_ppg_data(raw_data_string, csv_path):
+def analyze_ppg_window(time_ms, red_mv, ir_mv, fs=FS):
     """
-    Processes PPG data. 
-    Reads from the provided csv_path.
+    Heart rate and SpO2 from one window of red and IR samples (mV) with
+    their times (ms). bpm and SpO2 are 0 when the window holds fewer
+    than two beats.
+
+    Both channels are low-passed at 5 Hz and split into a DC baseline
+    (below 0.5 Hz) and the pulse around it. Beats are the IR pulse peaks,
+    at least 60/MAX_BPM s apart. bpm comes from the median beat interval.
+    SpO2 = 110 - 25 R, where R is the ratio of each channel's median
+    beat-to-beat amplitude over its mean baseline, red over IR.
     """
-    try:
-        INPUT_HEIGHT = 1.75 # height of user in meters
-        fs = 123.6  # sampling frequency (Hz)
+    red_mv = np.asarray(red_mv, dtype=float)
+    ir_mv = np.asarray(ir_mv, dtype=float)
+    t_filtered = np.asarray(time_ms, dtype=float)
+
+    if len(red_mv) < 10: # Not enough data to process
+        return {
+            "points_red": red_mv.tolist(), "points_ir": ir_mv.tolist(),
+            "bpm": 0, "SpO2": 0
+        }
+
+    num, den = butter(2, 5, btype='low', fs=fs)
+    red_mv = filtfilt(num, den, red_mv)
+    ir_mv = filtfilt(num, den, ir_mv)
+
+    # Remove baseline wander. The cut-off stays below the slowest pulse;
+    # at 2 Hz the baseline took most of a 1 Hz pulse with it.
+    b, a = butter(2, 0.5, btype='low', fs=fs)
+    baseline_red = filtfilt(b, a, red_mv)
+    baseline_ir = filtfilt(b, a, ir_mv)
+    red_ac = red_mv - baseline_red
+    ir_ac = ir_mv - baseline_ir
+
+    # Find heartbeat peaks: one per beat, well above the ripple between them
+    # and above MIN_PERFUSION of the IR level, so a flat signal has none
+    prominence = max(0.6 * np.std(ir_ac), MIN_PERFUSION * abs(np.mean(baseline_ir)))
+    peaks_idx, garb = find_peaks(ir_ac, distance=max(1, int(fs * 60 / MAX_BPM)),
+                                 prominence=prominence)
+    bpm = 0
+    spo2 = 0
+
+    if len(peaks_idx) >= 2:
+        intervals = np.diff(t_filtered[peaks_idx]) * 10**(-3)
+        bpm = round(float(np.clip(60 / np.median(intervals), MIN_BPM, MAX_BPM)), 2)
 
-        # Lists for time and all LED data
-        time_ms = []
-        red_mv = []
-        ir_mv = []
+        # Calculate SpO2 from the peak-to-peak pulse of each beat
+        beats = list(zip(peaks_idx[:-1], peaks_idx[1:]))
+        red_pulse = np.median([np.ptp(red_ac[i:j]) for i, j in beats])
+        ir_pulse = np.median([np.ptp(ir_ac[i:j]) for i, j in beats])
+        red_dc = np.mean(baseline_red)
+        ir_dc = np.mean(baseline_ir)
 
+        if red_dc > 0 and ir_dc > 0 and ir_pulse > 0:
+            R = (red_pulse/red_dc) / (ir_pulse/ir_dc)
+            spo2 = float(np.clip(110 - 25 * R, 70, 100))
+
+    return {
+        "points_red": red_mv.tolist(),
+        "points_ir": ir_mv.tolist(),
+        "bpm": bpm,
+        "SpO2": spo2
+    }
+
+def read_ppg_csv(csv_path, last=None):
+    """Time_ms, Red_lp and IR_lp columns of a PPG CSV, only the last rows if given."""
+    with open(csv_path, newline="") as csvfile:
+        rows = deque(csv.DictReader(csvfile), maxlen=last)
+    return ([float(r["Time_ms"]) for r in rows],
+            [float(r["Red_lp"]) for r in rows],
+            [float(r["IR_lp"]) for r in rows])
+
+def process_ppg_data(raw_data_string, csv_path):
+    """
+    Processes PPG data.
+    Analyses the last WINDOW_SAMPLES rows of the provided csv_path. Without
+    a session there is no display history, so bpm and SpO2 are the window's.
+    Reads the whole file on each call; live data goes through PpgSession.
+    """
+    try:
         # If the file doesn't exist, we return defaults
         if not csv_path or not os.path.exists(csv_path):
             print(f"File not found: {csv_path}")
@@ -34,109 +100,7 @@ def process_ppg_data(raw_data_string, csv_path):
                 "points_red": [], "points_ir": [],
                 "bpm": 0, "artStiffness": 0, "breathingRate": 0, "SpO2": 0
             }
-
-        # Assume data is added to a csv, taking 300 samples at a time (~ 9 seconds)
-        with open(csv_path, newline="") as csvfile:
-            reader = csv.DictReader(csvfile)
-            row_count = len(list(reader))
-            overshoot = row_count - 300
-            count = 0
-            for row in reader:
-                if (row_count < 300) or (row_count >= 300 and count >= overshoot):
-                    time_ms.append(float(row["Time_ms"]))
-                    red_mv.append(float(row["Red_lp"]))
-                    ir_mv.append(float(row["IR_lp"]))
-                count += 1
-
-        # Convert to numpy arrays
-        red_mv = np.array(red_mv)
-        ir_mv = np.array(ir_mv)
-        t_filtered = np.array(time_ms)
-
-        if len(red_mv) < 10: # Not enough data to process
-             return {
-                "points_red": red_mv.tolist(), "points_ir": ir_mv.tolist(),
-                "bpm": 0,"SpO2": 0
-            }
-            
-        num_red, den_red = butter(2, 5, btype='low', fs=123.6)
-        num_ir, den_ir = butter(2, 5, btype='low', fs=123.6)
-        red_mv = filtfilt(num_red, den_red, red_mv)
-        ir_mv = filtfilt(num_ir, den_ir, ir_mv)
-        
-        t_filtered = np.array(time_ms)
-        
-        # Remove baseline wander
-        b, a = butter(2, 2, btype='low', fs=fs)
-        baseline_red = filtfilt(b, a, red_mv)
-        baseline_ir = filtfilt(b, a, ir_mv)
-        
-        # Find heartbeat period peaks
-        peaks = []
-        peaks_time = []
-        filtered = ir_mv - baseline_ir
-        peaks_idx, garb = find_peaks(filtered, prominence=1)
-        bpms = []
-        DISPLAY_BPM = 0
-        i_bpm = 0
-        
-        for i in range(len(peaks_idx)):
-            peaks.append(filtered[peaks_idx[i]])
-            peaks_time.append(t_filtered[peaks_idx[i]])
-            if i > 0:
-                intervals = (peaks_time[i] - peaks_time[i-1])*10**(-3)
-                inst_bpm = 60 / intervals
-                inst_bpm = np.clip(inst_bpm, 40, 180)
-                bpms.append(round(inst_bpm, 2))
-                if len(bpms) > 1:
-                    if abs(bpms[i_bpm] - bpms[i_bpm-1]) > 5:
-                        DISPLAY_BPM = bpms[i_bpm]
-                
-        
-        # Calculate SpO2
-        if len(red_mv) > 0 and len(ir_mv) > 0:
-            red_ac = red_mv - baseline_red
-            ir_ac = ir_mv - baseline_ir
-        
-            peaks_red, peaks_red_time = peaks_function(red_ac, time_ms, 1)
-            troughs_red, troughs_red_time = peaks_function(red_ac, time_ms, -1)
-            peaks_ir, peaks_ir_time = peaks_function(ir_ac, time_ms, 1)
-            troughs_ir, troughs_ir_time = peaks_function(ir_ac, time_ms, -1)
-        
-            red_ac_list = []
-            red_ac = 0
-            ir_ac_list = []
-            ir_ac = 0
-            most_recent_ir_ac = 0
-            most_recent_red_ac = 0
-            spo2_list = []
-        
-            for i in range(min(len(peaks_red), len(troughs_red))):
-                red_ac = peaks_red[i] - troughs_red[i]
-                red_ac_list.append(round(red_ac,6))
-        
-            for i in range(min(len(peaks_ir), len(troughs_ir))):
-                ir_ac = peaks_ir[i] - troughs_ir[i]
-                ir_ac_list.append(round(ir_ac,6))
-        
-            red_dc = np.mean(baseline_red[-10:-1])
-            ir_dc = np.mean(baseline_ir[-10:-1])
-        
-            if red_dc > 0 and ir_dc > 0:
-                R = (red_ac/red_dc) / (ir_ac/ir_dc)
-                spo2 = 110 - 25 * R
-                spo2 = np.clip(spo2, 70, 100)
-                spo2_list.append(spo2)
-                if len(spo2_list) > 1:
-                    if abs(spo2_list[-1] - spo2_list[-2]) > 2:
-                        DISPLAY_SPO2 = spo2_list[-1]
-        
-        return {
-            "points_red": red_mv.tolist(),
-            "points_ir": ir_mv.tolist(),
-            "bpm": float(DISPLAY_BPM),
-            "SpO2": float(DISPLAY_SPO2)
-        }
+        return analyze_ppg_window(*read_ppg_csv(csv_path, WINDOW_SAMPLES))
 
     except Exception as e:
         print(f"Error processing PPG data: {e}")
@@ -144,3 +108,136 @@ def process_ppg_data(raw_data_string, csv_path):
             "points_red": [], "points_ir": [],
             "bpm": 0,"SpO2": 0
         }
+
+class PpgSession:
+    """
+    Live PPG analysis over the last `window` samples, kept in memory.
+
+    append() writes new red/IR samples into fixed rings; nothing is read
+    from disk. update() runs analyze_ppg_window() on the ring once every
+    `update_every` new samples and otherwise returns the previous result,
+    so the cost per packet is the copy into the ring. The time each
+    analysis took is kept in the result (latency_ms, mean and max).
+
+    bpm and SpO2 in the result are the displayed values: they only move
+    when a window's value differs from them by more than BPM_STEP or
+    SPO2_STEP, so the numbers on screen do not flicker. The window's own
+    values are window_bpm and window_SpO2. A window without beats leaves
+    the displayed values as they were.
+    """
+
+    def __init__(self, window=WINDOW_SAMPLES, fs=FS, update_every=None):
+        self.window = int(window)
+        self.fs = float(fs)
+        self.update_every = int(update_every or round(self.fs))
+        self.time_ms = np.zeros(self.window)
+        self.red = np.zeros(self.window)
+        self.ir = np.zeros(self.window)
+        self.pos = 0
+        self.count = 0
+        self.pending = 0
+        self.next_time_ms = 0.0
+        self.updates = 0
+        self.latency_ms = 0.0
+        self.total_latency_ms = 0.0
+        self.max_latency_ms = 0.0
+        self.display_bpm = 0
+        self.display_spo2 = 0
+        self.result = {"points_red": [], "points_ir": [], "bpm": 0, "SpO2": 0}
+
+    def append(self, red, ir, time_ms=None):
+        """Adds samples; without times they follow the last one at 1/fs."""
+        red = np.asarray(red, dtype=float).ravel()
+        ir = np.asarray(ir, dtype=float).ravel()
+        n = min(len(red), len(ir))
+        if n == 0:
+            return
+        if time_ms is None:
+            time_ms = self.next_time_ms + np.arange(n) * 1000.0 / self.fs
+        time_ms = np.asarray(time_ms, dtype=float).ravel()[:n]
+        self.next_time_ms = time_ms[-1] + 1000.0 / self.fs
+        # Only the newest `window` samples can survive
+        red, ir, time_ms = red[:n][-self.window:], ir[:n][-self.window:], time_ms[-self.window:]
+        k = len(red)
+        first = min(k, self.window - self.pos)
+        for ring, values in ((self.red, red), (self.ir, ir), (self.time_ms, time_ms)):
+            ring[self.pos:self.pos + first] = values[:first]
+            ring[:k - first] = values[first:]
+        self.pos = (self.pos + k) % self.window
+        self.count = min(self.count + n, self.window)
+        self.pending += n
+
+    def append_csv(self, text):
+        """Adds "red,ir,red,ir,..." as sent after the PPG, prefix."""
+        values = np.array([float(v) for v in text.split(',') if v.strip()])
+        self.append(values[0::2], values[1::2])
+
+    def ordered(self):
+        """The ring oldest first, as time_ms, red, ir."""
+        if self.count < self.window:
+            return self.time_ms[:self.count], self.red[:self.count], self.ir[:self.count]
+        return (np.roll(self.time_ms, -self.pos), np.roll(self.red, -self.pos),
+                np.roll(self.ir, -self.pos))
+
+    def update(self, force=False):
+        if self.pending < self.update_every and not force:
+            return self.result
+        t0 = time.perf_counter()
+        result = analyze_ppg_window(*self.ordered(), fs=self.fs)
+        self.latency_ms = (time.perf_counter() - t0) * 1e3
+        result["window_bpm"], result["window_SpO2"] = result["bpm"], result["SpO2"]
+        if result["bpm"] and (not self.display_bpm or abs(result["bpm"] - self.display_bpm) > BPM_STEP):
+            self.display_bpm = result["bpm"]
+        if result["SpO2"] and (not self.display_spo2 or abs(result["SpO2"] - self.display_spo2) > SPO2_STEP):
+            self.display_spo2 = result["SpO2"]
+        result["bpm"], result["SpO2"] = self.display_bpm, self.display_spo2
+        result["new_samples"] = min(self.pending, self.count)
+        self.pending = 0
+        self.updates += 1
+        self.total_latency_ms += self.latency_ms
+        self.max_latency_ms = max(self.max_latency_ms, self.latency_ms)
+        result["latency_ms"] = self.latency_ms
+        result["mean_latency_ms"] = self.total_latency_ms / self.updates
+        result["max_latency_ms"] = self.max_latency_ms
+        result["updates"] = self.updates
+        self.result = result
+        return result
+
+    def process(self, raw_data_string):
+        """append_csv() then update(), for one live packet."""
+        try:
+            self.append_csv(raw_data_string)
+            return self.update()
+        except Exception as e:
+            print(f"Error processing PPG data: {e}")
+            return self.result
+
+    def load_csv(self, csv_path):
+        """Seeds the ring with the end of a recording and analyses it."""
+        if csv_path and os.path.exists(csv_path):
+            time_ms, red, ir = read_ppg_csv(csv_path, self.window)
+            self.append(red, ir, time_ms)
+        return self.update(force=True)
+
+if __name__ == "__main__":
+    # Replays the bundled recording 10 samples per packet: the old call per
+    # packet against a session updating once a second.
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "ppg_filtered_data.csv")
+    t, red, ir = read_ppg_csv(path)
+    packets = range(0, len(t), 10)
+
+    t0 = time.perf_counter()
+    for i in packets:
+        process_ppg_data(None, path)
+    old_ms = (time.perf_counter() - t0) * 1e3 / len(packets)
+
+    session = PpgSession()
+    t0 = time.perf_counter()
+    for i in packets:
+        session.append(red[i:i + 10], ir[i:i + 10], t[i:i + 10])
+        result = session.update()
+    new_ms = (time.perf_counter() - t0) * 1e3 / len(packets)
+
+    print(f"per packet: csv {old_ms:.3f} ms, session {new_ms:.3f} ms")
+    print(f"session: {result['updates']} updates, latency mean {result['mean_latency_ms']:.2f} ms, "
+          f"max {result['max_latency_ms']:.2f} ms, bpm {result['bpm']:.1f}, SpO2 {result['SpO2']:.1f}")
@@ -0,0 +1,120 @@
+'''
+Offline export of sessions written by SessionRecorder.kt.
+
+A session is a set of files <prefix>_<yyyyMMdd_HHmmss>_<part>.bin, each
+holding stream frames back to back (stream_proto.py). Text packets from
+older firmware are stored as FMT_BYTES frames of their channel with the
+phone's receive time as t0; a line longer than one frame continues in
+frames with the same seq.
+
+For every session this writes one CSV per channel, named
+<session>_ch<channel>.csv with columns t_us,value. Replayed frames go to
+_ch<channel>_replay.csv and text lines to _ch<channel>_text.csv (t_us,line).
+Control messages are skipped. Files are read one part at a time, so
+sessions of any length fit in memory.
+
+    python session_export.py <sessions dir or .bin files> [-o out_dir]
+'''
+
+import argparse
+import csv
+import os
+import re
+from collections import defaultdict
+
+import stream_proto as sp
+
+PART_RE = re.compile(r"^(?P<session>.+)_(?P<part>\d{3})\.bin$")
+
+
+def group_parts(paths):
+    '''{session name: [part paths in order]} for the .bin files in `paths`.'''
+    files = []
+    for p in paths:
+        if os.path.isdir(p):
+            files += [os.path.join(p, f) for f in os.listdir(p)]
+        else:
+            files.append(p)
+    sessions = defaultdict(list)
+    for f in files:
+        m = PART_RE.match(os.path.basename(f))
+        if m:
+            sessions[m["session"]].append((int(m["part"]), f))
+    return {name: [f for _, f in sorted(parts)] for name, parts in sessions.items()}
+
+
+def frame_rows(f):
+    '''(t_us, value) for every sample of a data frame.'''
+    if f.format == sp.FMT_I16_STATS:
+        # One window: its mean at the window start
+        if f.count >= 3:
+            yield f.t0_us, f.samples[2]
+        return
+    values = sp.unpack_i16(f.samples) if f.format == sp.FMT_I16_DELTA else f.samples
+    for i, v in enumerate(values):
+        yield f.t0_us + i * f.period_ns // 1000, v
+
+
+def export_session(name, parts, out_dir):
+    '''Writes the CSVs of one session; returns {csv path: rows}.'''
+    writers, handles, counts = {}, [], defaultdict(int)
+
+    def writer(suffix, header):
+        path = os.path.join(out_dir, f"{name}_{suffix}.csv")
+        if path not in writers:
+            fh = open(path, "w", newline="")
+            handles.append(fh)
+            writers[path] = csv.writer(fh)
+            writers[path].writerow(header)
+        return path, writers[path]
+
+    text = None  # (channel, seq, t_us, bytes) of the line being joined
+
+    def flush_text():
+        if text:
+            path, w = writer(f"ch{text[0]}_text", ("t_us", "line"))
+            w.writerow((text[2], text[3].decode("utf-8", "replace")))
+            counts[path] += 1
+
+    try:
+        for part in parts:
+            with open(part, "rb") as fh:
+                data = fh.read()
+            for f in sp.iter_frames(data):
+                if f.channel == sp.CH_CONTROL:
+                    continue
+                if f.format == sp.FMT_BYTES:
+                    if text and text[0] == f.channel and text[1] == f.seq:
+                        text = (text[0], text[1], text[2], text[3] + bytes(f.samples))
+                    else:
+                        flush_text()
+                        text = (f.channel, f.seq, f.t0_us, bytes(f.samples))
+                    continue
+                ch = f.channel & ~sp.CH_REPLAY
+                suffix = f"ch{ch}_replay" if f.channel & sp.CH_REPLAY else f"ch{ch}"
+                path, w = writer(suffix, ("t_us", "value"))
+                for row in frame_rows(f):
+                    w.writerow(row)
+                    counts[path] += 1
+        flush_text()
+    finally:
+        for fh in handles:
+            fh.close()
+    return dict(counts)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("paths", nargs="+")
+    ap.add_argument("-o", "--out-dir", default=".")
+    args = ap.parse_args()
+    os.makedirs(args.out_dir, exist_ok=True)
+    for name, parts in sorted(group_parts(args.paths).items()):
+        size = sum(os.path.getsize(p) for p in parts)
+        print(f"{name}: {len(parts)} files, {size / 1e6:.1f} MB")
+        for path, rows in sorted(export_session(name, parts, args.out_dir).items()):
+            print(f"  {path}: {rows} rows")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,269 @@
+'''
+Decoder for the binary sensor stream sent by the firmware
+(nRF52840_code/common/include/stream_proto.h, StreamFrame.kt on the app side).
+
+A notification holds one or more frames. Each frame is a 14-byte
+little-endian header followed by `count` samples:
+
+    ver(u8) channel(u8) format(u8) count(u8) seq(u16) t0_us(u32) period_ns(u32)
+
+Frames recorded on the device while disconnected arrive later with
+CH_REPLAY set in `channel`, so they never match a live channel ID.
+
+Frames are decoded in place: `samples` is a memoryview over the received
+buffer, cast to the sample type, so nothing is copied until the caller
+asks for it (e.g. numpy.frombuffer(frame.samples, ...)).
+
+When the link is short of capacity the device lowers a channel's tier:
+zigzag-delta packed frames (FMT_I16_DELTA), decimated frames (plain I16
+with a longer period_ns) or one min/max/mean/rms frame per batch
+(FMT_I16_STATS). channel_samples() rebuilds a series on the finest
+period seen. Tier switches are announced on CH_CONTROL (tier_changes()).
+
+Boards that only send samples around detected events put them on
+CH_ADC_EVENT, between CTRL_EVENT begin and end messages (events()).
+'''
+
+import struct
+import sys
+from collections import namedtuple
+
+VERSION = 1
+HDR = struct.Struct("<BBBBHII")
+HDR_LEN = HDR.size
+
+CH_CONTROL = 0x00
+CH_EMG = 0x01
+CH_PPG = 0x02
+CH_SWEAT = 0x03
+CH_TEST = 0x04
+CH_ADC = 0x05
+CH_EIS = 0x06
+CH_ADC_EVENT = 0x07    # full-rate snippets; seq is contiguous, t0 jumps
+
+# Set in the channel byte of frames replayed from the device's flash recorder
+CH_REPLAY = 0x80
+
+FMT_BYTES = 0x00
+FMT_I16 = 0x01
+FMT_U16 = 0x02
+FMT_I32 = 0x03
+FMT_F32 = 0x04
+FMT_I16_DELTA = 0x05   # [n] + zigzag-delta varints, count = payload bytes
+FMT_I16_STATS = 0x06   # min, max, mean, rms of one window
+
+TIER_FULL = 0
+TIER_PACKED = 1
+TIER_DECIMATED = 2
+TIER_FEATURES = 3
+
+CTRL_TIER = 0x01
+CTRL_EVENT = 0x02      # [op, channel, triggers, phase, id u16, samples u16]
+EVENT_BEGIN = 0
+EVENT_END = 1
+
+# event_detect.h trigger bits
+TRIG_THRESHOLD = 0x01
+TRIG_SLOPE = 0x02
+TRIG_ENERGY = 0x04
+TRIG_ZC = 0x08
+
+Event = namedtuple("Event", "id channel triggers t0_us period_ns pre samples complete")
+
+# memoryview.cast codes; all native sizes match the wire on LE hosts
+FMT_CODES = {FMT_BYTES: "B", FMT_I16: "h", FMT_U16: "H", FMT_I32: "i", FMT_F32: "f",
+             FMT_I16_DELTA: "B", FMT_I16_STATS: "h"}
+FMT_SIZES = {FMT_BYTES: 1, FMT_I16: 2, FMT_U16: 2, FMT_I32: 4, FMT_F32: 4,
+             FMT_I16_DELTA: 1, FMT_I16_STATS: 2}
+NUMPY_DTYPES = {FMT_BYTES: "u1", FMT_I16: "<i2", FMT_U16: "<u2", FMT_I32: "<i4", FMT_F32: "<f4",
+                FMT_I16_DELTA: "<i2", FMT_I16_STATS: "<i2"}
+
+# Longer runs of lost frames (e.g. a reconnect that reset seq) are not filled
+MAX_GAP_FILL = 64
+
+Frame = namedtuple("Frame", "channel format count seq t0_us period_ns samples")
+
+
+def is_stream(data):
+    return len(data) >= HDR_LEN and (data[0] & 0xF0) == 0xB0
+
+
+def iter_frames(data):
+    '''
+    Yield a Frame for every frame in `data` (bytes, bytearray or
+    memoryview). Raises ValueError on a truncated or unknown frame.
+    '''
+    buf = memoryview(data).cast("B")
+    off = 0
+    while off < len(buf):
+        if off + HDR_LEN > len(buf):
+            raise ValueError(f"truncated header at offset {off}")
+        ver, ch, fmt, count, seq, t0_us, period_ns = HDR.unpack_from(buf, off)
+        if (ver & 0xF0) != 0xB0 or (ver & 0x0F) != VERSION:
+            raise ValueError(f"bad version byte 0x{ver:02x} at offset {off}")
+        if fmt not in FMT_SIZES:
+            raise ValueError(f"unknown sample format {fmt} at offset {off}")
+
+        start = off + HDR_LEN
+        end = start + count * FMT_SIZES[fmt]
+        if end > len(buf):
+            raise ValueError(f"truncated payload at offset {off}")
+
+        payload = buf[start:end]
+        if sys.byteorder == "little":
+            payload = payload.cast(FMT_CODES[fmt])
+        yield Frame(ch, fmt, count, seq, t0_us, period_ns, payload)
+        off = end
+
+
+def sample_times_us(frame):
+    '''Device time of every sample in `frame`, in µs.'''
+    return [frame.t0_us + i * frame.period_ns / 1000 for i in range(frame.count)]
+
+
+def unpack_i16(payload):
+    '''Samples of an FMT_I16_DELTA payload as a list of ints.'''
+    data = bytes(payload)
+    out, prev, pos = [], 0, 1
+    for _ in range(data[0] if data else 0):
+        z, shift = 0, 0
+        while True:
+            if pos >= len(data) or shift > 14:
+                raise ValueError("truncated I16_DELTA payload")
+            b = data[pos]
+            pos += 1
+            z |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        prev = (prev + ((z >> 1) ^ -(z & 1)) + 0x8000) % 0x10000 - 0x8000
+        out.append(prev)
+    return out
+
+
+def tier_changes(data):
+    '''(t0_us, channel, tier, decimation) for every tier announcement.'''
+    for f in iter_frames(data):
+        if f.channel == CH_CONTROL and f.count >= 4 and f.samples[0] == CTRL_TIER:
+            yield f.t0_us, f.samples[1], f.samples[2], f.samples[3]
+
+
+def events(data, channel=CH_ADC_EVENT):
+    '''
+    Yield an Event for every snippet of `channel` closed in `data`: the
+    samples between its begin and end messages as a numpy array, pre the
+    samples ahead of the first trigger. complete is False when frames of
+    the snippet were lost, i.e. fewer samples arrived than the end message
+    counts.
+    '''
+    import numpy as np
+
+    current, parts, period = None, [], 0
+    for f in iter_frames(data):
+        if f.channel == CH_CONTROL and f.count >= 8 and f.samples[0] == CTRL_EVENT:
+            if f.samples[1] != channel:
+                continue
+            p = bytes(f.samples)
+            ev_id, count = struct.unpack_from("<HH", p, 4)
+            if p[3] == EVENT_BEGIN:
+                current, parts = (ev_id, f.t0_us, count), []
+            elif p[3] == EVENT_END and current and current[0] == ev_id:
+                samples = np.concatenate(parts) if parts else np.empty(0, dtype="<i2")
+                yield Event(ev_id, channel, p[2], current[1], period, current[2],
+                            samples, len(samples) == count)
+                current = None
+        elif f.channel == channel and current and f.format == FMT_I16:
+            parts.append(np.frombuffer(f.samples, dtype="<i2"))
+            period = f.period_ns
+
+
+def channel_features(data, channel):
+    '''
+    (min, max, mean, rms) rows of the FMT_I16_STATS frames of `channel`,
+    as an (n, 4) numpy array, plus the window length of each in seconds.
+    '''
+    import numpy as np
+
+    rows, windows = [], []
+    for f in iter_frames(data):
+        if f.channel == channel and f.format == FMT_I16_STATS and f.count >= 4:
+            rows.append(f.samples[:4].tolist())
+            windows.append(f.period_ns / 1e9)
+    return np.array(rows, dtype=float).reshape(-1, 4), np.array(windows)
+
+
+def _base_period(frames):
+    periods = [f.period_ns for f in frames if f.format != FMT_I16_STATS and f.period_ns]
+    return min(periods) if periods else 0
+
+
+def _raw_count(f, base_ns):
+    '''Samples at the base period that frame f stands for.'''
+    if f.format == FMT_I16_STATS:
+        return max(1, round(f.period_ns / base_ns)) if base_ns else 1
+    n = f.samples[0] if f.format == FMT_I16_DELTA else f.count
+    if base_ns and f.period_ns > base_ns:
+        return n * round(f.period_ns / base_ns)
+    return n
+
+
+def channel_samples(data, channel, fill_gaps=True):
+    '''
+    All samples of `channel` in `data` as one numpy array, in arrival
+    order. Each raw frame is viewed with numpy.frombuffer; the only copy is
+    the final concatenation. Lower tiers are brought back to the finest
+    period in `data`: packed frames are expanded, decimated samples are
+    repeated and a features frame becomes its mean over the window. With
+    fill_gaps, frames missing from the seq count are replaced by zeros so
+    sample indices stay proportional to time.
+    '''
+    import numpy as np
+
+    frames = [f for f in iter_frames(data) if f.channel == channel]
+    base = _base_period(frames)
+    parts = []
+    prev = None
+    for f in frames:
+        if fill_gaps and prev is not None:
+            lost = (f.seq - prev.seq - 1) & 0xFFFF
+            if 0 < lost <= MAX_GAP_FILL:
+                parts.append(np.zeros(lost * _raw_count(prev, base), dtype="<i2"))
+        if f.format == FMT_I16_DELTA:
+            parts.append(np.array(unpack_i16(f.samples), dtype="<i2"))
+        elif f.format == FMT_I16_STATS:
+            parts.append(np.full(_raw_count(f, base), f.samples[2], dtype="<i2"))
+        else:
+            values = np.frombuffer(f.samples, dtype=NUMPY_DTYPES[f.format])
+            k = _raw_count(f, base) // max(f.count, 1)
+            parts.append(np.repeat(values, k) if k > 1 else values)
+        prev = f
+    if not parts:
+        return np.empty(0)
+    return np.concatenate(parts)
+
+
+def channel_rate(data, channel, clock_rate=1.0):
+    '''
+    Measured sample rate of `channel` in Hz of phone time, at the finest
+    period in `data`: samples per device second between consecutive
+    frames, divided by clock_rate (phone
+    seconds per device second, ClockSync.rate in the app). Falls back to
+    the nominal period when fewer than two consecutive frames are present,
+    and returns None if there is neither.
+    '''
+    frames = [f for f in iter_frames(data) if f.channel == channel]
+    base = _base_period(frames)
+    samples = 0
+    span_us = 0
+    period_ns = base
+    prev = None
+    for f in frames:
+        if prev is not None and f.seq == (prev.seq + 1) & 0xFFFF:
+            samples += _raw_count(prev, base)
+            span_us += (f.t0_us - prev.t0_us) & 0xFFFFFFFF
+        prev = f
+    if span_us > 0:
+        return samples * 1e6 / (span_us * clock_rate)
+    if period_ns:
+        return 1e9 / (period_ns * clock_rate)
+    return None
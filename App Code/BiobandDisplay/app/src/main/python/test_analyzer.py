@@ -1,5 +1,4 @@
 import numpy as np
-import pandas as pd
 from os.path import dirname, join
 
 def process_test_data(raw_data_string):
@@ -22,6 +21,9 @@ def get_csv_data():
     bp = a(:,3); bp(bp==0) = []; bp = kron(bp, [1;1])
     """
     try:
+        # Imported here: pandas takes seconds to load and only this button needs it
+        import pandas as pd
+
         csv_path = join(dirname(__file__), "sample_data.csv")
         
         # Load the data. Using pandas to handle potential headers and easy slicing.
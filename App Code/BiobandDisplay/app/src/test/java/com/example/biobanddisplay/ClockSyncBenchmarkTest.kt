@@ -0,0 +1,166 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.Executor
+import kotlin.math.PI
+import kotlin.math.abs
+import kotlin.math.ceil
+import kotlin.math.cos
+import kotlin.math.floor
+import kotlin.math.ln
+import kotlin.math.sin
+import kotlin.random.Random
+
+/**
+ * Residual timestamp error of ClockSync over a simulated 1-hour session.
+ *
+ * Device clock: 35 ppm fast plus a 3 ppm thermal wander over the hour,
+ * 32.768 kHz tick resolution, starting 10 minutes before its 32-bit µs
+ * counter wraps. Link: 15 ms connection interval. A request waits for the
+ * next connection event after a ~1 ms Android stack delay. The reply goes
+ * out one event later and reaches the app after a ~2 ms delay, with 5 %
+ * of replies delayed a further 20-50 ms (GC pauses) and 10 % of exchanges
+ * lost. Exchanges run at 1 s for the first 8, then every 10 s, as in
+ * BleConnectionManager.
+ *
+ * An EMG frame is mapped every 20 ms and compared with the true phone
+ * time of its first sample. Bias is the median error, which comes from
+ * the asymmetric link, and jitter is the error around it.
+ *
+ * StreamIngest, given the same ClockSync, gives every sample of a frame
+ * its phone time, and the receive time until the first exchange.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*ClockSyncBenchmarkTest*' -i
+ */
+class ClockSyncBenchmarkTest {
+
+    private val ciS = 15e-3
+    private val driftPpm = 35.0
+    private val wanderPpm = 3.0
+    private val sessionS = 3600.0
+    private val tickUs = 1e6 / 32768
+    private val wrapStartUs = 4294967296.0 - 600e6
+
+    private val rng = Random(1)
+
+    // True device time in µs (not wrapped) at phone time t seconds
+    private fun deviceUs(t: Double): Double {
+        val wander = wanderPpm * 1e-6 * sessionS / (2 * PI) * (1 - cos(2 * PI * t / sessionS))
+        val us = (t * (1 + driftPpm * 1e-6) + wander) * 1e6 + wrapStartUs
+        return floor(us / tickUs) * tickUs
+    }
+
+    private fun wire(us: Double): Long = us.toLong() and 0xFFFFFFFFL
+
+    private fun nextEvent(t: Double): Double = ceil(t / ciS) * ciS
+
+    private fun expo(meanS: Double): Double = -ln(1 - rng.nextDouble()) * meanS
+
+    // One EMG stream frame with t0 = device time of its first sample
+    private fun frame(t0Us: Long): StreamFrame {
+        val buf = ByteBuffer.allocate(StreamProto.HDR_LEN).order(ByteOrder.LITTLE_ENDIAN)
+        buf.put(0xB1.toByte()).put(StreamProto.CH_EMG.toByte()).put(StreamProto.FMT_I16.toByte())
+            .put(0.toByte()).putShort(0.toShort()).putInt(t0Us.toInt()).putInt(1_000_000)
+        return StreamFrame(buf).also { assertTrue(it.moveTo(0)) }
+    }
+
+    @Test
+    fun residualErrorOverOneHour() {
+        val sync = ClockSync()
+        val errorsMs = ArrayList<Double>()
+        var exchanges = 0
+        var nextExchange = 0.5
+        var frameT = 1.0
+
+        while (nextExchange < sessionS) {
+            val t1 = nextExchange
+            exchanges++
+            nextExchange += if (exchanges < 8) 1.0 else 10.0
+
+            val event = nextEvent(t1 + expo(1e-3))
+            val t2 = deviceUs(event + 150e-6)
+            val t3 = deviceUs(event + 200e-6)
+            var t4 = nextEvent(event + 300e-6) + expo(2e-3)
+            if (rng.nextDouble() < 0.05) t4 += 0.02 + 0.03 * rng.nextDouble()
+            if (rng.nextDouble() >= 0.10) {
+                sync.addExchange((t1 * 1e9).toLong(), wire(t2), wire(t3), (t4 * 1e9).toLong())
+            }
+
+            // Frames arriving until the next exchange; the first few seconds are settling
+            while (frameT < minOf(nextExchange, sessionS)) {
+                if (exchanges >= 3) {
+                    val mappedNs = sync.toPhoneNs(frame(wire(deviceUs(frameT))))
+                    errorsMs.add((mappedNs - frameT * 1e9) / 1e6)
+                }
+                frameT += 0.02
+            }
+        }
+
+        val sorted = errorsMs.sorted()
+        val bias = sorted[sorted.size / 2]
+        val jitter = errorsMs.map { abs(it - bias) }.sorted()
+        val absErr = errorsMs.map { abs(it) }.sorted()
+        fun p(list: List<Double>, q: Double) = list[((list.size - 1) * q).toInt()]
+        // True drift halfway through the fit window (64 exchanges, ~5 min before the end)
+        val trueDriftPpm = driftPpm + wanderPpm * sin(2 * PI * (sessionS - 320) / sessionS)
+
+        println("frames=%d exchanges=%d".format(errorsMs.size, exchanges))
+        println("abs error  p50=%.3f p95=%.3f p99=%.3f max=%.3f ms".format(
+            p(absErr, 0.5), p(absErr, 0.95), p(absErr, 0.99), absErr.last()))
+        println("bias=%.3f ms  jitter p95=%.3f p99=%.3f ms".format(
+            bias, p(jitter, 0.95), p(jitter, 0.99)))
+        println("drift est=%.2f ppm true=%.2f ppm".format(sync.driftPpm, trueDriftPpm))
+
+        // Bias stays within one connection interval, jitter well below it
+        assertTrue(abs(bias) < ciS * 1e3)
+        assertTrue(p(jitter, 0.95) < 2.0)
+        assertEquals(trueDriftPpm, sync.driftPpm, 1.0)
+    }
+
+    @Test
+    fun ingestGivesEverySamplePhoneTime() {
+        // Device 100 ppm fast, its clock at 1 s when the phone's is at 50 s
+        val rate = 1 / (1 + 100e-6)
+        fun devUs(phoneNs: Long) = 1_000_000 + ((phoneNs - 50_000_000_000L) / 1000 / rate).toLong()
+        val sync = ClockSync()
+        val received = ArrayList<LongArray>()
+        val ingest = StreamIngest(16, 256, 1, Executor { it.run() }, sync) { block ->
+            synchronized(received) { received.add(block.phoneTimesNs.copyOf(block.size)) }
+        }
+        ingest.start()
+
+        val packet = ByteArray(StreamProto.HDR_LEN + 20)
+        fun send(t0PhoneNs: Long, rxNs: Long): LongArray {
+            StreamProto.writeHeader(packet, 0, StreamProto.CH_EMG, StreamProto.FMT_I16, 10, 0,
+                devUs(t0PhoneNs) and 0xFFFFFFFFL, 1_000_000)
+            synchronized(received) { received.clear() }
+            assertTrue(ingest.offer(packet, packet.size, rxNs))
+            val deadline = System.nanoTime() + 5_000_000_000L
+            while (synchronized(received) { received.isEmpty() }) {
+                assertTrue("timed out", System.nanoTime() < deadline)
+                Thread.sleep(1)
+            }
+            return synchronized(received) { received[0] }
+        }
+
+        // Not synced yet: the frame starts at its receive time
+        assertEquals(60_000_000_000L, send(59_000_000_000L, 60_000_000_000L)[0])
+
+        // Exchanges without delay over 80 s; the fit takes the first half, 40 s
+        for (k in 0..80) {
+            val phoneNs = 50_000_000_000L + k * 1_000_000_000L
+            val us = devUs(phoneNs) and 0xFFFFFFFFL
+            sync.addExchange(phoneNs, us, us, phoneNs)
+        }
+        val t0 = 150_000_000_000L
+        val times = send(t0, t0 + 20_000_000)
+        assertEquals(10, times.size)
+        for (i in times.indices) {
+            assertEquals((t0 + i * 1_000_000 * rate), times[i].toDouble(), 2_000.0)
+        }
+    }
+}
@@ -0,0 +1,89 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+
+/**
+ * GattQueue starts one GATT operation at a time, in order, and gets past
+ * operations that fail to start or whose callback never comes.
+ *
+ * Throughput with and without the link setup can only be measured on a
+ * phone: connect to the benchmark firmware (ble_throughput_bench) once with
+ * each setting and compare the "Bench done" lines under BLE_MANAGER.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*GattQueueTest*' -i
+ */
+class GattQueueTest {
+
+    // Pending timeouts, fired by hand
+    private val timers = ArrayList<Runnable>()
+    private val log = ArrayList<String>()
+    private val started = ArrayList<String>()
+
+    private fun queue() = GattQueue(2_000, { r, _ -> timers.add(r) }, { timers.remove(it) }, { log.add(it) })
+
+    @Test
+    fun oneAtATime() {
+        val q = queue()
+        q.enqueue("MTU") { started.add("MTU") }
+        q.enqueue("CCCD a") { started.add("CCCD a") }
+        q.enqueue("priority", awaitsCallback = false) { started.add("priority") }
+        q.enqueue("CCCD b") { started.add("CCCD b") }
+        assertEquals(listOf("MTU"), started)
+
+        // Not the running operation: ignored
+        assertFalse(q.complete("CCCD a"))
+        assertTrue(q.complete("MTU"))
+        assertEquals(listOf("MTU", "CCCD a"), started)
+
+        // An operation without a callback lets the next one start at once
+        assertTrue(q.complete("CCCD a"))
+        assertEquals(listOf("MTU", "CCCD a", "priority", "CCCD b"), started)
+        assertEquals("CCCD b", q.currentKey)
+
+        assertTrue(q.complete("CCCD b"))
+        assertTrue(q.isIdle)
+        assertEquals(4, q.completed)
+        assertTrue(timers.isEmpty())
+    }
+
+    @Test
+    fun getsPastFailuresAndTimeouts() {
+        val q = queue()
+        // The stack never answers, does not queue the write, or throws without the permission
+        q.enqueue("PHY") { started.add("PHY") }
+        q.enqueue("CCCD a") { false }
+        q.enqueue("read") { throw SecurityException("BLUETOOTH_CONNECT not granted") }
+        q.enqueue("done", awaitsCallback = false) { started.add("done") }
+        assertEquals("PHY", q.currentKey)
+        assertEquals(1, timers.size)
+
+        timers.removeAt(0).run()
+        assertEquals(listOf("PHY", "done"), started)
+        assertTrue(q.isIdle)
+        assertEquals(1, q.timedOut)
+        assertEquals(2, q.failed)
+        assertEquals(1, q.completed)
+        assertEquals(3, log.size)
+
+        // The callback after the timeout changes nothing
+        assertFalse(q.complete("PHY"))
+        assertEquals(1, q.completed)
+    }
+
+    @Test
+    fun clearDropsPendingOperations() {
+        val q = queue()
+        q.enqueue("CCCD a") { started.add("CCCD a") }
+        q.enqueue("CCCD b") { started.add("CCCD b") }
+        q.clear()
+        assertTrue(q.isIdle)
+        assertTrue(timers.isEmpty())
+        assertFalse(q.complete("CCCD a"))
+
+        // A new connection starts from an empty queue
+        q.enqueue("MTU") { started.add("MTU") }
+        assertEquals(listOf("CCCD a", "MTU"), started)
+    }
+}
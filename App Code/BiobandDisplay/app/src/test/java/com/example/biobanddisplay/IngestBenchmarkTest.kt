@@ -0,0 +1,226 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import java.io.ByteArrayOutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.Executor
+import java.util.concurrent.LinkedBlockingQueue
+import java.util.concurrent.locks.LockSupport
+
+/**
+ * Packets/s and bytes allocated per packet on the BLE receive path, before
+ * and after StreamIngest.
+ *
+ * Before: what onCharacteristicChanged did per notification. A stream
+ * packet was posted to the main thread as a closure and decoded there, one
+ * listener call per frame. A text packet was turned into a String, logged
+ * (the string building that Log.d needs) and posted the same way.
+ * After: StreamIngest.offer() on the callback thread, decoding on the
+ * ingest thread, one post per channel per 33 ms tick.
+ *
+ * The main looper is a thread draining a queue of Runnables, and the EMG
+ * listener keeps whole frames the way GraphActivity does. The producer
+ * sends as fast as it can; when the ring is full it waits instead of
+ * dropping, so both paths deliver every packet. Allocation is measured
+ * with ThreadMXBean over all threads and includes the looper's queue
+ * nodes. The packet arrays themselves come from the Bluetooth stack on a
+ * phone, so they are made up front and not counted.
+ *
+ * batchedWakeups feeds packets at the EMG notification rate and counts the
+ * ingest thread's wakeups and hand-overs per minute, with the 33 ms tick
+ * used while a screen plots the stream and the 1 s batches used without one.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*IngestBenchmarkTest*' -i
+ */
+class IngestBenchmarkTest {
+
+    private val packets = 200_000
+    // As long as the run, so StreamIngest's blocks have grown to the tick size
+    private val warmup = 200_000
+    private val samplesPerFrame = 100
+
+    // Through reflection: java.lang.management is not part of android.jar
+    private val threadBean = Class.forName("java.lang.management.ManagementFactory")
+        .getMethod("getThreadMXBean").invoke(null)
+    private val beanType = Class.forName("com.sun.management.ThreadMXBean")
+    private val getAllThreadIds = beanType.getMethod("getAllThreadIds")
+    private val getAllocatedBytes = beanType.getMethod("getThreadAllocatedBytes", LongArray::class.java)
+
+    // Stand-in for the main looper
+    private class Looper : Executor {
+        val queue = LinkedBlockingQueue<Runnable>()
+        @Volatile var posts = 0L
+        val thread = Thread({
+            while (true) queue.take().run()
+        }, "main").apply { isDaemon = true; start() }
+
+        override fun execute(command: Runnable) {
+            posts++
+            queue.put(command)
+        }
+    }
+
+    // Keeps whole frames and hands them on every 10, like GraphActivity
+    private class EmgListener {
+        val buffer = ByteArrayOutputStream(64 * 1024)
+        var buffered = 0
+        @Volatile var frames = 0L
+        @Volatile var lines = 0L
+
+        fun onFrames(n: Int) {
+            buffered += n
+            frames += n
+            if (buffered >= 10) {
+                buffer.reset()
+                buffered = 0
+            }
+        }
+    }
+
+    private class Result(val packetsPerS: Double, val bytesPerPacket: Double, val posts: Long)
+
+    private fun streamPacket(seq: Int): ByteArray {
+        val buf = ByteBuffer.allocate(StreamProto.HDR_LEN + 2 * samplesPerFrame).order(ByteOrder.LITTLE_ENDIAN)
+        buf.put(0xB1.toByte()).put(StreamProto.CH_EMG.toByte()).put(StreamProto.FMT_I16.toByte())
+            .put(samplesPerFrame.toByte()).putShort(seq.toShort()).putInt(seq * 50_000).putInt(500_000)
+        for (i in 0 until samplesPerFrame) buf.putShort(((seq + i) % 2048 - 1024).toShort())
+        return buf.array()
+    }
+
+    private fun textPacket(seq: Int): ByteArray =
+        "EMG,${seq % 4096},${(seq + 1) % 4096},${(seq + 2) % 4096},${(seq + 3) % 4096}".toByteArray()
+
+    private fun allocatedBytes(): Long {
+        val ids = getAllThreadIds.invoke(threadBean) as LongArray
+        return (getAllocatedBytes.invoke(threadBean, ids) as LongArray).sumOf { it.coerceAtLeast(0) }
+    }
+
+    private fun waitFor(condition: () -> Boolean) {
+        val deadline = System.nanoTime() + 60_000_000_000L
+        while (!condition()) {
+            assertTrue("timed out", System.nanoTime() < deadline)
+            Thread.sleep(1)
+        }
+    }
+
+    /** Feeds [warmup] then [packets] packets through [send] and waits until [delivered] counts them. */
+    private fun measure(input: List<ByteArray>, looper: Looper, delivered: () -> Long,
+                        send: (ByteArray, Long) -> Unit): Result {
+        for (i in 0 until warmup) send(input[i % input.size], System.nanoTime())
+        waitFor { delivered() >= warmup }
+
+        val posts = looper.posts
+        val bytes = allocatedBytes()
+        val start = System.nanoTime()
+        for (i in 0 until packets) send(input[i % input.size], start)
+        waitFor { delivered() >= warmup + packets }
+        val seconds = (System.nanoTime() - start) / 1e9
+        val allocated = allocatedBytes() - bytes
+        return Result(packets / seconds, allocated.toDouble() / packets, looper.posts - posts)
+    }
+
+    private fun before(input: List<ByteArray>): Result {
+        val looper = Looper()
+        val listener = EmgListener()
+        return measure(input, looper, { listener.frames + listener.lines }) { value, _ ->
+            if (StreamProto.isStream(value)) {
+                looper.execute {
+                    StreamProto.forEachFrame(value) { frame ->
+                        frame.writeTo(listener.buffer)
+                        listener.onFrames(1)
+                    }
+                }
+            } else {
+                val raw = value.toString(Charsets.UTF_8)
+                val log = "Received raw data: $raw"
+                looper.execute {
+                    if (raw.startsWith("EMG,") && log.isNotEmpty()) {
+                        raw.removePrefix("EMG,")
+                        listener.lines++
+                    }
+                }
+            }
+        }
+    }
+
+    private fun after(input: List<ByteArray>): Result {
+        val looper = Looper()
+        val listener = EmgListener()
+        val ingest = StreamIngest(256, 2048, 33, looper) { block ->
+            listener.lines += block.text.size
+            if (block.frameCount > 0) {
+                block.writeFramesTo(listener.buffer)
+                listener.onFrames(block.frameCount)
+            }
+        }
+        ingest.start()
+        return measure(input, looper, { listener.frames + listener.lines }) { value, rxNs ->
+            while (!ingest.offer(value, value.size, rxNs)) Thread.yield()
+        }
+    }
+
+    private fun report(name: String, before: Result, after: Result) {
+        println("%-6s before: %9.0f packets/s %7.1f B/packet %7d UI posts".format(
+            name, before.packetsPerS, before.bytesPerPacket, before.posts))
+        println("%-6s after:  %9.0f packets/s %7.1f B/packet %7d UI posts".format(
+            name, after.packetsPerS, after.bytesPerPacket, after.posts))
+    }
+
+    @Test
+    fun streamPackets() {
+        val input = List(1024) { streamPacket(it) }
+        val before = before(input)
+        val after = after(input)
+        report("stream", before, after)
+
+        // One post per tick instead of one per packet, and no garbage per packet
+        assertEquals(packets.toLong(), before.posts)
+        assertTrue(after.posts < packets / 10)
+        assertTrue(after.bytesPerPacket < before.bytesPerPacket / 4)
+    }
+
+    @Test
+    fun textPackets() {
+        val input = List(1024) { textPacket(it) }
+        val before = before(input)
+        val after = after(input)
+        report("text", before, after)
+
+        // The strings themselves remain; the per-packet post and log line go
+        assertTrue(after.posts < packets / 10)
+        assertTrue(after.bytesPerPacket < before.bytesPerPacket)
+    }
+
+    /** Ingest wakeups plus hand-overs per minute over 3 s of packets every [packetNs]. */
+    private fun wakeupsPerMinute(intervalMs: Long, packetNs: Long): Double {
+        val looper = Looper()
+        val ingest = StreamIngest(256, 2048, intervalMs, looper) {}
+        ingest.start()
+        val input = List(256) { streamPacket(it) }
+        val count = (3_000_000_000L / packetNs).toInt()
+        val start = System.nanoTime()
+        for (i in 0 until count) {
+            LockSupport.parkNanos(start + i * packetNs - System.nanoTime())
+            val value = input[i % input.size]
+            ingest.offer(value, value.size, System.nanoTime())
+        }
+        val minutes = (System.nanoTime() - start) / 60e9
+        return (ingest.wakeups + looper.posts) / minutes
+    }
+
+    @Test
+    fun batchedWakeups() {
+        // 13.3 kHz in 100-sample frames: one notification every 7.5 ms
+        val packetNs = 7_500_000L
+        val live = wakeupsPerMinute(33, packetNs)
+        val batched = wakeupsPerMinute(1000, packetNs)
+        println("wakeups per minute at %.0f packets/s: %.0f with 33 ms ticks, %.0f with 1 s batches".format(
+            1e9 / packetNs, live, batched))
+
+        // Two per tick (ingest thread and worker) against about three per second
+        assertTrue(batched < live / 10)
+    }
+}
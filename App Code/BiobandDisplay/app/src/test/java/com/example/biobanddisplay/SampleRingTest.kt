@@ -0,0 +1,88 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import kotlin.random.Random
+
+/**
+ * Min/max decimation in SampleRing against a brute-force reference, and
+ * its cost per display frame at the full EMG rate.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*SampleRingTest*' -i
+ */
+class SampleRingTest {
+
+    /** Min and max of each column's share of [last], plus the sample before it. */
+    private fun reference(last: List<Float>, columns: Int): Pair<List<Float>, List<Float>> {
+        val n = last.size
+        val cols = minOf(columns, n)
+        val mins = ArrayList<Float>()
+        val maxs = ArrayList<Float>()
+        for (c in 0 until cols) {
+            val start = (c.toLong() * n / cols).toInt()
+            val end = ((c + 1L) * n / cols).toInt()
+            val seg = last.subList(maxOf(0, start - 1), end)
+            mins.add(seg.min())
+            maxs.add(seg.max())
+        }
+        return mins to maxs
+    }
+
+    @Test
+    fun decimationMatchesReference() {
+        val rnd = Random(1)
+        repeat(500) {
+            val capacity = rnd.nextInt(1, 64)
+            val ring = SampleRing(capacity)
+            val history = ArrayList<Float>()
+            repeat(rnd.nextInt(1, 6)) {
+                val src = FloatArray(rnd.nextInt(0, 100)) { rnd.nextFloat() }
+                val count = rnd.nextInt(0, src.size + 1)
+                ring.append(src, count)
+                for (i in 0 until count) history.add(src[i])
+            }
+            val window = rnd.nextInt(1, 80)
+            val columns = rnd.nextInt(1, 40)
+            val last = history.takeLast(minOf(window, capacity))
+
+            val mins = FloatArray(columns)
+            val maxs = FloatArray(columns)
+            val cols = ring.decimate(window, columns, mins, maxs)
+            val (refMin, refMax) = reference(last, columns)
+            assertEquals(refMin.size, cols)
+            assertEquals(refMin, mins.take(cols))
+            assertEquals(refMax, maxs.take(cols))
+        }
+    }
+
+    @Test
+    fun frameCostAtFullEmgRate() {
+        // 13.3 kHz arriving in 33 ms blocks, 5 s on screen across 1440 pixels
+        val fs = 13333
+        val ring = SampleRing(1 shl 17)
+        val block = FloatArray(fs * 33 / 1000) { (it % 200 - 100).toFloat() }
+        val window = 5 * fs
+        val columns = 1440
+        val mins = FloatArray(columns)
+        val maxs = FloatArray(columns)
+        while (ring.size < window) ring.append(block)
+
+        val frames = 600
+        var worstNs = 0L
+        val start = System.nanoTime()
+        for (f in 0 until frames) {
+            // Two frames per block, as at 60 Hz
+            if (f % 2 == 0) ring.append(block)
+            val t = System.nanoTime()
+            ring.decimate(window, columns, mins, maxs)
+            worstNs = maxOf(worstNs, System.nanoTime() - t)
+        }
+        val meanMs = (System.nanoTime() - start) / 1e6 / frames
+        println("decimate %d samples to %d columns: %.3f ms mean, %.3f ms worst".format(
+            window, columns, meanMs, worstNs / 1e6))
+
+        // Leaves most of a 16 ms frame for drawing
+        assertTrue(meanMs < 4.0)
+    }
+}
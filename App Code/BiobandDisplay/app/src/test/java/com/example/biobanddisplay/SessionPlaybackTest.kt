@@ -0,0 +1,164 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import java.io.ByteArrayOutputStream
+import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.file.Files
+import java.util.concurrent.Executor
+
+/**
+ * SessionPlayback gives StreamIngest the same samples and text a recording
+ * was made from, and keeps to its speed: 10x plays a session in a tenth of
+ * its length, and "as fast as possible" drops nothing.
+ *
+ * On a phone, BleConnectionManager logs each run ("Playback done:") with
+ * the receive path's figures, which the real-time screen shows while it plays.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*SessionPlaybackTest*' -i
+ */
+class SessionPlaybackTest {
+
+    private val samplesPerFrame = 10
+    private val frameUs = 10_000L
+
+    private fun tempDir(): File = Files.createTempDirectory("playback").toFile()
+
+    // [frames] EMG frames 10 ms apart, and every 50th a PPG line too long for one frame,
+    // stored as SessionRecorder stores text: FMT_BYTES frames with one seq
+    private fun writeSession(file: File, frames: Int): List<String> {
+        val out = ByteArrayOutputStream()
+        val lines = ArrayList<String>()
+        val frame = ByteArray(StreamProto.HDR_LEN + 255)
+        for (i in 0 until frames) {
+            StreamProto.writeHeader(frame, 0, StreamProto.CH_EMG, StreamProto.FMT_I16, samplesPerFrame,
+                i, i * frameUs, frameUs * 1000 / samplesPerFrame)
+            val samples = ByteBuffer.wrap(frame, StreamProto.HDR_LEN, 2 * samplesPerFrame).order(ByteOrder.LITTLE_ENDIAN)
+            for (k in 0 until samplesPerFrame) samples.putShort((i * samplesPerFrame + k).toShort())
+            out.write(frame, 0, StreamProto.HDR_LEN + 2 * samplesPerFrame)
+
+            if (i % 50 == 0) {
+                val line = (0 until 60).joinToString(",") { "%04d".format((i + it) % 10_000) }
+                lines.add(line)
+                val bytes = line.toByteArray(Charsets.UTF_8)
+                var pos = 0
+                while (pos < bytes.size) {
+                    val n = minOf(255, bytes.size - pos)
+                    StreamProto.writeHeader(frame, 0, StreamProto.CH_PPG, StreamProto.FMT_BYTES, n,
+                        lines.size, i * frameUs, 0)
+                    System.arraycopy(bytes, pos, frame, StreamProto.HDR_LEN, n)
+                    out.write(frame, 0, StreamProto.HDR_LEN + n)
+                    pos += n
+                }
+            }
+        }
+        file.writeBytes(out.toByteArray())
+        return lines
+    }
+
+    private class Collected {
+        val values = ArrayList<Float>()
+        val text = HashMap<Int, ArrayList<String>>()
+        var lostFrames = 0
+    }
+
+    // Plays [files] as fast as possible through a StreamIngest, as BleConnectionManager does
+    private fun playThroughIngest(files: List<File>): Pair<SessionPlayback, Collected> {
+        val collected = Collected()
+        val ingest = StreamIngest(64, 2048, 5, Executor { it.run() }) { block ->
+            synchronized(collected) {
+                for (i in 0 until block.size) collected.values.add(block.values[i])
+                collected.text.getOrPut(block.channel) { ArrayList() }.addAll(block.text)
+                collected.lostFrames += block.lostFrames
+            }
+        }
+        ingest.start()
+        val playback = SessionPlayback(files, SessionPlayback.FASTEST) { data, length, rxNs ->
+            if (ingest.queueDepth >= ingest.capacity) false else ingest.offer(data, length, rxNs)
+        }.start()
+        waitFor { playback.finished && ingest.queueDepth == 0 && ingest.publishes > 0 }
+        // One more tick for the last block
+        Thread.sleep(50)
+        assertEquals(0L, ingest.droppedPackets)
+        return playback to collected
+    }
+
+    private fun waitFor(condition: () -> Boolean) {
+        val deadline = System.nanoTime() + 10_000_000_000L
+        while (!condition()) {
+            assertTrue("timed out", System.nanoTime() < deadline)
+            Thread.sleep(5)
+        }
+    }
+
+    @Test
+    fun sessionFileRoundTrip() {
+        val dir = tempDir()
+        val lines = writeSession(File(dir, "session_20250101_120000_000.bin"), 1000)
+        val (playback, collected) = playThroughIngest(listOf(File(dir, "session_20250101_120000_000.bin")))
+
+        assertEquals(1000 + lines.size, playback.packets.toInt())
+        assertEquals(0L, playback.droppedPackets)
+        assertEquals(999 * frameUs, playback.sessionUs)
+        synchronized(collected) {
+            assertEquals(1000 * samplesPerFrame, collected.values.size)
+            for (i in collected.values.indices) assertEquals(i.toFloat(), collected.values[i], 0f)
+            assertEquals(lines, collected.text[StreamProto.CH_PPG])
+            assertEquals(0, collected.lostFrames)
+        }
+        dir.deleteRecursively()
+    }
+
+    @Test
+    fun csvAsTextPackets() {
+        val dir = tempDir()
+        val csv = File(dir, "emg_log.csv")
+        csv.writeText("value\n" + (0 until 1050).joinToString("\n") { "$it,0" } + "\n")
+        val (playback, collected) = playThroughIngest(listOf(csv))
+
+        // 100 values per packet, the last one partly filled
+        assertEquals(11L, playback.packets)
+        synchronized(collected) {
+            val values = collected.text[StreamProto.CH_EMG]!!.flatMap { it.split(',') }.map { it.toInt() }
+            assertEquals((0 until 1050).toList(), values)
+        }
+        dir.deleteRecursively()
+    }
+
+    @Test
+    fun keepsToSpeed() {
+        val dir = tempDir()
+        val file = File(dir, "session_20250101_120000_000.bin")
+        writeSession(file, 200)
+        val sessionMs = 200 * frameUs / 1000
+
+        fun play(speed: Double, accept: (Long) -> Boolean): Pair<SessionPlayback, Long> {
+            var offered = 0L
+            val start = System.nanoTime()
+            val playback = SessionPlayback(listOf(file), speed) { _, _, _ -> accept(offered++) }.start()
+            waitFor { playback.finished }
+            return playback to (System.nanoTime() - start) / 1_000_000
+        }
+
+        val (tenfold, tenfoldMs) = play(10.0) { true }
+        val (fastest, fastestMs) = play(SessionPlayback.FASTEST) { true }
+        // A paced run drops what the receiver refuses; an unpaced one waits and retries
+        val (paced, _) = play(10.0) { it % 2 == 0L }
+        val (unpaced, _) = play(SessionPlayback.FASTEST) { it % 2 == 0L }
+        println("%d ms of data: 10x in %d ms (max lag %d ms), as fast as possible in %d ms".format(
+            sessionMs, tenfoldMs, tenfold.maxLagMs, fastestMs))
+
+        assertTrue(tenfoldMs >= sessionMs / 10 - 5)
+        assertTrue(tenfoldMs < sessionMs / 2)
+        assertTrue(fastestMs <= tenfoldMs)
+        assertEquals(tenfold.packets, fastest.packets)
+        assertEquals(paced.packets + paced.droppedPackets, tenfold.packets)
+        assertTrue(paced.droppedPackets > 0)
+        assertEquals(tenfold.packets, unpaced.packets)
+        assertEquals(0L, unpaced.droppedPackets)
+        dir.deleteRecursively()
+    }
+}
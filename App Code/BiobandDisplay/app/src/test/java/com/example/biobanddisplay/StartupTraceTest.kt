@@ -0,0 +1,102 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.Callable
+import java.util.concurrent.Executors
+
+/**
+ * StartupTrace keeps the first time of each step, and time to first sample
+ * and first metric on a cold start, before and after the scan stopped
+ * waiting for the Python runtime.
+ *
+ * The runtime start and the scan plus connection are stand-ins that take
+ * [runtimeMs] and [linkMs]. The packets go through a real StreamIngest to a
+ * worker, which polls the runtime's Future the way MonitorService polls
+ * the ppg_analyzer import: the first metric needs both the runtime and a
+ * sample. On a phone, BleConnectionManager.startup logs the real steps
+ * under "STARTUP".
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*StartupTraceTest*' -i
+ */
+class StartupTraceTest {
+
+    private val runtimeMs = 400L
+    private val linkMs = 200L
+
+    private fun streamPacket(seq: Int): ByteArray {
+        val buf = ByteBuffer.allocate(StreamProto.HDR_LEN + 2 * 10).order(ByteOrder.LITTLE_ENDIAN)
+        buf.put(0xB1.toByte()).put(StreamProto.CH_EMG.toByte()).put(StreamProto.FMT_I16.toByte())
+            .put(10.toByte()).putShort(seq.toShort()).putInt(seq * 5_000).putInt(500_000)
+        for (i in 0 until 10) buf.putShort(i.toShort())
+        return buf.array()
+    }
+
+    private fun coldStart(scanWaitsForRuntime: Boolean): StartupTrace {
+        val t0 = System.nanoTime()
+        val trace = StartupTrace(0, { (System.nanoTime() - t0) / 1_000_000 }) { println("  $it") }
+        val runtime = Executors.newSingleThreadExecutor()
+        val worker = Executors.newSingleThreadExecutor()
+        val started = runtime.submit(Callable {
+            Thread.sleep(runtimeMs)
+            trace.mark("python_ready")
+        })
+        val ingest = StreamIngest(64, 2048, 33, worker) { block ->
+            if (block.size > 0) trace.mark(StartupTrace.FIRST_SAMPLE)
+            if (started.isDone) trace.mark(StartupTrace.FIRST_METRIC)
+        }
+        ingest.start()
+
+        if (scanWaitsForRuntime) started.get()
+        trace.mark("scan")
+        Thread.sleep(linkMs)
+        trace.mark("connected")
+        var seq = 0
+        while (trace[StartupTrace.FIRST_METRIC] == null) {
+            assertTrue("timed out", seq < 1000)
+            val packet = streamPacket(seq++)
+            ingest.offer(packet, packet.size, System.nanoTime())
+            Thread.sleep(10)
+        }
+        runtime.shutdown()
+        worker.shutdown()
+        return trace
+    }
+
+    @Test
+    fun keepsFirstMark() {
+        var now = 1000L
+        val lines = ArrayList<String>()
+        val trace = StartupTrace(400, { now }) { lines.add(it) }
+        assertTrue(trace.mark("scan"))
+        now = 1500
+        assertFalse(trace.mark("scan"))
+        assertEquals(600L, trace["scan"])
+        assertNull(trace[StartupTrace.FIRST_SAMPLE])
+
+        trace.mark(StartupTrace.FIRST_METRIC)
+        now = 1200
+        trace.mark("python_ready")
+        // One line per step, plus the summary in time order from the first metric on
+        assertEquals(5, lines.size)
+        assertEquals("Startup: scan 600 ms, python_ready 800 ms, first_metric 1100 ms", lines.last())
+    }
+
+    @Test
+    fun parallelStart() {
+        println("scan after the runtime:")
+        val before = coldStart(scanWaitsForRuntime = true)
+        println("scan in parallel:")
+        val after = coldStart(scanWaitsForRuntime = false)
+        println("first sample %d -> %d ms, first metric %d -> %d ms (runtime %d ms, link %d ms)".format(
+            before[StartupTrace.FIRST_SAMPLE], after[StartupTrace.FIRST_SAMPLE],
+            before[StartupTrace.FIRST_METRIC], after[StartupTrace.FIRST_METRIC], runtimeMs, linkMs))
+
+        // The first sample no longer waits for the runtime; the metric waits for the slower of the two
+        assertTrue(after[StartupTrace.FIRST_SAMPLE]!! < before[StartupTrace.FIRST_SAMPLE]!! - runtimeMs / 2)
+        assertTrue(after[StartupTrace.FIRST_METRIC]!! < before[StartupTrace.FIRST_METRIC]!! - linkMs / 2)
+    }
+}
@@ -0,0 +1,191 @@
+package com.example.biobanddisplay
+
+import org.junit.Test
+
+import org.junit.Assert.*
+import java.io.File
+import java.nio.file.Files
+import java.util.Random
+
+/**
+ * GorillaCodec round-trips every bit, and TimeSeriesStore answers range and
+ * rollup queries exactly as a scan of all points would, across chunks,
+ * reopening and out-of-order appends. Also reports the disk size and the
+ * bytes read for a day and a week view compared with a CSV of the same data.
+ *
+ * Run with: ./gradlew :app:testDebugUnitTest --tests '*TimeSeriesStoreTest*' -i
+ */
+class TimeSeriesStoreTest {
+
+    private val startMs = 1_700_000_000_000L
+
+    private fun tempDir(): File = Files.createTempDirectory("timeseries").toFile()
+
+    // A metric once a second with a few ms of jitter, stored from a Float as the monitor does
+    private fun metric(seconds: Int, seed: Long): Pair<LongArray, DoubleArray> {
+        val rnd = Random(seed)
+        val times = LongArray(seconds)
+        val values = DoubleArray(seconds)
+        var v = 30f
+        for (i in 0 until seconds) {
+            times[i] = startMs + i * 1000L + rnd.nextInt(7) - 3
+            v = maxOf(0.5f, v + rnd.nextGaussian().toFloat() * 0.5f)
+            values[i] = v.toDouble()
+        }
+        return times to values
+    }
+
+    @Test
+    fun codecRoundTrip() {
+        val rnd = Random(1)
+        val n = 5000
+        val times = LongArray(n)
+        val values = DoubleArray(n)
+        val specials = doubleArrayOf(Double.NaN, Double.POSITIVE_INFINITY, -0.0, 0.0,
+            Double.MAX_VALUE, -Double.MIN_VALUE, 1e-300)
+        val steps = longArrayOf(1000, 1000, 1000, 1003, 997, 60_000, -5000, 1_000_000_000_000, 1)
+        times[0] = startMs
+        values[0] = 12.5
+        for (i in 1 until n) {
+            times[i] = times[i - 1] + steps[rnd.nextInt(steps.size)]
+            values[i] = when (rnd.nextInt(4)) {
+                0 -> values[i - 1]
+                1 -> (30 + rnd.nextGaussian() * 5).toFloat().toDouble()
+                2 -> specials[rnd.nextInt(specials.size)]
+                else -> rnd.nextDouble()
+            }
+        }
+        // From an offset, as the store encodes its open chunk
+        val bytes = GorillaCodec.encode(times, values, 1, n - 1)
+        val outTimes = LongArray(n)
+        val outValues = DoubleArray(n)
+        GorillaCodec.decode(bytes, 0, bytes.size, n - 1, outTimes, outValues, 1)
+        for (i in 1 until n) {
+            assertEquals(times[i], outTimes[i])
+            assertEquals(values[i].toRawBits(), outValues[i].toRawBits())
+        }
+    }
+
+    @Test
+    fun queriesMatchScan() {
+        val dir = tempDir()
+        val (times, values) = metric(4 * 3600, 2)
+        // Small chunks, so queries cross many of them; reopen halfway
+        var store = TimeSeriesStore(dir, chunkPoints = 300, zoneOffsetMs = -5 * TimeSeriesStore.HOUR_MS)
+        for (i in times.indices) {
+            if (i == times.size / 2) {
+                store.close()
+                store = TimeSeriesStore(dir, chunkPoints = 300, zoneOffsetMs = -5 * TimeSeriesStore.HOUR_MS)
+            }
+            store.append("emg_vrms", times[i], values[i])
+        }
+        // The tail stays in the open chunk
+
+        val rnd = Random(3)
+        repeat(50) {
+            val from = startMs + rnd.nextInt(5 * 3600_000) - 1800_000
+            val to = from + rnd.nextInt(2 * 3600_000)
+            val points = store.range("emg_vrms", from, to)
+            val expected = times.indices.filter { times[it] in from until to }
+            assertEquals(expected.size, points.size)
+            for ((k, i) in expected.withIndex()) {
+                assertEquals(times[i], points.timesMs[k])
+                assertEquals(values[i], points.values[k], 0.0)
+            }
+
+            for (res in TimeSeriesStore.RESOLUTIONS) {
+                val rollup = store.rollup("emg_vrms", res, from, to)
+                val first = store.bucketStart(from, res)
+                val buckets = times.indices
+                    .groupBy { store.bucketStart(times[it], res) }
+                    .filterKeys { it in first until to }
+                    .toSortedMap()
+                assertEquals(buckets.size, rollup.size)
+                for ((k, entry) in buckets.entries.withIndex()) {
+                    val v = entry.value.map { values[it] }
+                    assertEquals(entry.key, rollup.startsMs[k])
+                    assertEquals(v.size, rollup.counts[k])
+                    assertEquals(v.min(), rollup.mins[k], 0.0)
+                    assertEquals(v.max(), rollup.maxs[k], 0.0)
+                    assertEquals(v.average(), rollup.mean(k), 1e-9)
+                }
+            }
+        }
+        // Local days start at local midnight, 05:00 UTC here
+        assertEquals(5 * TimeSeriesStore.HOUR_MS, store.bucketStart(startMs, TimeSeriesStore.DAY_MS) % TimeSeriesStore.DAY_MS)
+        store.close()
+        dir.deleteRecursively()
+    }
+
+    @Test
+    fun outOfOrderAppends() {
+        val dir = tempDir()
+        val day = TimeSeriesStore.DAY_MS
+        val store = TimeSeriesStore(dir, zoneOffsetMs = 0)
+        val day0 = store.bucketStart(startMs, day)
+        // Journal entries saved late, and one day rewritten
+        store.append("journal_soreness", day0 + 2 * day, 5.0)
+        store.append("journal_soreness", day0, 3.0)
+        store.flush()
+        store.append("journal_soreness", day0 + day, 7.0)
+        store.append("journal_soreness", day0, 4.0)
+
+        val points = store.range("journal_soreness", day0, day0 + 3 * day)
+        assertArrayEquals(longArrayOf(day0, day0, day0 + day, day0 + 2 * day), points.timesMs)
+        assertArrayEquals(doubleArrayOf(3.0, 4.0, 7.0, 5.0), points.values, 0.0)
+
+        val rollup = store.rollup("journal_soreness", day, day0, day0 + 3 * day)
+        assertArrayEquals(intArrayOf(2, 1, 1), rollup.counts)
+        assertEquals(3.5, rollup.mean(0), 0.0)
+        assertEquals(4.0, rollup.maxs[0], 0.0)
+
+        store.close()
+        // Reopened, the flushed chunks are read back the same way
+        val reopened = TimeSeriesStore(dir, zoneOffsetMs = 0)
+        assertArrayEquals(points.values, reopened.range("journal_soreness", day0, day0 + 3 * day).values, 0.0)
+        reopened.close()
+        dir.deleteRecursively()
+    }
+
+    @Test
+    fun weekOfMetrics() {
+        val dir = tempDir()
+        val seconds = 7 * 24 * 3600
+        val (times, values) = metric(seconds, 4)
+        var csvBytes = 0L
+        for (i in 0 until seconds) csvBytes += "${times[i]},${values[i].toFloat()}\n".length
+
+        var start = System.nanoTime()
+        val store = TimeSeriesStore(dir, zoneOffsetMs = 0)
+        for (i in 0 until seconds) store.append("emg_vrms", times[i], values[i])
+        store.flush()
+        val appendSeconds = (System.nanoTime() - start) / 1e9
+        val diskBytes = store.diskBytes("emg_vrms")
+        store.close()
+
+        // A fresh store, as a screen opening on a new day would see it
+        val reader = TimeSeriesStore(dir, zoneOffsetMs = 0)
+        val lastDay = reader.bucketStart(times.last(), TimeSeriesStore.DAY_MS)
+        start = System.nanoTime()
+        val dayView = reader.rollup("emg_vrms", TimeSeriesStore.MINUTE_MS, lastDay - TimeSeriesStore.DAY_MS, lastDay)
+        val dayBytes = reader.bytesRead
+        val weekView = reader.rollup("emg_vrms", TimeSeriesStore.HOUR_MS, startMs, times.last() + 1)
+        val weekBytes = reader.bytesRead - dayBytes
+        val querySeconds = (System.nanoTime() - start) / 1e9
+        reader.close()
+
+        println("CSV: %.1f MB; store: %.2f MB (%.2f bytes/point), appends %.0f points/s".format(
+            csvBytes / 1e6, diskBytes / 1e6, diskBytes.toDouble() / seconds, seconds / appendSeconds))
+        println("day view: %d minutes from %.1f KB (CSV %.0f KB); week view: %d hours from %.1f KB; %.1f ms for both".format(
+            dayView.size, dayBytes / 1e3, csvBytes / 7 / 1e3, weekView.size, weekBytes / 1e3, querySeconds * 1e3))
+
+        assertEquals(1440, dayView.size)
+        assertEquals(7 * 24 + 1, weekView.size)
+        assertEquals(seconds, weekView.counts.sum())
+        assertTrue(diskBytes * 3 < csvBytes)
+        // Against a day's and the week's CSV; the day view includes loading the index
+        assertTrue(dayBytes * 10 < csvBytes / 7)
+        assertTrue(weekBytes * 100 < csvBytes)
+        dir.deleteRecursively()
+    }
+}
@@ -0,0 +1,87 @@
+"""
+ppg_analyzer gives plausible heart rate and SpO2 for known PPG: every
+window of the bundled recording (about 63 bpm by its spectrum), and a
+synthetic pulse whose rate and red/IR ratio are set. PpgSession only moves
+the displayed values on changes larger than BPM_STEP / SPO2_STEP.
+
+Run with: python -m unittest discover -s app/src/test/python -p '*_test.py' -v
+"""
+import os
+import sys
+import unittest
+
+import numpy as np
+
+PYTHON_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "main", "python")
+sys.path.insert(0, PYTHON_DIR)
+
+import ppg_analyzer  # noqa: E402
+from ppg_analyzer import PpgSession, analyze_ppg_window, read_ppg_csv  # noqa: E402
+
+RECORDING = os.path.join(PYTHON_DIR, "ppg_filtered_data.csv")
+
+
+def synthetic(bpm, r, seconds=8.0, fs=ppg_analyzer.FS):
+    """Pulse at `bpm` with a dicrotic notch, red/IR perfusion ratio `r`."""
+    t = np.arange(int(seconds * fs)) / fs
+    phase = 2 * np.pi * bpm / 60 * t
+    pulse = np.sin(phase) + 0.3 * np.sin(2 * phase + 1.0)
+    ir_dc, red_dc = 2900.0, 3200.0
+    ir = ir_dc + 10.0 * pulse + 3.0 * np.sin(2 * np.pi * 0.2 * t)
+    red = red_dc + r * 10.0 * (red_dc / ir_dc) * pulse
+    return t * 1000, red, ir
+
+
+class PpgAnalyzerTest(unittest.TestCase):
+
+    def test_recording_windows(self):
+        t, red, ir = map(np.array, read_ppg_csv(RECORDING))
+        n = ppg_analyzer.WINDOW_SAMPLES
+        for start in range(0, len(t) - n + 1, 50):
+            w = slice(start, start + n)
+            result = analyze_ppg_window(t[w], red[w], ir[w])
+            with self.subTest(start=start):
+                self.assertTrue(55 <= result["bpm"] <= 75, result["bpm"])
+                # Not pinned to either end of the 70-100 clamp
+                self.assertTrue(85 <= result["SpO2"] < 99, result["SpO2"])
+
+    def test_synthetic_pulse(self):
+        for bpm, r in ((50, 0.5), (72, 0.6), (120, 0.8)):
+            result = analyze_ppg_window(*synthetic(bpm, r))
+            with self.subTest(bpm=bpm, r=r):
+                self.assertAlmostEqual(result["bpm"], bpm, delta=2)
+                self.assertAlmostEqual(result["SpO2"], 110 - 25 * r, delta=1.5)
+
+    def test_no_beats(self):
+        t = np.arange(600) * 8.0
+        result = analyze_ppg_window(t, np.full(600, 3200.0), np.full(600, 2900.0))
+        self.assertEqual(0, result["bpm"])
+        self.assertEqual(0, result["SpO2"])
+
+    def test_session_gates_display(self):
+        t, red, ir = read_ppg_csv(RECORDING)
+        session = PpgSession()
+        shown = []
+        for i in range(0, len(t), 10):
+            session.append(red[i:i + 10], ir[i:i + 10], t[i:i + 10])
+            result = session.update()
+            # 0 until the ring holds two beats
+            if result["bpm"] and (not shown or shown[-1] != (result["bpm"], result["SpO2"])):
+                shown.append((result["bpm"], result["SpO2"]))
+
+        self.assertGreater(session.updates, 10)
+        self.assertTrue(all(55 <= bpm <= 75 and 85 <= spo2 < 99 for bpm, spo2 in shown), shown)
+        for (bpm0, spo20), (bpm1, spo21) in zip(shown, shown[1:]):
+            self.assertTrue(bpm1 == bpm0 or abs(bpm1 - bpm0) > ppg_analyzer.BPM_STEP)
+            self.assertTrue(spo21 == spo20 or abs(spo21 - spo20) > ppg_analyzer.SPO2_STEP)
+
+        # A window without beats keeps what is on screen
+        before = (session.result["bpm"], session.result["SpO2"])
+        session.append(np.full(600, 3200.0), np.full(600, 2900.0))
+        result = session.update()
+        self.assertEqual(0, result["window_bpm"])
+        self.assertEqual(before, (result["bpm"], result["SpO2"]))
+
+
+if __name__ == "__main__":
+    unittest.main()
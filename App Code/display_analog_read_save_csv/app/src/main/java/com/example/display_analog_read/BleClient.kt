@@ -8,6 +8,7 @@ import android.os.Build
 import android.os.ParcelUuid
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
+import java.io.File
 import java.util.UUID
 
 data class BleDevice(
@@ -142,12 +143,33 @@ class BleClient(private val context: Context) {
         gatt = null
         _state.value = BleState.Idle
     }
-    private val recorded = mutableListOf<Int>()
-
-    fun getRecordedSamplesSnapshot(): List<Int> = recorded.toList()
+    // Samples go to disk as little-endian int16 as they arrive; CSV is made on request
+    private val recordDir = File(context.filesDir, "recordings")
+    @Volatile private var recorder = SessionRecorder(recordDir, prefix = "ble_data").start()
+    private val finishedFiles = mutableListOf<File>()
+    private var finishedSamples = 0L
+
+    val recordedSamples: Long get() = finishedSamples + recorder.bytesRecorded / 2
+
+    /**
+     * Everything recorded since the last clear, oldest first. Closes the
+     * current file so it is complete, and carries on in a new one.
+     */
+    @Synchronized
+    fun finishRecording(): List<File> {
+        val done = recorder
+        recorder = SessionRecorder(recordDir, prefix = "ble_data").start()
+        done.close()
+        finishedFiles += done.files()
+        finishedSamples += done.bytesRecorded / 2
+        return finishedFiles.toList()
+    }
 
+    @Synchronized
     fun clearRecordedSamples() {
-        recorded.clear()
+        finishRecording().forEach { it.delete() }
+        finishedFiles.clear()
+        finishedSamples = 0
     }
     private val gattCallback = object : BluetoothGattCallback() {
 
@@ -241,7 +263,7 @@ class BleClient(private val context: Context) {
             val u16 = lo or (hi shl 8)
             val s16 = if (u16 and 0x8000 != 0) u16 - 0x10000 else u16
 
-            recorded.add(s16)
+            recorder.write(bytes, 0, 2)
             _latestMv.value = s16
         }
     }
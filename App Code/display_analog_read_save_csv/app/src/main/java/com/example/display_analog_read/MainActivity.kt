@@ -5,6 +5,8 @@ import android.Manifest
 import android.content.Context
 import android.content.pm.PackageManager
 import android.os.Bundle
+import android.os.Handler
+import android.os.Looper
 import android.widget.Toast
 import androidx.activity.ComponentActivity
 import androidx.activity.compose.setContent
@@ -33,10 +35,14 @@ import androidx.compose.ui.unit.dp
 import androidx.core.content.ContextCompat
 import com.example.display_analog_read.ui.theme.Display_analog_readTheme
 import java.io.File
+import java.io.FileInputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.text.SimpleDateFormat
 import java.util.Date
 import java.util.Locale
 import kotlin.math.max
+import kotlin.concurrent.thread
 import kotlin.math.roundToInt
 
 class MainActivity : ComponentActivity() {
@@ -110,7 +116,7 @@ private fun BleScreen(
         if (history.size > maxPoints) {
             history.removeAt(0)
         }
-        recordedCount = ble.getRecordedSamplesSnapshot().size
+        recordedCount = ble.recordedSamples.toInt()
     }
 
     Column(
@@ -145,24 +151,28 @@ private fun BleScreen(
 
             Button(
                 onClick = {
-                    val samples = ble.getRecordedSamplesSnapshot()
-                    if (samples.isEmpty()) {
+                    if (ble.recordedSamples == 0L) {
                         Toast.makeText(context, "No data to save yet", Toast.LENGTH_SHORT).show()
                     } else {
-                        val result = saveSamplesToCsv(context, samples)
-                        result.onSuccess { file ->
-                            lastSavedPath = file.absolutePath
-                            Toast.makeText(
-                                context,
-                                "Saved CSV: ${file.name}",
-                                Toast.LENGTH_LONG
-                            ).show()
-                        }.onFailure { e ->
-                            Toast.makeText(
-                                context,
-                                "Save failed: ${e.message}",
-                                Toast.LENGTH_LONG
-                            ).show()
+                        // Converted from the recorded files off the main thread
+                        thread(name = "csv-export") {
+                            val result = saveSamplesToCsv(context, ble.finishRecording())
+                            mainHandler.post {
+                                result.onSuccess { file ->
+                                    lastSavedPath = file.absolutePath
+                                    Toast.makeText(
+                                        context,
+                                        "Saved CSV: ${file.name}",
+                                        Toast.LENGTH_LONG
+                                    ).show()
+                                }.onFailure { e ->
+                                    Toast.makeText(
+                                        context,
+                                        "Save failed: ${e.message}",
+                                        Toast.LENGTH_LONG
+                                    ).show()
+                                }
+                            }
                         }
                     }
                 }
@@ -260,9 +270,12 @@ private fun BleScreen(
     }
 }
 
+private val mainHandler = Handler(Looper.getMainLooper())
+
+// Streams the recorded int16 samples into a CSV, one buffered pass over the files
 private fun saveSamplesToCsv(
     context: Context,
-    samples: List<Int>
+    recordings: List<File>
 ): Result<File> {
     return runCatching {
         val timestamp = SimpleDateFormat("yyyyMMdd_HHmmss", Locale.US).format(Date())
@@ -271,17 +284,25 @@ private fun saveSamplesToCsv(
 
         val file = File(dir, "ble_data_$timestamp.csv")
 
-        val csvText = buildString {
-            appendLine("index,value")
-            samples.forEachIndexed { index, value ->
-                append(index)
-                append(',')
-                append(value)
-                appendLine()
+        file.bufferedWriter(bufferSize = 1 shl 16).use { out ->
+            out.write("index,value\n")
+            var index = 0L
+            val buf = ByteBuffer.allocate(1 shl 16).order(ByteOrder.LITTLE_ENDIAN)
+            for (recording in recordings) {
+                FileInputStream(recording).channel.use { ch ->
+                    while (ch.read(buf) >= 0) {
+                        buf.flip()
+                        while (buf.remaining() >= 2) {
+                            out.write(index++.toString())
+                            out.write(','.code)
+                            out.write(buf.short.toInt().toString())
+                            out.write('\n'.code)
+                        }
+                        buf.compact()
+                    }
+                }
             }
         }
-
-        file.writeText(csvText)
         file
     }
 }
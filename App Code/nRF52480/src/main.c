@@ -17,6 +17,17 @@
 #endif
 #include <zephyr/sys/byteorder.h>
 
+#include "ble_tx.h"
+#include "fanout.h"
+#include "frame_log.h"
+#include "l2cap_stream.h"
+#include "rate_ctrl.h"
+#include "stream_proto.h"
+#include "time_sync.h"
+
+BUILD_ASSERT(FRAME_LOG_OFFLOAD_CREDITS <= FANOUT_RESERVED_TX,
+	     "the backlog offload must stay within the TX buffers fan-out leaves free");
+
 //button gpio container 
 #define BUTTON0_NODE DT_ALIAS(sw0)
 #if !DT_NODE_HAS_STATUS(BUTTON0_NODE, okay)
@@ -39,7 +50,7 @@ const struct uart_config uart_cfg = {
 
 //definitions for bluetooth
 char ble_uart_buffer[150] = {0}; //buffer to transmit bluetooth specific messages over uart
-volatile uint8_t notify_client = 0; //flag for notification enable/disable status
+volatile uint8_t notify_client = 0; //flag: at least one central has notifications enabled
 #define CONFIG_BT_DEVICE_NAME "Test Device"
 #define DEVICE_NAME             CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN         (sizeof(DEVICE_NAME) - 1) 
@@ -50,6 +61,9 @@ volatile uint8_t notify_client = 0; //flag for notification enable/disable statu
 #define BT_UUID_MY_SERVICE         BT_UUID_DECLARE_128(NRF52_SERVICE_UUID) //pointer to above service uuid
 #define BT_UUID_MY_CHARACTERISTIC  BT_UUID_DECLARE_128(NRF52_CHARACTERISTIC_UUID) //pointer to above characteristic uuid
 
+struct bt_conn *log_conn; //connection the flash backlog is offloaded to
+void nrf52_uart_tx(uint8_t *tx_buff);
+
 
 #ifdef CONFIG_ADC
 /* --- EMG / ADC sampling configuration --- */
@@ -58,10 +72,146 @@ static const struct device *adc_dev = DEVICE_DT_GET(DT_NODELABEL(adc));
 #define ADC_RESOLUTION 12
 #define SAMPLE_RATE_HZ 1000 /* Hz: change as needed */
 #define BATCH_SIZE 20       /* number of samples per BLE packet */
+#define ADC_GAIN ADC_GAIN_1_6
 
+/*
+ * Samples go out as one stream frame per batch (common/include/stream_proto.h):
+ * channel EMG, int16 mV, t0 = uptime of the first sample in the batch.
+ * The phone maps t0 to its own clock through the time-sync service.
+ *
+ * Up to CONFIG_BT_MAX_CONN centrals (a phone and a logging gateway, say)
+ * can be connected at once. Each batch is published once into the
+ * fan-out ring (common/include/fanout.h), and every subscribed central
+ * drains it at its own pace. A central that has the L2CAP stream channel
+ * open gets the frame there instead, and as a notification only while
+ * the channel is busy. Batches that reach nobody (no link, notifications
+ * off, link busy) go to the flash recorder and are offloaded after the
+ * next subscribe.
+ *
+ * While connected, a rate controller (common/include/rate_ctrl.h) picks
+ * the stream tier from the completion rate, refused or lapped sends and
+ * backlog of the slowest receiver, since they all get the same frames.
+ * Every switch is announced on the control channel in the same packet as
+ * the first frame at the new tier. Without a link, frames are recorded
+ * at full tier.
+ */
 static int16_t sample_batch[BATCH_SIZE];
 static size_t batch_idx = 0;
-static uint32_t packet_seq = 0;
+static uint32_t batch_t0_us;
+static struct stream_channel emg_stream =
+    STREAM_CHANNEL_INIT(STREAM_CH_EMG, STREAM_FMT_I16, 1000000000u / SAMPLE_RATE_HZ);
+static struct stream_channel ctrl_stream =
+    STREAM_CHANNEL_INIT(STREAM_CH_CONTROL, STREAM_FMT_BYTES, 0);
+
+#define EMG_PACKED_PCT 60   /* typical I16_DELTA size of EMG vs raw */
+
+static struct rate_ctrl emg_rate;
+static uint32_t emg_demand[STREAM_TIER_COUNT];
+static bool emg_announce = true;
+static int64_t window_start_ms;
+static uint32_t window_offered;
+static uint32_t window_failures;
+static uint32_t window_last_bytes;
+
+/* Bytes the L2CAP channel has carried since boot */
+static uint32_t l2cap_bytes(void)
+{
+    struct l2cap_stream_stats st;
+
+    l2cap_stream_get_stats(&st);
+    return st.bytes;    /* queued; SDU buffers bound what is not sent yet */
+}
+
+/* Close a controller window once RATE_CTRL_WINDOW_MS have passed */
+static void rate_window(bool linked)
+{
+    int64_t now = k_uptime_get();
+    bool l2cap = l2cap_stream_ready();
+    uint32_t bytes = l2cap_bytes();
+    struct fanout_window fw;
+
+    if (!linked) {
+        //record at full quality, start over on the next link
+        if (emg_rate.tier != STREAM_TIER_FULL) {
+            emg_announce = true;
+        }
+        rate_ctrl_init(&emg_rate, STREAM_TIER_FULL, STREAM_TIER_FEATURES);
+        window_start_ms = now;
+        window_offered = 0;
+        window_failures = 0;
+        window_last_bytes = bytes;
+        fanout_window(&fw);
+        return;
+    }
+    if (now - window_start_ms < RATE_CTRL_WINDOW_MS) {
+        return;
+    }
+
+    fanout_window(&fw);
+
+    //the slowest of the channel and the notification subscribers
+    uint32_t completed = fw.bytes;
+
+    if (l2cap) {
+        completed = fw.subscribers ? MIN(fw.bytes, bytes - window_last_bytes)
+                                   : bytes - window_last_bytes;
+    }
+
+    struct rate_ctrl_input in = {
+        .window_us       = (uint32_t)(now - window_start_ms) * 1000,
+        .offered_bytes   = window_offered,
+        .completed_bytes = completed,
+        .failures        = window_failures + fw.skipped,
+        .in_flight       = l2cap ? l2cap_stream_in_flight() : fw.lag,
+        .credits         = l2cap ? L2CAP_STREAM_BUFS : FANOUT_SLOTS,
+    };
+    uint8_t old = emg_rate.tier;
+
+    if (rate_ctrl_update(&emg_rate, &in, emg_demand) != old) {
+        emg_announce = true;
+    }
+    window_start_ms = now;
+    window_offered = 0;
+    window_failures = 0;
+    window_last_bytes = bytes;
+}
+
+/* Send one batch at the current tier, or record it */
+static void emg_send_batch(void)
+{
+    uint8_t packet[2 * STREAM_HDR_LEN + STREAM_CTRL_TIER_LEN + sizeof(sample_batch)];
+    struct stream_buf out;
+    struct bt_conn *l2cap_conn = l2cap_stream_conn();
+    bool linked = notify_client || l2cap_conn;
+    int receivers = 0;
+
+    rate_window(linked);
+
+    stream_buf_init(&out, packet, sizeof(packet));
+    if (emg_announce) {
+        stream_put_tier_change(&out, &ctrl_stream, batch_t0_us, STREAM_CH_EMG, emg_rate.tier);
+    }
+    stream_put_tier(&out, &emg_stream, emg_rate.tier, batch_t0_us, sample_batch, BATCH_SIZE);
+
+    if (l2cap_conn && l2cap_stream_send(out.data, out.len, K_NO_WAIT) == 0) {
+        receivers++;
+    } else {
+        l2cap_conn = NULL;  //channel busy: that central gets a notification
+    }
+    fanout_hold(l2cap_conn);
+    receivers += MAX(fanout_publish(out.data, out.len), 0);
+
+    if (receivers == 0) {
+        if (linked) {
+            window_failures++;
+        }
+        frame_log_append(out.data, out.len);
+    } else {
+        window_offered += out.len;
+    }
+    //the recorded copy carries the announcement too
+    emg_announce = false;
+}
 
 static int16_t single_sample_buffer;
 static struct adc_sequence sequence = {
@@ -75,26 +225,22 @@ static void sampling_thread(void *a, void *b, void *c)
 {
     ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
 
+    rate_ctrl_init(&emg_rate, STREAM_TIER_FULL, STREAM_TIER_FEATURES);
+    rate_ctrl_demand_i16(emg_demand, SAMPLE_RATE_HZ, BATCH_SIZE, EMG_PACKED_PCT);
+
     while (1) {
+        uint32_t t_us = time_sync_now_us();
         int rc = adc_read(adc_dev, &sequence);
         if (rc == 0) {
-            sample_batch[batch_idx++] = single_sample_buffer;
+            int32_t mv = single_sample_buffer;
+            adc_raw_to_millivolts(adc_ref_internal(adc_dev), ADC_GAIN,
+                                  ADC_RESOLUTION, &mv);
+            if (batch_idx == 0) {
+                batch_t0_us = t_us;
+            }
+            sample_batch[batch_idx++] = (int16_t)mv;
             if (batch_idx >= BATCH_SIZE) {
-                if (my_connection && notify_client) {
-                    uint8_t packet[3 + 4 + 2 + (BATCH_SIZE * 2)];
-                    uint8_t *p = packet;
-                    memcpy(p, "EMG", 3); p += 3; /* simple header */
-                    uint32_t seq_le = sys_cpu_to_le32(packet_seq++);
-                    memcpy(p, &seq_le, 4); p += 4;
-                    uint16_t count_le = sys_cpu_to_le16(BATCH_SIZE);
-                    memcpy(p, &count_le, 2); p += 2;
-                    for (size_t i = 0; i < BATCH_SIZE; i++) {
-                        int16_t s_le = sys_cpu_to_le16(sample_batch[i]);
-                        memcpy(p, &s_le, 2); p += 2;
-                    }
-
-                    send_notification(my_connection, (const char *)packet, p - packet);
-                }
+                emg_send_batch();
                 batch_idx = 0;
             }
         } else {
@@ -106,7 +252,7 @@ static void sampling_thread(void *a, void *b, void *c)
     }
 }
 
-K_THREAD_DEFINE(sampling_tid, 1024, sampling_thread, NULL, NULL, NULL, 7, 0, 0);
+K_THREAD_DEFINE(sampling_tid, 1536, sampling_thread, NULL, NULL, NULL, 7, 0, 0);
 #endif /* CONFIG_ADC */
 
 static K_SEM_DEFINE(ble_init_ok, 0, 1); //semaphore for ble initialization
@@ -122,8 +268,6 @@ static const struct bt_data sd[] = //scan response data setup
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL, NRF52_SERVICE_UUID),
 };
 
-struct bt_conn *my_connection; //bluetooth connection reference struct
-
 //ble cccd update function declaration
 void on_cccd_changed(const struct bt_gatt_attr *attr, uint16_t value);
 
@@ -152,11 +296,40 @@ void nrf52_uart_tx(uint8_t *tx_buff){
 	k_msleep(100);
 }
 
+//pick the first subscribed central other than @data
+static void find_log_conn(struct bt_conn *conn, void *data)
+{
+	if (!log_conn && conn != data &&
+	    bt_gatt_is_subscribed(conn, &my_service.attrs[2], BT_GATT_CCC_NOTIFY)) {
+		log_conn = bt_conn_ref(conn);
+	}
+}
+
+/*
+ *@brief : start offloading the flash backlog
+ *@param : connection to leave out (one that is going away), or NULL
+ *@retval : None
+ *@note : ble_tx serves one link, so the backlog goes to a single subscribed
+        central while the live stream fans out to all of them
+*/
+static void start_offload(struct bt_conn *skip)
+{
+	if (log_conn) {
+		return;
+	}
+	bt_conn_foreach(BT_CONN_TYPE_LE, find_log_conn, skip);
+	if (log_conn) {
+		frame_log_start_offload(log_conn, &my_service.attrs[2]);
+	}
+}
+
 /*
  *@brief : bluetooth notify cccd callback function
  *@param : gatt attribute structure , client characteristic configuration Values
  *@retval : None 
- *@note : function is called whenever the CCCD value has been changed by the client
+ *@note : function is called whenever the CCCD value has been changed by the client.
+        With several centrals the value is the highest over all of them, so
+        0 means nobody is subscribed any more
 */
 void on_cccd_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
@@ -167,6 +340,8 @@ void on_cccd_changed(const struct bt_gatt_attr *attr, uint16_t value)
             // Start sending stuff! No ACK
 			notify_client = 1;  //notify data send start
 			nrf52_uart_tx("notify enabled\n");
+			//send what was recorded while disconnected
+			start_offload(NULL);
             break;
 
         case BT_GATT_CCC_INDICATE: 
@@ -177,6 +352,11 @@ void on_cccd_changed(const struct bt_gatt_attr *attr, uint16_t value)
         case 0: 
             // Stop sending stuff
 			notify_client = 0;  //notify data send stop
+			frame_log_stop_offload();
+			if (log_conn) {
+				bt_conn_unref(log_conn);
+				log_conn = NULL;
+			}
 			nrf52_uart_tx("notify/indicate disabled\n");
             break;
         
@@ -187,68 +367,28 @@ void on_cccd_changed(const struct bt_gatt_attr *attr, uint16_t value)
 }   
 
 /*
- *@brief : bluetooth notification callback function
- *@param : bluetooth connection structure 
- *@retval : None 
- *@note : function is called whenever a Notification has been sent by the Characteristic
+ *@brief : (re)start connectable advertising
+ *@param : work item
+ *@retval : None
+ *@note : runs after every connect and disconnect so further centrals can
+        join. Right after a disconnect the connection object may not be
+        free yet; then it tries again a little later
 */
-static void on_sent(struct bt_conn *conn, void *user_data)
+static void adv_restart(struct k_work *work)
 {
-	ARG_UNUSED(user_data);
-        const bt_addr_le_t * addr = bt_conn_get_dst(conn);
-    
-	memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
-	sprintf(ble_uart_buffer,"Data sent to Address 0x %02X %02X %02X %02X %02X %02X \n", addr->a.val[0]
-                                                                    , addr->a.val[1]
-                                                                    , addr->a.val[2]
-                                                                    , addr->a.val[3]
-                                                                    , addr->a.val[4]
-                                                                    , addr->a.val[5]);
-        nrf52_uart_tx(ble_uart_buffer);
-}
-
+	int err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
+				  sd, ARRAY_SIZE(sd));
 
-/*
- *@brief : bluetooth notification callback function
- *@param : bluetooth connection structure 
- *@retval : None 
- *@note : This function sends a notification to a Client with the provided data,
-        given that the Client Characteristic Control Descripter has been set to Notify (0x1).
-        It also calls the on_sent() callback if successful
-*/
-void send_notification(struct bt_conn *conn, const char *data, uint16_t len)
-{
-    /* 
-    The attribute for the characteristic is used with bt_gatt_is_subscribed 
-    to check whether notification has been enabled by the peer or not.
-    Attribute table: 0 = Service, 1 = Primary service, 2 = Characteristic, 3 = CCCD.
-    */
-    const struct bt_gatt_attr *attr = &my_service.attrs[2]; 
-
-    struct bt_gatt_notify_params params = 
-    {
-        .uuid   = BT_UUID_MY_CHARACTERISTIC,
-        .attr   = attr,
-        .data   = data,
-        .len    = len,
-        .func   = on_sent
-    };
-
-    // Check whether notifications are enabled or not
-    if(bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY)) 
-    {
-        // Send the notification
-	    if(bt_gatt_notify_cb(conn, &params))
-        {
-            nrf52_uart_tx("Error, unable to send notification\n");
-        }
-    }
-    else
-    {
-        nrf52_uart_tx("Warning, notification not enabled\n");
-    }
+	if (err == -ENOMEM) {
+		k_work_reschedule(k_work_delayable_from_work(work), K_MSEC(500));
+	} else if (err && err != -EALREADY) {
+		memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+		sprintf(ble_uart_buffer,"Advertising failed to restart (err %d)\n", err);
+		nrf52_uart_tx(ble_uart_buffer);
+	}
 }
 
+static K_WORK_DELAYABLE_DEFINE(adv_work, adv_restart);
 
 /*
  *@brief : bluetooth connection callback function
@@ -261,7 +401,19 @@ static void connected(struct bt_conn *conn, uint8_t err)
 	struct bt_conn_info info; 
 	char addr[BT_ADDR_LE_STR_LEN];
 
-	my_connection = conn;
+	if (err) {
+		return;
+	}
+
+	//serve this central from the shared frame ring
+	if (fanout_add(conn) < 0) {
+		nrf52_uart_tx("no fan-out slot for this central\n");
+	}
+
+	//keep advertising while there is room for another central
+	if (fanout_count() < CONFIG_BT_MAX_CONN) {
+		k_work_reschedule(&adv_work, K_NO_WAIT);
+	}
 
 	if(bt_conn_get_info(conn, &info)!=0)
 	{
@@ -300,6 +452,21 @@ static void connected(struct bt_conn *conn, uint8_t err)
 */
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
+	fanout_remove(conn);
+	if (fanout_count() == 0) {
+		notify_client = 0;
+	}
+	if (conn == log_conn) {
+		frame_log_stop_offload();
+		ble_tx_reset();
+		bt_conn_unref(log_conn);
+		log_conn = NULL;
+		//hand the rest of the backlog to another subscriber, if any
+		start_offload(conn);
+	}
+
+	k_work_reschedule(&adv_work, K_NO_WAIT);
+
 	memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
 	sprintf(ble_uart_buffer,"Disconnected (reason %u)\n", reason);
 	nrf52_uart_tx(ble_uart_buffer);
@@ -330,6 +497,16 @@ static void bt_ready(int err)
 	//Configure connection callbacks
 	bt_conn_cb_register(&conn_callbacks);
 
+	//live stream to every subscribed central
+	fanout_init(&my_service.attrs[2]);
+
+	//L2CAP channel the phone can open for bulk transfer
+	err = l2cap_stream_init();
+	if (err)
+	{
+		nrf52_uart_tx("L2CAP stream server not registered\n");
+	}
+
 	//Start advertising
 	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
 			      sd, ARRAY_SIZE(sd));
@@ -347,6 +524,103 @@ static void bt_ready(int err)
 }
 
 
+/*
+ *@brief : print flash recorder and offload figures over uart
+ *@param : None
+ *@retval : None
+ *@note : write amplification = bytes programmed / stream bytes recorded,
+        including FCB length, CRC, sector headers and alignment padding.
+        Lifetime assumes the current recording rate and even wear over
+        the partition (the log is circular).
+*/
+static void frame_log_report(void)
+{
+        struct frame_log_stats st;
+
+        frame_log_get_stats(&st);
+        if (st.offload_too_small)
+        {
+                memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+                sprintf(ble_uart_buffer,"offload: stopped %u times, frame larger than the MTU\n",
+                        st.offload_too_small);
+                nrf52_uart_tx(ble_uart_buffer);
+        }
+        if (st.offload_us == 0 || st.bytes_in == 0)
+        {
+                return;
+        }
+
+        uint32_t kbps = (uint32_t)((uint64_t)st.offload_bytes * 1000 / st.offload_us);
+        uint32_t wa_x100 = (uint32_t)((uint64_t)st.flash_written * 100 / st.bytes_in);
+        uint32_t packed_pct = (uint32_t)((uint64_t)st.bytes_stored * 100 / st.bytes_in);
+        uint32_t uptime_s = (uint32_t)(k_uptime_get() / 1000);
+        uint64_t life_budget = (uint64_t)st.sector_count * FRAME_LOG_FLASH_ENDURANCE;
+        uint32_t life_days = st.erases ?
+                (uint32_t)(life_budget * uptime_s / st.erases / 86400) : 0;
+
+        memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+        sprintf(ble_uart_buffer,"offload: %u frames %u B (%u B over L2CAP) in %u ms, %u.%03u MB/s\n",
+                st.offload_frames, st.offload_bytes, st.offload_l2cap_bytes,
+                st.offload_us / 1000, kbps / 1000, kbps % 1000);
+        nrf52_uart_tx(ble_uart_buffer);
+
+        memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+        sprintf(ble_uart_buffer,"flash: in %u B stored %u B (%u%%) written %u B WA %u.%02u\n",
+                st.bytes_in, st.bytes_stored, packed_pct, st.flash_written,
+                wa_x100 / 100, wa_x100 % 100);
+        nrf52_uart_tx(ble_uart_buffer);
+
+        memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+        sprintf(ble_uart_buffer,"wear: %u erases over %u x %u B sectors, %u overwritten, %u dropped, ~%u days left\n",
+                st.erases, st.sector_count, st.sector_size, st.overwritten,
+                st.queue_drops, life_days);
+        nrf52_uart_tx(ble_uart_buffer);
+}
+
+
+/*
+ *@brief : print per-central fan-out figures over uart
+ *@param : None
+ *@retval : None
+ *@note : the rate is the payload each central completed since the last
+        report (or since it connected); skipped counts packets it lost
+        to being lapped by the ring
+*/
+static void fanout_report(void)
+{
+        static uint32_t last_bytes[FANOUT_MAX_CONN];
+        static uint32_t last_ms[FANOUT_MAX_CONN];
+        uint32_t now = k_uptime_get_32();
+
+        for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++)
+        {
+                struct fanout_conn_stats st;
+
+                fanout_get_stats(i, &st);
+                if (!st.active)
+                {
+                        continue;
+                }
+                if (last_ms[i] < st.connected_ms)
+                {
+                        last_ms[i] = st.connected_ms;
+                        last_bytes[i] = 0;
+                }
+
+                uint32_t bps = (uint32_t)((uint64_t)(st.bytes - last_bytes[i]) * 1000 /
+                                          MAX(1u, now - last_ms[i]));
+
+                memset(ble_uart_buffer,0,sizeof(ble_uart_buffer));
+                sprintf(ble_uart_buffer,"central %u: %u B/s, %u sent, %u skipped, lag %u (max %u), %u retries\n",
+                        i, bps, st.sent, st.skipped, st.lag, st.max_lag, st.retries);
+                nrf52_uart_tx(ble_uart_buffer);
+
+                last_bytes[i] = st.bytes;
+                last_ms[i] = now;
+        }
+}
+
+
 /*
  *@brief : main function
  *@param : execution status
@@ -366,7 +640,7 @@ int main(void)
 
         /* Configure ADC channel (adjust gain/reference/channel_id as required for your hardware) */
         struct adc_channel_cfg ch_cfg = {
-                .gain = ADC_GAIN_1_6,
+                .gain = ADC_GAIN,
                 .reference = ADC_REF_INTERNAL,
                 .acquisition_time = ADC_ACQ_TIME(ADC_ACQ_TIME_MICROSECONDS, 10),
                 .channel_id = ADC_CHANNEL_ID,
@@ -390,6 +664,13 @@ int main(void)
         *************************Bluetooth Section****************************
         *********************************************************************/
         
+        //Flash recorder for frames sampled while disconnected
+        err = frame_log_init();
+        if (err)
+        {
+                nrf52_uart_tx("frame log init failed, recording disabled\n");
+        }
+
         //Enable Bluetooth
         err = bt_enable(bt_ready);
         if (err) 
@@ -430,8 +711,22 @@ int main(void)
 
         nrf52_uart_tx("EMG sampling + BLE service started\n");
 
+        bool offloading = false;
+        uint32_t ticks = 0;
+
         while (1) {
                 k_sleep(K_SECONDS(1));
+
+                if (++ticks % 10 == 0) {
+                        fanout_report();
+                }
+
+                //report once each backlog offload has finished
+                bool active = frame_log_offload_active();
+                if (offloading && !active) {
+                        frame_log_report();
+                }
+                offloading = active;
         }
 
         return 0;
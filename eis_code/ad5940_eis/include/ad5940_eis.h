@@ -159,6 +159,93 @@ int eis_calibrate_rcal(const eis_config_t *cfg);
  */
 int eis_run_sweep(const eis_config_t *cfg, eis_result_t *result);
 
+/**
+ * @brief Per-point callback invoked by eis_run_sweep().
+ *
+ * Called from the sweep thread as soon as each frequency point has been
+ * computed, before the next frequency is measured. Keep it short – the
+ * AFE is idle while the callback runs.
+ *
+ * @param index      Index of the point within the sweep (0-based).
+ * @param point      The freshly computed impedance point.
+ * @param user_data  Opaque pointer passed to eis_set_point_callback().
+ */
+typedef void (*eis_point_cb_t)(uint16_t index, const eis_point_t *point,
+                               void *user_data);
+
+/**
+ * @brief Register a callback that receives each sweep point as it completes.
+ *
+ * @param cb         Callback, or NULL to disable.
+ * @param user_data  Passed through to the callback unchanged.
+ */
+void eis_set_point_callback(eis_point_cb_t cb, void *user_data);
+
+/* ---------- Tracking Mode ------------------------------------------- */
+
+/* Maximum number of frequencies in a tracking run. */
+#define EIS_TRACK_MAX_FREQS  4
+
+/**
+ * @brief Tracking configuration: the frequencies to hold the excitation at.
+ *
+ * With one frequency the DFT runs back to back and every result is a
+ * sample. With several, the frequencies are visited round-robin and each
+ * switch costs one extra (discarded) DFT for settling.
+ */
+typedef struct {
+    float   freqs_hz[EIS_TRACK_MAX_FREQS];
+    uint8_t num_freqs;          /**< 1 … EIS_TRACK_MAX_FREQS */
+} eis_track_config_t;
+
+/**
+ * @brief One timestamped tracking sample.
+ */
+typedef struct {
+    int64_t     timestamp_us;   /**< Uptime at the centre of the DFT window */
+    uint32_t    seq;            /**< Sample counter since eis_track_start() */
+    uint8_t     freq_index;     /**< Index into eis_track_config_t.freqs_hz */
+    eis_point_t point;          /**< Impedance at that frequency */
+} eis_track_sample_t;
+
+/**
+ * @brief Duration of one DFT block at the given frequency.
+ *
+ * DFT length (4 << dft_num) divided by the DFT input rate, which is
+ * 160 kHz in low-power mode and 400 kHz above 80 kHz (high-power mode).
+ * This is the minimum time between single-frequency tracking samples.
+ */
+uint32_t eis_dft_duration_us(const eis_config_t *cfg, float freq_hz);
+
+/**
+ * @brief Start continuous impedance tracking.
+ *
+ * Measures RCAL at every tracked frequency, then switches to the sensor
+ * path. eis_init() must have been called first. Calling it again
+ * restarts tracking with a fresh RCAL (use this to correct drift).
+ *
+ * @param cfg    EIS configuration (excitation, RTIA, DFT length, switches).
+ * @param track  Frequencies to track.
+ * @return 0 on success, -EINVAL for a bad frequency list, negative errno
+ *         on hardware failure.
+ */
+int eis_track_start(const eis_config_t *cfg, const eis_track_config_t *track);
+
+/**
+ * @brief Block until the next tracking sample is available.
+ *
+ * @param sample  Output sample.
+ * @return 0 on success, -ERANGE if the sensor DFT was too small (sample
+ *         is filled with zeros but still timestamped), -EINVAL if
+ *         tracking is not running, negative errno on hardware failure.
+ */
+int eis_track_next(eis_track_sample_t *sample);
+
+/**
+ * @brief Stop tracking. The AFE stays powered for subsequent sweeps.
+ */
+void eis_track_stop(void);
+
 /**
  * @brief Print the sweep results to the console (Nyquist-friendly format).
  *
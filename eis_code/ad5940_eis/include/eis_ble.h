@@ -0,0 +1,89 @@
+/**
+ * @file eis_ble.h
+ * @brief BLE GATT service that streams EIS data while a sweep is running.
+ *
+ * Each frequency point is notified as a compact binary record the moment
+ * eis_run_sweep() computes it, followed by a single summary record that
+ * carries the Randles fit. Both records fit in the 20-byte payload of the
+ * default 23-byte ATT MTU, so no MTU exchange is required.
+ *
+ * All multi-byte fields are little-endian, floats are IEEE-754 binary32.
+ *
+ * Point record (16 bytes):
+ *   [0]     type      = EIS_BLE_REC_POINT
+ *   [1]     sweep_id  – increments per sweep, wraps at 255
+ *   [2..3]  index     – point index within the sweep
+ *   [4..7]  freq_hz
+ *   [8..11] real_ohms
+ *   [12..15] imag_ohms
+ *
+ * Summary record (20 bytes):
+ *   [0]     type      = EIS_BLE_REC_SUMMARY
+ *   [1]     sweep_id
+ *   [2..3]  count     – points of this sweep notified successfully
+ *   [4..7]  rs_ohms   – NaN if the fit failed
+ *   [8..11] rct_ohms  – NaN if the fit failed
+ *   [12..15] cdl_farads – NaN if the fit failed
+ *   [16..19] f_peak_hz – NaN if the fit failed
+ *
+ * |Z| and phase are not sent; the receiver derives them from real/imag.
+ *
+ * Tracking record (16 bytes), one per eis_track_next() sample:
+ *   [0]     type      = EIS_BLE_REC_TRACK
+ *   [1]     freq_index
+ *   [2..3]  seq       – low 16 bits of the sample counter
+ *   [4..7]  timestamp_ms – uptime at the centre of the DFT window
+ *   [8..11] mag_ohms
+ *   [12..15] phase_deg
+ */
+#ifndef EIS_BLE_H
+#define EIS_BLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ad5940_eis.h"
+
+/* Record type tags (first byte of every notification) */
+#define EIS_BLE_REC_POINT    0x01
+#define EIS_BLE_REC_SUMMARY  0x02
+#define EIS_BLE_REC_TRACK    0x03
+
+/**
+ * @brief Enable Bluetooth and start advertising the EIS service.
+ * @return 0 on success, negative errno on failure.
+ */
+int eis_ble_init(void);
+
+/**
+ * @brief @return true if a central has enabled notifications.
+ */
+bool eis_ble_is_subscribed(void);
+
+/**
+ * @brief Start a new sweep: bumps the sweep ID and resets the point count.
+ */
+void eis_ble_sweep_begin(void);
+
+/**
+ * @brief Point callback suitable for eis_set_point_callback().
+ *
+ * Notifies a point record; silently does nothing when no central is
+ * subscribed.
+ */
+void eis_ble_send_point(uint16_t index, const eis_point_t *point,
+                        void *user_data);
+
+/**
+ * @brief Notify the end-of-sweep summary record.
+ *
+ * @param randles  Fit result, or NULL if the fit failed.
+ */
+void eis_ble_send_summary(const eis_randles_t *randles);
+
+/**
+ * @brief Notify one tracking sample. No-op when no central is subscribed.
+ */
+void eis_ble_send_track(const eis_track_sample_t *sample);
+
+#endif /* EIS_BLE_H */
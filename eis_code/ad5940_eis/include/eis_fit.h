@@ -0,0 +1,107 @@
+/**
+ * @file eis_fit.h
+ * @brief Levenberg–Marquardt equivalent-circuit fitting for EIS sweeps.
+ *
+ * Fits one of three circuit models to the complex impedance of a sweep:
+ *
+ *   EIS_MODEL_RANDLES      Rs + (Rct || Cdl)
+ *                          p = { Rs, Rct, Cdl }
+ *   EIS_MODEL_RANDLES_CPE  Rs + (Rct || CPE),  Z_cpe = 1 / (Q (jω)^n)
+ *                          p = { Rs, Rct, Q, n }
+ *   EIS_MODEL_RANDLES_W    Rs + ((Rct + Zw) || Cdl),  Zw = σ (1 − j) / √ω
+ *                          p = { Rs, Rct, Cdl, σ }
+ *
+ * Residuals are modulus-weighted ((Z_model − Z_meas) / |Z_meas|) so every
+ * decade counts equally. Parameters are fitted in log space (n through a
+ * logistic map onto 0…1), which keeps them positive without explicit
+ * bounds. The Jacobian is a forward difference accumulated straight into
+ * JᵀJ, so memory use is independent of the number of points.
+ *
+ * Pure C99 + libm, single precision, no Zephyr dependencies – the same
+ * file builds for the nRF52840 and on the host (see eis_fit_bench).
+ */
+#ifndef EIS_FIT_H
+#define EIS_FIT_H
+
+#include <stdint.h>
+
+#include "ad5940_eis.h"
+
+/* Largest parameter vector of any model. */
+#define EIS_FIT_MAX_PARAMS  4
+
+/* Default iteration cap (each iteration = one JᵀJ build + ≥1 solve). */
+#define EIS_FIT_DEFAULT_MAX_ITER  50
+
+typedef enum {
+    EIS_MODEL_RANDLES = 0,
+    EIS_MODEL_RANDLES_CPE,
+    EIS_MODEL_RANDLES_W,
+    EIS_MODEL_COUNT
+} eis_model_t;
+
+/**
+ * @brief Fitter options. Zero-initialise for defaults.
+ */
+typedef struct {
+    uint16_t max_iter;   /**< 0 → EIS_FIT_DEFAULT_MAX_ITER */
+    float    rel_tol;    /**< Stop when cost improves by less than this
+                          *   fraction; 0 → 1e-6 */
+} eis_fit_opts_t;
+
+/**
+ * @brief Fit result.
+ */
+typedef struct {
+    eis_model_t model;
+    uint8_t     num_params;
+    float       p[EIS_FIT_MAX_PARAMS];  /**< Fitted parameters (SI units) */
+    float       rms_rel_err;  /**< RMS of |Z_model − Z_meas| / |Z_meas| */
+    uint16_t    iterations;   /**< Accepted + rejected LM steps */
+    uint16_t    evaluations;  /**< Model evaluations over all points / N */
+    uint8_t     converged;    /**< 1 if rel_tol was met before max_iter */
+} eis_fit_result_t;
+
+/**
+ * @brief Number of parameters of a model.
+ */
+uint8_t eis_model_num_params(eis_model_t model);
+
+/**
+ * @brief Short human-readable model name ("Randles", "Randles+CPE", …).
+ */
+const char *eis_model_name(eis_model_t model);
+
+/**
+ * @brief Evaluate a model at one frequency.
+ *
+ * @param model    Circuit model.
+ * @param p        Parameter vector (layout as in the file header).
+ * @param freq_hz  Frequency.
+ * @param re, im   Output impedance (Ω).
+ */
+void eis_model_impedance(eis_model_t model, const float *p, float freq_hz,
+                         float *re, float *im);
+
+/**
+ * @brief Fit a circuit model to a sweep.
+ *
+ * @param data   Sweep to fit (points with |Z| < 1 Ω are skipped).
+ * @param model  Circuit model.
+ * @param p0     Initial guess holding eis_model_num_params(model)
+ *               values, or NULL to derive one from the data (Rs from
+ *               the highest frequency, Rct from the lowest, Cdl from the
+ *               −Zimag peak). The circle fit from eis_fit_randles()
+ *               makes a good guess: { rs_ohms, rct_ohms, cdl_farads },
+ *               with n ≈ 0.9 or a small σ appended for 4-parameter
+ *               models.
+ * @param opts   Options, or NULL for defaults.
+ * @param out    Fit result.
+ * @return 0 on success, -1 if there are too few valid points or the
+ *         initial guess is not finite.
+ */
+int eis_fit_model(const eis_result_t *data, eis_model_t model,
+                  const float *p0, const eis_fit_opts_t *opts,
+                  eis_fit_result_t *out);
+
+#endif /* EIS_FIT_H */
@@ -47,6 +47,24 @@ static bool  rcal_valid = false;
 /* Cached config for reconfiguring per-frequency */
 static bool high_power_mode = false;
 
+/* Amplitude last written to the waveform generator (-1 = unknown) */
+static int32_t wg_amplitude = -1;
+
+/* Optional per-point consumer (e.g. BLE streaming) */
+static eis_point_cb_t point_cb;
+static void          *point_cb_user_data;
+
+/* Tracking-mode state (see eis_track_start) */
+static struct {
+    bool               active;
+    eis_config_t       cfg;
+    eis_track_config_t track;
+    float              rcal_r[EIS_TRACK_MAX_FREQS];
+    float              rcal_i[EIS_TRACK_MAX_FREQS];
+    uint8_t            cur;     /* index of the frequency being excited */
+    uint32_t           seq;
+} trk;
+
 /* ====================================================================
  * Helper: sign-extend 18-bit DFT result to int32_t
  * ==================================================================== */
@@ -82,6 +100,22 @@ static bool needs_high_power(float freq_hz)
     return freq_hz > 80000.0f;
 }
 
+/* ====================================================================
+ * Helper: choose a DFT-result polling interval.
+ *
+ * Roughly 1/16 of the DFT duration so completion is seen promptly,
+ * capped at 1 ms for long DFTs and floored at 20 µs (a register read
+ * alone takes about that long on the SPI bus).
+ * ==================================================================== */
+static uint32_t dft_poll_interval_us(const eis_config_t *cfg, float freq_hz)
+{
+    uint32_t poll = eis_dft_duration_us(cfg, freq_hz) / 16u;
+
+    if (poll > 1000u) poll = 1000u;
+    if (poll < 20u)   poll = 20u;
+    return poll;
+}
+
 /* ====================================================================
  * Helper: configure the switch matrix using xSWFULLCON registers.
  *
@@ -110,19 +144,21 @@ static int set_switch_matrix(const eis_switch_cfg_t *sw)
     int ret;
 
     /* Write each full switch control register */
-    ret = ad5940_write_reg(REG_DSWFULLCON, sw->d_mux);
+    ret = ad5940_batch_write(REG_DSWFULLCON, sw->d_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_PSWFULLCON, sw->p_mux);
+    ret = ad5940_batch_write(REG_PSWFULLCON, sw->p_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_NSWFULLCON, sw->n_mux);
+    ret = ad5940_batch_write(REG_NSWFULLCON, sw->n_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_TSWFULLCON, sw->t_mux);
+    ret = ad5940_batch_write(REG_TSWFULLCON, sw->t_mux);
     if (ret) return ret;
 
     /* Set SWSOURCESEL bit to activate full control registers */
-    ret = ad5940_write_reg(REG_SWCON, SWCON_SWSOURCESEL);
+    ret = ad5940_batch_write(REG_SWCON, SWCON_SWSOURCESEL);
+    if (ret) return ret;
 
-    return ret;
+    /* Callers settle right after this, so the switches must be applied */
+    return ad5940_batch_flush();
 }
 
 /* ====================================================================
@@ -141,11 +177,11 @@ static int configure_lp_dac(float bias_v)
 
     /* Power on the LP DAC, enable writes, use 2.5 V LP reference */
     uint32_t lpdaccon0 = LPDACCON0_RSTEN;  /* bit 0 = enable writes, bit 1 = 0 (powered on) */
-    ret = ad5940_write_reg(REG_LPDACCON0, lpdaccon0);
+    ret = ad5940_batch_write(REG_LPDACCON0, lpdaccon0);
     if (ret) return ret;
 
     /* Enable LP reference buffer */
-    ret = ad5940_write_reg(REG_LPREFBUFCON, 0x00000000);
+    ret = ad5940_batch_write(REG_LPREFBUFCON, 0x00000000);
     if (ret) return ret;
 
     /*
@@ -179,7 +215,7 @@ static int configure_lp_dac(float bias_v)
     }
 
     uint32_t lpdacdat0 = (code_6 << 12) | code_12;
-    ret = ad5940_write_reg(REG_LPDACDAT0, lpdacdat0);
+    ret = ad5940_batch_write(REG_LPDACDAT0, lpdacdat0);
     if (ret) return ret;
 
     /*
@@ -189,7 +225,7 @@ static int configure_lp_dac(float bias_v)
      *   LPMODEDIS = 1: Individual switch control
      */
     uint32_t lpdacsw0 = LPDACSW0_LPMODEDIS | LPDACSW0_SW0 | LPDACSW0_SW3;
-    ret = ad5940_write_reg(REG_LPDACSW0, lpdacsw0);
+    ret = ad5940_batch_write(REG_LPDACSW0, lpdacsw0);
 
     LOG_INF("LP DAC: VZERO0=%.3fV (code6=%u), VBIAS0=%.3fV (code12=%u), bias=%.3fV",
             (double)vzero_v, code_6, (double)vbias_v, code_12, (double)bias_v);
@@ -210,7 +246,7 @@ static int configure_adc(const eis_config_t *cfg)
     adccon |= ((uint32_t)(ADCMUXN_HSTIA_N & 0x1F) << ADCCON_MUXSELN_SHIFT);
     adccon |= ((uint32_t)(cfg->pga_gain & 0x7) << ADCCON_GNPGA_SHIFT);
 
-    ret = ad5940_write_reg(REG_ADCCON, adccon);
+    ret = ad5940_batch_write(REG_ADCCON, adccon);
     if (ret) return ret;
 
     /*
@@ -235,7 +271,7 @@ static int configure_adc(const eis_config_t *cfg)
     /* Bypass the 50/60 Hz notch filter for impedance measurements */
     adcfilter |= ADCFILTERCON_LPFBYPEN;
 
-    ret = ad5940_write_reg(REG_ADCFILTERCON, adcfilter);
+    ret = ad5940_batch_write(REG_ADCFILTERCON, adcfilter);
     return ret;
 }
 
@@ -247,7 +283,7 @@ static int configure_hstia(const eis_config_t *cfg)
     int ret;
 
     /* HSTIA positive input = VZERO0 from LP DAC */
-    ret = ad5940_write_reg(REG_HSTIACON,
+    ret = ad5940_batch_write(REG_HSTIACON,
                            (HSTIA_VZERO0 << HSTIACON_VBIASSEL_SHIFT));
     if (ret) return ret;
 
@@ -267,7 +303,7 @@ static int configure_hstia(const eis_config_t *cfg)
 
     uint32_t hsrtiacon = (ctiacon << HSRTIACON_CTIACON_SHIFT) |
                          (rtia & HSRTIACON_RTIACON_MASK);
-    ret = ad5940_write_reg(REG_HSRTIACON, hsrtiacon);
+    ret = ad5940_batch_write(REG_HSRTIACON, hsrtiacon);
 
     LOG_INF("HSTIA RTIA = %u Ω, CTIA = 0x%02X", hsrtia_ohms[rtia], ctiacon);
     return ret;
@@ -288,7 +324,7 @@ static int configure_dft(const eis_config_t *cfg)
     dftcon |= ((uint32_t)(cfg->dft_num & 0xF) << DFTCON_DFTNUM_SHIFT);
     dftcon |= ((uint32_t)DFTINSEL_SINC3 << DFTCON_DFTINSEL_SHIFT);
 
-    return ad5940_write_reg(REG_DFTCON, dftcon);
+    return ad5940_batch_write(REG_DFTCON, dftcon);
 }
 
 /* ====================================================================
@@ -300,23 +336,29 @@ static int set_excitation_freq(float freq_hz, uint16_t amplitude)
 
     /* Set sine FCW */
     uint32_t fcw = freq_to_fcw(freq_hz);
-    ret = ad5940_write_reg(REG_WGFCW, fcw);
+    ret = ad5940_batch_write(REG_WGFCW, fcw);
     if (ret) return ret;
 
+    /* Amplitude, offset, phase and type only change with the amplitude */
+    if (wg_amplitude == (int32_t)amplitude) {
+        return 0;
+    }
+    wg_amplitude = (int32_t)amplitude;
+
     /* Set amplitude (11-bit unsigned) */
-    ret = ad5940_write_reg(REG_WGAMPLITUDE, (uint32_t)(amplitude & 0x7FF));
+    ret = ad5940_batch_write(REG_WGAMPLITUDE, (uint32_t)(amplitude & 0x7FF));
     if (ret) return ret;
 
     /* Offset = 0 (no DC offset on excitation) */
-    ret = ad5940_write_reg(REG_WGOFFSET, 0);
+    ret = ad5940_batch_write(REG_WGOFFSET, 0);
     if (ret) return ret;
 
     /* Phase = 0 */
-    ret = ad5940_write_reg(REG_WGPHASE, 0);
+    ret = ad5940_batch_write(REG_WGPHASE, 0);
     if (ret) return ret;
 
     /* Waveform type = Sinusoid, enable DAC offset+gain cal */
-    ret = ad5940_write_reg(REG_WGCON,
+    ret = ad5940_batch_write(REG_WGCON,
                            WGCON_TYPE_SINE |
                            WGCON_DACGAINCAL |
                            WGCON_DACOFFSETCAL);
@@ -341,7 +383,7 @@ static int configure_hsdac(void)
     uint32_t hsdaccon = (rate << HSDACCON_RATE_SHIFT);
     /* Gain = 2 (INAMPGNMDE = 0), no attenuation (ATTENEN = 0) */
 
-    return ad5940_write_reg(REG_HSDACCON, hsdaccon);
+    return ad5940_batch_write(REG_HSDACCON, hsdaccon);
 }
 
 /* ====================================================================
@@ -358,7 +400,7 @@ static int configure_power_mode(bool hp)
         pmbw = 0;
     }
     high_power_mode = hp;
-    return ad5940_write_reg(REG_PMBW, pmbw);
+    return ad5940_batch_write(REG_PMBW, pmbw);
 }
 
 /* ====================================================================
@@ -396,64 +438,93 @@ static int power_up_afe(void)
                       AFECON_ADCEN      |
                       AFECON_DACEN;
 
-    return ad5940_write_reg(REG_AFECON, afecon);
+    return ad5940_batch_write(REG_AFECON, afecon);
 }
 
 /* ====================================================================
- * Helper: read a single DFT measurement.
+ * Helper: DFT results via the data FIFO.
+ *
+ * With the FIFO source set to DFT, every completed DFT pushes two words
+ * (real, then imaginary, 18-bit signed in bits [17:0]) into the data
+ * FIFO. Polling FIFOCNTSTA costs one SPI frame once its address is
+ * selected, and several results come out in a single READFIFO burst.
+ * This replaces the INTCFLAG0 poll + DFTREAL + DFTIMAG + INTCCLR
+ * sequence, which needed eight frames per result plus two per poll.
  *
- * Polls the INTCFLAG0 register for the DFT-result bit.
- * Assumes interrupt flags have already been cleared and the
- * measurement has already been started before calling this.
+ * Poll intervals below 1 ms busy-wait instead of sleeping so short
+ * DFTs are not limited by the 1 ms kernel tick.
  * ==================================================================== */
-static int read_dft_result(float *dft_real, float *dft_imag)
+#define DFT_TIMEOUT_US       5000000u
+#define DFT_FIFO_WORDS       512u    /* 2 kB data FIFO */
+
+static int configure_fifo(void)
 {
+    uint32_t cmddatacon;
     int ret;
-    uint32_t flags;
-    int timeout_ms = 5000;
-    int elapsed = 0;
-
-    /* Poll INTCFLAG0 for DFT result bit */
-    while (elapsed < timeout_ms) {
-        ret = ad5940_read_reg(REG_INTCFLAG0, &flags);
-        if (ret) return ret;
 
-        if (flags & INTC_DFTRESULT) {
-            break;
-        }
-        k_msleep(1);
-        elapsed++;
-    }
+    /* Use the data SRAM as a 2 kB FIFO */
+    ret = ad5940_read_reg(REG_CMDDATACON, &cmddatacon);
+    if (ret) return ret;
+    cmddatacon &= ~(CMDDATACON_DATAMEMMDE_MASK | CMDDATACON_DATA_MEM_SEL_MASK);
+    cmddatacon |= (DATAMEMMDE_FIFO << CMDDATACON_DATAMEMMDE_SHIFT) |
+                  (DATAFIFOSIZE_2KB << CMDDATACON_DATA_MEM_SEL_SHIFT);
+    ret = ad5940_batch_write(REG_CMDDATACON, cmddatacon);
+    if (ret) return ret;
 
-    if (elapsed >= timeout_ms) {
-        LOG_ERR("DFT timeout (%d ms)", elapsed);
-        return -ETIMEDOUT;
-    }
+    return ad5940_batch_write(REG_FIFOCON, FIFOCON_DATAFIFOEN | FIFOCON_SRC_DFT);
+}
 
-    /* Read DFT results */
-    uint32_t raw_real, raw_imag;
-    ret = ad5940_read_reg(REG_DFTREAL, &raw_real);
-    if (ret) return ret;
-    ret = ad5940_read_reg(REG_DFTIMAG, &raw_imag);
+/*
+ * Empty the FIFO. The next result is from the DFT block in progress.
+ * Written directly (not batched) – the same register twice in a row.
+ */
+static int fifo_restart(void)
+{
+    int ret = ad5940_write_reg(REG_FIFOCON, FIFOCON_SRC_DFT);
     if (ret) return ret;
+    return ad5940_write_reg(REG_FIFOCON, FIFOCON_DATAFIFOEN | FIFOCON_SRC_DFT);
+}
 
-    /* Sign-extend 18-bit results */
-    *dft_real = (float)sign_extend_18(raw_real & 0x3FFFF);
-    *dft_imag = (float)sign_extend_18(raw_imag & 0x3FFFF);
+/* Poll FIFOCNTSTA until at least @want words are queued */
+static int wait_fifo_words(uint32_t want, uint32_t poll_us, uint32_t *avail)
+{
+    uint32_t elapsed_us = 0;
 
-    /* Clear the interrupt */
-    ad5940_write_reg(REG_INTCCLR, INTC_DFTRESULT);
+    if (poll_us == 0) poll_us = 1;
 
-    return 0;
+    while (elapsed_us < DFT_TIMEOUT_US) {
+        uint32_t sta;
+        int ret = ad5940_read_reg(REG_FIFOCNTSTA, &sta);
+        if (ret) return ret;
+
+        *avail = (sta & FIFOCNTSTA_CNT_MASK) >> FIFOCNTSTA_CNT_SHIFT;
+        if (*avail >= want) {
+            return 0;
+        }
+        if (poll_us >= 1000u) {
+            k_usleep(poll_us);
+        } else {
+            k_busy_wait(poll_us);
+        }
+        elapsed_us += poll_us;
+    }
+
+    LOG_ERR("DFT timeout (%u ms)", elapsed_us / 1000u);
+    return -ETIMEDOUT;
+}
+
+static inline float dft_word(uint32_t w)
+{
+    return (float)sign_extend_18(w & 0x3FFFF);
 }
 
 /* ====================================================================
  * Helper: perform one impedance measurement at a single frequency
  * with the currently configured switch matrix.
  *
- * Strategy: Leave the DFT running continuously. After changing
- * frequency, wait for TWO DFT completions — the first flushes
- * samples from the old frequency, the second is clean data.
+ * Strategy: Leave the DFT running continuously into the data FIFO.
+ * After changing frequency, wait for TWO DFT results — the first
+ * flushes samples from the old frequency, the second is clean data.
  * ==================================================================== */
 static int measure_one_freq(float freq_hz, const eis_config_t *cfg,
                             float *dft_r, float *dft_i)
@@ -473,28 +544,88 @@ static int measure_one_freq(float freq_hz, const eis_config_t *cfg,
         /* Re-enable full AFE after power mode change */
         ret = power_up_afe();
         if (ret) return ret;
+        ret = ad5940_batch_flush();
+        if (ret) return ret;
         k_msleep(5);
     }
 
     /* Set new excitation frequency */
     ret = set_excitation_freq(freq_hz, cfg->excit_amplitude);
     if (ret) return ret;
-
-    /* Wait 1: Flush DFT that contains old-frequency samples */
-    ret = ad5940_write_reg(REG_INTCCLR, 0xFFFFFFFF);
-    if (ret) return ret;
-    ret = ad5940_write_reg(REG_INTCSEL0, INTC_DFTRESULT);
+    ret = ad5940_batch_flush();
     if (ret) return ret;
 
-    ret = read_dft_result(dft_r, dft_i);  /* Discard this result */
+    /*
+     * Restart the FIFO and wait for TWO results: the first DFT block
+     * straddles the frequency change and is discarded, the second holds
+     * clean samples at the new frequency. At least one full block must
+     * elapse, so sleep through it before polling.
+     */
+    ret = fifo_restart();
     if (ret) return ret;
 
-    /* Wait 2: This DFT contains clean samples at the new frequency */
-    ret = ad5940_write_reg(REG_INTCCLR, INTC_DFTRESULT);
+    uint32_t block_us = eis_dft_duration_us(cfg, freq_hz);
+    if (block_us >= 2000u) {
+        k_usleep(block_us);
+    }
+
+    uint32_t avail;
+    uint32_t words[4];
+    ret = wait_fifo_words(4, dft_poll_interval_us(cfg, freq_hz), &avail);
+    if (ret) return ret;
+    ret = ad5940_read_fifo(words, 4);
     if (ret) return ret;
 
-    ret = read_dft_result(dft_r, dft_i);  /* Keep this result */
-    return ret;
+    *dft_r = dft_word(words[2]);
+    *dft_i = dft_word(words[3]);
+    return 0;
+}
+
+/* ====================================================================
+ * Helper: convert an RCAL / sensor DFT pair into an impedance point.
+ *
+ * Polar form, matching the ADI library, which uses atan2(-Imag, Real)
+ * (note the negated imaginary part):
+ *
+ *   Z_mag   = |DFT_rcal| / |DFT_sensor| * RCAL_ohms
+ *   Z_phase = phase_rcal - phase_sensor
+ *
+ * Returns -ERANGE (and a zeroed point) if the sensor DFT is too small
+ * to be meaningful.
+ * ==================================================================== */
+static int compute_impedance(float freq_hz, float rcal_r, float rcal_i,
+                             float sens_r, float sens_i, float rcal_ohms,
+                             eis_point_t *pt)
+{
+    float rcal_mag = sqrtf(rcal_r * rcal_r + rcal_i * rcal_i);
+    float sens_mag = sqrtf(sens_r * sens_r + sens_i * sens_i);
+
+    pt->freq_hz = freq_hz;
+
+    if (sens_mag < 1.0f) {
+        pt->real_ohms = 0;
+        pt->imag_ohms = 0;
+        pt->mag_ohms  = 0;
+        pt->phase_deg = 0;
+        return -ERANGE;
+    }
+
+    float rcal_phase = atan2f(-rcal_i, rcal_r);
+    float sens_phase = atan2f(-sens_i, sens_r);
+
+    float z_mag   = (rcal_mag / sens_mag) * rcal_ohms;
+    float z_phase = rcal_phase - sens_phase;
+
+    /* Wrap phase to [-pi, pi] */
+    while (z_phase > (float)M_PI)  z_phase -= 2.0f * (float)M_PI;
+    while (z_phase < -(float)M_PI) z_phase += 2.0f * (float)M_PI;
+
+    pt->real_ohms = z_mag * cosf(z_phase);
+    pt->imag_ohms = z_mag * sinf(z_phase);
+    pt->mag_ohms  = z_mag;
+    pt->phase_deg = z_phase * (180.0f / (float)M_PI);
+
+    return 0;
 }
 
 /* ====================================================================
@@ -525,6 +656,9 @@ int eis_init(const eis_config_t *cfg)
 
     LOG_INF("=== EIS Init ===");
 
+    /* Force a full waveform-generator write on the first point */
+    wg_amplitude = -1;
+
     /* Start in low-power mode; we'll switch to HP per-frequency as needed */
     ret = configure_power_mode(false);
     if (ret) return ret;
@@ -550,13 +684,21 @@ int eis_init(const eis_config_t *cfg)
     if (ret) return ret;
 
     /* Configure interrupt: positive edge on GP0 for active-low interrupt */
-    ret = ad5940_write_reg(REG_INTCPOL, 0x00000000);  /* Negative edge */
+    ret = ad5940_batch_write(REG_INTCPOL, 0x00000000);  /* Negative edge */
+    if (ret) return ret;
+
+    /* Route DFT results into the data FIFO */
+    ret = configure_fifo();
     if (ret) return ret;
 
     /* Power up the AFE */
     ret = power_up_afe();
     if (ret) return ret;
 
+    /* Everything above was queued – send it in one burst */
+    ret = ad5940_batch_flush();
+    if (ret) return ret;
+
     /* Allow blocks to settle */
     k_msleep(20);
 
@@ -642,55 +784,174 @@ int eis_run_sweep(const eis_config_t *cfg, eis_result_t *result)
             return ret;
         }
 
-        /*
-         * Step C: Compute impedance using polar form (matching ADI library).
-         * ADI library uses atan2(-Imag, Real) — note negated imaginary.
-         *
-         * Z_mag   = |DFT_rcal| / |DFT_sensor| * RCAL_ohms
-         * Z_phase = phase_rcal - phase_sensor
-         */
-        float rcal_mag = sqrtf(rcal_r * rcal_r + rcal_i * rcal_i);
-        float sens_mag = sqrtf(sens_r * sens_r + sens_i * sens_i);
+        /* ---- Step C: Compute impedance from the RCAL / sensor ratio ---- */
+        eis_point_t *pt = &result->points[i];
 
-        if (sens_mag < 1.0f) {
+        if (compute_impedance(freq, rcal_r, rcal_i, sens_r, sens_i,
+                              cfg->rcal_ohms, pt) != 0) {
             printk("[%2u] %.1f Hz: sensor DFT too small\n", i, (double)freq);
-            result->points[i].freq_hz   = freq;
-            result->points[i].real_ohms = 0;
-            result->points[i].imag_ohms = 0;
-            result->points[i].mag_ohms  = 0;
-            result->points[i].phase_deg = 0;
-            continue;
+        } else {
+            printk("[%2u] %8.1f Hz: |Z|=%.1f  ph=%.1f  (rcal=%.0f,%.0f sens=%.0f,%.0f)\n",
+                   i, (double)freq, (double)pt->mag_ohms, (double)pt->phase_deg,
+                   (double)rcal_r, (double)rcal_i, (double)sens_r, (double)sens_i);
         }
 
-        float rcal_phase = atan2f(-rcal_i, rcal_r);
-        float sens_phase = atan2f(-sens_i, sens_r);
+        if (point_cb) {
+            point_cb(i, &result->points[i], point_cb_user_data);
+        }
+    }
 
-        float z_mag   = (rcal_mag / sens_mag) * cfg->rcal_ohms;
-        float z_phase = rcal_phase - sens_phase;
+    printk("Sweep complete: %u points\n", npts);
+    return 0;
+}
 
-        /* Wrap phase to [-pi, pi] */
-        while (z_phase > (float)M_PI)  z_phase -= 2.0f * (float)M_PI;
-        while (z_phase < -(float)M_PI) z_phase += 2.0f * (float)M_PI;
+void eis_set_point_callback(eis_point_cb_t cb, void *user_data)
+{
+    point_cb = cb;
+    point_cb_user_data = user_data;
+}
 
-        float z_phase_deg = z_phase * (180.0f / (float)M_PI);
-        float z_real = z_mag * cosf(z_phase);
-        float z_imag = z_mag * sinf(z_phase);
+/* ====================================================================
+ * Tracking mode
+ *
+ * RCAL is measured once per tracked frequency when tracking starts and
+ * then reused for every sample. With a single frequency the excitation
+ * never changes, so every DFT block that the free-running engine
+ * produces is a valid sample – no flush DFT is needed and the output
+ * rate equals the DFT rate. With several frequencies each switch costs
+ * one flush DFT (see measure_one_freq), halving the per-sample rate.
+ * ==================================================================== */
 
-        result->points[i].freq_hz   = freq;
-        result->points[i].real_ohms = z_real;
-        result->points[i].imag_ohms = z_imag;
-        result->points[i].mag_ohms  = z_mag;
-        result->points[i].phase_deg = z_phase_deg;
+uint32_t eis_dft_duration_us(const eis_config_t *cfg, float freq_hz)
+{
+    /* DFT input rate: 160 kHz (low power) or 400 kHz (high power) */
+    uint32_t rate_hz = needs_high_power(freq_hz) ? 400000u : 160000u;
+    uint32_t n = 4u << (cfg->dft_num & 0xF);
 
-        printk("[%2u] %8.1f Hz: |Z|=%.1f  ph=%.1f  (rcal=%.0f,%.0f sens=%.0f,%.0f)\n",
-               i, (double)freq, (double)z_mag, (double)z_phase_deg,
-               (double)rcal_r, (double)rcal_i, (double)sens_r, (double)sens_i);
+    return (uint32_t)(((uint64_t)n * 1000000u) / rate_hz);
+}
+
+int eis_track_start(const eis_config_t *cfg, const eis_track_config_t *track)
+{
+    int ret;
+
+    if (track->num_freqs == 0 || track->num_freqs > EIS_TRACK_MAX_FREQS) {
+        LOG_ERR("Tracking needs 1..%d frequencies", EIS_TRACK_MAX_FREQS);
+        return -EINVAL;
+    }
+    for (uint8_t k = 0; k < track->num_freqs; k++) {
+        if (track->freqs_hz[k] <= 0.0f) {
+            return -EINVAL;
+        }
     }
 
-    printk("Sweep complete: %u points\n", npts);
+    trk.active = false;
+    trk.cfg    = *cfg;
+    trk.track  = *track;
+    trk.seq    = 0;
+
+    LOG_INF("=== Tracking start: %u freq(s), DFT %u pts ===",
+            track->num_freqs, 4u << (cfg->dft_num & 0xF));
+
+    /* ---- RCAL at every tracked frequency ---- */
+    ret = set_switch_matrix(&cfg->sw_rcal);
+    if (ret) return ret;
+    k_msleep(5);
+
+    for (uint8_t k = 0; k < track->num_freqs; k++) {
+        ret = measure_one_freq(track->freqs_hz[k], cfg,
+                               &trk.rcal_r[k], &trk.rcal_i[k]);
+        if (ret) {
+            LOG_ERR("RCAL failed at %.1f Hz", (double)track->freqs_hz[k]);
+            return ret;
+        }
+    }
+
+    /* ---- Switch to the sensor and settle on the last frequency ---- */
+    ret = set_switch_matrix(&cfg->sw_sensor);
+    if (ret) return ret;
+    k_msleep(2);
+
+    /*
+     * Excitation is still at the last RCAL frequency. Discard one DFT so
+     * the first sample does not straddle the switch-matrix change.
+     */
+    uint32_t avail;
+    uint32_t words[2];
+    uint8_t last = track->num_freqs - 1;
+    ret = fifo_restart();
+    if (ret) return ret;
+    ret = wait_fifo_words(2, dft_poll_interval_us(cfg, track->freqs_hz[last]),
+                          &avail);
+    if (ret) return ret;
+    ret = ad5940_read_fifo(words, 2);
+    if (ret) return ret;
+
+    trk.cur    = last;
+    trk.active = true;
     return 0;
 }
 
+int eis_track_next(eis_track_sample_t *sample)
+{
+    int ret;
+    float sens_r, sens_i;
+
+    if (!trk.active) {
+        return -EINVAL;
+    }
+
+    /* Results still queued behind the one being returned */
+    uint32_t backlog = 0;
+
+    if (trk.track.num_freqs == 1) {
+        /*
+         * Excitation unchanged – take the oldest result from the FIFO.
+         * The FIFO keeps collecting while the caller is busy, so slow
+         * consumers fall behind instead of losing samples.
+         */
+        uint32_t avail;
+        uint32_t words[2];
+        ret = wait_fifo_words(2, dft_poll_interval_us(&trk.cfg,
+                                                      trk.track.freqs_hz[0]),
+                              &avail);
+        if (ret) return ret;
+        if (avail >= DFT_FIFO_WORDS - 1) {
+            LOG_WRN("DFT FIFO full – tracking samples dropped");
+        }
+        ret = ad5940_read_fifo(words, 2);
+        if (ret) return ret;
+        sens_r = dft_word(words[0]);
+        sens_i = dft_word(words[1]);
+        backlog = avail / 2 - 1;
+    } else {
+        trk.cur = (trk.cur + 1) % trk.track.num_freqs;
+        ret = measure_one_freq(trk.track.freqs_hz[trk.cur], &trk.cfg,
+                               &sens_r, &sens_i);
+        if (ret) return ret;
+    }
+
+    float freq = trk.track.freqs_hz[trk.cur];
+    uint32_t block_us = eis_dft_duration_us(&trk.cfg, freq);
+
+    /* Timestamp the centre of the DFT window that was just read */
+    int64_t now_us = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+    sample->timestamp_us = now_us - (int64_t)backlog * block_us - block_us / 2;
+    sample->seq          = trk.seq++;
+    sample->freq_index   = trk.cur;
+
+    return compute_impedance(freq, trk.rcal_r[trk.cur], trk.rcal_i[trk.cur],
+                             sens_r, sens_i, trk.cfg.rcal_ohms,
+                             &sample->point);
+}
+
+void eis_track_stop(void)
+{
+    /* The AFE keeps running; a sweep or a new tracking run may follow */
+    trk.active = false;
+    LOG_INF("Tracking stopped after %u samples", trk.seq);
+}
+
 void eis_print_results(const eis_result_t *result)
 {
     printk("\n");
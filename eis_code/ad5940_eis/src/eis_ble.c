@@ -0,0 +1,234 @@
+/**
+ * @file eis_ble.c
+ * @brief BLE streaming of EIS sweep points and Randles summary.
+ *
+ * See eis_ble.h for the record layout.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <math.h>
+#include <string.h>
+
+#include "eis_ble.h"
+
+LOG_MODULE_REGISTER(eis_ble, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* ---------- UUIDs --------------------------------------------------- */
+
+#define EIS_SVC_UUID_VAL \
+    BT_UUID_128_ENCODE(0x5a3c0001, 0x8e2b, 0x4f6a, 0x9d1e, 0x2b7c4e9a0d10)
+#define EIS_DATA_UUID_VAL \
+    BT_UUID_128_ENCODE(0x5a3c0002, 0x8e2b, 0x4f6a, 0x9d1e, 0x2b7c4e9a0d10)
+
+static struct bt_uuid_128 eis_svc_uuid  = BT_UUID_INIT_128(EIS_SVC_UUID_VAL);
+static struct bt_uuid_128 eis_data_uuid = BT_UUID_INIT_128(EIS_DATA_UUID_VAL);
+
+/* ---------- State --------------------------------------------------- */
+
+#define POINT_REC_LEN    16
+#define SUMMARY_REC_LEN  20
+#define TRACK_REC_LEN    16
+
+static volatile bool notify_enabled;
+static uint8_t  sweep_id;
+static uint16_t points_sent;
+
+/* ---------- GATT ---------------------------------------------------- */
+
+static void eis_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+    notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("EIS notifications %s", notify_enabled ? "enabled" : "disabled");
+}
+
+BT_GATT_SERVICE_DEFINE(eis_svc,
+    BT_GATT_PRIMARY_SERVICE(&eis_svc_uuid),
+    BT_GATT_CHARACTERISTIC(&eis_data_uuid.uuid,
+                           BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_NONE,
+                           NULL, NULL, NULL),
+    BT_GATT_CCC(eis_ccc_cfg_changed,
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+/* ---------- Advertising --------------------------------------------- */
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME,
+            (sizeof(CONFIG_BT_DEVICE_NAME) - 1)),
+};
+
+static const struct bt_data sd[] = {
+    BT_DATA_BYTES(BT_DATA_UUID128_ALL, EIS_SVC_UUID_VAL),
+};
+
+static void adv_restart(struct k_work *work)
+{
+    ARG_UNUSED(work);
+    int err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_2, ad, ARRAY_SIZE(ad),
+                              sd, ARRAY_SIZE(sd));
+    if (err && err != -EALREADY) {
+        LOG_ERR("Advertising restart failed: %d", err);
+    }
+}
+
+static K_WORK_DEFINE(adv_work, adv_restart);
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    ARG_UNUSED(conn);
+    if (err) {
+        LOG_WRN("Connection failed (err %u)", err);
+        return;
+    }
+    LOG_INF("Central connected");
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    ARG_UNUSED(conn);
+    notify_enabled = false;
+    LOG_INF("Central disconnected (reason %u)", reason);
+}
+
+static void recycled(void)
+{
+    /* Connection object is free again – resume advertising */
+    k_work_submit(&adv_work);
+}
+
+BT_CONN_CB_DEFINE(eis_conn_cb) = {
+    .connected    = connected,
+    .disconnected = disconnected,
+    .recycled     = recycled,
+};
+
+/* ---------- Helpers ------------------------------------------------- */
+
+static inline void put_f32(uint8_t *dst, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    sys_put_le32(bits, dst);
+}
+
+static int notify(const uint8_t *rec, uint16_t len)
+{
+    /*
+     * attrs[0] = primary service
+     * attrs[1] = characteristic declaration
+     * attrs[2] = characteristic value  <-- notify this
+     * attrs[3] = CCC
+     */
+    int err = bt_gatt_notify(NULL, &eis_svc.attrs[2], rec, len);
+    if (err && err != -ENOTCONN) {
+        LOG_WRN("EIS notify failed: %d", err);
+    }
+    return err;
+}
+
+/* ---------- Public API ---------------------------------------------- */
+
+int eis_ble_init(void)
+{
+    int err = bt_enable(NULL);
+    if (err) {
+        LOG_ERR("Bluetooth init failed: %d", err);
+        return err;
+    }
+
+    err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_2, ad, ARRAY_SIZE(ad),
+                          sd, ARRAY_SIZE(sd));
+    if (err) {
+        LOG_ERR("Advertising failed to start: %d", err);
+        return err;
+    }
+
+    LOG_INF("Advertising EIS service as \"%s\"", CONFIG_BT_DEVICE_NAME);
+    return 0;
+}
+
+bool eis_ble_is_subscribed(void)
+{
+    return notify_enabled;
+}
+
+void eis_ble_sweep_begin(void)
+{
+    sweep_id++;
+    points_sent = 0;
+}
+
+void eis_ble_send_point(uint16_t index, const eis_point_t *point,
+                        void *user_data)
+{
+    ARG_UNUSED(user_data);
+
+    if (!notify_enabled) {
+        return;
+    }
+
+    uint8_t rec[POINT_REC_LEN];
+    rec[0] = EIS_BLE_REC_POINT;
+    rec[1] = sweep_id;
+    sys_put_le16(index, &rec[2]);
+    put_f32(&rec[4],  point->freq_hz);
+    put_f32(&rec[8],  point->real_ohms);
+    put_f32(&rec[12], point->imag_ohms);
+
+    /* The summary's count tells the receiver how many points reached it */
+    if (notify(rec, sizeof(rec)) == 0) {
+        points_sent++;
+    }
+}
+
+void eis_ble_send_summary(const eis_randles_t *randles)
+{
+    if (!notify_enabled) {
+        return;
+    }
+
+    uint8_t rec[SUMMARY_REC_LEN];
+    rec[0] = EIS_BLE_REC_SUMMARY;
+    rec[1] = sweep_id;
+    sys_put_le16(points_sent, &rec[2]);
+
+    if (randles) {
+        put_f32(&rec[4],  randles->rs_ohms);
+        put_f32(&rec[8],  randles->rct_ohms);
+        put_f32(&rec[12], randles->cdl_farads);
+        put_f32(&rec[16], randles->f_peak_hz);
+    } else {
+        put_f32(&rec[4],  NAN);
+        put_f32(&rec[8],  NAN);
+        put_f32(&rec[12], NAN);
+        put_f32(&rec[16], NAN);
+    }
+
+    notify(rec, sizeof(rec));
+}
+
+void eis_ble_send_track(const eis_track_sample_t *sample)
+{
+    if (!notify_enabled) {
+        return;
+    }
+
+    uint8_t rec[TRACK_REC_LEN];
+    rec[0] = EIS_BLE_REC_TRACK;
+    rec[1] = sample->freq_index;
+    sys_put_le16((uint16_t)sample->seq, &rec[2]);
+    sys_put_le32((uint32_t)(sample->timestamp_us / 1000), &rec[4]);
+    put_f32(&rec[8],  sample->point.mag_ohms);
+    put_f32(&rec[12], sample->point.phase_deg);
+
+    notify(rec, sizeof(rec));
+}
@@ -0,0 +1,431 @@
+/**
+ * @file eis_fit.c
+ * @brief Levenberg–Marquardt equivalent-circuit fitter (see eis_fit.h).
+ *
+ * Working set is a handful of P×P matrices (P ≤ 4) on the stack, so the
+ * fitter runs comfortably on the nRF52840 main thread. Everything is
+ * single precision to stay on the Cortex-M4F hardware FPU.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "eis_fit.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Forward-difference step in the transformed (log / logit) space */
+#define FD_STEP        1e-3f
+
+/* LM damping limits */
+#define LAMBDA_INIT    1e-3f
+#define LAMBDA_MIN     1e-7f
+#define LAMBDA_MAX     1e10f
+
+/* Largest per-parameter step (e² ≈ 7× change in a log-parameter) */
+#define MAX_STEP       2.0f
+
+/* Index of the CPE exponent n, the only non-log parameter */
+#define CPE_N_INDEX    3
+
+/* ====================================================================
+ * Small complex helpers
+ * ==================================================================== */
+
+typedef struct {
+    float re;
+    float im;
+} cpx_t;
+
+static inline cpx_t cpx_inv(cpx_t z)
+{
+    float d = z.re * z.re + z.im * z.im;
+    cpx_t r = { z.re / d, -z.im / d };
+    return r;
+}
+
+/* ====================================================================
+ * Models
+ * ==================================================================== */
+
+uint8_t eis_model_num_params(eis_model_t model)
+{
+    return (model == EIS_MODEL_RANDLES) ? 3 : 4;
+}
+
+const char *eis_model_name(eis_model_t model)
+{
+    switch (model) {
+    case EIS_MODEL_RANDLES:     return "Randles";
+    case EIS_MODEL_RANDLES_CPE: return "Randles+CPE";
+    case EIS_MODEL_RANDLES_W:   return "Randles+Warburg";
+    default:                    return "?";
+    }
+}
+
+void eis_model_impedance(eis_model_t model, const float *p, float freq_hz,
+                         float *re, float *im)
+{
+    float w = 2.0f * (float)M_PI * freq_hz;
+    float rs = p[0];
+    float rct = p[1];
+    cpx_t y;  /* admittance of the parallel branch */
+
+    switch (model) {
+    case EIS_MODEL_RANDLES_CPE: {
+        /* Y = 1/Rct + Q (jω)^n */
+        float qwn = p[2] * powf(w, p[3]);
+        float ang = p[3] * (float)M_PI * 0.5f;
+        y.re = 1.0f / rct + qwn * cosf(ang);
+        y.im = qwn * sinf(ang);
+        break;
+    }
+    case EIS_MODEL_RANDLES_W: {
+        /* Y = 1/(Rct + σ(1 − j)/√ω) + jωCdl */
+        float sw = p[3] / sqrtf(w);
+        cpx_t zf = { rct + sw, -sw };
+        y = cpx_inv(zf);
+        y.im += w * p[2];
+        break;
+    }
+    case EIS_MODEL_RANDLES:
+    default:
+        /* Y = 1/Rct + jωCdl */
+        y.re = 1.0f / rct;
+        y.im = w * p[2];
+        break;
+    }
+
+    cpx_t zp = cpx_inv(y);
+    *re = rs + zp.re;
+    *im = zp.im;
+}
+
+/* ====================================================================
+ * Parameter transforms
+ *
+ * All parameters are strictly positive, so they are fitted as ln(p).
+ * The CPE exponent n is fitted as logit(n) to keep it inside (0, 1).
+ * ==================================================================== */
+
+static bool is_logit(eis_model_t model, int k)
+{
+    return model == EIS_MODEL_RANDLES_CPE && k == CPE_N_INDEX;
+}
+
+static void to_params(eis_model_t model, const float *u, float *p, int np)
+{
+    for (int k = 0; k < np; k++) {
+        p[k] = is_logit(model, k) ? 1.0f / (1.0f + expf(-u[k])) : expf(u[k]);
+    }
+}
+
+static void to_internal(eis_model_t model, const float *p, float *u, int np)
+{
+    for (int k = 0; k < np; k++) {
+        if (is_logit(model, k)) {
+            float n = fminf(fmaxf(p[k], 0.01f), 0.999f);
+            u[k] = logf(n / (1.0f - n));
+        } else {
+            u[k] = logf(p[k]);
+        }
+    }
+}
+
+/* ====================================================================
+ * Cost and normal equations
+ * ==================================================================== */
+
+static bool point_valid(const eis_point_t *pt)
+{
+    return pt->mag_ohms >= 1.0f && pt->freq_hz > 0.0f;
+}
+
+/* Modulus-weighted residual of one point */
+static cpx_t residual(eis_model_t model, const float *p, const eis_point_t *pt)
+{
+    cpx_t r;
+    eis_model_impedance(model, p, pt->freq_hz, &r.re, &r.im);
+    r.re = (r.re - pt->real_ohms) / pt->mag_ohms;
+    r.im = (r.im - pt->imag_ohms) / pt->mag_ohms;
+    return r;
+}
+
+static float cost(const eis_result_t *data, eis_model_t model, const float *u,
+                  int np)
+{
+    float p[EIS_FIT_MAX_PARAMS];
+    float c = 0.0f;
+
+    to_params(model, u, p, np);
+    for (uint16_t i = 0; i < data->count; i++) {
+        const eis_point_t *pt = &data->points[i];
+        if (!point_valid(pt)) continue;
+        cpx_t r = residual(model, p, pt);
+        c += r.re * r.re + r.im * r.im;
+    }
+    return c;
+}
+
+/*
+ * Accumulate JᵀJ and Jᵀr with a forward-difference Jacobian, one point
+ * at a time so the full 2N×P Jacobian is never stored.
+ */
+static void build_normal(const eis_result_t *data, eis_model_t model,
+                         const float *u, int np,
+                         float jtj[EIS_FIT_MAX_PARAMS][EIS_FIT_MAX_PARAMS],
+                         float jtr[EIS_FIT_MAX_PARAMS])
+{
+    float p[EIS_FIT_MAX_PARAMS];
+    float ph[EIS_FIT_MAX_PARAMS][EIS_FIT_MAX_PARAMS];
+    float uh[EIS_FIT_MAX_PARAMS];
+
+    memset(jtj, 0, sizeof(float) * EIS_FIT_MAX_PARAMS * EIS_FIT_MAX_PARAMS);
+    memset(jtr, 0, sizeof(float) * EIS_FIT_MAX_PARAMS);
+
+    /* Perturbed parameter vectors are the same for every point */
+    to_params(model, u, p, np);
+    for (int k = 0; k < np; k++) {
+        memcpy(uh, u, sizeof(float) * np);
+        uh[k] += FD_STEP;
+        to_params(model, uh, ph[k], np);
+    }
+
+    for (uint16_t i = 0; i < data->count; i++) {
+        const eis_point_t *pt = &data->points[i];
+        if (!point_valid(pt)) continue;
+
+        cpx_t r = residual(model, p, pt);
+        cpx_t j[EIS_FIT_MAX_PARAMS];
+
+        for (int k = 0; k < np; k++) {
+            cpx_t rh = residual(model, ph[k], pt);
+            j[k].re = (rh.re - r.re) / FD_STEP;
+            j[k].im = (rh.im - r.im) / FD_STEP;
+        }
+
+        for (int a = 0; a < np; a++) {
+            jtr[a] += j[a].re * r.re + j[a].im * r.im;
+            for (int b = a; b < np; b++) {
+                jtj[a][b] += j[a].re * j[b].re + j[a].im * j[b].im;
+            }
+        }
+    }
+
+    /* Mirror the upper triangle */
+    for (int a = 0; a < np; a++) {
+        for (int b = 0; b < a; b++) {
+            jtj[a][b] = jtj[b][a];
+        }
+    }
+}
+
+/* Gaussian elimination with partial pivoting (n ≤ EIS_FIT_MAX_PARAMS) */
+static int solve_nxn(float A[EIS_FIT_MAX_PARAMS][EIS_FIT_MAX_PARAMS],
+                     float b[EIS_FIT_MAX_PARAMS], float x[EIS_FIT_MAX_PARAMS],
+                     int n)
+{
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        float max_val = fabsf(A[col][col]);
+        for (int row = col + 1; row < n; row++) {
+            if (fabsf(A[row][col]) > max_val) {
+                max_val = fabsf(A[row][col]);
+                pivot = row;
+            }
+        }
+
+        if (max_val < 1e-30f) {
+            return -1;  /* Singular */
+        }
+
+        if (pivot != col) {
+            for (int j = 0; j < n; j++) {
+                float tmp = A[col][j];
+                A[col][j] = A[pivot][j];
+                A[pivot][j] = tmp;
+            }
+            float tmp = b[col];
+            b[col] = b[pivot];
+            b[pivot] = tmp;
+        }
+
+        for (int row = col + 1; row < n; row++) {
+            float factor = A[row][col] / A[col][col];
+            for (int j = col; j < n; j++) {
+                A[row][j] -= factor * A[col][j];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+        x[i] = b[i];
+        for (int j = i + 1; j < n; j++) {
+            x[i] -= A[i][j] * x[j];
+        }
+        x[i] /= A[i][i];
+    }
+
+    return 0;
+}
+
+/* ====================================================================
+ * Initial guess
+ * ==================================================================== */
+
+static int initial_guess(const eis_result_t *data, eis_model_t model, float *p)
+{
+    const eis_point_t *lo = NULL, *hi = NULL;
+    float peak = -1.0f, f_peak = 0.0f;
+    uint16_t valid = 0;
+
+    for (uint16_t i = 0; i < data->count; i++) {
+        const eis_point_t *pt = &data->points[i];
+        if (!point_valid(pt)) continue;
+        valid++;
+        if (!lo || pt->freq_hz < lo->freq_hz) lo = pt;
+        if (!hi || pt->freq_hz > hi->freq_hz) hi = pt;
+        if (-pt->imag_ohms > peak) {
+            peak = -pt->imag_ohms;
+            f_peak = pt->freq_hz;
+        }
+    }
+
+    if (valid < 4) {
+        return -1;
+    }
+
+    float rs  = fmaxf(hi->real_ohms, 1e-3f * lo->mag_ohms);
+    float rct = fmaxf(lo->real_ohms - rs, 0.1f * lo->mag_ohms);
+    if (f_peak <= 0.0f) f_peak = sqrtf(lo->freq_hz * hi->freq_hz);
+    float cdl = 1.0f / (2.0f * (float)M_PI * f_peak * rct);
+
+    p[0] = rs;
+    p[1] = rct;
+    p[2] = cdl;
+
+    if (model == EIS_MODEL_RANDLES_CPE) {
+        p[3] = 0.9f;
+    } else if (model == EIS_MODEL_RANDLES_W) {
+        /* |Zw| ≈ 0.1·Rct at the lowest frequency */
+        float w_lo = 2.0f * (float)M_PI * lo->freq_hz;
+        p[3] = 0.1f * rct * sqrtf(w_lo) / sqrtf(2.0f);
+    }
+
+    return 0;
+}
+
+/* ====================================================================
+ * Public API
+ * ==================================================================== */
+
+int eis_fit_model(const eis_result_t *data, eis_model_t model,
+                  const float *p0, const eis_fit_opts_t *opts,
+                  eis_fit_result_t *out)
+{
+    int np = eis_model_num_params(model);
+    uint16_t max_iter = (opts && opts->max_iter) ? opts->max_iter
+                                                 : EIS_FIT_DEFAULT_MAX_ITER;
+    float rel_tol = (opts && opts->rel_tol > 0.0f) ? opts->rel_tol : 1e-6f;
+    float p[EIS_FIT_MAX_PARAMS];
+    float u[EIS_FIT_MAX_PARAMS];
+    uint16_t valid = 0;
+
+    memset(out, 0, sizeof(*out));
+    out->model = model;
+    out->num_params = (uint8_t)np;
+
+    for (uint16_t i = 0; i < data->count; i++) {
+        if (point_valid(&data->points[i])) valid++;
+    }
+    if (valid < (uint16_t)np + 1) {
+        return -1;
+    }
+
+    if (p0) {
+        memcpy(p, p0, sizeof(float) * np);
+        /* A circle fit can return Rs ≤ 0 – nudge into the log domain */
+        for (int k = 0; k < np; k++) {
+            if (!(p[k] > 0.0f)) p[k] = 1e-6f;
+        }
+    } else if (initial_guess(data, model, p) != 0) {
+        return -1;
+    }
+
+    to_internal(model, p, u, np);
+    for (int k = 0; k < np; k++) {
+        if (!isfinite(u[k])) return -1;
+    }
+
+    float c = cost(data, model, u, np);
+    float lambda = LAMBDA_INIT;
+    uint16_t nfev = 1;
+    bool rebuild = true;
+    float jtj[EIS_FIT_MAX_PARAMS][EIS_FIT_MAX_PARAMS];
+    float jtr[EIS_FIT_MAX_PARAMS];
+
+    while (out->iterations < max_iter) {
+        if (rebuild) {
+            build_normal(data, model, u, np, jtj, jtr);
+            nfev += np + 1;
+            rebuild = false;
+        }
+
+        /* (JᵀJ + λ·diag(JᵀJ)) δ = −Jᵀr */
+        float A[EIS_FIT_MAX_PARAMS][EIS_FIT_MAX_PARAMS];
+        float b[EIS_FIT_MAX_PARAMS];
+        float delta[EIS_FIT_MAX_PARAMS];
+
+        memcpy(A, jtj, sizeof(A));
+        for (int k = 0; k < np; k++) {
+            A[k][k] += lambda * fmaxf(jtj[k][k], 1e-12f);
+            b[k] = -jtr[k];
+        }
+
+        out->iterations++;
+
+        if (solve_nxn(A, b, delta, np) != 0) {
+            lambda *= 10.0f;
+            if (lambda > LAMBDA_MAX) break;
+            continue;
+        }
+
+        float u_new[EIS_FIT_MAX_PARAMS];
+        for (int k = 0; k < np; k++) {
+            float d = fminf(fmaxf(delta[k], -MAX_STEP), MAX_STEP);
+            u_new[k] = u[k] + d;
+        }
+
+        float c_new = cost(data, model, u_new, np);
+        nfev++;
+
+        if (isfinite(c_new) && c_new < c) {
+            float gain = (c - c_new) / c;
+            memcpy(u, u_new, sizeof(float) * np);
+            c = c_new;
+            lambda = fmaxf(lambda * 0.1f, LAMBDA_MIN);
+            rebuild = true;
+
+            if (gain < rel_tol || c < 1e-12f) {
+                out->converged = 1;
+                break;
+            }
+        } else {
+            lambda *= 10.0f;
+            if (lambda > LAMBDA_MAX) {
+                /* No descent direction left: at a (local) minimum */
+                out->converged = 1;
+                break;
+            }
+        }
+    }
+
+    to_params(model, u, out->p, np);
+    out->rms_rel_err = sqrtf(c / (float)valid);
+    out->evaluations = nfev;
+
+    return 0;
+}
@@ -16,10 +16,13 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <math.h>
 
 #include "ad5940_spi.h"
 #include "ad5940_eis.h"
 #include "ad5940_regs.h"
+#include "eis_ble.h"
+#include "eis_fit.h"
 
 LOG_MODULE_REGISTER(main, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -27,6 +30,32 @@ LOG_MODULE_REGISTER(main, CONFIG_LOG_DEFAULT_LEVEL);
  * Configuration – adjust these for your setup
  * ==================================================================== */
 
+/*
+ * Run mode:
+ *   EIS_MODE_SWEEP        – one log sweep + Randles fit (default)
+ *   EIS_MODE_TRACK        – continuous |Z|/phase at TRACK_FREQS_HZ
+ *   EIS_MODE_CHARACTERISE – sample rate and noise at every DFT length
+ */
+#define EIS_MODE_SWEEP         0
+#define EIS_MODE_TRACK         1
+#define EIS_MODE_CHARACTERISE  2
+
+#define EIS_MODE  EIS_MODE_SWEEP
+
+/* Tracking frequencies (sweat: 1 kHz tracks solution resistance well) */
+static const float TRACK_FREQS_HZ[] = { 1000.0f };
+
+/* Samples per DFT length in characterisation mode */
+#define CHAR_SAMPLES  64
+
+/*
+ * How long to wait for a central to enable notifications before
+ * measuring. Records sent before that are dropped, and the default
+ * mode runs a single sweep, so without a wait BLE would never see it.
+ * After the timeout the results still go to the UART.
+ */
+#define BLE_SUBSCRIBE_TIMEOUT_MS  30000
+
 static eis_config_t build_config(void)
 {
     eis_config_t cfg = eis_default_config();
@@ -87,6 +116,204 @@ static eis_config_t build_config(void)
     return cfg;
 }
 
+/*
+ * Print SPI frames, bytes and bus time since the last
+ * ad5940_spi_reset_stats(), in total and per sweep point.
+ */
+static void print_spi_stats(uint16_t points)
+{
+    ad5940_spi_stats_t st;
+
+    ad5940_spi_get_stats(&st);
+    printk("# SPI: %u frames, %u bytes, %u us on the bus",
+           st.transactions, st.bytes, st.bus_us);
+    if (points > 0) {
+        printk(" (%u frames / point)", st.transactions / points);
+    }
+    printk("\n");
+}
+
+/*
+ * Wait until a central enables notifications, or timeout_ms passes.
+ * Returns true if one did.
+ */
+static bool wait_for_subscriber(uint32_t timeout_ms)
+{
+    int64_t deadline = k_uptime_get() + timeout_ms;
+
+    printk("Waiting up to %u s for a BLE subscriber...\n", timeout_ms / 1000);
+    while (!eis_ble_is_subscribed()) {
+        if (k_uptime_get() >= deadline) {
+            printk("No BLE subscriber – results on UART only\n");
+            return false;
+        }
+        k_msleep(100);
+    }
+    printk("BLE subscriber connected\n");
+    return true;
+}
+
+/* ====================================================================
+ * Tracking mode – stream |Z|/phase forever
+ * ==================================================================== */
+
+static int run_tracking(const eis_config_t *cfg)
+{
+    eis_track_config_t track = { 0 };
+    eis_track_sample_t sample;
+    int ret;
+
+    track.num_freqs = ARRAY_SIZE(TRACK_FREQS_HZ);
+    for (uint8_t k = 0; k < track.num_freqs; k++) {
+        track.freqs_hz[k] = TRACK_FREQS_HZ[k];
+    }
+
+    ret = eis_track_start(cfg, &track);
+    if (ret) {
+        LOG_ERR("Tracking start failed: %d", ret);
+        return ret;
+    }
+
+    printk("\nDFT %u us per sample\n",
+           eis_dft_duration_us(cfg, track.freqs_hz[0]));
+    printk("t_ms,freq_hz,mag_ohms,phase_deg\n");
+
+    while (1) {
+        ret = eis_track_next(&sample);
+        if (ret && ret != -ERANGE) {
+            LOG_ERR("Tracking failed: %d", ret);
+            eis_track_stop();
+            return ret;
+        }
+
+        printk("%lld,%.1f,%.2f,%.3f\n",
+               sample.timestamp_us / 1000,
+               (double)sample.point.freq_hz,
+               (double)sample.point.mag_ohms,
+               (double)sample.point.phase_deg);
+        eis_ble_send_track(&sample);
+    }
+}
+
+/* ====================================================================
+ * Characterisation – throughput and noise vs DFT length
+ *
+ * For every DFT length, tracks the first TRACK_FREQS_HZ entry for
+ * CHAR_SAMPLES samples and reports the achieved sample rate next to
+ * the theoretical one, plus the standard deviation of |Z| and phase.
+ * ==================================================================== */
+
+static int characterise_dft_lengths(eis_config_t cfg)
+{
+    eis_track_config_t track = { 0 };
+    eis_track_sample_t sample;
+    int ret;
+
+    track.num_freqs   = 1;
+    track.freqs_hz[0] = TRACK_FREQS_HZ[0];
+
+    printk("\n=== DFT length characterisation @ %.1f Hz ===\n",
+           (double)track.freqs_hz[0]);
+    printk("dft_pts,dft_us,ideal_sps,actual_sps,mag_mean,mag_std,mag_ppm,phase_std_deg\n");
+
+    for (uint8_t n = DFTNUM_4; n <= DFTNUM_16384; n++) {
+        cfg.dft_num = n;
+
+        /* DFTCON is written by eis_init() */
+        ret = eis_init(&cfg);
+        if (ret) return ret;
+        ret = eis_track_start(&cfg, &track);
+        if (ret) return ret;
+
+        /* Welford running mean / variance */
+        double mag_mean = 0, mag_m2 = 0, ph_mean = 0, ph_m2 = 0;
+        uint32_t good = 0;
+        /* Microseconds: at short DFTs a run lasts only a few ms */
+        int64_t t0 = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+
+        for (int i = 0; i < CHAR_SAMPLES; i++) {
+            ret = eis_track_next(&sample);
+            if (ret == -ERANGE) continue;
+            if (ret) {
+                eis_track_stop();
+                return ret;
+            }
+
+            good++;
+            double d = sample.point.mag_ohms - mag_mean;
+            mag_mean += d / good;
+            mag_m2   += d * (sample.point.mag_ohms - mag_mean);
+            d = sample.point.phase_deg - ph_mean;
+            ph_mean += d / good;
+            ph_m2   += d * (sample.point.phase_deg - ph_mean);
+        }
+
+        int64_t elapsed_us = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks()) - t0;
+        eis_track_stop();
+
+        uint32_t dft_us  = eis_dft_duration_us(&cfg, track.freqs_hz[0]);
+        double ideal_sps = 1e6 / dft_us;
+        double sps       = elapsed_us > 0 ? CHAR_SAMPLES * 1e6 / elapsed_us : 0;
+        double mag_std   = good > 1 ? sqrt(mag_m2 / (good - 1)) : 0;
+        double ph_std    = good > 1 ? sqrt(ph_m2 / (good - 1)) : 0;
+        double mag_ppm   = mag_mean > 0 ? mag_std / mag_mean * 1e6 : 0;
+
+        printk("%u,%u,%.1f,%.1f,%.2f,%.3f,%.0f,%.4f\n",
+               4u << n, dft_us, ideal_sps, sps,
+               mag_mean, mag_std, mag_ppm, ph_std);
+    }
+
+    printk("=== Characterisation done ===\n");
+    return 0;
+}
+
+/* ====================================================================
+ * Nonlinear fits – every model, seeded from the circle fit if it worked
+ * ==================================================================== */
+
+static void run_model_fits(const eis_result_t *result,
+                           const eis_randles_t *circle)
+{
+    printk("\n# Equivalent-circuit fits (Levenberg-Marquardt)\n");
+    printk("# model, iter, cycles, us, rms_rel_err, params...\n");
+
+    for (int m = 0; m < EIS_MODEL_COUNT; m++) {
+        eis_model_t model = (eis_model_t)m;
+        float p0[EIS_FIT_MAX_PARAMS];
+        const float *guess = NULL;
+        eis_fit_result_t fit;
+
+        if (circle && circle->rct_ohms > 0 && circle->cdl_farads > 0) {
+            p0[0] = circle->rs_ohms;
+            p0[1] = circle->rct_ohms;
+            p0[2] = circle->cdl_farads;
+            /* n for CPE; small Warburg σ otherwise */
+            p0[3] = (model == EIS_MODEL_RANDLES_CPE) ? 0.9f
+                                                     : 0.01f * circle->rct_ohms;
+            guess = p0;
+        }
+
+        uint32_t t0 = k_cycle_get_32();
+        int ret = eis_fit_model(result, model, guess, NULL, &fit);
+        uint32_t cycles = k_cycle_get_32() - t0;
+
+        if (ret) {
+            printk("%s, fit failed\n", eis_model_name(model));
+            continue;
+        }
+
+        printk("%s, %u, %u, %u, %.2e",
+               eis_model_name(model), fit.iterations, cycles,
+               (uint32_t)k_cyc_to_us_floor64(cycles),
+               (double)fit.rms_rel_err);
+        for (int k = 0; k < fit.num_params; k++) {
+            printk(", %.4g", (double)fit.p[k]);
+        }
+        printk("%s\n", fit.converged ? "" : "  (not converged)");
+    }
+    printk("# END\n\n");
+}
+
 /* ====================================================================
  * Main
  * ==================================================================== */
@@ -94,6 +321,7 @@ static eis_config_t build_config(void)
 int main(void)
 {
     int ret;
+    bool ble_ok = false;
 
     printk("\n");
     printk("========================================\n");
@@ -141,6 +369,15 @@ int main(void)
     /* ---- Step 5: Build EIS configuration ---- */
     eis_config_t cfg = build_config();
 
+    /* ---- Step 5b: Start BLE streaming (UART output works without it) ---- */
+    ret = eis_ble_init();
+    if (ret) {
+        LOG_WRN("BLE init failed (%d) – results on UART only", ret);
+    } else {
+        ble_ok = true;
+        eis_set_point_callback(eis_ble_send_point, NULL);
+    }
+
     /* ---- Step 6: Initialise AFE for impedance measurement ---- */
     ret = eis_init(&cfg);
     if (ret) {
@@ -148,9 +385,24 @@ int main(void)
         return ret;
     }
 
+    /* ---- Step 6b: Give a central time to connect and subscribe ---- */
+    if (ble_ok) {
+        wait_for_subscriber(BLE_SUBSCRIBE_TIMEOUT_MS);
+    }
+
+    /* ---- Alternative run modes (see EIS_MODE) ---- */
+    if (EIS_MODE == EIS_MODE_TRACK) {
+        return run_tracking(&cfg);
+    }
+    if (EIS_MODE == EIS_MODE_CHARACTERISE) {
+        return characterise_dft_lengths(cfg);
+    }
+
     /* ---- Step 7: Run the frequency sweep (RCAL calibrated per-frequency) ---- */
     static eis_result_t result;
 
+    ad5940_spi_reset_stats();
+    eis_ble_sweep_begin();
     ret = eis_run_sweep(&cfg, &result);
     if (ret) {
         LOG_ERR("Sweep failed: %d", ret);
@@ -161,6 +413,9 @@ int main(void)
         return ret;
     }
 
+    /* ---- Step 8: SPI bus usage for the sweep ---- */
+    print_spi_stats(result.count);
+
     /* ---- Step 9: Output results ---- */
     eis_print_results(&result);
 
@@ -172,6 +427,10 @@ int main(void)
     } else {
         printk("Randles circuit fit failed.\n");
     }
+    eis_ble_send_summary(ret == 0 ? &randles : NULL);
+
+    /* ---- Step 11: CPE / Warburg-aware nonlinear fits ---- */
+    run_model_fits(&result, ret == 0 ? &randles : NULL);
 
     /*
      * Optional: continuous sweep loop.
@@ -180,9 +439,12 @@ int main(void)
     /*
     while (1) {
         k_msleep(5000);
+        eis_ble_sweep_begin();
         ret = eis_run_sweep(&cfg, &result);
         if (ret == 0) {
             eis_print_results(&result);
+            ret = eis_fit_randles(&result, &randles);
+            eis_ble_send_summary(ret == 0 ? &randles : NULL);
         }
     }
     */
@@ -0,0 +1,276 @@
+/**
+ * @file bench.c
+ * @brief Host benchmark for the EIS equivalent-circuit fitter.
+ *
+ * Usage:
+ *   eis_fit_bench [sweep.csv ...]
+ *
+ * Without arguments, fits every model to a set of synthetic sweeps
+ * (40 log-spaced points, 100 Hz – 100 kHz, like the firmware default)
+ * at several noise levels and reports iterations, model evaluations,
+ * time / cycles per fit, parameter error and RMS relative residual.
+ *
+ * Each CSV argument is a recorded sweep as printed by eis_print_results()
+ * over UART – copy the block between the "# EIS Sweep Results" and
+ * "# END" lines into a file. Lines that do not parse as five numbers
+ * are ignored, so a raw console log works too.
+ *
+ * Exit status is non-zero if any noise-free synthetic fit with the
+ * matching model misses a parameter by more than 1 %.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "eis_fit.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Fits per timing measurement */
+#define TIMING_REPEATS  200
+
+#define SWEEP_POINTS    40
+#define SWEEP_START_HZ  100.0f
+#define SWEEP_STOP_HZ   100000.0f
+
+/* ====================================================================
+ * Synthetic data
+ * ==================================================================== */
+
+typedef struct {
+    const char *name;
+    eis_model_t model;
+    float       p[EIS_FIT_MAX_PARAMS];
+} synth_case_t;
+
+static const synth_case_t cases[] = {
+    { "ideal Randles",      EIS_MODEL_RANDLES,     { 200.0f, 5000.0f, 1e-6f } },
+    { "depressed (CPE)",    EIS_MODEL_RANDLES_CPE, { 150.0f, 8000.0f, 2e-6f, 0.8f } },
+    { "diffusion tail (W)", EIS_MODEL_RANDLES_W,   { 100.0f, 2000.0f, 2e-6f, 3000.0f } },
+    { "sweat patch (CPE)",  EIS_MODEL_RANDLES_CPE, { 1000.0f, 50000.0f, 5e-8f, 0.7f } },
+};
+
+static const float noise_levels[] = { 0.0f, 0.001f, 0.01f };
+
+static uint32_t rng_state = 0x12345678u;
+
+static float rand_uniform(void)
+{
+    /* xorshift32 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return ((rng_state >> 8) + 0.5f) / 16777216.0f;
+}
+
+static float rand_gauss(void)
+{
+    /* Box–Muller */
+    float u1 = rand_uniform();
+    float u2 = rand_uniform();
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+static void make_sweep(const synth_case_t *c, float noise, eis_result_t *out)
+{
+    float ratio = powf(SWEEP_STOP_HZ / SWEEP_START_HZ,
+                       1.0f / (SWEEP_POINTS - 1));
+    float f = SWEEP_START_HZ;
+
+    out->count = SWEEP_POINTS;
+    for (int i = 0; i < SWEEP_POINTS; i++, f *= ratio) {
+        eis_point_t *pt = &out->points[i];
+        float re, im;
+
+        eis_model_impedance(c->model, c->p, f, &re, &im);
+        float mag = sqrtf(re * re + im * im);
+
+        /* Complex Gaussian noise proportional to |Z| */
+        re += noise * mag * rand_gauss();
+        im += noise * mag * rand_gauss();
+
+        pt->freq_hz   = f;
+        pt->real_ohms = re;
+        pt->imag_ohms = im;
+        pt->mag_ohms  = sqrtf(re * re + im * im);
+        pt->phase_deg = atan2f(im, re) * (180.0f / (float)M_PI);
+    }
+}
+
+/* ====================================================================
+ * Timing
+ * ==================================================================== */
+
+typedef struct {
+    double   us;
+    double   cycles;  /* host TSC cycles, 0 if unavailable */
+} fit_cost_t;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int timed_fit(const eis_result_t *data, eis_model_t model,
+                     eis_fit_result_t *fit, fit_cost_t *cost)
+{
+    int ret = eis_fit_model(data, model, NULL, NULL, fit);
+    if (ret) return ret;
+
+    double t0 = now_us();
+#if HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    for (int r = 0; r < TIMING_REPEATS; r++) {
+        eis_fit_result_t tmp;
+        eis_fit_model(data, model, NULL, NULL, &tmp);
+    }
+#if HAVE_TSC
+    cost->cycles = (double)(__rdtsc() - c0) / TIMING_REPEATS;
+#else
+    cost->cycles = 0;
+#endif
+    cost->us = (now_us() - t0) / TIMING_REPEATS;
+    return 0;
+}
+
+static void print_params(const eis_fit_result_t *fit)
+{
+    for (int k = 0; k < fit->num_params; k++) {
+        printf("%s%.4g", k ? " " : "", (double)fit->p[k]);
+    }
+}
+
+/* ====================================================================
+ * Benchmarks
+ * ==================================================================== */
+
+static int bench_synthetic(void)
+{
+    static eis_result_t data;
+    int failures = 0;
+
+    printf("# Synthetic sweeps: %d pts, %.0f Hz - %.0f Hz, %d fits timed each\n",
+           SWEEP_POINTS, (double)SWEEP_START_HZ, (double)SWEEP_STOP_HZ,
+           TIMING_REPEATS);
+    printf("case,noise_pct,model,ok,conv,iter,nfev,us,host_cycles,"
+           "rms_rel_err,max_param_err_pct,params\n");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (size_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+            make_sweep(&cases[c], noise_levels[n], &data);
+
+            for (int m = 0; m < EIS_MODEL_COUNT; m++) {
+                eis_fit_result_t fit;
+                fit_cost_t cost = { 0 };
+                int ret = timed_fit(&data, (eis_model_t)m, &fit, &cost);
+
+                /* Parameter error only makes sense for the true model */
+                double max_err = NAN;
+                if (ret == 0 && (eis_model_t)m == cases[c].model) {
+                    max_err = 0;
+                    for (int k = 0; k < fit.num_params; k++) {
+                        double e = fabs(fit.p[k] / cases[c].p[k] - 1.0) * 100.0;
+                        if (e > max_err) max_err = e;
+                    }
+                    if (noise_levels[n] == 0.0f && !(max_err < 1.0)) {
+                        failures++;
+                    }
+                }
+
+                printf("%s,%.1f,%s,%d,%u,%u,%u,%.1f,%.0f,%.2e,%.3f,",
+                       cases[c].name, (double)(noise_levels[n] * 100.0f),
+                       eis_model_name((eis_model_t)m), ret == 0,
+                       fit.converged, fit.iterations, fit.evaluations,
+                       cost.us, cost.cycles, (double)fit.rms_rel_err,
+                       max_err);
+                print_params(&fit);
+                printf("\n");
+            }
+        }
+    }
+
+    return failures;
+}
+
+static int load_csv(const char *path, eis_result_t *out)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256];
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    out->count = 0;
+    while (fgets(line, sizeof(line), fp) && out->count < EIS_MAX_FREQ_POINTS) {
+        eis_point_t pt;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%f , %f , %f , %f , %f", &pt.freq_hz, &pt.real_ohms,
+                   &pt.imag_ohms, &pt.mag_ohms, &pt.phase_deg) == 5) {
+            out->points[out->count++] = pt;
+        }
+    }
+
+    fclose(fp);
+    return out->count > 0 ? 0 : -1;
+}
+
+static void bench_recorded(const char *path)
+{
+    static eis_result_t data;
+
+    if (load_csv(path, &data) != 0) {
+        fprintf(stderr, "%s: no sweep points found\n", path);
+        return;
+    }
+
+    printf("\n# Recorded sweep %s (%u points)\n", path, data.count);
+    printf("model,ok,conv,iter,nfev,us,host_cycles,rms_rel_err,params\n");
+
+    for (int m = 0; m < EIS_MODEL_COUNT; m++) {
+        eis_fit_result_t fit;
+        fit_cost_t cost = { 0 };
+        int ret = timed_fit(&data, (eis_model_t)m, &fit, &cost);
+
+        printf("%s,%d,%u,%u,%u,%.1f,%.0f,%.2e,",
+               eis_model_name((eis_model_t)m), ret == 0, fit.converged,
+               fit.iterations, fit.evaluations, cost.us, cost.cycles,
+               (double)fit.rms_rel_err);
+        print_params(&fit);
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int failures = bench_synthetic();
+
+    for (int i = 1; i < argc; i++) {
+        bench_recorded(argv[i]);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d noise-free fit(s) missed the true parameters\n",
+                failures);
+        return 1;
+    }
+    return 0;
+}
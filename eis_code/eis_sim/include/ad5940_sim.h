@@ -0,0 +1,97 @@
+/**
+ * @file ad5940_sim.h
+ * @brief Simulated AD5940 behind the ad5940_spi.h register API.
+ *
+ * ad5940_sim.c implements every function in ad5940_spi.h against a
+ * register-level model instead of the SPI bus, so the unmodified EIS
+ * engine can run on the host or under native_sim. The model covers the
+ * registers the engine touches:
+ *
+ *   - WGFCW / WGAMPLITUDE + PMBW     → excitation frequency and amplitude
+ *   - TSWFULLCON (SWT_RCAL1)         → RCAL path vs sensor path
+ *   - HSRTIACON, ADCCON (PGA)        → TIA gain and ADC scaling
+ *   - ADCFILTERCON, DFTCON, AFECON   → DFT input rate, length, run/stop
+ *   - INTCSEL0 / INTCFLAG0 / INTCCLR → DFT-complete flag
+ *   - DFTREAL / DFTIMAG              → 18-bit signed results
+ *   - FIFOCON / FIFOCNTSTA / DATAFIFORD, READFIFO bursts
+ *                                    → 512-word data FIFO (DFT source)
+ *
+ * The DFT free-runs in blocks of N = 4 << dft_num samples at the
+ * configured input rate. A block whose window straddles a frequency or
+ * switch change returns a time-weighted mix of the old and new
+ * responses, so skipping the flush DFT shows up as an error. Each block
+ * gets Gaussian ADC noise that averages down as 1/√N.
+ *
+ * SPI framing follows the driver: a set-address frame is only counted
+ * when the address changes, batched writes go out as back-to-back
+ * frames on ad5940_batch_flush(), and ad5940_spi_get_stats() reports
+ * the same counters as ad5940_sim_get_stats().
+ *
+ * Time comes from the Zephyr clock (k_uptime_ticks); every SPI
+ * transaction advances it with k_busy_wait() by its bus time. On the
+ * host the shim kernel makes this a virtual clock, so a full sweep
+ * "takes" its real duration in microseconds of CPU time.
+ */
+#ifndef AD5940_SIM_H
+#define AD5940_SIM_H
+
+#include <stdint.h>
+
+#include "eis_fit.h"
+
+/**
+ * @brief Simulated load and analogue front end.
+ */
+typedef struct {
+    eis_model_t load_model;                 /**< Circuit on the sensor path */
+    float       load_p[EIS_FIT_MAX_PARAMS]; /**< Parameters, see eis_fit.h */
+    float       rcal_ohms;        /**< Resistor on the RCAL path */
+    float       noise_codes_rms;  /**< ADC noise per sample (LSB rms) */
+    float       delay_us;         /**< Common signal-chain group delay */
+    uint32_t    seed;             /**< Noise RNG seed (non-zero) */
+    uint32_t    spi_hz;           /**< Bus clock used for transaction time */
+} ad5940_sim_config_t;
+
+/**
+ * @brief SPI and DFT activity counters since the last reset.
+ */
+typedef struct {
+    uint32_t transactions;  /**< CS-low … CS-high frames */
+    uint32_t bytes;         /**< Bytes clocked on the bus */
+    uint32_t bus_us;        /**< Time spent in SPI frames */
+    uint32_t reg_reads;
+    uint32_t reg_writes;
+    uint32_t dft_blocks;    /**< DFT blocks completed */
+    uint32_t fifo_lost;     /**< Words popped by READFIFO but never clocked out */
+    uint32_t fifo_short;    /**< READFIFO frames under AD5940_FIFO_BURST_MIN words */
+} ad5940_sim_stats_t;
+
+/**
+ * @brief Default model: 2-wire Randles cell (Rs 200 Ω, Rct 5 kΩ,
+ *        Cdl 1 µF), RCAL 9910 Ω, 3 LSB noise, 2 µs delay, 8 MHz SPI.
+ */
+ad5940_sim_config_t ad5940_sim_default_config(void);
+
+/**
+ * @brief Apply a model. Also resets the register file and statistics,
+ *        as a hardware reset would.
+ */
+void ad5940_sim_configure(const ad5940_sim_config_t *cfg);
+
+/**
+ * @brief Read the activity counters.
+ */
+void ad5940_sim_get_stats(ad5940_sim_stats_t *stats);
+
+/**
+ * @brief Zero the activity counters (model state is kept).
+ */
+void ad5940_sim_reset_stats(void);
+
+/**
+ * @brief Replace the data FIFO contents with @p count known words, for
+ *        checking the read path word by word.
+ */
+void ad5940_sim_fifo_load(const uint32_t *words, size_t count);
+
+#endif /* AD5940_SIM_H */
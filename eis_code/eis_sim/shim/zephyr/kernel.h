@@ -0,0 +1,79 @@
+/**
+ * @file kernel.h
+ * @brief Minimal host stand-in for <zephyr/kernel.h>.
+ *
+ * Just enough of the kernel API for the EIS engine and the AD5940
+ * simulator. Time is virtual: sleeping and busy-waiting advance a
+ * microsecond counter instantly, so benchmarks report device time,
+ * not host time. One tick is one microsecond; the "CPU" runs at 64 MHz
+ * like the nRF52840.
+ */
+#ifndef SIM_ZEPHYR_KERNEL_H
+#define SIM_ZEPHYR_KERNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <errno.h>
+
+#ifndef BIT
+#define BIT(n)          (1UL << (n))
+#endif
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MIN(a, b)       (((a) < (b)) ? (a) : (b))
+#define ARG_UNUSED(x)   (void)(x)
+
+#define SIM_CPU_HZ      64000000u
+
+/* Virtual uptime in microseconds (zephyr_shim.c) */
+extern int64_t sim_uptime_us;
+
+/* Set to silence printk, e.g. the per-point sweep log in benchmarks */
+extern bool sim_printk_quiet;
+
+void printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static inline int32_t k_msleep(int32_t ms)
+{
+    sim_uptime_us += ms * 1000LL;
+    return 0;
+}
+
+static inline int32_t k_usleep(int32_t us)
+{
+    sim_uptime_us += us;
+    return 0;
+}
+
+static inline void k_busy_wait(uint32_t us)
+{
+    sim_uptime_us += us;
+}
+
+static inline int64_t k_uptime_get(void)
+{
+    return sim_uptime_us / 1000;
+}
+
+static inline int64_t k_uptime_ticks(void)
+{
+    return sim_uptime_us;
+}
+
+static inline uint64_t k_ticks_to_us_floor64(uint64_t t)
+{
+    return t;
+}
+
+static inline uint32_t k_cycle_get_32(void)
+{
+    return (uint32_t)(sim_uptime_us * (SIM_CPU_HZ / 1000000u));
+}
+
+static inline uint64_t k_cyc_to_us_floor64(uint64_t cyc)
+{
+    return cyc / (SIM_CPU_HZ / 1000000u);
+}
+
+#endif /* SIM_ZEPHYR_KERNEL_H */
@@ -0,0 +1,35 @@
+/**
+ * @file log.h
+ * @brief Minimal host stand-in for <zephyr/logging/log.h>.
+ *
+ * Errors and warnings go to stderr; info is printed only when
+ * SIM_LOG_VERBOSE is defined, so benchmark output stays parseable.
+ */
+#ifndef SIM_ZEPHYR_LOG_H
+#define SIM_ZEPHYR_LOG_H
+
+#include <stdio.h>
+
+#ifndef CONFIG_LOG_DEFAULT_LEVEL
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#endif
+
+#define LOG_MODULE_REGISTER(name, level) \
+    static const char *const sim_log_module = #name
+
+#define SIM_LOG(stream, lvl, fmt, ...) \
+    fprintf(stream, "[%s] <" lvl "> " fmt "\n", sim_log_module, ##__VA_ARGS__)
+
+#define LOG_ERR(fmt, ...) SIM_LOG(stderr, "err", fmt, ##__VA_ARGS__)
+#define LOG_WRN(fmt, ...) SIM_LOG(stderr, "wrn", fmt, ##__VA_ARGS__)
+
+#ifdef SIM_LOG_VERBOSE
+#define LOG_INF(fmt, ...) SIM_LOG(stdout, "inf", fmt, ##__VA_ARGS__)
+#define LOG_DBG(fmt, ...) SIM_LOG(stdout, "dbg", fmt, ##__VA_ARGS__)
+#else
+/* Never printed, but the arguments still count as used */
+#define LOG_INF(fmt, ...) do { if (0) SIM_LOG(stdout, "inf", fmt, ##__VA_ARGS__); } while (0)
+#define LOG_DBG(fmt, ...) do { if (0) SIM_LOG(stdout, "dbg", fmt, ##__VA_ARGS__); } while (0)
+#endif
+
+#endif /* SIM_ZEPHYR_LOG_H */
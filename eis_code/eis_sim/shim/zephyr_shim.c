@@ -0,0 +1,22 @@
+/**
+ * @file zephyr_shim.c
+ * @brief Storage and printk for the host kernel shim (see zephyr/kernel.h).
+ */
+
+#include <stdarg.h>
+
+#include <zephyr/kernel.h>
+
+int64_t sim_uptime_us;
+bool    sim_printk_quiet;
+
+void printk(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!sim_printk_quiet) {
+        va_start(ap, fmt);
+        vprintf(fmt, ap);
+        va_end(ap);
+    }
+}
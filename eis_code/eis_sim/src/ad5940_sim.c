@@ -0,0 +1,661 @@
+/**
+ * @file ad5940_sim.c
+ * @brief Register-level AD5940 model implementing ad5940_spi.h.
+ *
+ * See ad5940_sim.h for what is modelled. Only Zephyr kernel and logging
+ * APIs are used, so the same file links into a native_sim build or,
+ * through the shim headers in eis_sim/shim, into a plain host binary.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ad5940_spi.h"
+#include "ad5940_regs.h"
+#include "ad5940_sim.h"
+
+LOG_MODULE_REGISTER(ad5940_sim, CONFIG_LOG_DEFAULT_LEVEL);
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* ---------- Analogue constants -------------------------------------- */
+
+#define HSDAC_FS_V        0.607f    /* Excitation peak at code 2048, gain 2 */
+#define ADC_FS_V          0.9f      /* ±0.9 V ADC input range */
+#define ADC_FS_CODES      32768.0f
+/*
+ * DFT output per ADC code of sine amplitude. A full-scale sine lands
+ * near 18-bit full scale; N only changes the noise, since the engine
+ * only ever uses RCAL / sensor ratios.
+ */
+#define DFT_GAIN          4.0f
+#define DFT_MAX           131071.0f
+
+#define SWT_RCAL1         (1u << 11)
+
+/* Per-frame CS / GPIO overhead on top of the clocked bytes */
+#define SPI_FRAME_OVERHEAD_NS  1500u
+
+static const float pga_gain[] = { 1.0f, 1.5f, 2.0f, 4.0f, 9.0f };
+
+/* ---------- Model state --------------------------------------------- */
+
+#define REG_SPACE_WORDS  ((0x3014 / 4) + 1)
+
+/* Everything that shapes the DFT input signal */
+typedef struct {
+    float freq_hz;
+    float amp_v;        /* excitation peak */
+    bool  rcal_path;
+    bool  connected;    /* any T switch closed */
+    float rtia_ohms;
+    float pga;
+    bool  running;      /* WG + ADC + DFT enabled */
+} signal_state_t;
+
+static ad5940_sim_config_t sim_cfg;
+static ad5940_sim_stats_t  stats;
+static uint32_t            regs[REG_SPACE_WORDS];
+static bool                configured;
+
+static signal_state_t sig_cur;
+static signal_state_t sig_prev;
+static int64_t        sig_change_us;
+
+static int64_t  dft_epoch_us;      /* start of block 0 */
+static uint32_t dft_blocks_done;
+static float    dft_real, dft_imag;
+static bool     dft_flag;
+
+/* Data FIFO (DFT source): real, imag pairs as 18-bit codes */
+#define FIFO_WORDS  512u
+static uint32_t fifo[FIFO_WORDS];
+static uint32_t fifo_head, fifo_count;
+
+static uint32_t rng_state;
+static uint32_t spi_ns_accum;
+static int32_t  cur_addr = -1;     /* address register, -1 = unknown */
+
+/* Queue behind ad5940_batch_write(), same semantics as the driver */
+static struct {
+    uint16_t addr;
+    uint32_t data;
+} batch[AD5940_BATCH_MAX];
+static size_t batch_len;
+
+/* ---------- Helpers ------------------------------------------------- */
+
+static int64_t now_us(void)
+{
+    return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static float rand_gauss(void)
+{
+    /* xorshift32 + Box–Muller */
+    float u[2];
+    for (int i = 0; i < 2; i++) {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        u[i] = ((rng_state >> 8) + 0.5f) / 16777216.0f;
+    }
+    return sqrtf(-2.0f * logf(u[0])) * cosf(2.0f * (float)M_PI * u[1]);
+}
+
+static uint32_t reg_get(uint16_t addr)
+{
+    return (addr / 4 < REG_SPACE_WORDS) ? regs[addr / 4] : 0;
+}
+
+static bool high_power(void)
+{
+    return reg_get(REG_PMBW) & PMBW_SYSHS;
+}
+
+static float dft_rate_hz(void)
+{
+    uint32_t f = reg_get(REG_ADCFILTERCON);
+    float adc = (f & ADCFILTERCON_ADCSAMPLERATE) ? 800e3f : 1.6e6f;
+    static const float osr[] = { 5.0f, 4.0f, 2.0f, 2.0f };
+
+    return adc / osr[(f & ADCFILTERCON_SINC3OSR_MASK) >>
+                     ADCFILTERCON_SINC3OSR_SHIFT];
+}
+
+static uint32_t dft_len(void)
+{
+    return 4u << ((reg_get(REG_DFTCON) & DFTCON_DFTNUM_MASK) >>
+                  DFTCON_DFTNUM_SHIFT);
+}
+
+static int64_t dft_period_us(void)
+{
+    int64_t p = (int64_t)(dft_len() * 1e6f / dft_rate_hz());
+    return p > 0 ? p : 1;
+}
+
+static bool signal_equal(const signal_state_t *a, const signal_state_t *b)
+{
+    return a->freq_hz == b->freq_hz && a->amp_v == b->amp_v &&
+           a->rcal_path == b->rcal_path && a->connected == b->connected &&
+           a->rtia_ohms == b->rtia_ohms && a->pga == b->pga &&
+           a->running == b->running;
+}
+
+static signal_state_t decode_signal(void)
+{
+    signal_state_t s;
+    uint32_t afecon = reg_get(REG_AFECON);
+    uint32_t tsw    = reg_get(REG_TSWFULLCON);
+    uint32_t rtia   = reg_get(REG_HSRTIACON) & HSRTIACON_RTIACON_MASK;
+    uint32_t gn     = (reg_get(REG_ADCCON) & ADCCON_GNPGA_MASK) >>
+                      ADCCON_GNPGA_SHIFT;
+    float aclk      = high_power() ? 32e6f : 16e6f;
+
+    s.freq_hz   = (float)reg_get(REG_WGFCW) * aclk / (float)(1UL << 30);
+    s.amp_v     = (float)(reg_get(REG_WGAMPLITUDE) & 0x7FF) / 2048.0f *
+                  HSDAC_FS_V;
+    s.rcal_path = tsw & SWT_RCAL1;
+    s.connected = tsw != 0;
+    s.rtia_ohms = (rtia < ARRAY_SIZE(hsrtia_ohms)) ? hsrtia_ohms[rtia] : 1e9f;
+    s.pga       = pga_gain[gn < ARRAY_SIZE(pga_gain) ? gn : 0];
+    s.running   = (afecon & AFECON_DFTEN) && (afecon & AFECON_ADCCONVEN) &&
+                  (afecon & AFECON_WAVEGENEN);
+    return s;
+}
+
+/*
+ * Noise-free DFT of one signal state, as the engine expects it:
+ * DFT ∝ conj(V / Z), so Z = RCAL · DFT_rcal / DFT_sensor.
+ */
+static void ideal_dft(const signal_state_t *s, float *re, float *im)
+{
+    float zr, zi;
+
+    *re = 0;
+    *im = 0;
+    if (!s->running || !s->connected || s->freq_hz <= 0) {
+        return;
+    }
+
+    if (s->rcal_path) {
+        zr = sim_cfg.rcal_ohms;
+        zi = 0;
+    } else {
+        eis_model_impedance(sim_cfg.load_model, sim_cfg.load_p, s->freq_hz,
+                            &zr, &zi);
+    }
+
+    /* Current phasor I = V / Z, then TIA + PGA into ADC codes */
+    float d = zr * zr + zi * zi;
+    float ir = s->amp_v * zr / d;
+    float ii = -s->amp_v * zi / d;
+    float k = s->rtia_ohms * s->pga / ADC_FS_V * ADC_FS_CODES;
+
+    float vr = ir * k, vi = ii * k;
+    float mag = sqrtf(vr * vr + vi * vi);
+    if (mag > ADC_FS_CODES) {
+        /* ADC clips – crude, but enough to flag a wrong RTIA */
+        vr *= ADC_FS_CODES / mag;
+        vi *= ADC_FS_CODES / mag;
+    }
+
+    /* Common signal-chain delay cancels in the RCAL ratio */
+    float ph = -2.0f * (float)M_PI * s->freq_hz * sim_cfg.delay_us * 1e-6f;
+    float c = cosf(ph), sn = sinf(ph);
+    float rr = vr * c - vi * sn;
+    float ri = vr * sn + vi * c;
+
+    *re = DFT_GAIN * rr;
+    *im = -DFT_GAIN * ri;   /* conjugate */
+}
+
+static bool fifo_enabled(void)
+{
+    uint32_t con = reg_get(REG_FIFOCON);
+    return (con & FIFOCON_DATAFIFOEN) &&
+           (con & FIFOCON_SRCSEL_MASK) == FIFOCON_SRC_DFT;
+}
+
+static uint32_t dft_code(float v)
+{
+    return (uint32_t)(int32_t)lrintf(v) & 0x3FFFF;
+}
+
+/* Result of block @k (1-based), including the straddle mix and noise */
+static void dft_block(uint32_t k, int64_t period, float *re, float *im)
+{
+    int64_t t1 = dft_epoch_us + (int64_t)k * period;
+    int64_t t0 = t1 - period;
+    float new_r, new_i, old_r, old_i;
+
+    ideal_dft(&sig_cur, &new_r, &new_i);
+
+    if (sig_change_us > t0) {
+        /* Block straddles a change: time-weighted mix */
+        float w = (float)(sig_change_us - t0) / (float)period;
+        if (w > 1.0f) w = 1.0f;
+        ideal_dft(&sig_prev, &old_r, &old_i);
+        new_r = w * old_r + (1.0f - w) * new_r;
+        new_i = w * old_i + (1.0f - w) * new_i;
+    }
+
+    /* Hann window ENBW = 1.5 bins */
+    float sigma = DFT_GAIN * sim_cfg.noise_codes_rms *
+                  sqrtf(1.5f / (float)dft_len());
+    new_r += sigma * rand_gauss();
+    new_i += sigma * rand_gauss();
+
+    *re = fminf(fmaxf(new_r, -DFT_MAX), DFT_MAX);
+    *im = fminf(fmaxf(new_i, -DFT_MAX), DFT_MAX);
+}
+
+/* Latch the most recent completed DFT block and queue new ones in the FIFO */
+static void dft_advance(void)
+{
+    if (!sig_cur.running) {
+        return;
+    }
+
+    int64_t t = now_us();
+    int64_t period = dft_period_us();
+    uint32_t done = (t > dft_epoch_us) ? (uint32_t)((t - dft_epoch_us) / period) : 0;
+
+    if (done <= dft_blocks_done) {
+        return;
+    }
+
+    uint32_t first = dft_blocks_done + 1;
+    stats.dft_blocks += done - dft_blocks_done;
+    dft_blocks_done = done;
+
+    /* Blocks beyond what the FIFO can hold would be dropped anyway */
+    if (fifo_enabled() && done - first >= FIFO_WORDS / 2) {
+        first = done - FIFO_WORDS / 2 + 1;
+    } else if (!fifo_enabled()) {
+        first = done;
+    }
+
+    for (uint32_t k = first; k <= done; k++) {
+        dft_block(k, period, &dft_real, &dft_imag);
+        if (fifo_enabled() && fifo_count + 2 <= FIFO_WORDS) {
+            fifo[(fifo_head + fifo_count++) % FIFO_WORDS] = dft_code(dft_real);
+            fifo[(fifo_head + fifo_count++) % FIFO_WORDS] = dft_code(dft_imag);
+        }
+    }
+
+    if (reg_get(REG_INTCSEL0) & INTC_DFTRESULT) {
+        dft_flag = true;
+    }
+}
+
+static void dft_restart(void)
+{
+    dft_epoch_us = now_us();
+    dft_blocks_done = 0;
+}
+
+static uint32_t fifo_pop(void)
+{
+    if (fifo_count == 0) {
+        return 0;
+    }
+    uint32_t w = fifo[fifo_head];
+    fifo_head = (fifo_head + 1) % FIFO_WORDS;
+    fifo_count--;
+    return w;
+}
+
+static void spi_frame(uint32_t bytes)
+{
+    uint32_t hz = sim_cfg.spi_hz ? sim_cfg.spi_hz : 8000000u;
+    uint32_t ns = (uint32_t)((uint64_t)bytes * 8u * 1000000000u / hz) +
+                  SPI_FRAME_OVERHEAD_NS;
+
+    stats.transactions++;
+    stats.bytes += bytes;
+
+    spi_ns_accum += ns;
+    uint32_t us = spi_ns_accum / 1000u;
+    if (us) {
+        spi_ns_accum -= us * 1000u;
+        stats.bus_us += us;
+        k_busy_wait(us);
+    }
+}
+
+/* SETADDR frame, skipped when the address is already selected */
+static void set_addr(uint16_t addr)
+{
+    if (cur_addr == addr) {
+        return;
+    }
+    spi_frame(3);
+    cur_addr = addr;
+}
+
+static inline bool is_32bit_reg(uint16_t addr)
+{
+    return (addr >= 0x1000) && (addr <= 0x3014);
+}
+
+/* ---------- Sim control --------------------------------------------- */
+
+ad5940_sim_config_t ad5940_sim_default_config(void)
+{
+    ad5940_sim_config_t c = {
+        .load_model      = EIS_MODEL_RANDLES,
+        .load_p          = { 200.0f, 5000.0f, 1e-6f, 0.0f },
+        .rcal_ohms       = 9910.0f,
+        .noise_codes_rms = 3.0f,
+        .delay_us        = 2.0f,
+        .seed            = 0x2545F491u,
+        .spi_hz          = 8000000u,
+    };
+    return c;
+}
+
+void ad5940_sim_configure(const ad5940_sim_config_t *cfg)
+{
+    sim_cfg = *cfg;
+    rng_state = cfg->seed ? cfg->seed : 1u;
+    configured = true;
+
+    memset(regs, 0, sizeof(regs));
+    memset(&sig_cur, 0, sizeof(sig_cur));
+    sig_prev = sig_cur;
+    sig_change_us = 0;
+    dft_flag = false;
+    dft_real = dft_imag = 0;
+    fifo_head = fifo_count = 0;
+    cur_addr = -1;
+    batch_len = 0;
+    dft_restart();
+    ad5940_sim_reset_stats();
+}
+
+void ad5940_sim_get_stats(ad5940_sim_stats_t *out)
+{
+    *out = stats;
+}
+
+void ad5940_sim_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    spi_ns_accum = 0;
+}
+
+/* ---------- ad5940_spi.h API ---------------------------------------- */
+
+int ad5940_spi_init(void)
+{
+    if (!configured) {
+        ad5940_sim_config_t c = ad5940_sim_default_config();
+        ad5940_sim_configure(&c);
+    }
+    LOG_INF("AD5940 simulator: %s load, RCAL %.0f Ω",
+            eis_model_name(sim_cfg.load_model), (double)sim_cfg.rcal_ohms);
+    return 0;
+}
+
+void ad5940_hw_reset(void)
+{
+    ad5940_sim_config_t c = sim_cfg;
+    ad5940_sim_configure(&c);
+    k_msleep(1);
+    k_msleep(10);
+}
+
+int ad5940_write_reg(uint16_t addr, uint32_t data)
+{
+    set_addr(addr);
+    spi_frame(is_32bit_reg(addr) ? 5 : 3);
+    stats.reg_writes++;
+
+    /* Anything already completed was computed with the old settings */
+    dft_advance();
+
+    if (addr == REG_INTCCLR) {
+        if (data & INTC_DFTRESULT) {
+            dft_flag = false;
+        }
+        return 0;
+    }
+
+    if (addr / 4 < REG_SPACE_WORDS) {
+        regs[addr / 4] = data;
+    }
+
+    switch (addr) {
+    case REG_FIFOCON:
+        /* Clearing DATAFIFOEN empties the FIFO */
+        if (!(data & FIFOCON_DATAFIFOEN)) {
+            fifo_head = fifo_count = 0;
+        }
+        break;
+    case REG_AFECON:
+    case REG_DFTCON:
+    case REG_ADCFILTERCON:
+    case REG_PMBW:
+        /* DFT pipeline restarts from an empty block */
+        dft_restart();
+        /* fall through */
+    case REG_WGFCW:
+    case REG_WGAMPLITUDE:
+    case REG_TSWFULLCON:
+    case REG_HSRTIACON:
+    case REG_ADCCON: {
+        signal_state_t s = decode_signal();
+        if (!signal_equal(&s, &sig_cur)) {
+            sig_prev = sig_cur;
+            sig_cur = s;
+            sig_change_us = now_us();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+int ad5940_read_reg(uint16_t addr, uint32_t *data)
+{
+    set_addr(addr);
+    spi_frame(is_32bit_reg(addr) ? 6 : 4);
+    stats.reg_reads++;
+
+    dft_advance();
+
+    switch (addr) {
+    case REG_ADIID:
+        *data = 0x4144;
+        break;
+    case REG_CHIPID:
+        *data = 0x5502;
+        break;
+    case REG_INTCFLAG0:
+        *data = dft_flag ? INTC_DFTRESULT : 0;
+        break;
+    case REG_DFTREAL:
+        *data = dft_code(dft_real);
+        break;
+    case REG_DFTIMAG:
+        *data = dft_code(dft_imag);
+        break;
+    case REG_FIFOCNTSTA:
+        *data = (fifo_count << FIFOCNTSTA_CNT_SHIFT) & FIFOCNTSTA_CNT_MASK;
+        break;
+    case REG_DATAFIFORD:
+        *data = fifo_pop();
+        break;
+    default:
+        *data = reg_get(addr);
+        break;
+    }
+
+    return 0;
+}
+
+int ad5940_read_regs(const uint16_t *addrs, uint32_t *data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        ad5940_read_reg(addrs[i], &data[i]);
+    }
+    return 0;
+}
+
+int ad5940_batch_write(uint16_t addr, uint32_t data)
+{
+    for (size_t i = 0; i < batch_len; i++) {
+        if (batch[i].addr == addr) {
+            batch[i].data = data;
+            return 0;
+        }
+    }
+
+    if (batch_len == AD5940_BATCH_MAX) {
+        ad5940_batch_flush();
+    }
+
+    batch[batch_len].addr = addr;
+    batch[batch_len].data = data;
+    batch_len++;
+    return 0;
+}
+
+int ad5940_batch_flush(void)
+{
+    for (size_t i = 0; i < batch_len; i++) {
+        ad5940_write_reg(batch[i].addr, batch[i].data);
+    }
+    batch_len = 0;
+    return 0;
+}
+
+/*
+ * One READFIFO frame as the chip runs it. Two words are prefetched
+ * during the dummy bytes, and each word clocked out with a zero offset
+ * prefetches the next one; a non-zero offset does not. Words still
+ * prefetched when CS rises have left the FIFO for good.
+ */
+static void readfifo_frame(const uint8_t *tx, uint32_t *buf, size_t n)
+{
+    uint32_t pre[2] = { 0, 0 };
+    size_t   held = 0;
+
+    spi_frame(7 + 4 * n);
+    if (n < AD5940_FIFO_BURST_MIN) {
+        stats.fifo_short++;
+    }
+
+    while (held < 2 && fifo_count > 0) {
+        pre[held++] = fifo_pop();
+    }
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *off = &tx[7 + 4 * i];
+
+        buf[i] = held ? pre[0] : 0;
+        if (held) {
+            pre[0] = pre[1];
+            held--;
+        }
+        if ((off[0] | off[1] | off[2] | off[3]) == 0 && fifo_count > 0) {
+            pre[held++] = fifo_pop();
+        }
+    }
+    stats.fifo_lost += held;
+}
+
+int ad5940_read_fifo(uint32_t *buf, size_t count)
+{
+    if (count < AD5940_FIFO_BURST_MIN) {
+        for (size_t i = 0; i < count; i++) {
+            ad5940_read_reg(REG_DATAFIFORD, &buf[i]);
+        }
+        return 0;
+    }
+
+    /* Same frames as the driver, decoded from their offset words */
+    static uint8_t tx[7 + 4 * AD5940_FIFO_BURST_MAX];
+
+    dft_advance();
+    while (count > 0) {
+        size_t n = ad5940_fifo_frame_words(count);
+
+        ad5940_fifo_frame_tx(tx, n);
+        readfifo_frame(tx, buf, n);
+        buf += n;
+        count -= n;
+    }
+    cur_addr = -1;
+    return 0;
+}
+
+void ad5940_sim_fifo_load(const uint32_t *words, size_t count)
+{
+    fifo_head = 0;
+    fifo_count = MIN(count, (size_t)FIFO_WORDS);
+    memcpy(fifo, words, fifo_count * sizeof(words[0]));
+}
+
+void ad5940_spi_get_stats(ad5940_spi_stats_t *out)
+{
+    out->transactions = stats.transactions;
+    out->bytes        = stats.bytes;
+    out->bus_us       = stats.bus_us;
+}
+
+void ad5940_spi_reset_stats(void)
+{
+    ad5940_sim_reset_stats();
+}
+
+int ad5940_chip_init(void)
+{
+    /* Same register traffic as the real init sequence (14 writes) */
+    for (int i = 0; i < 14; i++) {
+        spi_frame(3);
+        spi_frame(5);
+        stats.reg_writes++;
+    }
+    cur_addr = -1;
+    return 0;
+}
+
+int ad5940_verify_id(void)
+{
+    uint32_t id = 0;
+    ad5940_read_reg(REG_ADIID, &id);
+    if (id != 0x4144) {
+        return -1;
+    }
+    LOG_INF("ADIID verified: 0x%04X (simulated)", id);
+    return 0;
+}
+
+int ad5940_wait_interrupt(uint32_t timeout_ms)
+{
+    int64_t deadline = now_us() + (int64_t)timeout_ms * 1000;
+
+    dft_advance();
+    while (!dft_flag) {
+        if (!sig_cur.running || now_us() >= deadline) {
+            return -ETIMEDOUT;
+        }
+        /* Jump straight to the next block boundary */
+        int64_t period = dft_period_us();
+        int64_t next = dft_epoch_us + (int64_t)(dft_blocks_done + 1) * period;
+        int64_t wait = next - now_us();
+        k_busy_wait(wait > 0 ? (uint32_t)wait : 1u);
+        dft_advance();
+    }
+    return 0;
+}
@@ -0,0 +1,270 @@
+/**
+ * @file sim_bench.c
+ * @brief Run the unmodified EIS engine against the AD5940 simulator.
+ *
+ * For each simulated load and DFT length this performs the same steps as
+ * the firmware (SPI init, reset, chip init, eis_init, eis_run_sweep) and
+ * reports, in device time:
+ *
+ *   - sweep duration and per-point time
+ *   - SPI frames, bytes and bus time
+ *   - worst |Z| and phase error against the true load
+ *   - the equivalent-circuit fit of the recovered sweep
+ *
+ * It then measures single-frequency tracking throughput against the
+ * theoretical DFT rate, and reads known words through ad5940_read_fifo()
+ * at lengths around the burst limits.
+ *
+ * Usage: eis_sim_bench [-v]   (-v prints the engine's own sweep log)
+ *
+ * Exit status is non-zero if a 16384-point sweep misses the true load by
+ * more than 1 % in |Z| or 1° in phase, so the binary doubles as a
+ * regression test for the engine's measurement sequence. It is also
+ * non-zero if any READFIFO frame loses a word or is shorter than the
+ * AD5940 allows, or a FIFO read returns the wrong words.
+ */
+
+#include <zephyr/kernel.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ad5940_eis.h"
+#include "ad5940_regs.h"
+#include "ad5940_spi.h"
+#include "ad5940_sim.h"
+#include "eis_fit.h"
+
+#define TRACK_SAMPLES   100
+#define TRACK_FREQ_HZ   1000.0f
+
+typedef struct {
+    const char *name;
+    eis_model_t model;
+    float       p[EIS_FIT_MAX_PARAMS];
+    uint8_t     rtia_sel;
+} load_case_t;
+
+static const load_case_t loads[] = {
+    { "Randles 200R/5k/1uF",   EIS_MODEL_RANDLES,     { 200.0f, 5000.0f, 1e-6f },          HSRTIA_5K },
+    { "CPE 150R/8k/2u/0.8",    EIS_MODEL_RANDLES_CPE, { 150.0f, 8000.0f, 2e-6f, 0.8f },    HSRTIA_5K },
+    { "Warburg 100R/2k/2u/3k", EIS_MODEL_RANDLES_W,   { 100.0f, 2000.0f, 2e-6f, 3000.0f }, HSRTIA_1K },
+};
+
+static const uint8_t dft_lengths[] = { DFTNUM_1024, DFTNUM_4096, DFTNUM_16384 };
+
+/* Word counts around the single-read / burst boundary and frame splits */
+static const uint16_t fifo_reads[] = { 1, 2, 3, 4, 5, 63, 64, 65, 66, 67, 130, 200 };
+
+/* READFIFO words lost or short frames, summed over every run */
+static uint32_t fifo_errors;
+
+/* Same settings as build_config() in the firmware main.c */
+static eis_config_t bench_config(uint8_t dft_num, uint8_t rtia_sel)
+{
+    eis_config_t cfg = eis_default_config();
+
+    cfg.freq_start_hz   = 100.0f;
+    cfg.freq_stop_hz    = 100000.0f;
+    cfg.num_points      = 40;
+    cfg.excit_amplitude = 33;
+    cfg.rtia_sel        = rtia_sel;
+    cfg.dft_num         = dft_num;
+    cfg.pga_gain        = ADCPGA_1P5;
+    cfg.rcal_ohms       = 9910.0f;
+    cfg.sw_sensor       = EIS_SWITCH_2WIRE;
+    cfg.sw_rcal         = EIS_SWITCH_RCAL;
+    return cfg;
+}
+
+static void bring_up(const load_case_t *load)
+{
+    ad5940_sim_config_t sim = ad5940_sim_default_config();
+
+    sim.load_model = load->model;
+    memcpy(sim.load_p, load->p, sizeof(sim.load_p));
+    sim.rcal_ohms = 9910.0f;
+    ad5940_sim_configure(&sim);
+
+    ad5940_spi_init();
+    ad5940_hw_reset();
+    ad5940_chip_init();
+    ad5940_verify_id();
+}
+
+static int bench_sweeps(void)
+{
+    static eis_result_t result;
+    int failures = 0;
+
+    printf("# Sweeps: 40 pts, 100 Hz - 100 kHz (device time)\n");
+    printf("load,dft_pts,sweep_ms,ms_per_pt,spi_frames,spi_kbytes,spi_bus_ms,"
+           "dft_blocks,max_mag_err_pct,max_phase_err_deg,fit_rms,fit_params\n");
+
+    for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+        for (size_t d = 0; d < sizeof(dft_lengths); d++) {
+            const load_case_t *load = &loads[l];
+            eis_config_t cfg = bench_config(dft_lengths[d], load->rtia_sel);
+            ad5940_sim_stats_t st;
+
+            bring_up(load);
+            if (eis_init(&cfg) != 0) {
+                fprintf(stderr, "eis_init failed\n");
+                return 1;
+            }
+
+            ad5940_sim_reset_stats();
+            int64_t t0 = k_uptime_get();
+            int ret = eis_run_sweep(&cfg, &result);
+            int64_t sweep_ms = k_uptime_get() - t0;
+            ad5940_sim_get_stats(&st);
+            fifo_errors += st.fifo_lost + st.fifo_short;
+
+            if (ret != 0) {
+                fprintf(stderr, "%s: sweep failed (%d)\n", load->name, ret);
+                failures++;
+                continue;
+            }
+
+            /* Accuracy against the true load */
+            float max_mag = 0, max_ph = 0;
+            for (uint16_t i = 0; i < result.count; i++) {
+                const eis_point_t *pt = &result.points[i];
+                float zr, zi;
+                eis_model_impedance(load->model, load->p, pt->freq_hz, &zr, &zi);
+                float mag = sqrtf(zr * zr + zi * zi);
+                float ph = atan2f(zi, zr) * (180.0f / 3.14159265f);
+                max_mag = fmaxf(max_mag, fabsf(pt->mag_ohms / mag - 1.0f) * 100.0f);
+                max_ph = fmaxf(max_ph, fabsf(pt->phase_deg - ph));
+            }
+
+            if (dft_lengths[d] == DFTNUM_16384 &&
+                (!(max_mag < 1.0f) || !(max_ph < 1.0f))) {
+                failures++;
+            }
+
+            eis_fit_result_t fit;
+            bool fit_ok = eis_fit_model(&result, load->model, NULL, NULL, &fit) == 0;
+
+            printf("%s,%u,%lld,%.1f,%u,%.1f,%.1f,%u,%.3f,%.3f,",
+                   load->name, 4u << dft_lengths[d], (long long)sweep_ms,
+                   (double)sweep_ms / result.count, st.transactions,
+                   st.bytes / 1024.0, st.bus_us / 1000.0, st.dft_blocks,
+                   (double)max_mag, (double)max_ph);
+            if (fit_ok) {
+                printf("%.2e,", (double)fit.rms_rel_err);
+                for (int k = 0; k < fit.num_params; k++) {
+                    printf("%s%.4g", k ? " " : "", (double)fit.p[k]);
+                }
+            } else {
+                printf("-,-");
+            }
+            printf("\n");
+        }
+    }
+
+    return failures;
+}
+
+static void bench_tracking(void)
+{
+    eis_track_config_t track = { .freqs_hz = { TRACK_FREQ_HZ }, .num_freqs = 1 };
+    eis_track_sample_t s;
+
+    printf("\n# Tracking @ %.0f Hz, %d samples (device time)\n",
+           (double)TRACK_FREQ_HZ, TRACK_SAMPLES);
+    printf("dft_pts,dft_us,ideal_sps,actual_sps,spi_frames_per_sample,"
+           "mag_mean,mag_std\n");
+
+    for (uint8_t n = DFTNUM_64; n <= DFTNUM_16384; n += 2) {
+        eis_config_t cfg = bench_config(n, loads[0].rtia_sel);
+        ad5940_sim_stats_t st;
+
+        bring_up(&loads[0]);
+        eis_init(&cfg);
+        if (eis_track_start(&cfg, &track) != 0) {
+            fprintf(stderr, "tracking start failed\n");
+            return;
+        }
+
+        ad5940_sim_reset_stats();
+        int64_t t0 = sim_uptime_us;
+        double sum = 0, sum2 = 0;
+        for (int i = 0; i < TRACK_SAMPLES; i++) {
+            eis_track_next(&s);
+            sum += s.point.mag_ohms;
+            sum2 += (double)s.point.mag_ohms * s.point.mag_ohms;
+        }
+        int64_t dt = sim_uptime_us - t0;
+        eis_track_stop();
+        ad5940_sim_get_stats(&st);
+        fifo_errors += st.fifo_lost + st.fifo_short;
+
+        double mean = sum / TRACK_SAMPLES;
+        double var = sum2 / TRACK_SAMPLES - mean * mean;
+        uint32_t dft_us = eis_dft_duration_us(&cfg, TRACK_FREQ_HZ);
+
+        printf("%u,%u,%.1f,%.1f,%.1f,%.2f,%.3f\n",
+               4u << n, dft_us, 1e6 / dft_us, TRACK_SAMPLES * 1e6 / dt,
+               (double)st.transactions / TRACK_SAMPLES, mean,
+               var > 0 ? sqrt(var) : 0.0);
+    }
+}
+
+/* Returns the number of reads that did not return the loaded words in order */
+static int bench_fifo_reads(void)
+{
+    static uint32_t words[256], out[256];
+    int failures = 0;
+
+    printf("\n# FIFO reads: 8 words left behind each read\n");
+    printf("words,spi_frames,spi_bytes,left,ok\n");
+
+    for (size_t k = 0; k < sizeof(fifo_reads) / sizeof(fifo_reads[0]); k++) {
+        size_t n = fifo_reads[k];
+        ad5940_sim_stats_t st;
+        uint32_t cnt = 0;
+
+        bring_up(&loads[0]);
+        for (size_t i = 0; i < n + 8; i++) {
+            words[i] = 0x10000u + i;
+        }
+        ad5940_sim_fifo_load(words, n + 8);
+
+        ad5940_sim_reset_stats();
+        memset(out, 0, sizeof(out));
+        ad5940_read_fifo(out, n);
+        ad5940_sim_get_stats(&st);
+        fifo_errors += st.fifo_lost + st.fifo_short;
+
+        ad5940_read_reg(REG_FIFOCNTSTA, &cnt);
+        cnt = (cnt & FIFOCNTSTA_CNT_MASK) >> FIFOCNTSTA_CNT_SHIFT;
+
+        bool ok = memcmp(out, words, n * sizeof(words[0])) == 0 && cnt == 8;
+        if (!ok) {
+            failures++;
+        }
+        printf("%u,%u,%u,%u,%s\n", (unsigned)n, st.transactions, st.bytes,
+               cnt, ok ? "yes" : "NO");
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    sim_printk_quiet = !(argc > 1 && strcmp(argv[1], "-v") == 0);
+
+    int failures = bench_sweeps();
+    bench_tracking();
+    int bad_reads = bench_fifo_reads();
+
+    if (failures) {
+        fprintf(stderr, "%d sweep(s) outside 1 %% / 1 deg of the true load\n",
+                failures);
+    }
+    if (bad_reads || fifo_errors) {
+        fprintf(stderr, "FIFO: %d bad read(s), %u READFIFO protocol error(s)\n",
+                bad_reads, fifo_errors);
+    }
+    return (failures || bad_reads || fifo_errors) ? 1 : 0;
+}
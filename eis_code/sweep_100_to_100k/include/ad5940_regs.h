@@ -442,7 +442,24 @@ static const uint32_t hsrtia_ohms[] = {
 /* ====================================================================
  * DATA FIFO READ REGISTER
  * ==================================================================== */
-#define REG_DATAFIFORD      0x2084  /* 32-bit – read FIFO data */
+#define REG_DATAFIFORD      0x206C  /* 32-bit – read FIFO data */
+
+/* ====================================================================
+ * FIFO STATUS / MEMORY CONFIGURATION
+ * ==================================================================== */
+#define REG_FIFOCNTSTA      0x2200  /* 32-bit – data FIFO word count */
+#define FIFOCNTSTA_CNT_SHIFT    16
+#define FIFOCNTSTA_CNT_MASK     (0x7FF << FIFOCNTSTA_CNT_SHIFT)
+
+#define REG_CMDDATACON      0x21D8  /* 32-bit – command/data SRAM split */
+#define CMDDATACON_DATAMEMMDE_SHIFT 9
+#define CMDDATACON_DATAMEMMDE_MASK  (0x7 << CMDDATACON_DATAMEMMDE_SHIFT)
+#define CMDDATACON_DATA_MEM_SEL_SHIFT 6
+#define CMDDATACON_DATA_MEM_SEL_MASK  (0x7 << CMDDATACON_DATA_MEM_SEL_SHIFT)
+#define DATAMEMMDE_FIFO         2   /* Data memory used as FIFO */
+#define DATAFIFOSIZE_2KB        1   /* 512 words */
+#define DATAFIFOSIZE_4KB        2
+#define DATAFIFOSIZE_6KB        3
 
 /* ====================================================================
  * LOW POWER REFERENCE
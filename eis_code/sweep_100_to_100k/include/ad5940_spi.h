@@ -6,11 +6,82 @@
  * AD5940 datasheet § "SPI Interface":
  *   Transaction 1: SPICMD_SETADDR + 16-bit address
  *   Transaction 2: SPICMD_WRITEREG/READREG + data
+ *
+ * Each transaction is a single DMA transfer between manual CS edges.
+ * The set-address transaction is skipped when the register is already
+ * selected, so polling one status register costs one frame per read.
  */
 #ifndef AD5940_SPI_H
 #define AD5940_SPI_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "ad5940_regs.h"
+
+/* Writes queued by ad5940_batch_write() before an automatic flush. */
+#define AD5940_BATCH_MAX       16
+
+/* Words per READFIFO burst frame in ad5940_read_fifo(). */
+#define AD5940_FIFO_BURST_MAX  64
+
+/*
+ * Shortest READFIFO burst. The chip prefetches two words ahead, and
+ * the last two words of a frame are clocked with a non-zero offset to
+ * stop that prefetch, so a burst needs at least one word before them.
+ * Shorter reads go through REG_DATAFIFORD (AD5940_FIFORd() in the ADI
+ * library).
+ */
+#define AD5940_FIFO_BURST_MIN   3
+#define AD5940_FIFO_TAIL_OFFSET 0x44444444u
+
+/**
+ * @brief Words in the next READFIFO frame when @p remaining are left.
+ *
+ * At most AD5940_FIFO_BURST_MAX, and never leaves a tail shorter than
+ * AD5940_FIFO_BURST_MIN for the following frame.
+ */
+static inline size_t ad5940_fifo_frame_words(size_t remaining)
+{
+    size_t n = remaining < AD5940_FIFO_BURST_MAX ? remaining
+                                                 : AD5940_FIFO_BURST_MAX;
+
+    if (remaining - n > 0 && remaining - n < AD5940_FIFO_BURST_MIN) {
+        n -= AD5940_FIFO_BURST_MIN;
+    }
+    return n;
+}
+
+/**
+ * @brief Fill the transmit side of an @p n word READFIFO frame.
+ *
+ * @p tx gets 7 + 4·n bytes: the command, six dummy bytes, an offset of
+ * 0 (DATAFIFORD) for each word but the last two, and
+ * AD5940_FIFO_TAIL_OFFSET for those.
+ */
+static inline void ad5940_fifo_frame_tx(uint8_t *tx, size_t n)
+{
+    tx[0] = SPICMD_READFIFO;
+    for (size_t i = 1; i < 7 + 4 * n; i++) {
+        tx[i] = 0;
+    }
+    for (size_t i = n - 2; i < n; i++) {
+        uint8_t *w = &tx[7 + 4 * i];
+        w[0] = (uint8_t)(AD5940_FIFO_TAIL_OFFSET >> 24);
+        w[1] = (uint8_t)(AD5940_FIFO_TAIL_OFFSET >> 16);
+        w[2] = (uint8_t)(AD5940_FIFO_TAIL_OFFSET >> 8);
+        w[3] = (uint8_t)AD5940_FIFO_TAIL_OFFSET;
+    }
+}
+
+/**
+ * @brief SPI bus activity counters.
+ */
+typedef struct {
+    uint32_t transactions;  /**< CS-low … CS-high frames */
+    uint32_t bytes;         /**< Bytes clocked in those frames */
+    uint32_t bus_us;        /**< Time spent inside frames */
+} ad5940_spi_stats_t;
 
 /**
  * @brief Initialise the SPI bus, CS, RESET and GP0 (interrupt) GPIOs.
@@ -42,6 +113,59 @@ int ad5940_write_reg(uint16_t addr, uint32_t data);
  */
 int ad5940_read_reg(uint16_t addr, uint32_t *data);
 
+/**
+ * @brief Read several registers back to back.
+ *
+ * @param addrs  Register addresses.
+ * @param data   Output values, one per address.
+ * @param count  Number of registers.
+ * @return 0 on success, negative errno on failure.
+ */
+int ad5940_read_regs(const uint16_t *addrs, uint32_t *data, size_t count);
+
+/**
+ * @brief Queue a register write for the next ad5940_batch_flush().
+ *
+ * A second write to a register that is already queued replaces the
+ * queued value, so only use this for configuration registers where the
+ * last value wins (not key sequences or INTCCLR). The queue flushes
+ * itself when AD5940_BATCH_MAX writes are pending.
+ *
+ * @return 0 on success, negative errno if an automatic flush failed.
+ */
+int ad5940_batch_write(uint16_t addr, uint32_t data);
+
+/**
+ * @brief Send all queued writes, in queue order, as one burst.
+ * @return 0 on success, negative errno on failure.
+ */
+int ad5940_batch_flush(void);
+
+/**
+ * @brief Read words from the data FIFO.
+ *
+ * Fewer than AD5940_FIFO_BURST_MIN words are read through
+ * REG_DATAFIFORD. Longer reads use SPICMD_READFIFO frames of
+ * AD5940_FIFO_BURST_MIN to AD5940_FIFO_BURST_MAX words, laid out by
+ * ad5940_fifo_frame_tx().
+ * The caller must know that @p count words are available (FIFOCNTSTA).
+ *
+ * @param buf    Output words.
+ * @param count  Number of words to read.
+ * @return 0 on success, negative errno on failure.
+ */
+int ad5940_read_fifo(uint32_t *buf, size_t count);
+
+/**
+ * @brief Read the bus activity counters since the last reset.
+ */
+void ad5940_spi_get_stats(ad5940_spi_stats_t *stats);
+
+/**
+ * @brief Zero the bus activity counters.
+ */
+void ad5940_spi_reset_stats(void);
+
 /**
  * @brief Run the mandatory initialisation sequence from Table 14.
  *
@@ -47,6 +47,9 @@ static bool  rcal_valid = false;
 /* Cached config for reconfiguring per-frequency */
 static bool high_power_mode = false;
 
+/* Amplitude last written to the waveform generator (-1 = unknown) */
+static int32_t wg_amplitude = -1;
+
 /* ====================================================================
  * Helper: sign-extend 18-bit DFT result to int32_t
  * ==================================================================== */
@@ -82,6 +85,35 @@ static bool needs_high_power(float freq_hz)
     return freq_hz > 80000.0f;
 }
 
+/* ====================================================================
+ * Helper: duration of one DFT block.
+ *
+ * DFT length (4 << dft_num) over the DFT input rate: 160 kHz in
+ * low-power mode, 400 kHz in high-power mode.
+ * ==================================================================== */
+static uint32_t dft_block_us(const eis_config_t *cfg, float freq_hz)
+{
+    uint32_t rate_hz = needs_high_power(freq_hz) ? 400000u : 160000u;
+    uint32_t n = 4u << (cfg->dft_num & 0xF);
+
+    return (uint32_t)(((uint64_t)n * 1000000u) / rate_hz);
+}
+
+/* ====================================================================
+ * Helper: choose a DFT-result polling interval.
+ *
+ * Roughly 1/16 of the DFT duration, capped at 1 ms for long DFTs and
+ * floored at 20 µs (about one register read on the SPI bus).
+ * ==================================================================== */
+static uint32_t dft_poll_interval_us(const eis_config_t *cfg, float freq_hz)
+{
+    uint32_t poll = dft_block_us(cfg, freq_hz) / 16u;
+
+    if (poll > 1000u) poll = 1000u;
+    if (poll < 20u)   poll = 20u;
+    return poll;
+}
+
 /* ====================================================================
  * Helper: configure the switch matrix using xSWFULLCON registers.
  *
@@ -110,19 +142,21 @@ static int set_switch_matrix(const eis_switch_cfg_t *sw)
     int ret;
 
     /* Write each full switch control register */
-    ret = ad5940_write_reg(REG_DSWFULLCON, sw->d_mux);
+    ret = ad5940_batch_write(REG_DSWFULLCON, sw->d_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_PSWFULLCON, sw->p_mux);
+    ret = ad5940_batch_write(REG_PSWFULLCON, sw->p_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_NSWFULLCON, sw->n_mux);
+    ret = ad5940_batch_write(REG_NSWFULLCON, sw->n_mux);
     if (ret) return ret;
-    ret = ad5940_write_reg(REG_TSWFULLCON, sw->t_mux);
+    ret = ad5940_batch_write(REG_TSWFULLCON, sw->t_mux);
     if (ret) return ret;
 
     /* Set SWSOURCESEL bit to activate full control registers */
-    ret = ad5940_write_reg(REG_SWCON, SWCON_SWSOURCESEL);
+    ret = ad5940_batch_write(REG_SWCON, SWCON_SWSOURCESEL);
+    if (ret) return ret;
 
-    return ret;
+    /* Callers settle right after this, so the switches must be applied */
+    return ad5940_batch_flush();
 }
 
 /* ====================================================================
@@ -141,11 +175,11 @@ static int configure_lp_dac(float bias_v)
 
     /* Power on the LP DAC, enable writes, use 2.5 V LP reference */
     uint32_t lpdaccon0 = LPDACCON0_RSTEN;  /* bit 0 = enable writes, bit 1 = 0 (powered on) */
-    ret = ad5940_write_reg(REG_LPDACCON0, lpdaccon0);
+    ret = ad5940_batch_write(REG_LPDACCON0, lpdaccon0);
     if (ret) return ret;
 
     /* Enable LP reference buffer */
-    ret = ad5940_write_reg(REG_LPREFBUFCON, 0x00000000);
+    ret = ad5940_batch_write(REG_LPREFBUFCON, 0x00000000);
     if (ret) return ret;
 
     /*
@@ -179,7 +213,7 @@ static int configure_lp_dac(float bias_v)
     }
 
     uint32_t lpdacdat0 = (code_6 << 12) | code_12;
-    ret = ad5940_write_reg(REG_LPDACDAT0, lpdacdat0);
+    ret = ad5940_batch_write(REG_LPDACDAT0, lpdacdat0);
     if (ret) return ret;
 
     /*
@@ -189,7 +223,7 @@ static int configure_lp_dac(float bias_v)
      *   LPMODEDIS = 1: Individual switch control
      */
     uint32_t lpdacsw0 = LPDACSW0_LPMODEDIS | LPDACSW0_SW0 | LPDACSW0_SW3;
-    ret = ad5940_write_reg(REG_LPDACSW0, lpdacsw0);
+    ret = ad5940_batch_write(REG_LPDACSW0, lpdacsw0);
 
     LOG_INF("LP DAC: VZERO0=%.3fV (code6=%u), VBIAS0=%.3fV (code12=%u), bias=%.3fV",
             (double)vzero_v, code_6, (double)vbias_v, code_12, (double)bias_v);
@@ -210,7 +244,7 @@ static int configure_adc(const eis_config_t *cfg)
     adccon |= ((uint32_t)(ADCMUXN_HSTIA_N & 0x1F) << ADCCON_MUXSELN_SHIFT);
     adccon |= ((uint32_t)(cfg->pga_gain & 0x7) << ADCCON_GNPGA_SHIFT);
 
-    ret = ad5940_write_reg(REG_ADCCON, adccon);
+    ret = ad5940_batch_write(REG_ADCCON, adccon);
     if (ret) return ret;
 
     /*
@@ -235,7 +269,7 @@ static int configure_adc(const eis_config_t *cfg)
     /* Bypass the 50/60 Hz notch filter for impedance measurements */
     adcfilter |= ADCFILTERCON_LPFBYPEN;
 
-    ret = ad5940_write_reg(REG_ADCFILTERCON, adcfilter);
+    ret = ad5940_batch_write(REG_ADCFILTERCON, adcfilter);
     return ret;
 }
 
@@ -247,7 +281,7 @@ static int configure_hstia(const eis_config_t *cfg)
     int ret;
 
     /* HSTIA positive input = VZERO0 from LP DAC */
-    ret = ad5940_write_reg(REG_HSTIACON,
+    ret = ad5940_batch_write(REG_HSTIACON,
                            (HSTIA_VZERO0 << HSTIACON_VBIASSEL_SHIFT));
     if (ret) return ret;
 
@@ -267,7 +301,7 @@ static int configure_hstia(const eis_config_t *cfg)
 
     uint32_t hsrtiacon = (ctiacon << HSRTIACON_CTIACON_SHIFT) |
                          (rtia & HSRTIACON_RTIACON_MASK);
-    ret = ad5940_write_reg(REG_HSRTIACON, hsrtiacon);
+    ret = ad5940_batch_write(REG_HSRTIACON, hsrtiacon);
 
     LOG_INF("HSTIA RTIA = %u Ω, CTIA = 0x%02X", hsrtia_ohms[rtia], ctiacon);
     return ret;
@@ -288,7 +322,7 @@ static int configure_dft(const eis_config_t *cfg)
     dftcon |= ((uint32_t)(cfg->dft_num & 0xF) << DFTCON_DFTNUM_SHIFT);
     dftcon |= ((uint32_t)DFTINSEL_SINC3 << DFTCON_DFTINSEL_SHIFT);
 
-    return ad5940_write_reg(REG_DFTCON, dftcon);
+    return ad5940_batch_write(REG_DFTCON, dftcon);
 }
 
 /* ====================================================================
@@ -300,23 +334,29 @@ static int set_excitation_freq(float freq_hz, uint16_t amplitude)
 
     /* Set sine FCW */
     uint32_t fcw = freq_to_fcw(freq_hz);
-    ret = ad5940_write_reg(REG_WGFCW, fcw);
+    ret = ad5940_batch_write(REG_WGFCW, fcw);
     if (ret) return ret;
 
+    /* Amplitude, offset, phase and type only change with the amplitude */
+    if (wg_amplitude == (int32_t)amplitude) {
+        return 0;
+    }
+    wg_amplitude = (int32_t)amplitude;
+
     /* Set amplitude (11-bit unsigned) */
-    ret = ad5940_write_reg(REG_WGAMPLITUDE, (uint32_t)(amplitude & 0x7FF));
+    ret = ad5940_batch_write(REG_WGAMPLITUDE, (uint32_t)(amplitude & 0x7FF));
     if (ret) return ret;
 
     /* Offset = 0 (no DC offset on excitation) */
-    ret = ad5940_write_reg(REG_WGOFFSET, 0);
+    ret = ad5940_batch_write(REG_WGOFFSET, 0);
     if (ret) return ret;
 
     /* Phase = 0 */
-    ret = ad5940_write_reg(REG_WGPHASE, 0);
+    ret = ad5940_batch_write(REG_WGPHASE, 0);
     if (ret) return ret;
 
     /* Waveform type = Sinusoid, enable DAC offset+gain cal */
-    ret = ad5940_write_reg(REG_WGCON,
+    ret = ad5940_batch_write(REG_WGCON,
                            WGCON_TYPE_SINE |
                            WGCON_DACGAINCAL |
                            WGCON_DACOFFSETCAL);
@@ -341,7 +381,7 @@ static int configure_hsdac(void)
     uint32_t hsdaccon = (rate << HSDACCON_RATE_SHIFT);
     /* Gain = 2 (INAMPGNMDE = 0), no attenuation (ATTENEN = 0) */
 
-    return ad5940_write_reg(REG_HSDACCON, hsdaccon);
+    return ad5940_batch_write(REG_HSDACCON, hsdaccon);
 }
 
 /* ====================================================================
@@ -358,7 +398,7 @@ static int configure_power_mode(bool hp)
         pmbw = 0;
     }
     high_power_mode = hp;
-    return ad5940_write_reg(REG_PMBW, pmbw);
+    return ad5940_batch_write(REG_PMBW, pmbw);
 }
 
 /* ====================================================================
@@ -396,64 +436,93 @@ static int power_up_afe(void)
                       AFECON_ADCEN      |
                       AFECON_DACEN;
 
-    return ad5940_write_reg(REG_AFECON, afecon);
+    return ad5940_batch_write(REG_AFECON, afecon);
 }
 
 /* ====================================================================
- * Helper: read a single DFT measurement.
+ * Helper: DFT results via the data FIFO.
  *
- * Polls the INTCFLAG0 register for the DFT-result bit.
- * Assumes interrupt flags have already been cleared and the
- * measurement has already been started before calling this.
+ * With the FIFO source set to DFT, every completed DFT pushes two words
+ * (real, then imaginary, 18-bit signed in bits [17:0]) into the data
+ * FIFO. Polling FIFOCNTSTA costs one SPI frame once its address is
+ * selected, and several results come out in a single READFIFO burst.
+ * This replaces the INTCFLAG0 poll + DFTREAL + DFTIMAG + INTCCLR
+ * sequence, which needed eight frames per result plus two per poll.
+ *
+ * Poll intervals below 1 ms busy-wait instead of sleeping so short
+ * DFTs are not limited by the 1 ms kernel tick.
  * ==================================================================== */
-static int read_dft_result(float *dft_real, float *dft_imag)
+#define DFT_TIMEOUT_US       5000000u
+#define DFT_FIFO_WORDS       512u    /* 2 kB data FIFO */
+
+static int configure_fifo(void)
 {
+    uint32_t cmddatacon;
     int ret;
-    uint32_t flags;
-    int timeout_ms = 5000;
-    int elapsed = 0;
-
-    /* Poll INTCFLAG0 for DFT result bit */
-    while (elapsed < timeout_ms) {
-        ret = ad5940_read_reg(REG_INTCFLAG0, &flags);
-        if (ret) return ret;
 
-        if (flags & INTC_DFTRESULT) {
-            break;
-        }
-        k_msleep(1);
-        elapsed++;
-    }
+    /* Use the data SRAM as a 2 kB FIFO */
+    ret = ad5940_read_reg(REG_CMDDATACON, &cmddatacon);
+    if (ret) return ret;
+    cmddatacon &= ~(CMDDATACON_DATAMEMMDE_MASK | CMDDATACON_DATA_MEM_SEL_MASK);
+    cmddatacon |= (DATAMEMMDE_FIFO << CMDDATACON_DATAMEMMDE_SHIFT) |
+                  (DATAFIFOSIZE_2KB << CMDDATACON_DATA_MEM_SEL_SHIFT);
+    ret = ad5940_batch_write(REG_CMDDATACON, cmddatacon);
+    if (ret) return ret;
 
-    if (elapsed >= timeout_ms) {
-        LOG_ERR("DFT timeout (%d ms)", elapsed);
-        return -ETIMEDOUT;
-    }
+    return ad5940_batch_write(REG_FIFOCON, FIFOCON_DATAFIFOEN | FIFOCON_SRC_DFT);
+}
 
-    /* Read DFT results */
-    uint32_t raw_real, raw_imag;
-    ret = ad5940_read_reg(REG_DFTREAL, &raw_real);
-    if (ret) return ret;
-    ret = ad5940_read_reg(REG_DFTIMAG, &raw_imag);
+/*
+ * Empty the FIFO. The next result is from the DFT block in progress.
+ * Written directly (not batched) – the same register twice in a row.
+ */
+static int fifo_restart(void)
+{
+    int ret = ad5940_write_reg(REG_FIFOCON, FIFOCON_SRC_DFT);
     if (ret) return ret;
+    return ad5940_write_reg(REG_FIFOCON, FIFOCON_DATAFIFOEN | FIFOCON_SRC_DFT);
+}
+
+/* Poll FIFOCNTSTA until at least @want words are queued */
+static int wait_fifo_words(uint32_t want, uint32_t poll_us, uint32_t *avail)
+{
+    uint32_t elapsed_us = 0;
 
-    /* Sign-extend 18-bit results */
-    *dft_real = (float)sign_extend_18(raw_real & 0x3FFFF);
-    *dft_imag = (float)sign_extend_18(raw_imag & 0x3FFFF);
+    if (poll_us == 0) poll_us = 1;
 
-    /* Clear the interrupt */
-    ad5940_write_reg(REG_INTCCLR, INTC_DFTRESULT);
+    while (elapsed_us < DFT_TIMEOUT_US) {
+        uint32_t sta;
+        int ret = ad5940_read_reg(REG_FIFOCNTSTA, &sta);
+        if (ret) return ret;
 
-    return 0;
+        *avail = (sta & FIFOCNTSTA_CNT_MASK) >> FIFOCNTSTA_CNT_SHIFT;
+        if (*avail >= want) {
+            return 0;
+        }
+        if (poll_us >= 1000u) {
+            k_usleep(poll_us);
+        } else {
+            k_busy_wait(poll_us);
+        }
+        elapsed_us += poll_us;
+    }
+
+    LOG_ERR("DFT timeout (%u ms)", elapsed_us / 1000u);
+    return -ETIMEDOUT;
+}
+
+static inline float dft_word(uint32_t w)
+{
+    return (float)sign_extend_18(w & 0x3FFFF);
 }
 
 /* ====================================================================
  * Helper: perform one impedance measurement at a single frequency
  * with the currently configured switch matrix.
  *
- * Strategy: Leave the DFT running continuously. After changing
- * frequency, wait for TWO DFT completions — the first flushes
- * samples from the old frequency, the second is clean data.
+ * Strategy: Leave the DFT running continuously into the data FIFO.
+ * After changing frequency, wait for TWO DFT results — the first
+ * flushes samples from the old frequency, the second is clean data.
  * ==================================================================== */
 static int measure_one_freq(float freq_hz, const eis_config_t *cfg,
                             float *dft_r, float *dft_i)
@@ -473,28 +542,41 @@ static int measure_one_freq(float freq_hz, const eis_config_t *cfg,
         /* Re-enable full AFE after power mode change */
         ret = power_up_afe();
         if (ret) return ret;
+        ret = ad5940_batch_flush();
+        if (ret) return ret;
         k_msleep(5);
     }
 
     /* Set new excitation frequency */
     ret = set_excitation_freq(freq_hz, cfg->excit_amplitude);
     if (ret) return ret;
-
-    /* Wait 1: Flush DFT that contains old-frequency samples */
-    ret = ad5940_write_reg(REG_INTCCLR, 0xFFFFFFFF);
-    if (ret) return ret;
-    ret = ad5940_write_reg(REG_INTCSEL0, INTC_DFTRESULT);
+    ret = ad5940_batch_flush();
     if (ret) return ret;
 
-    ret = read_dft_result(dft_r, dft_i);  /* Discard this result */
+    /*
+     * Restart the FIFO and wait for TWO results: the first DFT block
+     * straddles the frequency change and is discarded, the second holds
+     * clean samples at the new frequency. At least one full block must
+     * elapse, so sleep through it before polling.
+     */
+    ret = fifo_restart();
     if (ret) return ret;
 
-    /* Wait 2: This DFT contains clean samples at the new frequency */
-    ret = ad5940_write_reg(REG_INTCCLR, INTC_DFTRESULT);
+    uint32_t block_us = dft_block_us(cfg, freq_hz);
+    if (block_us >= 2000u) {
+        k_usleep(block_us);
+    }
+
+    uint32_t avail;
+    uint32_t words[4];
+    ret = wait_fifo_words(4, dft_poll_interval_us(cfg, freq_hz), &avail);
+    if (ret) return ret;
+    ret = ad5940_read_fifo(words, 4);
     if (ret) return ret;
 
-    ret = read_dft_result(dft_r, dft_i);  /* Keep this result */
-    return ret;
+    *dft_r = dft_word(words[2]);
+    *dft_i = dft_word(words[3]);
+    return 0;
 }
 
 /* ====================================================================
@@ -525,6 +607,9 @@ int eis_init(const eis_config_t *cfg)
 
     LOG_INF("=== EIS Init ===");
 
+    /* Force a full waveform-generator write on the first point */
+    wg_amplitude = -1;
+
     /* Start in low-power mode; we'll switch to HP per-frequency as needed */
     ret = configure_power_mode(false);
     if (ret) return ret;
@@ -550,13 +635,21 @@ int eis_init(const eis_config_t *cfg)
     if (ret) return ret;
 
     /* Configure interrupt: positive edge on GP0 for active-low interrupt */
-    ret = ad5940_write_reg(REG_INTCPOL, 0x00000000);  /* Negative edge */
+    ret = ad5940_batch_write(REG_INTCPOL, 0x00000000);  /* Negative edge */
+    if (ret) return ret;
+
+    /* Route DFT results into the data FIFO */
+    ret = configure_fifo();
     if (ret) return ret;
 
     /* Power up the AFE */
     ret = power_up_afe();
     if (ret) return ret;
 
+    /* Everything above was queued – send it in one burst */
+    ret = ad5940_batch_flush();
+    if (ret) return ret;
+
     /* Allow blocks to settle */
     k_msleep(20);
 
@@ -11,6 +11,7 @@
 #include <zephyr/drivers/spi.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/logging/log.h>
+#include <string.h>
 
 #include "ad5940_spi.h"
 #include "ad5940_regs.h"
@@ -54,6 +55,21 @@ static void gp0_isr(const struct device *dev, struct gpio_callback *cb,
 
 /* ---------- Low-level SPI (no automatic CS) ------------------------- */
 
+/*
+ * Bus statistics. bus_cycles accumulates k_cycle_get_32() deltas around
+ * each CS frame and is converted to microseconds on read-out.
+ */
+static ad5940_spi_stats_t stats;
+static uint64_t           bus_cycles;
+
+/*
+ * Address most recently sent with SPICMD_SETADDR, or -1 if unknown.
+ * The AD5940 keeps the address between data transactions, so repeated
+ * accesses to the same register (status polling, DATAFIFORD) can skip
+ * the set-address frame.
+ */
+static int32_t cur_addr = -1;
+
 static void spi_xfer(uint8_t *tx, uint8_t *rx, size_t len)
 {
     struct spi_buf     tx_buf = { .buf = tx, .len = len };
@@ -68,32 +84,32 @@ static void spi_xfer(uint8_t *tx, uint8_t *rx, size_t len)
     }
 }
 
-static uint8_t spi_rw_8(uint8_t data)
+/*
+ * One CS-low … CS-high frame as a single EasyDMA transfer. Every
+ * transaction in this driver goes through here.
+ */
+static void spi_frame(uint8_t *tx, uint8_t *rx, size_t len)
 {
-    uint8_t tx = data, rx = 0;
-    spi_xfer(&tx, &rx, 1);
-    return rx;
-}
+    uint32_t t0 = k_cycle_get_32();
 
-static uint16_t spi_rw_16(uint16_t data)
-{
-    uint8_t tx[2], rx[2];
-    tx[0] = (data >> 8) & 0xFF;
-    tx[1] = data & 0xFF;
-    spi_xfer(tx, rx, 2);
-    return ((uint16_t)rx[0] << 8) | rx[1];
+    cs_low();
+    spi_xfer(tx, rx, len);
+    cs_high();
+
+    bus_cycles += k_cycle_get_32() - t0;
+    stats.transactions++;
+    stats.bytes += len;
 }
 
-static uint32_t spi_rw_32(uint32_t data)
+static void set_addr(uint16_t addr)
 {
-    uint8_t tx[4], rx[4];
-    tx[0] = (data >> 24) & 0xFF;
-    tx[1] = (data >> 16) & 0xFF;
-    tx[2] = (data >> 8) & 0xFF;
-    tx[3] = data & 0xFF;
-    spi_xfer(tx, rx, 4);
-    return ((uint32_t)rx[0] << 24) | ((uint32_t)rx[1] << 16) |
-           ((uint32_t)rx[2] << 8) | rx[3];
+    if (cur_addr == addr) {
+        return;
+    }
+
+    uint8_t tx[3] = { SPICMD_SETADDR, addr >> 8, addr & 0xFF };
+    spi_frame(tx, NULL, sizeof(tx));
+    cur_addr = addr;
 }
 
 /**
@@ -107,6 +123,20 @@ static inline bool is_32bit_reg(uint16_t addr)
     return (addr >= 0x1000) && (addr <= 0x3014);
 }
 
+static inline uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* ---------- Batched writes ------------------------------------------ */
+
+static struct {
+    uint16_t addr;
+    uint32_t data;
+} batch[AD5940_BATCH_MAX];
+static size_t batch_len;
+
 /* ---------- Public API ---------------------------------------------- */
 
 int ad5940_spi_init(void)
@@ -176,6 +206,9 @@ int ad5940_spi_init(void)
 
 void ad5940_hw_reset(void)
 {
+    cur_addr = -1;
+    batch_len = 0;
+
     gpio_pin_set(gpio_dev, RESET_PIN, 0);
     k_msleep(1);
     gpio_pin_set(gpio_dev, RESET_PIN, 1);
@@ -187,47 +220,148 @@ void ad5940_hw_reset(void)
 
 int ad5940_write_reg(uint16_t addr, uint32_t data)
 {
-    /* Transaction 1: set address */
-    cs_low();
-    spi_rw_8(SPICMD_SETADDR);
-    spi_rw_16(addr);
-    cs_high();
+    uint8_t tx[5] = { SPICMD_WRITEREG };
+    size_t  len;
+
+    /* Transaction 1: set address (skipped if already selected) */
+    set_addr(addr);
 
     /* Transaction 2: write data */
-    cs_low();
-    spi_rw_8(SPICMD_WRITEREG);
-    if (is_32bit_reg(addr))
-        spi_rw_32(data);
-    else
-        spi_rw_16((uint16_t)data);
-    cs_high();
+    if (is_32bit_reg(addr)) {
+        tx[1] = data >> 24;
+        tx[2] = data >> 16;
+        tx[3] = data >> 8;
+        tx[4] = data;
+        len = 5;
+    } else {
+        tx[1] = data >> 8;
+        tx[2] = data;
+        len = 3;
+    }
+    spi_frame(tx, NULL, len);
 
     return 0;
 }
 
 int ad5940_read_reg(uint16_t addr, uint32_t *data)
 {
-    /* Transaction 1: set address */
-    cs_low();
-    spi_rw_8(SPICMD_SETADDR);
-    spi_rw_16(addr);
-    cs_high();
+    uint8_t tx[6] = { SPICMD_READREG, 0 };  /* cmd + dummy byte */
+    uint8_t rx[6];
+
+    /* Transaction 1: set address (skipped if already selected) */
+    set_addr(addr);
 
     /* Transaction 2: read data */
-    cs_low();
-    spi_rw_8(SPICMD_READREG);
-    spi_rw_8(0);  /* Dummy byte */
+    if (is_32bit_reg(addr)) {
+        spi_frame(tx, rx, 6);
+        *data = get_be32(&rx[2]);
+    } else {
+        spi_frame(tx, rx, 4);
+        *data = ((uint32_t)rx[2] << 8) | rx[3];
+    }
 
-    if (is_32bit_reg(addr))
-        *data = spi_rw_32(0);
-    else
-        *data = spi_rw_16(0);
+    return 0;
+}
 
-    cs_high();
+int ad5940_read_regs(const uint16_t *addrs, uint32_t *data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        int ret = ad5940_read_reg(addrs[i], &data[i]);
+        if (ret) return ret;
+    }
+    return 0;
+}
+
+int ad5940_batch_write(uint16_t addr, uint32_t data)
+{
+    /* A later write to the same register supersedes the queued one */
+    for (size_t i = 0; i < batch_len; i++) {
+        if (batch[i].addr == addr) {
+            batch[i].data = data;
+            return 0;
+        }
+    }
+
+    if (batch_len == AD5940_BATCH_MAX) {
+        int ret = ad5940_batch_flush();
+        if (ret) return ret;
+    }
+
+    batch[batch_len].addr = addr;
+    batch[batch_len].data = data;
+    batch_len++;
+    return 0;
+}
 
+int ad5940_batch_flush(void)
+{
+    /*
+     * The AD5940 has no multi-register write command, so the burst is
+     * the queued SETADDR/WRITEREG frames back to back with no
+     * interleaved work. Queue order is preserved.
+     */
+    for (size_t i = 0; i < batch_len; i++) {
+        int ret = ad5940_write_reg(batch[i].addr, batch[i].data);
+        if (ret) {
+            batch_len = 0;
+            return ret;
+        }
+    }
+    batch_len = 0;
     return 0;
 }
 
+int ad5940_read_fifo(uint32_t *buf, size_t count)
+{
+    if (count < AD5940_FIFO_BURST_MIN) {
+        /* Short reads go through DATAFIFORD (one frame per word once
+         * the address is selected), as in the ADI library */
+        for (size_t i = 0; i < count; i++) {
+            int ret = ad5940_read_reg(REG_DATAFIFORD, &buf[i]);
+            if (ret) return ret;
+        }
+        return 0;
+    }
+
+    /*
+     * Burst: SPICMD_READFIFO, six dummy bytes, then one offset word per
+     * data word, all in a single CS frame / DMA transfer. Every frame
+     * ends with two non-zero offsets so the chip pops exactly n words.
+     */
+    static uint8_t tx[7 + 4 * AD5940_FIFO_BURST_MAX];
+    static uint8_t rx[7 + 4 * AD5940_FIFO_BURST_MAX];
+
+    while (count > 0) {
+        size_t n = ad5940_fifo_frame_words(count);
+        size_t len = 7 + 4 * n;
+
+        ad5940_fifo_frame_tx(tx, n);
+        spi_frame(tx, rx, len);
+
+        for (size_t i = 0; i < n; i++) {
+            buf[i] = get_be32(&rx[7 + 4 * i]);
+        }
+        buf += n;
+        count -= n;
+    }
+
+    /* READFIFO does not go through the address register, but be safe */
+    cur_addr = -1;
+    return 0;
+}
+
+void ad5940_spi_get_stats(ad5940_spi_stats_t *out)
+{
+    *out = stats;
+    out->bus_us = (uint32_t)k_cyc_to_us_floor64(bus_cycles);
+}
+
+void ad5940_spi_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    bus_cycles = 0;
+}
+
 /* ---------- Chip initialisation (Table 14 + AD5940 library) --------- */
 
 int ad5940_chip_init(void)
@@ -258,7 +392,13 @@ int ad5940_chip_init(void)
 
     /* Ensure CS starts high */
     cs_high();
+    cur_addr = -1;
 
+    /*
+     * Written one by one rather than batched: the table writes the same
+     * register twice (0x0A04 key sequence, 0x2230 lock/unlock) and each
+     * write must reach the chip in order.
+     */
     for (size_t i = 0; i < ARRAY_SIZE(init_seq); i++) {
         ret = ad5940_write_reg(init_seq[i].addr, init_seq[i].data);
         if (ret) {
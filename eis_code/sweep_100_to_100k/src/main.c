@@ -84,6 +84,23 @@ static eis_config_t build_config(void)
     return cfg;
 }
 
+/*
+ * Print SPI frames, bytes and bus time since the last
+ * ad5940_spi_reset_stats(), in total and per sweep point.
+ */
+static void print_spi_stats(uint16_t points)
+{
+    ad5940_spi_stats_t st;
+
+    ad5940_spi_get_stats(&st);
+    printk("# SPI: %u frames, %u bytes, %u us on the bus",
+           st.transactions, st.bytes, st.bus_us);
+    if (points > 0) {
+        printk(" (%u frames / point)", st.transactions / points);
+    }
+    printk("\n");
+}
+
 /* ====================================================================
  * Main
  * ==================================================================== */
@@ -148,6 +165,7 @@ int main(void)
     /* ---- Step 7: Run the frequency sweep (RCAL calibrated per-frequency) ---- */
     static eis_result_t result;
 
+    ad5940_spi_reset_stats();
     ret = eis_run_sweep(&cfg, &result);
     if (ret) {
         LOG_ERR("Sweep failed: %d", ret);
@@ -158,6 +176,9 @@ int main(void)
         return ret;
     }
 
+    /* ---- Step 8: SPI bus usage for the sweep ---- */
+    print_spi_stats(result.count);
+
     /* ---- Step 9: Output results ---- */
     eis_print_results(&result);
 
@@ -9,6 +9,8 @@
 #include <zephyr/bluetooth/hci.h>
 #include <zephyr/bluetooth/gatt.h>
 
+#include "stream_proto.h"
+
 /* ---- ADC devicetree plumbing (uses your zephyr,user io-channels) ---- */
 #if !DT_NODE_EXISTS(DT_PATH(zephyr_user)) || \
     !DT_NODE_HAS_PROP(DT_PATH(zephyr_user), io_channels)
@@ -35,6 +37,14 @@ static struct bt_uuid_128 adc_mv_char_uuid =
 static int16_t latest_mv = 0;
 static bool notify_enabled = false;
 
+/*
+ * Notifications are stream frames (common/include/stream_proto.h) with
+ * one sample each. The ADC is read from a sleep loop, so there is no
+ * fixed period and the receiver uses t0_us.
+ */
+static struct stream_channel adc_stream =
+	STREAM_CHANNEL_INIT(STREAM_CH_ADC, STREAM_FMT_I16, 0);
+
 /* Read callback */
 static ssize_t read_mv(struct bt_conn *conn,
 		       const struct bt_gatt_attr *attr,
@@ -116,12 +126,13 @@ int main(void)
 	}
 	printk("Advertising as \"%s\"\n", CONFIG_BT_DEVICE_NAME);
 
-	/* ---- Main loop: read ADC, convert to mV, notify if enabled ---- */
+	/* ---- Main loop: read ADC, convert to mV, notify a stream frame ---- */
 	while (1) {
 		const struct adc_dt_spec *ch = &adc_channels[0];
 
 		adc_sequence_init_dt(ch, &sequence);
 
+		uint32_t t_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
 		err = adc_read_dt(ch, &sequence);
 		if (err) {
 			printk("adc_read_dt failed!! (%d)\n", err);
@@ -151,8 +162,13 @@ int main(void)
 			 *   attrs[2] = characteristic value  <-- use this
 			 *   attrs[3] = CCC
 			 */
+			uint8_t frame[STREAM_HDR_LEN + sizeof(latest_mv)];
+			struct stream_buf out;
+
+			stream_buf_init(&out, frame, sizeof(frame));
+			stream_put(&out, &adc_stream, t_us, &latest_mv, 1);
 			(void)bt_gatt_notify(NULL, &adc_svc.attrs[2],
-					     &latest_mv, sizeof(latest_mv));
+					     out.data, out.len);
 		}
 
 		k_sleep(K_MSEC(80));
@@ -4,16 +4,23 @@
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 
+#include "ble_tx.h"
+#include "event_detect.h"
+#include "stream_proto.h"
+
 #include <nrfx_saadc.h>
 #include <nrfx_timer.h>
 #include <helpers/nrfx_gppi.h>
 
 #include <hal/nrf_saadc.h>
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 /* =========================
  * Settings
@@ -25,11 +32,14 @@
 /* Change if needed */
 #define ADC_INPUT_PIN            NRF_SAADC_INPUT_AIN0
 
-#define WARNING_DELTA_RAW        100
-#define CRITICAL_DELTA_RAW       1000
-
 #define TIMER_INSTANCE_NUMBER    2
 
+/* Event chunks waiting for the main thread; each is up to 100 samples */
+#define EVENT_QUEUE_LEN          32
+
+/* How long one snippet notification may wait for a ble_tx credit */
+#define EVENT_TX_TIMEOUT         K_MSEC(50)
+
 /* =========================
  * BLE UUIDs / GATT
  * ======================== */
@@ -42,8 +52,33 @@ static struct bt_uuid_128 adc_mv_char_uuid =
 	BT_UUID_INIT_128(0x11, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe,
 			 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe);
 
+/* Event detector settings: struct event_detect_cfg, little-endian */
+static struct bt_uuid_128 adc_event_cfg_uuid =
+	BT_UUID_INIT_128(0x12, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe,
+			 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe);
+
 static int16_t latest_mv = 0;
 static bool notify_enabled = false;
+static struct bt_conn *current_conn;
+
+/*
+ * Each notification is a stream frame (common/include/stream_proto.h)
+ * holding the last sample of one SAADC buffer, stamped with the time
+ * that buffer completed.
+ */
+static struct stream_channel adc_stream =
+	STREAM_CHANNEL_INIT(STREAM_CH_ADC, STREAM_FMT_I16, 0);
+
+/*
+ * Around detected events the same characteristic carries every sample:
+ * STREAM_CH_ADC_EVENT frames in mV, opened and closed by STREAM_CTRL_EVENT
+ * messages on the control channel.
+ */
+static struct stream_channel event_stream =
+	STREAM_CHANNEL_INIT(STREAM_CH_ADC_EVENT, STREAM_FMT_I16,
+			    SAADC_SAMPLE_INTERVAL_US * 1000u);
+static struct stream_channel ctrl_stream =
+	STREAM_CHANNEL_INIT(STREAM_CH_CONTROL, STREAM_FMT_BYTES, 0);
 
 /* =========================
  * SAADC / TIMER / GPPI
@@ -59,10 +94,45 @@ static uint32_t saadc_current_buffer = 0;
 
 struct adc_summary {
 	int16_t latest_raw;
-	uint16_t max_abs_delta;
 	uint32_t buffer_count;
+	uint32_t t_us;
 };
 
+/*
+ * Event detection runs in the SAADC interrupt, on every buffer. Its sink
+ * copies event samples into chunk_q and the main thread frames and sends
+ * them, so only samples around events leave the interrupt.
+ */
+#define CHUNK_FIRST  BIT(0)
+#define CHUNK_LAST   BIT(1)
+
+struct event_chunk {
+	uint32_t t0_us;
+	uint16_t id;
+	uint16_t n;
+	uint16_t pre;
+	uint16_t total;          /* samples in the event, on CHUNK_LAST   */
+	uint16_t peak;
+	uint16_t max_slope;
+	uint8_t  triggers;
+	uint8_t  flags;
+	int16_t  samples[EVENT_DETECT_CHUNK];
+};
+
+K_MSGQ_DEFINE(chunk_q, sizeof(struct event_chunk), EVENT_QUEUE_LEN, 4);
+
+static struct event_detect detector;
+static struct event_detect_cfg detector_cfg;
+static volatile bool detector_cfg_pending;
+
+/* Index and time of the last sample of the buffer being processed */
+static uint32_t buf_last_index;
+static uint32_t buf_t_us;
+
+static volatile uint32_t chunks_dropped;
+static uint32_t events_sent;
+static uint32_t events_incomplete;
+
 static volatile struct adc_summary summary_data;
 static volatile uint32_t summary_seq;
 static volatile bool runtime_error;
@@ -87,6 +157,32 @@ static void mv_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 	printk("Notifications %s\n", notify_enabled ? "ENABLED" : "DISABLED");
 }
 
+static ssize_t read_event_cfg(struct bt_conn *conn,
+			      const struct bt_gatt_attr *attr,
+			      void *buf, uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset,
+				 &detector_cfg, sizeof(detector_cfg));
+}
+
+/* Applied by the SAADC interrupt before its next buffer */
+static ssize_t write_event_cfg(struct bt_conn *conn,
+			       const struct bt_gatt_attr *attr,
+			       const void *buf, uint16_t len,
+			       uint16_t offset, uint8_t flags)
+{
+	if (offset != 0 || len != sizeof(detector_cfg)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	unsigned int key = irq_lock();
+
+	memcpy(&detector_cfg, buf, len);
+	detector_cfg_pending = true;
+	irq_unlock(key);
+	return len;
+}
+
 BT_GATT_SERVICE_DEFINE(adc_svc,
 	BT_GATT_PRIMARY_SERVICE(&adc_svc_uuid),
 	BT_GATT_CHARACTERISTIC(&adc_mv_char_uuid.uuid,
@@ -94,7 +190,44 @@ BT_GATT_SERVICE_DEFINE(adc_svc,
 			       BT_GATT_PERM_READ,
 			       read_mv, NULL, &latest_mv),
 	BT_GATT_CCC(mv_ccc_cfg_changed,
-		    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE));
+		    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(&adc_event_cfg_uuid.uuid,
+			       BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+			       read_event_cfg, write_event_cfg, NULL));
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	printk("ATT MTU %u\n", bt_gatt_get_mtu(conn));
+}
+
+static struct bt_gatt_exchange_params mtu_params = { .func = mtu_exchanged };
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		return;
+	}
+	current_conn = bt_conn_ref(conn);
+	/* Snippets pack more samples per notification with a large MTU */
+	bt_gatt_exchange_mtu(conn, &mtu_params);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	notify_enabled = false;
+	if (current_conn) {
+		bt_conn_unref(current_conn);
+		current_conn = NULL;
+	}
+	ble_tx_reset();
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected    = connected,
+	.disconnected = disconnected,
+};
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -106,15 +239,6 @@ static const struct bt_data ad[] = {
  * Utility
  * ========================= */
 
-static inline uint16_t abs_u16_diff(int16_t a, int16_t b)
-{
-	int32_t d = (int32_t)a - (int32_t)b;
-	if (d < 0) {
-		d = -d;
-	}
-	return (uint16_t)d;
-}
-
 /* 12-bit SAADC, gain 1/6, internal ref 0.6 V => 3.6 V full-scale */
 static int16_t raw_to_mv(int16_t raw)
 {
@@ -128,6 +252,35 @@ static int16_t raw_to_mv(int16_t raw)
 	return (int16_t)(((int32_t)raw * 3600) / 4095);
 }
 
+/* =========================
+ * Event detection
+ * ========================= */
+
+/* Runs in the SAADC interrupt: copy the chunk out, never block */
+static void event_sink(void *user, const struct event_detect_event *ev,
+		       uint32_t index, const int16_t *samples, uint16_t n,
+		       bool last)
+{
+	struct event_chunk c;
+
+	ARG_UNUSED(user);
+
+	c.t0_us = buf_t_us - (buf_last_index - index) * SAADC_SAMPLE_INTERVAL_US;
+	c.id = ev->id;
+	c.n = n;
+	c.pre = ev->pre;
+	c.total = ev->samples;
+	c.peak = ev->peak;
+	c.max_slope = ev->max_slope;
+	c.triggers = ev->triggers;
+	c.flags = (index == ev->start_index ? CHUNK_FIRST : 0) | (last ? CHUNK_LAST : 0);
+	memcpy(c.samples, samples, n * sizeof(samples[0]));
+
+	if (k_msgq_put(&chunk_q, &c, K_NO_WAIT) != 0) {
+		chunks_dropped++;
+	}
+}
+
 /* =========================
  * SAADC callback
  * ========================= */
@@ -161,18 +314,20 @@ static void saadc_event_handler(nrfx_saadc_evt_t const *p_event)
 			break;
 		}
 
-		uint16_t max_delta = 0;
-		for (uint16_t i = 1; i < count; i++) {
-			uint16_t d = abs_u16_diff(buf[i], buf[i - 1]);
-			if (d > max_delta) {
-				max_delta = d;
-			}
+		uint32_t t_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+
+		if (detector_cfg_pending) {
+			detector_cfg_pending = false;
+			event_detect_configure(&detector, &detector_cfg);
 		}
+		buf_last_index = detector.index + count - 1;
+		buf_t_us = t_us;
+		event_detect_process(&detector, buf, count);
 
 		unsigned int key = irq_lock();
 		summary_data.latest_raw = buf[count - 1];
-		summary_data.max_abs_delta = max_delta;
 		summary_data.buffer_count++;
+		summary_data.t_us = t_us;
 		summary_seq++;
 		irq_unlock(key);
 		break;
@@ -183,6 +338,101 @@ static void saadc_event_handler(nrfx_saadc_evt_t const *p_event)
 	}
 }
 
+/* =========================
+ * Event snippets
+ * ========================= */
+
+static bool send_packet(struct stream_buf *out)
+{
+	int err = 0;
+
+	if (out->len > 0) {
+		err = ble_tx_notify(current_conn, &adc_svc.attrs[2], out->data,
+				    out->len, EVENT_TX_TIMEOUT);
+	}
+	stream_buf_reset(out);
+	return err == 0;
+}
+
+/*
+ * Frame one chunk as STREAM_CH_ADC_EVENT frames of up to one notification
+ * each, with the event's opening or closing control message.
+ */
+static void send_event_chunk(struct event_chunk *c)
+{
+	uint8_t packet[CONFIG_BT_L2CAP_TX_MTU - 3];
+	struct stream_buf out;
+	bool ok = true;
+
+	if (c->flags & CHUNK_LAST) {
+		printk("EVENT id=%u triggers=0x%02x samples=%u pre=%u peak=%u max_slope=%u\n",
+		       c->id, c->triggers, c->total, c->pre, c->peak, c->max_slope);
+	}
+	if (!current_conn || !notify_enabled) {
+		return;
+	}
+
+	for (uint16_t i = 0; i < c->n; i++) {
+		c->samples[i] = raw_to_mv(c->samples[i]);
+	}
+
+	stream_buf_init(&out, packet, MIN(bt_gatt_get_mtu(current_conn) - 3, sizeof(packet)));
+	if (c->flags & CHUNK_FIRST) {
+		stream_put_event(&out, &ctrl_stream, c->t0_us, STREAM_CH_ADC_EVENT, c->id,
+				 c->triggers, STREAM_EVENT_BEGIN, c->pre);
+	}
+
+	for (uint16_t done = 0; done < c->n;) {
+		uint16_t room = stream_buf_room(&out, STREAM_FMT_I16);
+
+		if (room == 0) {
+			ok &= send_packet(&out);
+			continue;
+		}
+		uint8_t n = MIN(room, c->n - done);
+
+		stream_put(&out, &event_stream, c->t0_us + done * SAADC_SAMPLE_INTERVAL_US,
+			   &c->samples[done], n);
+		done += n;
+	}
+
+	if (c->flags & CHUNK_LAST) {
+		if (stream_put_event(&out, &ctrl_stream, c->t0_us, STREAM_CH_ADC_EVENT, c->id,
+				     c->triggers, STREAM_EVENT_END, c->total) == -ENOSPC) {
+			ok &= send_packet(&out);
+			stream_put_event(&out, &ctrl_stream, c->t0_us, STREAM_CH_ADC_EVENT, c->id,
+					 c->triggers, STREAM_EVENT_END, c->total);
+		}
+		events_sent++;
+	}
+	ok &= send_packet(&out);
+	if (!ok) {
+		events_incomplete++;
+	}
+}
+
+/* Share of the samples that left as snippets, every 10 s */
+static void report_events(void)
+{
+	static int64_t next_ms;
+	int64_t now = k_uptime_get();
+
+	if (now < next_ms) {
+		return;
+	}
+	next_ms = now + 10000;
+
+	unsigned int key = irq_lock();
+	struct event_detect_stats st = detector.stats;
+	irq_unlock(key);
+
+	printk("Events: %u detected, %u sent (%u incomplete), %u/%u samples (%u permille), "
+	       "chunks dropped %u, hits thr/slope/energy/zc %u/%u/%u/%u\n",
+	       st.events, events_sent, events_incomplete, st.emitted, st.samples,
+	       st.samples ? (uint32_t)((uint64_t)st.emitted * 1000 / st.samples) : 0,
+	       chunks_dropped, st.hits[0], st.hits[1], st.hits[2], st.hits[3]);
+}
+
 /* =========================
  * Init helpers
  * ========================= */
@@ -338,6 +588,9 @@ int main(void){
 	printk("boot\n");
 	printk("Starting ADC TIMER/GPPI example\n");
 
+	event_detect_default_cfg(&detector_cfg);
+	event_detect_init(&detector, &detector_cfg, event_sink, NULL);
+
 	err = configure_timer();
 	if (err) {
 		return 0;
@@ -383,27 +636,25 @@ int main(void){
 
 			latest_mv = raw_to_mv(local.latest_raw);
 
-			if (local.max_abs_delta > CRITICAL_DELTA_RAW) {
-				printk("CRITICAL raw=%d mv=%d max_delta=%u buf=%u\n",
-				       local.latest_raw,
-				       latest_mv,
-				       local.max_abs_delta,
-				       local.buffer_count);
-			} else if (local.max_abs_delta > WARNING_DELTA_RAW) {
-				printk("WARNING raw=%d mv=%d max_delta=%u buf=%u\n",
-				       local.latest_raw,
-				       latest_mv,
-				       local.max_abs_delta,
-				       local.buffer_count);
-			}
+			if (notify_enabled && current_conn) {
+				uint8_t frame[STREAM_HDR_LEN + sizeof(latest_mv)];
+				struct stream_buf out;
 
-			if (notify_enabled) {
-				(void)bt_gatt_notify(NULL, &adc_svc.attrs[2],
-						     &latest_mv, sizeof(latest_mv));
+				stream_buf_init(&out, frame, sizeof(frame));
+				stream_put(&out, &adc_stream, local.t_us, &latest_mv, 1);
+				/* Best effort: the next buffer brings a fresh value */
+				(void)ble_tx_notify(current_conn, &adc_svc.attrs[2],
+						    out.data, out.len, K_NO_WAIT);
 			}
 		}
 
-		k_sleep(K_MSEC(5));
+		/* Waiting for event chunks doubles as the loop's sleep */
+		struct event_chunk chunk;
+
+		if (k_msgq_get(&chunk_q, &chunk, K_MSEC(5)) == 0) {
+			send_event_chunk(&chunk);
+		}
+		report_events();
 	}
 
 	return 0;
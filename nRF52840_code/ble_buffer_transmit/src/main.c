@@ -3,8 +3,24 @@
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 
+#include "ble_tx.h"
+
+/*
+ * Transmit strategy:
+ *   1 = credit-based engine (common/src/ble_tx.c): the producer blocks
+ *       while all ACL TX buffers are in flight, nothing is dropped.
+ *   0 = original spin loop: bt_gatt_notify() back to back, blocks that
+ *       hit a full buffer pool are lost ("notify error").
+ * Both print goodput, drops and CPU idle time once a second so the two
+ * can be compared on the same link.
+ */
+#define TX_ENGINE_CREDIT 1
+
+#define REPORT_INTERVAL_MS 1000
+
 /* ---- BLE UUIDs ---- */
 
 static struct bt_uuid_128 test_svc_uuid =
@@ -23,6 +39,7 @@ static uint16_t counter_block[BLOCK_SIZE];
 static uint16_t counter = 0;
 
 static bool notify_enabled = false;
+static struct bt_conn *current_conn;
 
 /* ---- Read callback ---- */
 
@@ -56,6 +73,37 @@ BT_GATT_SERVICE_DEFINE(test_svc,
                 BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
 );
 
+/* ---- Connection tracking ---- */
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err) {
+        printk("Connection failed (err 0x%02x)\n", err);
+        return;
+    }
+    current_conn = bt_conn_ref(conn);
+    printk("Connected\n");
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    printk("Disconnected (reason 0x%02x)\n", reason);
+    notify_enabled = false;
+
+    /* Packets still queued for this link will never complete */
+    ble_tx_reset();
+
+    if (current_conn) {
+        bt_conn_unref(current_conn);
+        current_conn = NULL;
+    }
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+    .connected    = connected,
+    .disconnected = disconnected,
+};
+
 /* ---- Advertising ---- */
 
 static const struct bt_data ad[] = {
@@ -64,13 +112,71 @@ static const struct bt_data ad[] = {
             (sizeof(CONFIG_BT_DEVICE_NAME) - 1)),
 };
 
+/* ---- Statistics ---- */
+
+#if !TX_ENGINE_CREDIT
+static uint32_t spin_sent;
+static uint32_t spin_errors;
+#endif
+
+/*
+ * Print goodput, drops and CPU idle share since the previous call.
+ * Goodput counts completed notifications for the credit engine and
+ * accepted ones for the spin loop.
+ */
+static void print_report(uint32_t elapsed_ms)
+{
+    static uint64_t last_idle, last_total;
+    k_thread_runtime_stats_t rt;
+    uint32_t bytes, drops, waits = 0;
+
+    k_thread_runtime_stats_all_get(&rt);
+    uint64_t idle = rt.idle_cycles - last_idle;
+    uint64_t total = rt.execution_cycles - last_total;
+    last_idle = rt.idle_cycles;
+    last_total = rt.execution_cycles;
+
+#if TX_ENGINE_CREDIT
+    struct ble_tx_stats st;
+    ble_tx_get_stats(&st);
+    ble_tx_reset_stats();
+    bytes = st.bytes;
+    drops = st.errors;
+    waits = st.waits;
+#else
+    bytes = spin_sent * sizeof(counter_block);
+    drops = spin_errors;
+    spin_sent = 0;
+    spin_errors = 0;
+#endif
+
+    printk("goodput=%u B/s drops=%u waits=%u cpu_idle=%u%% counter=%u\n",
+           (uint32_t)((uint64_t)bytes * 1000u / MAX(elapsed_ms, 1u)), drops,
+           waits, total ? (uint32_t)(idle * 100u / total) : 0u, counter);
+}
+
 /* ---- Main ---- */
 
+static void fill_block(void)
+{
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+
+        counter_block[i] = counter;
+
+        counter++;
+
+        if (counter > 32000) {
+            counter = 0;
+        }
+    }
+}
+
 int main(void)
 {
     int err;
 
-    printk("Starting BLE counter block test\n");
+    printk("Starting BLE counter block test (%s)\n",
+           TX_ENGINE_CREDIT ? "credit engine" : "spin loop");
 
     err = bt_enable(NULL);
     if (err) {
@@ -90,41 +196,60 @@ int main(void)
 
     printk("Advertising as \"%s\"\n", CONFIG_BT_DEVICE_NAME);
 
-    while (1) {
-
-        /* Fill block */
-
-        for (int i = 0; i < BLOCK_SIZE; i++) {
+    int64_t last_report = k_uptime_get();
+    bool block_pending = false;
 
-            counter_block[i] = counter;
-
-            counter++;
+    while (1) {
 
-            if (counter > 32000) {
-                counter = 0;
-            }
+        int64_t now = k_uptime_get();
+        if (now - last_report >= REPORT_INTERVAL_MS) {
+            print_report((uint32_t)(now - last_report));
+            last_report = now;
         }
 
-        if (notify_enabled) {
-
-            int err = bt_gatt_notify(NULL,
-                                     &test_svc.attrs[2],
-                                     counter_block,
-                                     sizeof(counter_block));
-
-            if (err) {
-                printk("notify error %d\n", err);
-            }
+        if (!notify_enabled || !current_conn) {
+            k_msleep(100);
+            continue;
         }
 
-        /* Optional debug print */
+#if TX_ENGINE_CREDIT
+        /*
+         * Back-pressure: a block is only refilled once the previous one
+         * was queued, so the counter sequence on the phone has no gaps.
+         * The timeout only bounds the wait so the report keeps running.
+         */
+        if (!block_pending) {
+            fill_block();
+            block_pending = true;
+        }
 
-        if ((counter % 1000) == 0) {
-            printk("counter=%u\n", counter);
+        err = ble_tx_notify(current_conn, &test_svc.attrs[2],
+                            counter_block, sizeof(counter_block),
+                            K_MSEC(REPORT_INTERVAL_MS));
+        if (err == 0) {
+            block_pending = false;
+        } else if (err != -EAGAIN) {
+            printk("notify error %d\n", err);
+            k_msleep(10);
+        }
+#else
+        ARG_UNUSED(block_pending);
+        fill_block();
+
+        err = bt_gatt_notify(current_conn,
+                             &test_svc.attrs[2],
+                             counter_block,
+                             sizeof(counter_block));
+
+        if (err) {
+            spin_errors++;
+        } else {
+            spin_sent++;
         }
 
         /* No sleep = maximum throughput */
+#endif
     }
 
     return 0;
-}
\ No newline at end of file
+}
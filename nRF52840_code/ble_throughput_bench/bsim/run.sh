@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+#
+# Run the throughput benchmark in BabbleSim (no radio hardware).
+#
+# Builds the peripheral and bsim_central for nrf52_bsim, runs both against
+# the 2.4 GHz PHY simulator and analyzes the central's log.
+#
+# Needs a Zephyr workspace with BabbleSim:
+#   export ZEPHYR_BASE=... BSIM_OUT_PATH=... BSIM_COMPONENTS_PATH=...
+#
+# Usage: bsim/run.sh [extra bs_2G4_phy_v1 args]
+#   SIM_LENGTH_S   simulated seconds (default 480, enough for all 56 runs)
+#
+set -euo pipefail
+
+: "${ZEPHYR_BASE:?set ZEPHYR_BASE}"
+: "${BSIM_OUT_PATH:?set BSIM_OUT_PATH}"
+
+HERE="$(cd "$(dirname "$0")/.." && pwd)"
+OUT="${HERE}/build_bsim"
+SIM_ID="ble_bench_$$"
+SIM_LENGTH_S="${SIM_LENGTH_S:-480}"
+
+west build -p auto -b nrf52_bsim -d "${OUT}/peripheral" "${HERE}"
+west build -p auto -b nrf52_bsim -d "${OUT}/central" "${HERE}/bsim_central"
+
+cd "${BSIM_OUT_PATH}/bin"
+
+"${OUT}/peripheral/zephyr/zephyr.exe" -s="${SIM_ID}" -d=0 -rs=23 \
+	> "${OUT}/peripheral.log" &
+"${OUT}/central/zephyr/zephyr.exe" -s="${SIM_ID}" -d=1 -rs=42 \
+	> "${OUT}/central.log" &
+./bs_2G4_phy_v1 -s="${SIM_ID}" -D=2 -sim_length=$((SIM_LENGTH_S * 1000000)) "$@"
+wait
+
+python3 "${HERE}/host/ble_bench.py" --from-log "${OUT}/central.log" \
+	| tee "${OUT}/results.csv"
@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+#
+# Evaluate the adaptive stream tier controller in BabbleSim.
+#
+# Builds the peripheral and bsim_central (-DBENCH_TABLE=adaptive), then runs
+# the same 60 s synthetic sensor stream twice: at a fixed full tier and
+# under common/rate_ctrl. A burst interferer jams the band during part of
+# each run, so the link cannot carry the full tier for a while. The result
+# is host/stream_eval.py's summary plus a per-second table.
+#
+# Needs a Zephyr workspace with BabbleSim, including the burst interferer
+# (bs_device_2G4_burst_interf):
+#   export ZEPHYR_BASE=... BSIM_OUT_PATH=... BSIM_COMPONENTS_PATH=...
+#
+# Usage: bsim/run_adaptive.sh [extra bs_2G4_phy_v1 args]
+#   SIM_LENGTH_S   simulated seconds (default 150, two runs plus setup)
+#   INTERF_ARGS    arguments of bs_device_2G4_burst_interf (see its --help).
+#                  The default is a WLAN-like burst in the middle of each
+#                  run, from 20 to 40 s and 90 to 110 s of simulated time,
+#                  plus a short one at 50 and 120 s.
+#
+set -euo pipefail
+
+: "${ZEPHYR_BASE:?set ZEPHYR_BASE}"
+: "${BSIM_OUT_PATH:?set BSIM_OUT_PATH}"
+
+HERE="$(cd "$(dirname "$0")/.." && pwd)"
+OUT="${HERE}/build_bsim_adaptive"
+SIM_ID="ble_adaptive_$$"
+SIM_LENGTH_S="${SIM_LENGTH_S:-150}"
+INTERF_ARGS="${INTERF_ARGS:--type=WLAN -power=-40 -centerfreq=26 \
+-times=20000000,40000000,50000000,52000000,90000000,110000000,120000000,122000000}"
+
+west build -p auto -b nrf52_bsim -d "${OUT}/peripheral" "${HERE}"
+west build -p auto -b nrf52_bsim -d "${OUT}/central" "${HERE}/bsim_central" \
+	-- -DBENCH_TABLE=adaptive
+
+cd "${BSIM_OUT_PATH}/bin"
+
+"${OUT}/peripheral/zephyr/zephyr.exe" -s="${SIM_ID}" -d=0 -rs=23 \
+	> "${OUT}/peripheral.log" &
+"${OUT}/central/zephyr/zephyr.exe" -s="${SIM_ID}" -d=1 -rs=42 \
+	> "${OUT}/central.log" &
+# shellcheck disable=SC2086
+./bs_device_2G4_burst_interf -s="${SIM_ID}" -d=2 ${INTERF_ARGS} &
+./bs_2G4_phy_v1 -s="${SIM_ID}" -D=3 -sim_length=$((SIM_LENGTH_S * 1000000)) "$@"
+wait
+
+python3 "${HERE}/host/stream_eval.py" "${OUT}/central.log" \
+	--seconds "${OUT}/per_second.csv" | tee "${OUT}/summary.csv"
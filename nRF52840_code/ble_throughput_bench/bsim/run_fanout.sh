@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+#
+# Per-connection throughput against the number of links, in BabbleSim.
+#
+# Fan-out: one peripheral built with -DBENCH_TABLE=fanout streams to 1..4
+# centrals at once through common/fanout. For N centrals, one simulation
+# runs the table central (-DBENCH_TABLE=fanout) and N - 1 listeners
+# (-DBENCH_TABLE=listener), which start a second later so the table
+# central connects first.
+#
+# Aggregation: one central built with -DBENCH_TABLE=aggregate connects to
+# four default peripherals and streams from 1, 2, 3 and 4 of them at once.
+#
+# Both tables send 100-sample frames at 2, 4 and 8 kHz on 1M at a 30 ms
+# interval. host/fanout_eval.py turns the logs into summary.csv (one row
+# per link and run) and scaling.csv (per-link and total goodput against
+# the number of links).
+#
+# Needs a Zephyr workspace with BabbleSim:
+#   export ZEPHYR_BASE=... BSIM_OUT_PATH=... BSIM_COMPONENTS_PATH=...
+#
+# Usage: bsim/run_fanout.sh [extra bs_2G4_phy_v1 args]
+#   MAX_LINKS      most centrals / bands (default 4)
+#
+set -euo pipefail
+
+: "${ZEPHYR_BASE:?set ZEPHYR_BASE}"
+: "${BSIM_OUT_PATH:?set BSIM_OUT_PATH}"
+
+HERE="$(cd "$(dirname "$0")/.." && pwd)"
+OUT="${HERE}/build_bsim_fanout"
+MAX_LINKS="${MAX_LINKS:-4}"
+
+west build -p auto -b nrf52_bsim -d "${OUT}/peripheral_fanout" "${HERE}" \
+	-- -DBENCH_TABLE=fanout
+west build -p auto -b nrf52_bsim -d "${OUT}/peripheral" "${HERE}"
+west build -p auto -b nrf52_bsim -d "${OUT}/central" "${HERE}/bsim_central" \
+	-- -DBENCH_TABLE=fanout
+west build -p auto -b nrf52_bsim -d "${OUT}/listener" "${HERE}/bsim_central" \
+	-- -DBENCH_TABLE=listener
+west build -p auto -b nrf52_bsim -d "${OUT}/aggregator" "${HERE}/bsim_central" \
+	-- -DBENCH_TABLE=aggregate
+
+cd "${BSIM_OUT_PATH}/bin"
+
+# ---- Fan-out: 3 runs of 20 s plus setup ----
+for n in $(seq 1 "${MAX_LINKS}"); do
+	dir="${OUT}/fanout_${n}"
+	sim="ble_fanout_${n}_$$"
+	mkdir -p "${dir}"
+
+	"${OUT}/peripheral_fanout/zephyr/zephyr.exe" -s="${sim}" -d=0 -rs=23 \
+		> "${dir}/peripheral.log" &
+	"${OUT}/central/zephyr/zephyr.exe" -s="${sim}" -d=1 -rs=42 \
+		> "${dir}/central.log" &
+	for d in $(seq 2 "${n}"); do
+		"${OUT}/listener/zephyr/zephyr.exe" -s="${sim}" -d="${d}" -rs=$((42 + d)) \
+			-start_offset=1000000 > "${dir}/listener_${d}.log" &
+	done
+	./bs_2G4_phy_v1 -s="${sim}" -D=$((n + 1)) -sim_length=80000000 "$@"
+	wait
+done
+
+# ---- Aggregation: 3 runs of 20 s for each band count ----
+dir="${OUT}/aggregate"
+sim="ble_aggregate_$$"
+mkdir -p "${dir}"
+
+for d in $(seq 0 $((MAX_LINKS - 1))); do
+	"${OUT}/peripheral/zephyr/zephyr.exe" -s="${sim}" -d="${d}" -rs=$((23 + d)) \
+		> "${dir}/peripheral_${d}.log" &
+done
+"${OUT}/aggregator/zephyr/zephyr.exe" -s="${sim}" -d="${MAX_LINKS}" -rs=42 \
+	> "${dir}/aggregator.log" &
+./bs_2G4_phy_v1 -s="${sim}" -D=$((MAX_LINKS + 1)) \
+	-sim_length=$(((MAX_LINKS * 66 + 20) * 1000000)) "$@"
+wait
+
+python3 "${HERE}/host/fanout_eval.py" "${OUT}"/fanout_*/peripheral.log \
+	"${dir}/aggregator.log" --scaling "${OUT}/scaling.csv" | tee "${OUT}/summary.csv"
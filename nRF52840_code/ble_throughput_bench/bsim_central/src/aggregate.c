@@ -0,0 +1,411 @@
+/*
+ * BLE throughput benchmark - BabbleSim aggregator central.
+ *
+ * Built instead of main.c with -DBENCH_TABLE=aggregate (bsim/run_fanout.sh).
+ * It plays a logging gateway: it connects to up to CONFIG_BT_MAX_CONN
+ * peripherals advertising as BLE_BENCH, sets each one up and subscribes
+ * to its Data and Control characteristics. It then runs the same stream
+ * on the first 1, 2, ... N of them at once, so per-band throughput can be
+ * measured against the number of bands one central serves.
+ *
+ * Each link has its own state; notifications are matched to their link
+ * by connection. Frames are counted in the notification callback rather
+ * than logged, and each run ends with one line per band:
+ *
+ *   AGG,<bands>,<band>,<period_us>,<frames>,<bytes>,<gaps>,<elapsed_us>,<sent>,<tx_errors>
+ *
+ * gaps is sequence numbers missing from the band's EMG channel. sent and
+ * tx_errors come from the band's DONE report, so frames the peripheral
+ * dropped for lack of a credit are told apart from link loss.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "bench_proto.h"
+#include "stream_proto.h"
+
+#define BENCH_PEER_NAME "BLE_BENCH"
+#define SETTLE_MS       300
+#define ATT_MTU         247
+#define JOIN_MS         5000      /* scan this long for each further band */
+
+#define MAX_BANDS       CONFIG_BT_MAX_CONN
+
+/*
+ * ---- Aggregation table ----
+ *
+ * The fan-out table the other way round: 100-sample frames at 2, 4 and
+ * 8 kHz from every band, at a 30 ms interval on 1M.
+ */
+#define RUN_MS          20000
+#define STREAM_BATCH    100
+#define STREAM_INTERVAL 24
+static const uint32_t periods_us[] = { 500, 250, 125 };
+
+struct band {
+	struct bt_conn *conn;
+	uint16_t data_handle;
+	uint16_t ctrl_handle;
+	struct bt_gatt_exchange_params mtu_params;
+	struct bt_gatt_discover_params discover_params;
+	struct bt_gatt_subscribe_params data_sub;
+	struct bt_gatt_subscribe_params ctrl_sub;
+	struct bt_gatt_write_params write_params;
+	struct bench_cmd cmd;
+	struct bench_report report;
+
+	/* Per run, written by the BT RX thread */
+	uint32_t frames;
+	uint32_t bytes;
+	uint32_t gaps;
+	uint16_t next_seq;
+	bool     seq_valid;
+};
+
+static struct band bands[MAX_BANDS];
+static uint8_t band_count;
+static struct bt_conn *pending;
+
+static struct bt_uuid_128 bench_data_uuid = BT_UUID_INIT_128(BENCH_UUID_DATA_VAL);
+static struct bt_uuid_128 bench_ctrl_uuid = BT_UUID_INIT_128(BENCH_UUID_CTRL_VAL);
+
+K_SEM_DEFINE(connected_sem, 0, 1);
+K_SEM_DEFINE(step_sem, 0, 1);
+K_SEM_DEFINE(done_sem, 0, MAX_BANDS);
+
+static struct band *band_of(struct bt_conn *conn)
+{
+	for (uint8_t i = 0; i < band_count; i++) {
+		if (bands[i].conn == conn) {
+			return &bands[i];
+		}
+	}
+	return NULL;
+}
+
+/* ---- Scanning ---- */
+
+static bool match_name(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == strlen(BENCH_PEER_NAME) &&
+	    memcmp(data->data, BENCH_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool found = false;
+
+	if (pending || (type != BT_GAP_ADV_TYPE_ADV_IND &&
+			type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND)) {
+		return;
+	}
+
+	bt_data_parse(ad, match_name, &found);
+	if (!found) {
+		return;
+	}
+
+	/* Already one of ours */
+	struct bt_conn *existing = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+
+	if (existing) {
+		bt_conn_unref(existing);
+		return;
+	}
+	if (bt_le_scan_stop()) {
+		return;
+	}
+
+	if (bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+			      BT_LE_CONN_PARAM(STREAM_INTERVAL, STREAM_INTERVAL, 0, 400),
+			      &pending)) {
+		printk("Create connection failed\n");
+		pending = NULL;
+		bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	}
+}
+
+static void connected(struct bt_conn *c, uint8_t err)
+{
+	if (c != pending) {
+		return;
+	}
+	if (err) {
+		printk("Connection failed (err 0x%02x)\n", err);
+		bt_conn_unref(pending);
+		pending = NULL;
+		bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+		return;
+	}
+
+	/* The ref from bt_conn_le_create() moves to the band */
+	bands[band_count++].conn = pending;
+	pending = NULL;
+	printk("Band %u connected\n", band_count - 1);
+	k_sem_give(&connected_sem);
+}
+
+static void disconnected(struct bt_conn *c, uint8_t reason)
+{
+	struct band *b = band_of(c);
+
+	if (b) {
+		printk("Band %u disconnected (reason 0x%02x)\n",
+		       (unsigned int)(b - bands), reason);
+		/* Do not wait for its DONE */
+		k_sem_give(&done_sem);
+	}
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected    = connected,
+	.disconnected = disconnected,
+};
+
+/* ---- GATT client ---- */
+
+static void mtu_exchanged(struct bt_conn *c, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	k_sem_give(&step_sem);
+}
+
+static uint8_t discover_func(struct bt_conn *c, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	struct band *b = band_of(c);
+
+	if (!attr || !b) {
+		k_sem_give(&step_sem);
+		return BT_GATT_ITER_STOP;
+	}
+
+	const struct bt_gatt_chrc *chrc = attr->user_data;
+
+	if (!bt_uuid_cmp(chrc->uuid, &bench_data_uuid.uuid)) {
+		b->data_handle = chrc->value_handle;
+	} else if (!bt_uuid_cmp(chrc->uuid, &bench_ctrl_uuid.uuid)) {
+		b->ctrl_handle = chrc->value_handle;
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+/* Count the EMG frames of one notification and the sequence gaps */
+static uint8_t on_data(struct bt_conn *c, struct bt_gatt_subscribe_params *params,
+		       const void *data, uint16_t length)
+{
+	struct band *b = band_of(c);
+	const uint8_t *p = data;
+
+	if (!data || !b) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	b->bytes += length;
+	while (length >= STREAM_HDR_LEN) {
+		uint16_t payload = p[3] * stream_sample_size(p[2]);
+
+		if ((p[0] & 0xF0) != 0xB0 || STREAM_HDR_LEN + payload > length) {
+			break;
+		}
+		if (p[1] == STREAM_CH_EMG) {
+			uint16_t seq = sys_get_le16(p + 4);
+
+			if (b->seq_valid) {
+				b->gaps += (uint16_t)(seq - b->next_seq);
+			}
+			b->next_seq = seq + 1;
+			b->seq_valid = true;
+			b->frames++;
+		}
+		p += STREAM_HDR_LEN + payload;
+		length -= STREAM_HDR_LEN + payload;
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static uint8_t on_ctrl(struct bt_conn *c, struct bt_gatt_subscribe_params *params,
+		       const void *data, uint16_t length)
+{
+	struct band *b = band_of(c);
+	struct bench_report r;
+
+	if (!data || !b || length < sizeof(r)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+	memcpy(&r, data, sizeof(r));
+
+	if (r.type == BENCH_REPORT_DONE) {
+		b->report = r;
+		k_sem_give(&done_sem);
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void write_done(struct bt_conn *c, uint8_t err,
+		       struct bt_gatt_write_params *params)
+{
+	k_sem_give(&step_sem);
+}
+
+static int send_cmd(struct band *b)
+{
+	b->write_params.func   = write_done;
+	b->write_params.handle = b->ctrl_handle;
+	b->write_params.offset = 0;
+	b->write_params.data   = &b->cmd;
+	b->write_params.length = sizeof(b->cmd);
+
+	int err = bt_gatt_write(b->conn, &b->write_params);
+	if (err == 0) {
+		k_sem_take(&step_sem, K_SECONDS(5));
+	}
+	return err;
+}
+
+/* MTU, discovery and both subscriptions, one band at a time */
+static int setup_band(struct band *b)
+{
+	int err;
+
+	b->mtu_params.func = mtu_exchanged;
+	bt_gatt_exchange_mtu(b->conn, &b->mtu_params);
+	k_sem_take(&step_sem, K_SECONDS(5));
+
+	b->discover_params.func         = discover_func;
+	b->discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	b->discover_params.end_handle   = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	b->discover_params.type         = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(b->conn, &b->discover_params);
+	if (err) {
+		return err;
+	}
+	k_sem_take(&step_sem, K_SECONDS(10));
+	if (!b->data_handle || !b->ctrl_handle) {
+		return -ENOENT;
+	}
+
+	/* The peripheral puts each CCC right after its characteristic value */
+	b->data_sub.notify       = on_data;
+	b->data_sub.value        = BT_GATT_CCC_NOTIFY;
+	b->data_sub.value_handle = b->data_handle;
+	b->data_sub.ccc_handle   = b->data_handle + 1;
+	b->ctrl_sub.notify       = on_ctrl;
+	b->ctrl_sub.value        = BT_GATT_CCC_NOTIFY;
+	b->ctrl_sub.value_handle = b->ctrl_handle;
+	b->ctrl_sub.ccc_handle   = b->ctrl_handle + 1;
+
+	err = bt_gatt_subscribe(b->conn, &b->data_sub);
+	if (err) {
+		return err;
+	}
+	return bt_gatt_subscribe(b->conn, &b->ctrl_sub);
+}
+
+/* The same stream on bands 0..@n-1 at once */
+static void run_bands(uint8_t n, uint32_t period_us)
+{
+	uint8_t started = 0;
+
+	k_sem_reset(&done_sem);
+	for (uint8_t i = 0; i < n; i++) {
+		struct band *b = &bands[i];
+
+		b->frames = 0;
+		b->bytes = 0;
+		b->gaps = 0;
+		b->seq_valid = false;
+		memset(&b->report, 0, sizeof(b->report));
+		b->cmd = (struct bench_cmd){
+			.op            = BENCH_OP_START,
+			.phy           = BENCH_PHY_1M,
+			.payload_len   = STREAM_BATCH,
+			.conn_interval = STREAM_INTERVAL,
+			.att_mtu       = ATT_MTU,
+			.interval_us   = period_us,
+			.duration_ms   = RUN_MS,
+			.transport     = BENCH_TRANSPORT_STREAM,
+		};
+		started += send_cmd(b) == 0;
+	}
+
+	for (uint8_t i = 0; i < started; i++) {
+		k_sem_take(&done_sem, K_MSEC(RUN_MS + 10000));
+	}
+	/* Late packets still belong to this run */
+	k_msleep(SETTLE_MS);
+
+	for (uint8_t i = 0; i < n; i++) {
+		const struct band *b = &bands[i];
+
+		printk("AGG,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", n, i, period_us, b->frames,
+		       b->bytes, b->gaps, b->report.elapsed_us, b->report.sent,
+		       b->report.tx_errors);
+	}
+}
+
+int main(void)
+{
+	int err;
+
+	printk("Starting BLE throughput benchmark aggregator\n");
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Bluetooth init failed (err %d)\n", err);
+		return 0;
+	}
+
+	/* Connect to as many bands as answer, up to MAX_BANDS */
+	while (band_count < MAX_BANDS) {
+		err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+		if (err) {
+			printk("Scanning failed to start (err %d)\n", err);
+			return 0;
+		}
+		if (k_sem_take(&connected_sem, K_MSEC(JOIN_MS)) != 0) {
+			bt_le_scan_stop();
+			break;
+		}
+	}
+	if (band_count == 0) {
+		printk("No band found\n");
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < band_count; i++) {
+		err = setup_band(&bands[i]);
+		if (err) {
+			printk("Band %u setup failed (err %d)\n", i, err);
+			band_count = i;
+			break;
+		}
+	}
+	k_msleep(SETTLE_MS);
+
+	for (uint8_t n = 1; n <= band_count; n++) {
+		ARRAY_FOR_EACH(periods_us, p) {
+			run_bands(n, periods_us[p]);
+		}
+	}
+
+	printk("All runs complete\n");
+	return 0;
+}
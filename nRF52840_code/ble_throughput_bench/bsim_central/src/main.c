@@ -0,0 +1,564 @@
+/*
+ * BLE throughput benchmark - BabbleSim central.
+ *
+ * Stands in for the phone when the peripheral runs on nrf52_bsim:
+ * connects to BLE_BENCH, runs the table below and prints one line per
+ * event for host/ble_bench.py --from-log:
+ *
+ *   RUN,<payload>,<interval_us>,<att_mtu>,<phy>,<conn_interval>,<transport>
+ *   ACK,<phy>,<att_mtu>,<conn_interval>,<payload_len>
+ *   RX,<rx_us>,<seq>,<tx_us>,<len>,<fill_ok>
+ *   DONE,<sent>,<tx_errors>,<elapsed_us>,<late>
+ *   END,
+ *
+ * Both devices count uptime from the start of the simulation, so rx_us
+ * and tx_us share a clock and latency is absolute.
+ *
+ * After the notification table it opens the L2CAP stream channel and runs
+ * the transport table. Each profile there runs once with notifications
+ * and once with SDUs. RX lines come from either transport.
+ *
+ * Built with -DBENCH_TABLE=adaptive it runs only the stream table
+ * (bsim/run_adaptive.sh): the same synthetic sensor stream at a fixed
+ * full tier and under rate_ctrl. Data then holds stream frames, logged as
+ *
+ *   FRAME,<rx_us>,<channel>,<format>,<count>,<seq>,<t0_us>,<period_ns>,<samples>
+ *   TIER,<rx_us>,<channel>,<tier>,<decimation>
+ *
+ * for host/stream_eval.py.
+ *
+ * -DBENCH_TABLE=fanout runs only the fan-out table (bsim/run_fanout.sh):
+ * the full-tier stream at several rates, sent by the peripheral to every
+ * connected central at once. The other centrals in that simulation are
+ * built with -DBENCH_TABLE=listener. A listener connects, subscribes to
+ * Data and logs FRAME lines; it never writes a command.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "bench_proto.h"
+#include "l2cap_stream.h"
+#include "stream_proto.h"
+
+#define BENCH_PEER_NAME "BLE_BENCH"
+#define RUN_MS          5000
+#define SETTLE_MS       300
+#define ATT_MTU         247
+
+/* ---- Run table: payload x cadence x PHY x interval ---- */
+static const uint16_t payloads[]  = { 20, 128, 244 };
+static const uint32_t cadences[]  = { 0, 1000 };
+static const uint8_t  phys[]      = { BENCH_PHY_1M, BENCH_PHY_2M };
+static const uint16_t intervals[] = { 6, 12, 24 };   /* 7.5, 15, 30 ms */
+
+/*
+ * ---- Transport table: notifications vs L2CAP SDUs ----
+ *
+ * EMG live: one 54-byte stream frame (20 int16 samples) every 20 ms.
+ * Offload: flash backlog sent back to back, one MTU (notify) or one
+ * SDU (L2CAP) at a time.
+ */
+struct profile {
+	uint16_t payload;
+	uint32_t interval_us;
+	uint8_t  phy;
+};
+
+static const struct profile profiles[] = {
+	{   54, 20000, BENCH_PHY_1M },
+	{  244,     0, BENCH_PHY_1M },
+	{  244,     0, BENCH_PHY_2M },
+	{ 1024,     0, BENCH_PHY_1M },
+	{ 1024,     0, BENCH_PHY_2M },
+};
+static const uint16_t profile_intervals[] = { 12, 24 };
+static const uint8_t  transports[] = { BENCH_TRANSPORT_NOTIFY, BENCH_TRANSPORT_L2CAP };
+
+/*
+ * ---- Stream table: full tier vs adaptive ----
+ *
+ * 8 kHz synthetic EMG in 100-sample frames (214 B every 12.5 ms) at a
+ * 30 ms interval on 1M: about 17 kB/s, which a clean link carries and
+ * an interfered one does not. interval_us is the sample period here.
+ */
+#define STREAM_RUN_MS      60000
+#define STREAM_PERIOD_US   125
+#define STREAM_BATCH       100
+#define STREAM_INTERVAL    24
+static const uint8_t stream_transports[] = {
+	BENCH_TRANSPORT_STREAM, BENCH_TRANSPORT_STREAM_ADAPTIVE,
+};
+
+/*
+ * ---- Fan-out table: per-central throughput vs number of centrals ----
+ *
+ * 100-sample frames (214 B) at 2, 4 and 8 kHz, about 4, 9 and 17 kB/s
+ * for each central, all at a 30 ms interval on 1M. Listeners get
+ * FANOUT_JOIN_MS to connect before the first run.
+ */
+#define FANOUT_RUN_MS      20000
+#define FANOUT_JOIN_MS     3000
+static const uint32_t fanout_periods_us[] = { 500, 250, 125 };
+
+/* Fan-out centrals start at the table's interval and share the air evenly */
+#if defined(BENCH_TABLE_FANOUT) || defined(BENCH_TABLE_LISTENER)
+#define CREATE_PARAM  BT_LE_CONN_PARAM(STREAM_INTERVAL, STREAM_INTERVAL, 0, 400)
+#else
+#define CREATE_PARAM  BT_LE_CONN_PARAM_DEFAULT
+#endif
+
+static struct bt_uuid_128 bench_data_uuid = BT_UUID_INIT_128(BENCH_UUID_DATA_VAL);
+static struct bt_uuid_128 bench_ctrl_uuid = BT_UUID_INIT_128(BENCH_UUID_CTRL_VAL);
+
+static struct bt_conn *conn;
+static bool stream_run;
+static uint16_t data_handle;
+static uint16_t ctrl_handle;
+
+K_SEM_DEFINE(connected_sem, 0, 1);
+K_SEM_DEFINE(step_sem, 0, 1);
+K_SEM_DEFINE(done_sem, 0, 1);
+K_SEM_DEFINE(l2cap_sem, 0, 1);
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* ---- Scanning ---- */
+
+static bool match_name(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == strlen(BENCH_PEER_NAME) &&
+	    memcmp(data->data, BENCH_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool found = false;
+
+	if (conn || (type != BT_GAP_ADV_TYPE_ADV_IND &&
+		     type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND)) {
+		return;
+	}
+
+	bt_data_parse(ad, match_name, &found);
+	if (!found || bt_le_scan_stop()) {
+		return;
+	}
+
+	if (bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, CREATE_PARAM, &conn)) {
+		printk("Create connection failed\n");
+		bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	}
+}
+
+static void connected(struct bt_conn *c, uint8_t err)
+{
+	if (err) {
+		printk("Connection failed (err 0x%02x)\n", err);
+		bt_conn_unref(conn);
+		conn = NULL;
+		bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+		return;
+	}
+	k_sem_give(&connected_sem);
+}
+
+static void disconnected(struct bt_conn *c, uint8_t reason)
+{
+	printk("Disconnected (reason 0x%02x)\n", reason);
+	k_sem_give(&done_sem);
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected    = connected,
+	.disconnected = disconnected,
+};
+
+/* ---- GATT client ---- */
+
+static void mtu_exchanged(struct bt_conn *c, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	printk("ATT MTU %u\n", bt_gatt_get_mtu(c));
+	k_sem_give(&step_sem);
+}
+
+static struct bt_gatt_exchange_params mtu_params = { .func = mtu_exchanged };
+
+static uint8_t discover_func(struct bt_conn *c, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	if (!attr) {
+		k_sem_give(&step_sem);
+		return BT_GATT_ITER_STOP;
+	}
+
+	const struct bt_gatt_chrc *chrc = attr->user_data;
+
+	if (!bt_uuid_cmp(chrc->uuid, &bench_data_uuid.uuid)) {
+		data_handle = chrc->value_handle;
+	} else if (!bt_uuid_cmp(chrc->uuid, &bench_ctrl_uuid.uuid)) {
+		ctrl_handle = chrc->value_handle;
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static struct bt_gatt_discover_params discover_params = {
+	.func         = discover_func,
+	.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE,
+	.end_handle   = BT_ATT_LAST_ATTRIBUTE_HANDLE,
+	.type         = BT_GATT_DISCOVER_CHARACTERISTIC,
+};
+
+/* One line per stream frame; tier announcements get their own line */
+static void log_frames(uint32_t rx_us, const uint8_t *p, uint16_t length)
+{
+	while (length >= STREAM_HDR_LEN) {
+		uint8_t channel = p[1];
+		uint8_t format = p[2];
+		uint8_t count = p[3];
+		uint16_t payload = count * stream_sample_size(format);
+
+		if ((p[0] & 0xF0) != 0xB0 || STREAM_HDR_LEN + payload > length) {
+			printk("FRAME,%u,bad\n", rx_us);
+			return;
+		}
+
+		const uint8_t *data = p + STREAM_HDR_LEN;
+
+		if (channel == STREAM_CH_CONTROL && count >= STREAM_CTRL_TIER_LEN &&
+		    data[0] == STREAM_CTRL_TIER) {
+			printk("TIER,%u,%u,%u,%u\n", rx_us, data[1], data[2], data[3]);
+		} else {
+			printk("FRAME,%u,%u,%u,%u,%u,%u,%u,%u\n", rx_us, channel, format,
+			       count, sys_get_le16(p + 4), sys_get_le32(p + 6),
+			       sys_get_le32(p + 10),
+			       format == STREAM_FMT_I16_DELTA ? data[0] : count);
+		}
+		p += STREAM_HDR_LEN + payload;
+		length -= STREAM_HDR_LEN + payload;
+	}
+}
+
+static uint8_t on_data(struct bt_conn *c, struct bt_gatt_subscribe_params *params,
+		       const void *data, uint16_t length)
+{
+	struct bench_hdr hdr;
+	const uint8_t *p = data;
+	bool fill_ok = true;
+
+	if (!data || length < sizeof(hdr)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	uint32_t rx_us = now_us();
+
+	if (stream_run) {
+		log_frames(rx_us, p, length);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	memcpy(&hdr, p, sizeof(hdr));
+	for (uint16_t i = sizeof(hdr); i < length; i++) {
+		if (p[i] != (uint8_t)(hdr.seq + i)) {
+			fill_ok = false;
+			break;
+		}
+	}
+	printk("RX,%u,%u,%u,%u,%u\n", rx_us, hdr.seq, hdr.tx_us, length, fill_ok);
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static uint8_t on_ctrl(struct bt_conn *c, struct bt_gatt_subscribe_params *params,
+		       const void *data, uint16_t length)
+{
+	struct bench_report r;
+
+	if (!data || length < sizeof(r)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+	memcpy(&r, data, sizeof(r));
+
+	if (r.type == BENCH_REPORT_ACK) {
+		printk("ACK,%u,%u,%u,%u\n", r.phy, r.att_mtu, r.conn_interval,
+		       r.payload_len);
+	} else if (r.type == BENCH_REPORT_DONE) {
+		printk("DONE,%u,%u,%u,%u\n", r.sent, r.tx_errors, r.elapsed_us,
+		       r.late);
+		k_sem_give(&done_sem);
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+/* The peripheral puts each CCC right after its characteristic value */
+static struct bt_gatt_subscribe_params data_sub = {
+	.notify = on_data,
+	.value  = BT_GATT_CCC_NOTIFY,
+};
+static struct bt_gatt_subscribe_params ctrl_sub = {
+	.notify = on_ctrl,
+	.value  = BT_GATT_CCC_NOTIFY,
+};
+
+static void write_done(struct bt_conn *c, uint8_t err,
+		       struct bt_gatt_write_params *params)
+{
+	k_sem_give(&step_sem);
+}
+
+static int send_cmd(const struct bench_cmd *cmd)
+{
+	static struct bt_gatt_write_params wp;
+
+	wp.func   = write_done;
+	wp.handle = ctrl_handle;
+	wp.offset = 0;
+	wp.data   = cmd;
+	wp.length = sizeof(*cmd);
+
+	int err = bt_gatt_write(conn, &wp);
+	if (err == 0) {
+		k_sem_take(&step_sem, K_SECONDS(5));
+	}
+	return err;
+}
+
+/* ---- L2CAP stream channel ---- */
+
+NET_BUF_POOL_FIXED_DEFINE(sdu_rx_pool, 2, BT_L2CAP_SDU_BUF_SIZE(L2CAP_STREAM_SDU_MAX),
+			  CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+static struct bt_l2cap_le_chan l2cap_chan;
+static bool l2cap_open;
+
+static struct net_buf *l2cap_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	return net_buf_alloc(&sdu_rx_pool, K_FOREVER);
+}
+
+static int l2cap_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	/* Same log line as a notification */
+	on_data(conn, NULL, buf->data, buf->len);
+	return 0;
+}
+
+static void l2cap_connected(struct bt_l2cap_chan *chan)
+{
+	printk("L2CAP channel open, peer MTU %u MPS %u\n",
+	       l2cap_chan.tx.mtu, l2cap_chan.tx.mps);
+	l2cap_open = true;
+	k_sem_give(&l2cap_sem);
+}
+
+static void l2cap_disconnected(struct bt_l2cap_chan *chan)
+{
+	l2cap_open = false;
+	k_sem_give(&l2cap_sem);
+}
+
+static const struct bt_l2cap_chan_ops l2cap_ops = {
+	.alloc_buf    = l2cap_alloc_buf,
+	.recv         = l2cap_recv,
+	.connected    = l2cap_connected,
+	.disconnected = l2cap_disconnected,
+};
+
+static int open_l2cap(void)
+{
+	l2cap_chan.chan.ops = &l2cap_ops;
+	l2cap_chan.rx.mtu = L2CAP_STREAM_SDU_MAX;
+
+	int err = bt_l2cap_chan_connect(conn, &l2cap_chan.chan, L2CAP_STREAM_PSM);
+	if (err) {
+		return err;
+	}
+	k_sem_take(&l2cap_sem, K_SECONDS(5));
+	return l2cap_open ? 0 : -ECONNREFUSED;
+}
+
+static void run_one(const struct bench_cmd *cmd)
+{
+	printk("RUN,%u,%u,%u,%u,%u,%u\n", cmd->payload_len, cmd->interval_us,
+	       cmd->att_mtu, cmd->phy, cmd->conn_interval, cmd->transport);
+	stream_run = (cmd->transport == BENCH_TRANSPORT_STREAM ||
+		      cmd->transport == BENCH_TRANSPORT_STREAM_ADAPTIVE ||
+		      cmd->transport == BENCH_TRANSPORT_FANOUT);
+	k_sem_reset(&done_sem);
+	if (send_cmd(cmd) == 0) {
+		k_sem_take(&done_sem, K_MSEC(cmd->duration_ms + 10000));
+	}
+	/* Late packets still belong to this run */
+	k_msleep(SETTLE_MS);
+	printk("END,\n");
+}
+
+static int setup_link(void)
+{
+	int err;
+
+	bt_gatt_exchange_mtu(conn, &mtu_params);
+	k_sem_take(&step_sem, K_SECONDS(5));
+
+	err = bt_gatt_discover(conn, &discover_params);
+	if (err) {
+		return err;
+	}
+	k_sem_take(&step_sem, K_SECONDS(10));
+	if (!data_handle || !ctrl_handle) {
+		printk("Benchmark service not found\n");
+		return -ENOENT;
+	}
+
+	data_sub.value_handle = data_handle;
+	data_sub.ccc_handle   = data_handle + 1;
+	ctrl_sub.value_handle = ctrl_handle;
+	ctrl_sub.ccc_handle   = ctrl_handle + 1;
+
+	err = bt_gatt_subscribe(conn, &data_sub);
+	if (err || IS_ENABLED(BENCH_TABLE_LISTENER)) {
+		return err;
+	}
+	return bt_gatt_subscribe(conn, &ctrl_sub);
+}
+
+int main(void)
+{
+	int err;
+
+	printk("Starting BLE throughput benchmark central\n");
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Bluetooth init failed (err %d)\n", err);
+		return 0;
+	}
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	if (err) {
+		printk("Scanning failed to start (err %d)\n", err);
+		return 0;
+	}
+
+	k_sem_take(&connected_sem, K_FOREVER);
+	err = setup_link();
+	if (err) {
+		printk("Link setup failed (err %d)\n", err);
+		return 0;
+	}
+	k_msleep(SETTLE_MS);
+
+	if (IS_ENABLED(BENCH_TABLE_LISTENER)) {
+		/* Every fan-out run arrives as FRAME lines */
+		stream_run = true;
+		printk("Listening\n");
+		k_sem_take(&done_sem, K_FOREVER);
+		return 0;
+	}
+
+	if (IS_ENABLED(BENCH_TABLE_FANOUT)) {
+		k_msleep(FANOUT_JOIN_MS);
+		ARRAY_FOR_EACH(fanout_periods_us, f) {
+			struct bench_cmd cmd = {
+				.op            = BENCH_OP_START,
+				.phy           = BENCH_PHY_1M,
+				.payload_len   = STREAM_BATCH,
+				.conn_interval = STREAM_INTERVAL,
+				.att_mtu       = ATT_MTU,
+				.interval_us   = fanout_periods_us[f],
+				.duration_ms   = FANOUT_RUN_MS,
+				.transport     = BENCH_TRANSPORT_FANOUT,
+			};
+
+			run_one(&cmd);
+		}
+		printk("All runs complete\n");
+		return 0;
+	}
+
+	if (IS_ENABLED(BENCH_TABLE_ADAPTIVE)) {
+		ARRAY_FOR_EACH(stream_transports, t) {
+			struct bench_cmd cmd = {
+				.op            = BENCH_OP_START,
+				.phy           = BENCH_PHY_1M,
+				.payload_len   = STREAM_BATCH,
+				.conn_interval = STREAM_INTERVAL,
+				.att_mtu       = ATT_MTU,
+				.interval_us   = STREAM_PERIOD_US,
+				.duration_ms   = STREAM_RUN_MS,
+				.transport     = stream_transports[t],
+			};
+
+			run_one(&cmd);
+		}
+		printk("All runs complete\n");
+		return 0;
+	}
+
+	ARRAY_FOR_EACH(payloads, p) {
+		ARRAY_FOR_EACH(cadences, c) {
+			ARRAY_FOR_EACH(phys, y) {
+				ARRAY_FOR_EACH(intervals, i) {
+					struct bench_cmd cmd = {
+						.op            = BENCH_OP_START,
+						.phy           = phys[y],
+						.payload_len   = payloads[p],
+						.conn_interval = intervals[i],
+						.att_mtu       = ATT_MTU,
+						.interval_us   = cadences[c],
+						.duration_ms   = RUN_MS,
+					};
+
+					run_one(&cmd);
+				}
+			}
+		}
+	}
+
+	err = open_l2cap();
+	if (err) {
+		printk("L2CAP channel not opened (err %d)\n", err);
+		return 0;
+	}
+
+	ARRAY_FOR_EACH(profiles, p) {
+		ARRAY_FOR_EACH(profile_intervals, i) {
+			ARRAY_FOR_EACH(transports, t) {
+				struct bench_cmd cmd = {
+					.op            = BENCH_OP_START,
+					.phy           = profiles[p].phy,
+					.payload_len   = profiles[p].payload,
+					.conn_interval = profile_intervals[i],
+					.att_mtu       = ATT_MTU,
+					.interval_us   = profiles[p].interval_us,
+					.duration_ms   = RUN_MS,
+					.transport     = transports[t],
+				};
+
+				run_one(&cmd);
+			}
+		}
+	}
+
+	printk("All runs complete\n");
+	return 0;
+}
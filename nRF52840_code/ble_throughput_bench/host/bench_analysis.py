@@ -0,0 +1,144 @@
+'''
+Metrics for one benchmark run.
+
+Input is the list of received notifications as (rx_us, seq, tx_us, length,
+fill_ok) tuples plus the peripheral's DONE report. rx_us is the receiver's
+clock, tx_us the peripheral's (32-bit, wraps every ~71 minutes).
+
+Latency:
+  On real hardware the two clocks are unrelated, so the one-way delay is
+  estimated relative to its floor: the minimum of (rx - tx) in each
+  one-second window gives a line (offset + crystal drift), and latency is
+  reported as the excess over that line. Under BabbleSim both devices run
+  on the same simulated clock and latency is absolute (absolute=True).
+'''
+
+import statistics
+
+GAP_BUCKETS = ((1, 1), (2, 4), (5, 16), (17, None))
+
+
+def percentile(sorted_vals, p):
+    if not sorted_vals:
+        return float("nan")
+    k = (len(sorted_vals) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_vals) - 1)
+    return sorted_vals[lo] + (sorted_vals[hi] - sorted_vals[lo]) * (k - lo)
+
+
+def unwrap32(values):
+    out, base, prev = [], 0, None
+    for v in values:
+        if prev is not None and v < prev and prev - v > (1 << 31):
+            base += 1 << 32
+        out.append(v + base)
+        prev = v
+    return out
+
+
+def _floor_line(tx, delay, window_us=1_000_000):
+    '''Least-squares line through the per-window minima of delay vs tx.'''
+    mins = {}
+    for t, d in zip(tx, delay):
+        w = t // window_us
+        if w not in mins or d < mins[w][1]:
+            mins[w] = (t, d)
+    pts = list(mins.values())
+    if len(pts) < 2:
+        return 0.0, min(delay)
+    mx = statistics.fmean(p[0] for p in pts)
+    my = statistics.fmean(p[1] for p in pts)
+    sxx = sum((p[0] - mx) ** 2 for p in pts)
+    slope = sum((p[0] - mx) * (p[1] - my) for p in pts) / sxx if sxx else 0.0
+    return slope, my - slope * mx
+
+
+def analyze(packets, report=None, absolute=False):
+    '''Return a dict of metrics for one run.'''
+    m = {"rx_packets": len(packets)}
+    if report:
+        m.update(tx_sent=report["sent"], tx_errors=report["tx_errors"],
+                 late=report["late"])
+    if len(packets) < 2:
+        return m
+
+    packets = sorted(packets, key=lambda p: p[0])
+    rx = [p[0] for p in packets]
+    seqs = [p[1] for p in packets]
+    tx = unwrap32([p[2] for p in packets])
+
+    # Goodput: payload bytes delivered over the receive span
+    span_us = rx[-1] - rx[0]
+    rx_bytes = sum(p[3] for p in packets[1:])
+    m["goodput_kbps"] = rx_bytes * 8 / span_us * 1000 if span_us else float("nan")
+    m["corrupt"] = sum(1 for p in packets if not p[4])
+
+    # Loss: sequence numbers never seen. seq counts every attempt, so this
+    # includes source drops; link loss is what remains after tx_errors.
+    expected = max(seqs) - min(seqs) + 1
+    unique = len(set(seqs))
+    m["loss_pct"] = 100.0 * (expected - unique) / expected
+    m["dup"] = len(seqs) - unique
+    if report:
+        link_lost = expected - unique - report["tx_errors"]
+        m["link_loss_pct"] = 100.0 * max(link_lost, 0) / expected
+
+    # Gap distribution: lengths of runs of missing seq, and inter-arrival
+    gaps = {b: 0 for b in GAP_BUCKETS}
+    ordered = sorted(set(seqs))
+    for a, b in zip(ordered, ordered[1:]):
+        run = b - a - 1
+        if run <= 0:
+            continue
+        for lo, hi in GAP_BUCKETS:
+            if run >= lo and (hi is None or run <= hi):
+                gaps[(lo, hi)] += 1
+                break
+    m["gap_runs"] = gaps
+    iat = sorted(b - a for a, b in zip(rx, rx[1:]))
+    m["iat_us_p50"] = percentile(iat, 50)
+    m["iat_us_p99"] = percentile(iat, 99)
+    m["iat_us_max"] = iat[-1]
+
+    # Latency
+    delay = [r - t for r, t in zip(rx, tx)]
+    if absolute:
+        lat = sorted(delay)
+    else:
+        slope, icpt = _floor_line(tx, delay)
+        lat = sorted(d - (slope * t + icpt) for t, d in zip(tx, delay))
+        m["drift_ppm"] = slope * 1e6
+    m["lat_absolute"] = absolute
+    for p in (50, 90, 99):
+        m[f"lat_us_p{p}"] = percentile(lat, p)
+    m["lat_us_max"] = lat[-1]
+    return m
+
+
+CSV_COLUMNS = ("transport", "payload", "interval_us", "att_mtu", "phy", "conn_interval_ms",
+               "rx_packets", "tx_sent", "tx_errors", "late", "goodput_kbps",
+               "loss_pct", "link_loss_pct", "corrupt", "gaps_1", "gaps_2_4",
+               "gaps_5_16", "gaps_17_plus", "iat_us_p50", "iat_us_p99",
+               "iat_us_max", "lat_absolute", "lat_us_p50", "lat_us_p90",
+               "lat_us_p99", "lat_us_max", "drift_ppm")
+
+
+def csv_header():
+    return ",".join(CSV_COLUMNS)
+
+
+def csv_row(params, m):
+    row = dict(params)
+    row.update(m)
+    gaps = m.get("gap_runs", {})
+    for (lo, hi), key in zip(GAP_BUCKETS, ("gaps_1", "gaps_2_4",
+                                           "gaps_5_16", "gaps_17_plus")):
+        row[key] = gaps.get((lo, hi), "")
+
+    def fmt(v):
+        if isinstance(v, float):
+            return f"{v:.1f}"
+        return "" if v is None else str(v)
+
+    return ",".join(fmt(row.get(c)) for c in CSV_COLUMNS)
@@ -0,0 +1,68 @@
+'''
+Wire format of the BLE throughput benchmark.
+
+Mirrors include/bench_proto.h - keep the two in sync.
+'''
+
+import struct
+
+SVC_UUID  = "fedcba98-7654-3210-fedc-ba9876543220"
+DATA_UUID = "fedcba98-7654-3210-fedc-ba9876543221"
+CTRL_UUID = "fedcba98-7654-3210-fedc-ba9876543222"
+
+DEVICE_NAME = "BLE_BENCH"
+
+OP_START = 0x01
+OP_STOP  = 0x02
+
+PHY_KEEP, PHY_1M, PHY_2M, PHY_CODED = 0, 1, 2, 3
+PHY_NAMES = {PHY_KEEP: "keep", PHY_1M: "1M", PHY_2M: "2M", PHY_CODED: "coded"}
+PHY_BY_NAME = {v.lower(): k for k, v in PHY_NAMES.items()}
+
+TRANSPORT_NOTIFY, TRANSPORT_L2CAP = 0, 1
+TRANSPORT_STREAM, TRANSPORT_STREAM_ADAPTIVE = 2, 3
+TRANSPORT_FANOUT = 4
+TRANSPORT_NAMES = {TRANSPORT_NOTIFY: "notify", TRANSPORT_L2CAP: "l2cap",
+                   TRANSPORT_STREAM: "stream", TRANSPORT_STREAM_ADAPTIVE: "adaptive",
+                   TRANSPORT_FANOUT: "fanout"}
+
+REPORT_ACK  = 0x81
+REPORT_DONE = 0x82
+
+# struct bench_cmd: op, phy, payload_len, conn_interval, att_mtu,
+#                   interval_us, duration_ms, transport
+CMD = struct.Struct("<BBHHHIIB")
+
+# struct bench_report: type, phy, att_mtu, conn_interval, payload_len,
+#                      sent, tx_errors, elapsed_us, late, transport
+REPORT = struct.Struct("<BBHHHIIIIB")
+REPORT_FIELDS = ("type", "phy", "att_mtu", "conn_interval", "payload_len",
+                 "sent", "tx_errors", "elapsed_us", "late", "transport")
+
+# struct bench_hdr: seq, tx_us
+HDR = struct.Struct("<II")
+
+
+def encode_start(payload_len, interval_us, duration_ms, phy=PHY_KEEP,
+                 conn_interval=0, att_mtu=0, transport=TRANSPORT_NOTIFY):
+    return CMD.pack(OP_START, phy, payload_len, conn_interval, att_mtu,
+                    interval_us, duration_ms, transport)
+
+
+def encode_stop():
+    return CMD.pack(OP_STOP, 0, 0, 0, 0, 0, 0, 0)
+
+
+def decode_report(data):
+    return dict(zip(REPORT_FIELDS, REPORT.unpack_from(data)))
+
+
+def decode_hdr(data):
+    '''Return (seq, tx_us) without copying the payload.'''
+    return HDR.unpack_from(data)
+
+
+def check_fill(data, seq):
+    '''True if the bytes after the header are the expected pattern.'''
+    return all(b == ((seq + i) & 0xFF)
+               for i, b in enumerate(data[HDR.size:], start=HDR.size))
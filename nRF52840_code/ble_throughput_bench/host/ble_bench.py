@@ -0,0 +1,199 @@
+'''
+BLE throughput / loss benchmark - host side.
+
+Connects to the BLE_BENCH peripheral with bleak, runs every combination of
+the requested payload sizes, notify cadences, ATT MTU caps, PHYs and
+connection intervals, and prints one CSV row per run with goodput, loss,
+gap distribution and latency percentiles (see bench_analysis.py).
+
+    python3 ble_bench.py --payload 20,128,244 --interval-us 0,1000 \\
+                         --phy 1m,2m --conn-interval-ms 7.5,15,30 \\
+                         --mtu 23,247 --duration 10 > results.csv
+
+--from-log analyzes the console log of the BabbleSim central instead
+(bsim/run.sh), where both devices share the simulated clock and latency
+is absolute. That log also holds the L2CAP runs: bleak cannot open an
+L2CAP channel, so live runs always use notifications.
+
+Requires: pip install bleak
+'''
+
+import argparse
+import asyncio
+import itertools
+import re
+import sys
+import time
+
+import bench_analysis
+import bench_proto as proto
+
+
+def csv_list(conv):
+    return lambda s: [conv(x) for x in s.split(",") if x]
+
+
+def phy_code(name):
+    try:
+        return proto.PHY_BY_NAME[name.lower()]
+    except KeyError:
+        raise argparse.ArgumentTypeError(f"unknown PHY {name!r}")
+
+
+def parse_args(argv=None):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[1],
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--name", default=proto.DEVICE_NAME,
+                    help="advertised device name")
+    ap.add_argument("--payload", type=csv_list(int), default=[20, 128, 244],
+                    help="notification sizes in bytes (header included)")
+    ap.add_argument("--interval-us", type=csv_list(int), default=[0],
+                    help="notify cadence, 0 = back to back")
+    ap.add_argument("--mtu", type=csv_list(int), default=[247],
+                    help="ATT MTU caps (the peripheral negotiates the max)")
+    ap.add_argument("--phy", type=csv_list(phy_code), default=[proto.PHY_2M],
+                    help="1m, 2m, coded or keep")
+    ap.add_argument("--conn-interval-ms", type=csv_list(float), default=[15.0],
+                    help="connection intervals (multiples of 1.25 ms)")
+    ap.add_argument("--duration", type=float, default=10.0,
+                    help="seconds per run")
+    ap.add_argument("--from-log", metavar="FILE",
+                    help="analyze a BabbleSim central log instead of a live link")
+    return ap.parse_args(argv)
+
+
+def combos(args):
+    for payload, interval, mtu, phy, ci in itertools.product(
+            args.payload, args.interval_us, args.mtu, args.phy,
+            args.conn_interval_ms):
+        yield {"payload": payload, "interval_us": interval, "att_mtu": mtu,
+               "phy": phy, "conn_interval_ms": ci}
+
+
+def print_row(params, metrics):
+    params = dict(params, phy=proto.PHY_NAMES.get(params["phy"], params["phy"]),
+                  transport=proto.TRANSPORT_NAMES.get(params.get("transport", 0),
+                                                      params.get("transport")))
+    print(bench_analysis.csv_row(params, metrics), flush=True)
+
+
+# ---------------------------------------------------------------------------
+# Live runs over bleak
+# ---------------------------------------------------------------------------
+
+class Run:
+    def __init__(self):
+        self.packets = []
+        self.ack = asyncio.Event()
+        self.done = asyncio.Event()
+        self.report = None
+        self.link = None
+
+    def on_data(self, _char, data):
+        rx_us = time.perf_counter_ns() // 1000
+        seq, tx_us = proto.decode_hdr(data)
+        self.packets.append((rx_us, seq, tx_us, len(data),
+                             proto.check_fill(data, seq)))
+
+    def on_ctrl(self, _char, data):
+        rep = proto.decode_report(data)
+        if rep["type"] == proto.REPORT_ACK:
+            self.link = rep
+            self.ack.set()
+        elif rep["type"] == proto.REPORT_DONE:
+            self.report = rep
+            self.done.set()
+
+
+async def run_live(args):
+    from bleak import BleakClient, BleakScanner
+
+    print(f"# scanning for {args.name}", file=sys.stderr)
+    device = await BleakScanner.find_device_by_name(args.name, timeout=15.0)
+    if device is None:
+        print(f"{args.name} not found", file=sys.stderr)
+        return 1
+
+    async with BleakClient(device) as client:
+        print(f"# connected, MTU {client.mtu_size}", file=sys.stderr)
+        print(bench_analysis.csv_header())
+
+        for params in combos(args):
+            run = Run()
+            await client.start_notify(proto.DATA_UUID, run.on_data)
+            await client.start_notify(proto.CTRL_UUID, run.on_ctrl)
+
+            cmd = proto.encode_start(
+                params["payload"], params["interval_us"],
+                int(args.duration * 1000), params["phy"],
+                round(params["conn_interval_ms"] / 1.25), params["att_mtu"])
+            await client.write_gatt_char(proto.CTRL_UUID, cmd, response=True)
+
+            try:
+                await asyncio.wait_for(run.ack.wait(), 10.0)
+                await asyncio.wait_for(run.done.wait(), args.duration + 10.0)
+            except asyncio.TimeoutError:
+                await client.write_gatt_char(proto.CTRL_UUID, proto.encode_stop(),
+                                             response=True)
+                print(f"# run timed out: {params}", file=sys.stderr)
+
+            # Let in-flight notifications land before unsubscribing
+            await asyncio.sleep(0.5)
+            await client.stop_notify(proto.DATA_UUID)
+            await client.stop_notify(proto.CTRL_UUID)
+
+            metrics = bench_analysis.analyze(run.packets, run.report)
+            if run.link:
+                params = dict(params, payload=run.link["payload_len"],
+                              att_mtu=run.link["att_mtu"],
+                              conn_interval_ms=run.link["conn_interval"] * 1.25)
+            print_row(params, metrics)
+    return 0
+
+
+# ---------------------------------------------------------------------------
+# BabbleSim log
+# ---------------------------------------------------------------------------
+
+LOG_LINE = re.compile(r"\b(RUN|ACK|RX|DONE|END),([-0-9,.]*)")
+
+
+def run_log(path):
+    params, packets, report = None, [], None
+    print(bench_analysis.csv_header())
+
+    with open(path, errors="replace") as fp:
+        for line in fp:
+            m = LOG_LINE.search(line)
+            if not m:
+                continue
+            kind = m.group(1)
+            f = [int(x) for x in m.group(2).split(",") if x]
+            if kind == "RUN":
+                params = {"payload": f[0], "interval_us": f[1], "att_mtu": f[2],
+                          "phy": f[3], "conn_interval_ms": f[4] * 1.25,
+                          "transport": f[5] if len(f) > 5 else proto.TRANSPORT_NOTIFY}
+                packets, report = [], None
+            elif kind == "ACK" and params:
+                params.update(phy=f[0], att_mtu=f[1],
+                              conn_interval_ms=f[2] * 1.25, payload=f[3])
+            elif kind == "RX":
+                packets.append((f[0], f[1], f[2], f[3], bool(f[4])))
+            elif kind == "DONE":
+                report = dict(zip(("sent", "tx_errors", "elapsed_us", "late"), f))
+            elif kind == "END" and params:
+                print_row(params, bench_analysis.analyze(packets, report,
+                                                         absolute=True))
+                params = None
+    return 0
+
+
+def main(argv=None):
+    args = parse_args(argv)
+    if args.from_log:
+        return run_log(args.from_log)
+    return asyncio.run(run_live(args))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
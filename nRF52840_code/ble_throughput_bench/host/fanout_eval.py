@@ -0,0 +1,129 @@
+'''
+Fan-out and aggregation evaluation - host side.
+
+Reads the console logs of bsim/run_fanout.sh: the peripheral logs of the
+fan-out runs (FANOUT lines, one peripheral streaming to several centrals)
+and the aggregator central's log (AGG lines, one central collecting from
+several peripherals), and puts both on one table of per-link figures.
+
+    python3 fanout_eval.py build_bsim_fanout/fanout_*/peripheral.log \\
+                           build_bsim_fanout/aggregate/aggregator.log \\
+                           --scaling scaling.csv > summary.csv
+
+Both tables stream 100-sample I16 frames, HDR_LEN + 200 bytes each, so
+the offered load per link is that much per 100 sample periods. "lost" is
+frames the link never delivered: skipped by the fan-out ring for a
+central that fell behind, or sequence gaps seen by the aggregator.
+"dropped" is frames a peripheral produced with nowhere to put them.
+'''
+
+import argparse
+import re
+import sys
+
+HDR_LEN = 14
+FRAME_SAMPLES = 100
+FRAME_BYTES = HDR_LEN + 2 * FRAME_SAMPLES
+
+LOG_LINE = re.compile(r"\b(FANOUT|AGG),([-0-9,]*)")
+
+SUMMARY_COLS = ("mode", "links", "link", "rate_hz", "offered_Bps", "goodput_Bps",
+                "goodput_pct", "frames", "lost", "dropped", "max_lag")
+SCALING_COLS = ("mode", "links", "rate_hz", "per_link_Bps", "min_link_Bps",
+                "total_Bps", "per_link_vs_1_pct", "lost")
+
+
+def offered_bps(period_us):
+    return 1e6 / period_us * FRAME_BYTES / FRAME_SAMPLES
+
+
+def row(mode, links, link, period_us, frames, nbytes, elapsed_us, lost, dropped, max_lag):
+    seconds = max(elapsed_us / 1e6, 1e-6)
+    goodput = nbytes / seconds
+    offered = offered_bps(period_us)
+    return {
+        "mode": mode,
+        "links": links,
+        "link": link,
+        "rate_hz": round(1e6 / period_us),
+        "offered_Bps": round(offered),
+        "goodput_Bps": round(goodput),
+        "goodput_pct": round(100.0 * goodput / offered, 1),
+        "frames": frames,
+        "lost": lost,
+        "dropped": dropped,
+        "max_lag": max_lag,
+    }
+
+
+def parse_log(path):
+    rows = []
+    with open(path, errors="replace") as fp:
+        for line in fp:
+            m = LOG_LINE.search(line)
+            if not m:
+                continue
+            try:
+                f = [int(x) for x in m.group(2).split(",") if x]
+            except ValueError:
+                continue
+            if m.group(1) == "FANOUT" and len(f) >= 9:
+                links, link, period_us, _sent, nbytes, elapsed_us, skipped, max_lag = f[:8]
+                # The frames a central completed; bytes carry whole frames
+                rows.append(row("fanout", links, link, period_us, nbytes // FRAME_BYTES,
+                                nbytes, elapsed_us, skipped, "", max_lag))
+            elif m.group(1) == "AGG" and len(f) >= 9:
+                links, link, period_us, frames, nbytes, gaps, elapsed_us, _sent, \
+                    tx_errors = f[:9]
+                rows.append(row("aggregate", links, link, period_us, frames, nbytes,
+                                elapsed_us, gaps, tx_errors, ""))
+    return rows
+
+
+def scaling(rows):
+    '''Per-link and total goodput per mode, link count and rate.'''
+    groups = {}
+    for r in rows:
+        groups.setdefault((r["mode"], r["rate_hz"], r["links"]), []).append(r)
+
+    out = []
+    for (mode, rate, links), g in sorted(groups.items()):
+        total = sum(r["goodput_Bps"] for r in g)
+        per_link = total / len(g)
+        single = groups.get((mode, rate, 1))
+        base = sum(r["goodput_Bps"] for r in single) / len(single) if single else 0
+        out.append({
+            "mode": mode,
+            "links": links,
+            "rate_hz": rate,
+            "per_link_Bps": round(per_link),
+            "min_link_Bps": min(r["goodput_Bps"] for r in g),
+            "total_Bps": total,
+            "per_link_vs_1_pct": round(100.0 * per_link / base, 1) if base else "",
+            "lost": sum(r["lost"] for r in g),
+        })
+    return out
+
+
+def main(argv=None):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    ap.add_argument("logs", nargs="+", help="peripheral and aggregator console logs")
+    ap.add_argument("--scaling", metavar="FILE",
+                    help="also write one row per mode, link count and rate to FILE")
+    args = ap.parse_args(argv)
+
+    rows = [r for path in args.logs for r in parse_log(path)]
+    print(",".join(SUMMARY_COLS))
+    for r in rows:
+        print(",".join(str(r[c]) for c in SUMMARY_COLS))
+
+    if args.scaling:
+        with open(args.scaling, "w") as out:
+            out.write(",".join(SCALING_COLS) + "\n")
+            for s in scaling(rows):
+                out.write(",".join(str(s[c]) for c in SCALING_COLS) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,195 @@
+'''
+Stream tier evaluation - host side.
+
+Reads the console log of the BabbleSim central built with
+-DBENCH_TABLE=adaptive (bsim/run_adaptive.sh) and compares the stream runs:
+the same synthetic sensor channel at a fixed full tier and under the
+adaptive tier controller (common/rate_ctrl), with interference injected
+during both.
+
+    python3 stream_eval.py build_bsim_adaptive/central.log \\
+                           --seconds per_second.csv > summary.csv
+
+Samples are counted at the full rate: a decimated frame stands for
+STREAM_DECIMATION samples per value and a features frame for its whole
+window. "coverage" is the share of the run's samples that reached the
+central in some form, so a frame lost on the link or dropped for lack of
+a credit is a hole either way.
+'''
+
+import argparse
+import re
+import sys
+
+import bench_proto as proto
+
+# stream_proto.h formats the tiers use
+FMT_I16_DELTA = 0x05
+FMT_I16_STATS = 0x06
+HDR_LEN = 14
+TIER_NAMES = {0: "full", 1: "packed", 2: "decimated", 3: "features"}
+
+LOG_LINE = re.compile(r"\b(RUN|DONE|END|FRAME|TIER),([-0-9,.]*)")
+
+SUMMARY_COLS = ("transport", "seconds", "frames_rx", "frames_lost", "tx_errors",
+                "coverage_pct", "switches", "full_pct", "packed_pct",
+                "decimated_pct", "features_pct", "age_ms_p50", "age_ms_p95",
+                "goodput_kbps")
+SECOND_COLS = ("transport", "second", "tier", "frames_rx", "frames_lost",
+               "coverage_pct", "bytes")
+
+
+def percentile(values, pct):
+    if not values:
+        return ""
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+class StreamRun:
+    def __init__(self, transport, period_us):
+        self.transport = transport
+        self.period_ns = period_us * 1000
+        self.frames = []   # (rx_us, seq, t0_us, raw_samples, bytes)
+        self.tiers = []    # (rx_us, tier)
+        self.report = None
+
+    def add_frame(self, f):
+        rx_us, _channel, fmt, count, seq, t0_us, period_ns, samples = f[:8]
+        if fmt == FMT_I16_STATS:
+            raw = max(1, round(period_ns / self.period_ns))
+            size = 2 * count
+        else:
+            raw = samples * max(1, round(period_ns / self.period_ns))
+            size = count if fmt == FMT_I16_DELTA else 2 * count
+        self.frames.append((rx_us, seq, t0_us, raw, HDR_LEN + size))
+
+    def tier_at(self, rx_us):
+        tier = 0
+        for t_us, t in self.tiers:
+            if t_us > rx_us:
+                break
+            tier = t
+        return tier
+
+    def lost_before(self):
+        '''Frames missing from the seq count ahead of each received frame.'''
+        lost, prev = [], None
+        for _rx, seq, *_ in self.frames:
+            lost.append(0 if prev is None else (seq - prev - 1) & 0xFFFF)
+            prev = seq
+        return lost
+
+    def per_second(self):
+        if not self.frames:
+            return []
+        start = self.frames[0][0]
+        per_s = 1e9 / self.period_ns
+        rows = {}
+        for (rx, _seq, _t0, raw, size), lost in zip(self.frames, self.lost_before()):
+            sec = (rx - start) // 1000000
+            r = rows.setdefault(sec, [0, 0, 0, 0])
+            r[0] += 1
+            r[1] += lost
+            r[2] += raw
+            r[3] += size
+        return [(sec, TIER_NAMES.get(self.tier_at(start + (sec + 1) * 1000000)),
+                 r[0], r[1], round(100.0 * r[2] / per_s, 1), r[3])
+                for sec, r in sorted(rows.items())]
+
+    def summary(self):
+        if not self.frames:
+            return dict.fromkeys(SUMMARY_COLS, "") | {"transport": self.name()}
+        start, end = self.frames[0][0], self.frames[-1][0]
+        seconds = max((end - start) / 1e6, 1e-6)
+        raw = sum(f[3] for f in self.frames)
+        expected = (self.frames[-1][2] - self.frames[0][2]) * 1000 / self.period_ns \
+            + self.frames[-1][3]
+
+        # Time spent in each tier, from the announcements seen
+        spent = dict.fromkeys(TIER_NAMES, 0)
+        t, tier, switches = start, 0, 0
+        for t_us, new in self.tiers:
+            t_us = min(max(t_us, start), end)
+            spent[tier] += t_us - t
+            switches += new != tier
+            t, tier = t_us, new
+        spent[tier] += end - t
+
+        # Age of the newest sample in each frame when it arrived
+        ages = [(rx - t0) / 1000 - raw * self.period_ns / 1e6
+                for rx, _seq, t0, raw, _size in self.frames]
+        return {
+            "transport": self.name(),
+            "seconds": round(seconds, 1),
+            "frames_rx": len(self.frames),
+            "frames_lost": sum(self.lost_before()),
+            "tx_errors": self.report["tx_errors"] if self.report else "",
+            "coverage_pct": round(100.0 * raw / expected, 1) if expected else "",
+            "switches": switches,
+            **{f"{name}_pct": round(100.0 * spent[k] / max(end - start, 1), 1)
+               for k, name in TIER_NAMES.items()},
+            "age_ms_p50": round(percentile(ages, 50), 1),
+            "age_ms_p95": round(percentile(ages, 95), 1),
+            "goodput_kbps": round(sum(f[4] for f in self.frames) * 8 / seconds / 1000, 1),
+        }
+
+    def name(self):
+        return proto.TRANSPORT_NAMES.get(self.transport, str(self.transport))
+
+
+def parse_log(path):
+    runs, run = [], None
+    with open(path, errors="replace") as fp:
+        for line in fp:
+            m = LOG_LINE.search(line)
+            if not m:
+                continue
+            kind = m.group(1)
+            try:
+                f = [int(x) for x in m.group(2).split(",") if x]
+            except ValueError:
+                continue
+            if kind == "RUN":
+                transport = f[5] if len(f) > 5 else proto.TRANSPORT_NOTIFY
+                run = None
+                if transport in (proto.TRANSPORT_STREAM, proto.TRANSPORT_STREAM_ADAPTIVE):
+                    run = StreamRun(transport, f[1])
+            elif run is None:
+                continue
+            elif kind == "FRAME" and len(f) >= 8:
+                run.add_frame(f)
+            elif kind == "TIER":
+                run.tiers.append((f[0], f[2]))
+            elif kind == "DONE":
+                run.report = dict(zip(("sent", "tx_errors", "elapsed_us", "late"), f))
+            elif kind == "END":
+                runs.append(run)
+                run = None
+    return runs
+
+
+def main(argv=None):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    ap.add_argument("log", help="central console log")
+    ap.add_argument("--seconds", metavar="FILE",
+                    help="also write one row per run and second to FILE")
+    args = ap.parse_args(argv)
+
+    runs = parse_log(args.log)
+    print(",".join(SUMMARY_COLS))
+    for run in runs:
+        s = run.summary()
+        print(",".join(str(s[c]) for c in SUMMARY_COLS))
+
+    if args.seconds:
+        with open(args.seconds, "w") as out:
+            out.write(",".join(SECOND_COLS) + "\n")
+            for run in runs:
+                for row in run.per_second():
+                    out.write(",".join(str(x) for x in (run.name(),) + row) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,114 @@
+/*
+ * Wire format of the BLE throughput benchmark.
+ *
+ * Shared by the peripheral (src/main.c), the BabbleSim central
+ * (bsim_central/) and mirrored in host/bench_proto.py. All fields are
+ * little-endian and packed.
+ *
+ * Service      fe dc ba 98 76 54 32 10 fe dc ba 98 76 54 32 20
+ *   Data       ...21  NOTIFY          bench_hdr + fill bytes
+ *   Control    ...22  WRITE | NOTIFY  bench_cmd in, bench_report out
+ *
+ * A run is: host writes BENCH_OP_START, peripheral applies the link
+ * parameters and answers BENCH_REPORT_ACK with what it actually got,
+ * streams data until duration_ms elapses (or BENCH_OP_STOP), then
+ * answers BENCH_REPORT_DONE with its own counters.
+ *
+ * With transport BENCH_TRANSPORT_L2CAP the data goes as SDUs on the
+ * common/l2cap_stream channel (PSM L2CAP_STREAM_PSM) instead of as
+ * notifications. The host opens that channel before the run. Each SDU
+ * starts with bench_hdr like a notification, and payload_len is the SDU
+ * size.
+ *
+ * The stream transports evaluate the adaptive tier controller
+ * (common/rate_ctrl) instead of raw throughput. The peripheral sends a
+ * synthetic EMG-like I16 channel as stream_proto frames through ble_tx,
+ * as the EMG firmware does: interval_us is the sample period and
+ * payload_len the samples per frame. BENCH_TRANSPORT_STREAM keeps the
+ * full tier and drops frames that find no credit.
+ * BENCH_TRANSPORT_STREAM_ADAPTIVE lets rate_ctrl pick the tier and
+ * announces each switch on the CONTROL channel. Data notifications then
+ * carry stream frames, not bench_hdr; sent / tx_errors count frames.
+ *
+ * BENCH_TRANSPORT_FANOUT sends the full-tier stream through common/fanout
+ * to every connected central that subscribed to Data, not only the one
+ * that wrote the command. It needs a peripheral built with
+ * -DBENCH_TABLE=fanout (CONFIG_BT_MAX_CONN > 1). sent counts frames
+ * published, tx_errors frames that found no subscriber; what each central
+ * completed and lost goes to the peripheral's log.
+ */
+#ifndef BENCH_PROTO_H
+#define BENCH_PROTO_H
+
+#include <stdint.h>
+
+#define BENCH_UUID_SVC_VAL \
+	BT_UUID_128_ENCODE(0xfedcba98, 0x7654, 0x3210, 0xfedc, 0xba9876543220)
+#define BENCH_UUID_DATA_VAL \
+	BT_UUID_128_ENCODE(0xfedcba98, 0x7654, 0x3210, 0xfedc, 0xba9876543221)
+#define BENCH_UUID_CTRL_VAL \
+	BT_UUID_128_ENCODE(0xfedcba98, 0x7654, 0x3210, 0xfedc, 0xba9876543222)
+
+/* ---- Control: host -> peripheral ---- */
+
+#define BENCH_OP_START  0x01
+#define BENCH_OP_STOP   0x02
+
+/* bench_cmd.transport */
+#define BENCH_TRANSPORT_NOTIFY  0
+#define BENCH_TRANSPORT_L2CAP   1
+#define BENCH_TRANSPORT_STREAM  2
+#define BENCH_TRANSPORT_STREAM_ADAPTIVE  3
+#define BENCH_TRANSPORT_FANOUT  4
+
+/* bench_cmd.phy */
+#define BENCH_PHY_KEEP   0
+#define BENCH_PHY_1M     1
+#define BENCH_PHY_2M     2
+#define BENCH_PHY_CODED  3
+
+struct bench_cmd {
+	uint8_t  op;
+	uint8_t  phy;             /* BENCH_PHY_*                          */
+	uint16_t payload_len;     /* notification size, header included  */
+	uint16_t conn_interval;   /* 1.25 ms units, 0 = keep current      */
+	uint16_t att_mtu;         /* cap on the ATT MTU used, 0 = no cap  */
+	uint32_t interval_us;     /* notify cadence, 0 = back to back     */
+	uint32_t duration_ms;
+	uint8_t  transport;       /* BENCH_TRANSPORT_*, may be omitted    */
+} __attribute__((packed));
+
+/* ---- Control: peripheral -> host ---- */
+
+#define BENCH_REPORT_ACK   0x81
+#define BENCH_REPORT_DONE  0x82
+
+struct bench_report {
+	uint8_t  type;            /* BENCH_REPORT_*                       */
+	uint8_t  phy;             /* PHY in use (BENCH_PHY_*)             */
+	uint16_t att_mtu;         /* effective ATT MTU for this run       */
+	uint16_t conn_interval;   /* 1.25 ms units                        */
+	uint16_t payload_len;     /* after clamping to att_mtu - 3 or SDU */
+	uint32_t sent;            /* notifications accepted by the stack  */
+	uint32_t tx_errors;       /* notify / SDU send failures (dropped) */
+	uint32_t elapsed_us;
+	uint32_t late;            /* cadence deadlines missed             */
+	uint8_t  transport;       /* BENCH_TRANSPORT_* used for the run   */
+} __attribute__((packed));
+
+/* ---- Data ---- */
+
+/*
+ * Every notification starts with this header. seq counts every packet
+ * the peripheral tried to send (dropped ones included), so host-side
+ * gaps are link loss and tx_errors is source loss. The remaining bytes
+ * are (uint8_t)(seq + i) so corruption is detectable.
+ */
+struct bench_hdr {
+	uint32_t seq;
+	uint32_t tx_us;           /* device uptime (µs) when queued       */
+} __attribute__((packed));
+
+#define BENCH_MIN_PAYLOAD  ((uint16_t)sizeof(struct bench_hdr))
+
+#endif /* BENCH_PROTO_H */
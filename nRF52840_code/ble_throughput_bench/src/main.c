@@ -0,0 +1,667 @@
+/*
+ * BLE throughput / loss benchmark (peripheral).
+ *
+ * Replaces the fixed experiments in packet_loss_test (2-byte counter
+ * every 50 µs) and ble_buffer_transmit (160-byte blocks, no sleep) with
+ * one firmware whose payload size, notify cadence, ATT MTU, PHY and
+ * connection interval are set per run over the control characteristic.
+ * See include/bench_proto.h for the wire format and host/ble_bench.py
+ * for the analyzer. Runs can also send over the L2CAP stream channel
+ * from common/ to compare it with notifications, or send a synthetic
+ * sensor stream to evaluate the adaptive tier controller.
+ *
+ * Built with -DBENCH_TABLE=fanout it accepts several centrals. The first
+ * one runs the table; the others only subscribe to Data and receive
+ * BENCH_TRANSPORT_FANOUT runs, so per-connection throughput can be
+ * measured against the number of centrals.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "bench_proto.h"
+#include "ble_tx.h"
+#include "fanout.h"
+#include "l2cap_stream.h"
+#include "rate_ctrl.h"
+#include "stream_proto.h"
+
+/* Largest notification: ATT MTU (CONFIG_BT_L2CAP_TX_MTU) minus opcode+handle */
+#define MAX_PAYLOAD       (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+/* Back-to-back L2CAP runs block on the SDU pool instead of failing */
+#define SDU_WAIT          K_MSEC(100)
+
+/* How long to wait for the controller to apply PHY / interval changes */
+#define LINK_UPDATE_MS    2000
+
+/* Stream runs: default sample period and the expected I16_DELTA ratio */
+#define STREAM_PERIOD_US  1000
+#define STREAM_PACKED_PCT 60
+
+/* ---- BLE UUIDs ---- */
+static struct bt_uuid_128 bench_svc_uuid  = BT_UUID_INIT_128(BENCH_UUID_SVC_VAL);
+static struct bt_uuid_128 bench_data_uuid = BT_UUID_INIT_128(BENCH_UUID_DATA_VAL);
+static struct bt_uuid_128 bench_ctrl_uuid = BT_UUID_INIT_128(BENCH_UUID_CTRL_VAL);
+
+/* ---- State ---- */
+static struct bt_conn *bench_conn;      /* the central running the table */
+static bool data_notify_enabled;
+static bool ctrl_notify_enabled;
+
+/* Link parameters as last reported by the stack */
+static uint8_t  cur_phy = BENCH_PHY_1M;
+static uint16_t cur_interval;
+static uint16_t cur_mtu = 23;
+
+K_SEM_DEFINE(link_updated, 0, 1);
+K_MSGQ_DEFINE(cmd_q, sizeof(struct bench_cmd), 4, 4);
+
+static atomic_t stop_requested;
+static uint8_t  tx_buf[MAX(MAX_PAYLOAD, L2CAP_STREAM_SDU_MAX)];
+
+/* ---- GATT ---- */
+
+static void data_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	data_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	printk("Data notifications %s\n", data_notify_enabled ? "ENABLED" : "DISABLED");
+}
+
+static void ctrl_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	ctrl_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+static ssize_t write_ctrl(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			  const void *buf, uint16_t len, uint16_t offset,
+			  uint8_t flags)
+{
+	struct bench_cmd cmd = { 0 };
+
+	if (offset != 0 || len < 1 || len > sizeof(cmd)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+	memcpy(&cmd, buf, len);
+
+	if (cmd.op == BENCH_OP_STOP) {
+		atomic_set(&stop_requested, 1);
+		return len;
+	}
+	if (cmd.op != BENCH_OP_START) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	/* Runs execute on the main thread, not in the BT RX context */
+	if (k_msgq_put(&cmd_q, &cmd, K_NO_WAIT) != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_PREPARE_QUEUE_FULL);
+	}
+	return len;
+}
+
+/*
+ * attrs[0] = primary service
+ * attrs[1] = data characteristic declaration
+ * attrs[2] = data value            <-- notify this
+ * attrs[3] = data CCC
+ * attrs[4] = control characteristic declaration
+ * attrs[5] = control value         <-- reports
+ * attrs[6] = control CCC
+ */
+BT_GATT_SERVICE_DEFINE(bench_svc,
+	BT_GATT_PRIMARY_SERVICE(&bench_svc_uuid),
+
+	BT_GATT_CHARACTERISTIC(&bench_data_uuid.uuid,
+			       BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE,
+			       NULL, NULL, NULL),
+	BT_GATT_CCC(data_ccc_changed,
+		    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+	BT_GATT_CHARACTERISTIC(&bench_ctrl_uuid.uuid,
+			       BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_WRITE,
+			       NULL, write_ctrl, NULL),
+	BT_GATT_CCC(ctrl_ccc_changed,
+		    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
+);
+
+#define DATA_ATTR  (&bench_svc.attrs[2])
+#define CTRL_ATTR  (&bench_svc.attrs[5])
+
+/* ---- Connection callbacks ---- */
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	if (conn != bench_conn) {
+		printk("Listener ATT MTU %u\n", bt_gatt_get_mtu(conn));
+		return;
+	}
+	cur_mtu = bt_gatt_get_mtu(conn);
+	printk("ATT MTU %u%s\n", cur_mtu, err ? " (exchange failed)" : "");
+}
+
+static struct bt_gatt_exchange_params mtu_params = { .func = mtu_exchanged };
+static struct bt_gatt_exchange_params listener_mtu_params[CONFIG_BT_MAX_CONN];
+
+static void start_advertising(void);
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct bt_conn_info info;
+
+	if (err) {
+		printk("Connection failed (err 0x%02x)\n", err);
+		return;
+	}
+
+	int index = fanout_add(conn);
+
+	if (fanout_count() < CONFIG_BT_MAX_CONN) {
+		start_advertising();
+	}
+	if (bench_conn) {
+		/* A listener: it only gets fan-out runs */
+		printk("Central %d joined, %u connected\n", index, fanout_count());
+		if (index >= 0) {
+			listener_mtu_params[index].func = mtu_exchanged;
+			bt_gatt_exchange_mtu(conn, &listener_mtu_params[index]);
+		}
+		bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+		return;
+	}
+
+	bench_conn = bt_conn_ref(conn);
+	if (bt_conn_get_info(conn, &info) == 0) {
+		cur_interval = info.le.interval;
+	}
+	cur_mtu = bt_gatt_get_mtu(conn);
+	printk("Connected, interval %u x 1.25 ms\n", cur_interval);
+
+	/* Largest MTU and data length the build allows; runs cap it lower */
+	bt_gatt_exchange_mtu(conn, &mtu_params);
+	bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	fanout_remove(conn);
+	if (conn != bench_conn) {
+		printk("Central left (reason 0x%02x), %u connected\n", reason, fanout_count());
+		return;
+	}
+
+	printk("Disconnected (reason 0x%02x)\n", reason);
+	atomic_set(&stop_requested, 1);
+	data_notify_enabled = false;
+	ctrl_notify_enabled = false;
+
+	if (bench_conn) {
+		bt_conn_unref(bench_conn);
+		bench_conn = NULL;
+	}
+	ble_tx_reset();
+}
+
+/* Connection object released: advertise again for the next host */
+static void recycled(void)
+{
+	start_advertising();
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+			     uint16_t latency, uint16_t timeout)
+{
+	if (conn != bench_conn) {
+		return;
+	}
+	cur_interval = interval;
+	printk("Interval %u x 1.25 ms, latency %u\n", interval, latency);
+	k_sem_give(&link_updated);
+}
+
+static void le_phy_updated(struct bt_conn *conn,
+			   struct bt_conn_le_phy_info *param)
+{
+	if (conn != bench_conn) {
+		return;
+	}
+	switch (param->tx_phy) {
+	case BT_GAP_LE_PHY_2M:
+		cur_phy = BENCH_PHY_2M;
+		break;
+	case BT_GAP_LE_PHY_CODED:
+		cur_phy = BENCH_PHY_CODED;
+		break;
+	default:
+		cur_phy = BENCH_PHY_1M;
+		break;
+	}
+	printk("PHY tx %u rx %u\n", param->tx_phy, param->rx_phy);
+	k_sem_give(&link_updated);
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected        = connected,
+	.disconnected     = disconnected,
+	.recycled         = recycled,
+	.le_param_updated = le_param_updated,
+	.le_phy_updated   = le_phy_updated,
+};
+
+/* ---- Advertising ---- */
+static const struct bt_data ad[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME,
+		(sizeof(CONFIG_BT_DEVICE_NAME) - 1)),
+};
+
+static const struct bt_data sd[] = {
+	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BENCH_UUID_SVC_VAL),
+};
+
+static void start_advertising(void)
+{
+	int err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_2,
+				  ad, ARRAY_SIZE(ad),
+				  sd, ARRAY_SIZE(sd));
+	if (err == -EALREADY) {
+		return;
+	}
+	if (err) {
+		printk("Advertising failed to start (err %d)\n", err);
+		return;
+	}
+	printk("Advertising as \"%s\"\n", CONFIG_BT_DEVICE_NAME);
+}
+
+/* ---- Benchmark run ---- */
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void send_report(uint8_t type, const struct bench_report *r)
+{
+	struct bench_report out = *r;
+
+	out.type = type;
+	if (bench_conn && ctrl_notify_enabled) {
+		bt_gatt_notify(bench_conn, CTRL_ATTR, &out, sizeof(out));
+	}
+}
+
+/* Request a link change and wait for the controller to confirm it */
+static void apply_link(const struct bench_cmd *cmd)
+{
+	static const uint8_t gap_phy[] = {
+		[BENCH_PHY_1M]    = BT_GAP_LE_PHY_1M,
+		[BENCH_PHY_2M]    = BT_GAP_LE_PHY_2M,
+		[BENCH_PHY_CODED] = BT_GAP_LE_PHY_CODED,
+	};
+
+	if (cmd->phy != BENCH_PHY_KEEP && cmd->phy < ARRAY_SIZE(gap_phy) &&
+	    cmd->phy != cur_phy) {
+		struct bt_conn_le_phy_param phy = {
+			.options     = BT_CONN_LE_PHY_OPT_NONE,
+			.pref_tx_phy = gap_phy[cmd->phy],
+			.pref_rx_phy = gap_phy[cmd->phy],
+		};
+
+		k_sem_reset(&link_updated);
+		if (bt_conn_le_phy_update(bench_conn, &phy) == 0) {
+			k_sem_take(&link_updated, K_MSEC(LINK_UPDATE_MS));
+		}
+	}
+
+	if (cmd->conn_interval != 0 && cmd->conn_interval != cur_interval) {
+		struct bt_le_conn_param *param =
+			BT_LE_CONN_PARAM(cmd->conn_interval, cmd->conn_interval,
+					 0, 400);
+
+		k_sem_reset(&link_updated);
+		if (bt_conn_le_param_update(bench_conn, param) == 0) {
+			k_sem_take(&link_updated, K_MSEC(LINK_UPDATE_MS));
+		}
+	}
+}
+
+/* Wait until @deadline (device µs), busy-waiting below one tick */
+static bool wait_until(uint32_t deadline)
+{
+	int32_t remain = (int32_t)(deadline - now_us());
+
+	if (remain < 0) {
+		return false;
+	}
+	if (remain >= (int32_t)k_ticks_to_us_ceil32(2)) {
+		k_usleep(remain - k_ticks_to_us_ceil32(1));
+	}
+	while ((int32_t)(deadline - now_us()) > 0) {
+		/* spin */
+	}
+	return true;
+}
+
+/*
+ * Synthetic EMG: low-passed noise whose amplitude alternates between rest
+ * and a burst every second, so it packs about as well as the real signal.
+ */
+static int16_t synth_sample(uint32_t n, uint32_t rate_hz)
+{
+	static uint32_t lcg = 1;
+	static int32_t y;
+	int32_t amp = ((n / MAX(rate_hz, 1u)) & 1) ? 1500 : 100;
+
+	lcg = lcg * 1664525u + 1013904223u;
+	int32_t x = (int32_t)((lcg >> 16) % (uint32_t)(2 * amp + 1)) - amp;
+
+	y += (x - y) / 4;
+	return (int16_t)y;
+}
+
+/* Samples per frame: payload_len, bounded by what one notification holds */
+static uint8_t stream_batch(const struct bench_cmd *cmd, uint16_t max_len)
+{
+	int fit = ((int)max_len - 2 * STREAM_HDR_LEN - STREAM_CTRL_TIER_LEN) / 2;
+
+	return CLAMP(cmd->payload_len, STREAM_DECIMATION,
+		     CLAMP(fit, STREAM_DECIMATION, UINT8_MAX));
+}
+
+/*
+ * Per-central figures of a fan-out run, one line each:
+ *
+ *   FANOUT,<centrals>,<index>,<period_us>,<sent>,<bytes>,<elapsed_us>,<skipped>,
+ *          <max_lag>,<retries>
+ *
+ * bytes is what the central's link completed during the run; max_lag
+ * covers the whole connection. @before holds each index's counters from
+ * the start of the run.
+ */
+static void report_fanout(const struct fanout_conn_stats *before, uint32_t period_us,
+			  uint32_t elapsed_us)
+{
+	uint8_t centrals = fanout_subscribers();
+
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		struct fanout_conn_stats st;
+
+		fanout_get_stats(i, &st);
+		if (!st.active || st.connected_ms != before[i].connected_ms) {
+			continue;
+		}
+		printk("FANOUT,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", centrals, i, period_us,
+		       st.sent - before[i].sent, st.bytes - before[i].bytes, elapsed_us,
+		       st.skipped - before[i].skipped, st.max_lag, st.retries - before[i].retries);
+	}
+}
+
+/*
+ * Stream run: frames of @batch samples at one frame per batch period,
+ * queued without waiting for a credit, like the EMG firmware's live
+ * path. A frame that finds no credit is dropped (tx_errors). In adaptive
+ * runs the tier follows rate_ctrl and every switch is announced ahead of
+ * the frame that uses it. Fan-out runs publish each frame once into
+ * common/fanout for every subscribed central; there a frame is dropped
+ * only if nobody is subscribed, and a central that falls behind loses
+ * frames to the ring instead (FANOUT lines).
+ */
+static void run_stream(const struct bench_cmd *cmd, struct bench_report *rep,
+		       uint16_t max_len)
+{
+	bool adaptive = (cmd->transport == BENCH_TRANSPORT_STREAM_ADAPTIVE);
+	bool fan = (cmd->transport == BENCH_TRANSPORT_FANOUT);
+	uint32_t period_us = cmd->interval_us ? cmd->interval_us : STREAM_PERIOD_US;
+	uint32_t rate_hz = 1000000u / period_us;
+	uint8_t batch = stream_batch(cmd, max_len);
+	struct stream_channel ch =
+		STREAM_CHANNEL_INIT(STREAM_CH_EMG, STREAM_FMT_I16, period_us * 1000u);
+	struct stream_channel ctrl =
+		STREAM_CHANNEL_INIT(STREAM_CH_CONTROL, STREAM_FMT_BYTES, 0);
+	struct rate_ctrl rc;
+	uint32_t demand[STREAM_TIER_COUNT];
+	int16_t samples[UINT8_MAX];
+	uint32_t n = 0;
+	bool announce = adaptive;
+
+	rate_ctrl_init(&rc, STREAM_TIER_FULL, adaptive ? STREAM_TIER_FEATURES : STREAM_TIER_FULL);
+	rate_ctrl_demand_i16(demand, rate_hz, batch, STREAM_PACKED_PCT);
+
+	printk("Stream run: %u Hz, %u samples/frame, %s for %u ms\n", rate_hz, batch,
+	       adaptive ? "adaptive" : fan ? "fan-out" : "full tier", cmd->duration_ms);
+
+	struct fanout_conn_stats before[FANOUT_MAX_CONN];
+
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		fanout_get_stats(i, &before[i]);
+	}
+
+	uint32_t start = now_us();
+	uint32_t next = start;
+	uint32_t window_start = start;
+	uint32_t window_failures = 0;
+	uint32_t window_offered = 0;
+	struct ble_tx_stats st;
+
+	ble_tx_get_stats(&st);
+	uint32_t window_bytes = st.bytes;
+
+	while (!atomic_get(&stop_requested) && bench_conn &&
+	       (uint32_t)(now_us() - start) < cmd->duration_ms * 1000u) {
+		/* A frame leaves once its last sample exists */
+		uint32_t t0 = next;
+
+		next += batch * period_us;
+		if (!wait_until(next)) {
+			rep->late++;
+		}
+		for (uint8_t i = 0; i < batch; i++) {
+			samples[i] = synth_sample(n++, rate_hz);
+		}
+
+		uint32_t now = now_us();
+
+		if (adaptive && now - window_start >= RATE_CTRL_WINDOW_MS * 1000u) {
+			ble_tx_get_stats(&st);
+			struct rate_ctrl_input in = {
+				.window_us       = now - window_start,
+				.offered_bytes   = window_offered,
+				.completed_bytes = st.bytes - window_bytes,
+				.failures        = window_failures,
+				.in_flight       = ble_tx_in_flight(),
+				.credits         = BLE_TX_CREDITS,
+			};
+			uint8_t old = rc.tier;
+
+			if (rate_ctrl_update(&rc, &in, demand) != old) {
+				announce = true;
+				printk("Tier %u -> %u (capacity %u B/s)\n", old, rc.tier,
+				       rc.capacity_bps);
+			}
+			window_start = now;
+			window_bytes = st.bytes;
+			window_offered = 0;
+			window_failures = 0;
+		}
+
+		struct stream_buf out;
+
+		stream_buf_init(&out, tx_buf, max_len);
+		if (announce) {
+			stream_put_tier_change(&out, &ctrl, t0, STREAM_CH_EMG, rc.tier);
+		}
+		int err = stream_put_tier(&out, &ch, rc.tier, t0, samples, batch);
+
+		/* -ENOSPC only if the ATT MTU cannot hold one frame */
+		if (err == 0 && fan) {
+			err = fanout_publish(out.data, out.len) > 0 ? 0 : -ENOTCONN;
+		} else if (err == 0) {
+			err = data_notify_enabled ?
+			      ble_tx_notify(bench_conn, DATA_ATTR, out.data, out.len, K_NO_WAIT) :
+			      -ENOTCONN;
+		}
+		if (err) {
+			/* The announcement goes again with the next frame */
+			rep->tx_errors++;
+			window_failures++;
+		} else {
+			rep->sent++;
+			window_offered += out.len;
+			announce = false;
+		}
+	}
+	if (fan) {
+		/* Let the slower centrals drain what the ring still holds */
+		k_msleep(1000);
+		report_fanout(before, period_us, now_us() - start);
+		return;
+	}
+	ble_tx_flush(K_MSEC(1000));
+	printk("Stream run: %u tier switches, capacity estimate %u B/s\n", rc.switches,
+	       rc.capacity_bps);
+}
+
+static void run_bench(const struct bench_cmd *cmd)
+{
+	struct bench_report rep = { 0 };
+	struct bench_hdr hdr = { 0 };
+
+	atomic_set(&stop_requested, 0);
+	apply_link(cmd);
+
+	bool l2cap = (cmd->transport == BENCH_TRANSPORT_L2CAP);
+	bool stream = (cmd->transport == BENCH_TRANSPORT_STREAM ||
+		       cmd->transport == BENCH_TRANSPORT_STREAM_ADAPTIVE ||
+		       cmd->transport == BENCH_TRANSPORT_FANOUT);
+	uint16_t mtu = cur_mtu;
+	if (cmd->att_mtu != 0 && cmd->att_mtu < mtu) {
+		mtu = MAX(cmd->att_mtu, 23);
+	}
+	uint16_t max_len = l2cap ? l2cap_stream_sdu_max() : MIN(mtu - 3, MAX_PAYLOAD);
+
+	if (cmd->transport == BENCH_TRANSPORT_FANOUT) {
+		/* Every central's ATT MTU, not only this one's */
+		max_len = MIN(max_len, MAX(fanout_max_payload(), 23 - 3));
+	}
+	uint16_t len = CLAMP(cmd->payload_len, BENCH_MIN_PAYLOAD,
+			     MAX(max_len, BENCH_MIN_PAYLOAD));
+
+	rep.phy           = cur_phy;
+	rep.att_mtu       = mtu;
+	rep.conn_interval = cur_interval;
+	rep.payload_len   = len;
+	rep.transport     = cmd->transport;
+
+	if (stream) {
+		/* payload_len is samples per frame in stream runs */
+		rep.payload_len = stream_batch(cmd, max_len);
+		send_report(BENCH_REPORT_ACK, &rep);
+
+		uint32_t start = now_us();
+
+		run_stream(cmd, &rep, max_len);
+		rep.elapsed_us = now_us() - start;
+		send_report(BENCH_REPORT_DONE, &rep);
+		printk("Done: frames sent=%u dropped=%u late=%u\n", rep.sent,
+		       rep.tx_errors, rep.late);
+		return;
+	}
+	send_report(BENCH_REPORT_ACK, &rep);
+
+	printk("Run: %u B %s every %u us for %u ms (MTU %u, %u x 1.25 ms, PHY %u)\n",
+	       len, l2cap ? "SDUs" : "notifications", cmd->interval_us,
+	       cmd->duration_ms, mtu, cur_interval, cur_phy);
+
+	uint32_t start = now_us();
+	uint32_t next = start;
+	uint32_t duration_us = cmd->duration_ms * 1000u;
+
+	while (!atomic_get(&stop_requested) && bench_conn &&
+	       (uint32_t)(now_us() - start) < duration_us) {
+		if (cmd->interval_us != 0) {
+			if (!wait_until(next)) {
+				rep.late++;
+			}
+			next += cmd->interval_us;
+		}
+
+		hdr.tx_us = now_us();
+		memcpy(tx_buf, &hdr, sizeof(hdr));
+		for (uint16_t i = sizeof(hdr); i < len; i++) {
+			tx_buf[i] = (uint8_t)(hdr.seq + i);
+		}
+
+		int err;
+
+		if (l2cap) {
+			err = l2cap_stream_send(tx_buf, len,
+						cmd->interval_us ? K_NO_WAIT : SDU_WAIT);
+		} else {
+			err = data_notify_enabled ?
+			      bt_gatt_notify(bench_conn, DATA_ATTR, tx_buf, len) :
+			      -ENOTCONN;
+		}
+		if (err) {
+			rep.tx_errors++;
+			if (cmd->interval_us == 0) {
+				/* Back-to-back mode: let the stack drain */
+				k_yield();
+			}
+		} else {
+			rep.sent++;
+		}
+		hdr.seq++;
+	}
+
+	rep.elapsed_us = now_us() - start;
+	send_report(BENCH_REPORT_DONE, &rep);
+
+	printk("Done: sent=%u errors=%u late=%u in %u ms -> %u B/s\n",
+	       rep.sent, rep.tx_errors, rep.late, rep.elapsed_us / 1000u,
+	       (uint32_t)((uint64_t)rep.sent * len * 1000000u /
+			  MAX(rep.elapsed_us, 1u)));
+}
+
+int main(void)
+{
+	int err;
+
+	printk("Starting BLE throughput benchmark\n");
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Bluetooth init failed (err %d)\n", err);
+		return 0;
+	}
+	printk("Bluetooth initialized\n");
+
+	err = l2cap_stream_init();
+	if (err) {
+		printk("L2CAP server registration failed (err %d)\n", err);
+	}
+
+	fanout_init(DATA_ATTR);
+
+	start_advertising();
+
+	while (1) {
+		struct bench_cmd cmd;
+
+		k_msgq_get(&cmd_q, &cmd, K_FOREVER);
+		if (!bench_conn) {
+			continue;
+		}
+		run_bench(&cmd);
+	}
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Credit-based notification transmit engine.
+ *
+ * bt_gatt_notify() in a tight loop fails with -ENOMEM as soon as the
+ * host's ACL TX buffers run out. The caller then either spins or drops
+ * the packet. This engine holds one credit per TX buffer instead. A
+ * credit is taken before bt_gatt_notify_cb() and returned from its
+ * completion callback, once the controller has sent the packet. So a
+ * producer that calls ble_tx_notify() blocks (or gets -EAGAIN) while
+ * the link is full. It never loses data to buffer exhaustion or burns
+ * CPU retrying.
+ *
+ * One link at a time. Call ble_tx_reset() from the disconnected
+ * callback so credits held by packets that will never complete are
+ * returned.
+ */
+#ifndef BLE_TX_H
+#define BLE_TX_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/*
+ * Notifications in flight. Defaults to the ACL TX buffer count, capped
+ * by the number of TX contexts (one per notification with a callback)
+ * on stacks that have that limit.
+ */
+#ifndef BLE_TX_CREDITS
+#if defined(CONFIG_BT_CONN_TX_MAX)
+#define BLE_TX_CREDITS  MIN(CONFIG_BT_BUF_ACL_TX_COUNT, CONFIG_BT_CONN_TX_MAX)
+#else
+#define BLE_TX_CREDITS  CONFIG_BT_BUF_ACL_TX_COUNT
+#endif
+#endif
+
+struct ble_tx_stats {
+	uint32_t sent;          /* notifications accepted by the stack     */
+	uint32_t completed;     /* completion callbacks received           */
+	uint32_t bytes;         /* payload bytes of completed packets      */
+	uint32_t waits;         /* calls that had to wait for a credit     */
+	uint32_t timeouts;      /* calls that gave up (-EAGAIN)            */
+	uint32_t errors;        /* bt_gatt_notify_cb() failures            */
+	uint32_t max_in_flight;
+};
+
+/*
+ * Send one notification, waiting up to @timeout for a credit.
+ *
+ * @return 0 when queued, -EAGAIN if no credit became free in time or
+ *         ble_tx_reset() ran while waiting for one, -ENOTCONN without
+ *         a connection, or the bt_gatt_notify_cb()
+ *         error (the credit is returned in that case).
+ */
+int ble_tx_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+		  const void *data, uint16_t len, k_timeout_t timeout);
+
+/* Notifications queued but not yet completed. */
+uint32_t ble_tx_in_flight(void);
+
+/* Wait until every queued notification has completed. */
+int ble_tx_flush(k_timeout_t timeout);
+
+/* Return all credits; ignore completions of packets sent before. */
+void ble_tx_reset(void);
+
+void ble_tx_get_stats(struct ble_tx_stats *out);
+void ble_tx_reset_stats(void);
+
+#endif /* BLE_TX_H */
@@ -0,0 +1,68 @@
+/*
+ * Decimation for oversampled SAADC data.
+ *
+ * Two stages take the raw DMA samples down to the rate a sensor needs:
+ *
+ *   CIC     order DECIM_CIC_ORDER, ratio 2^log2_ratio. Integrators and
+ *           combs only, no multiplies. Its sinc^3 response droops 1.7 dB
+ *           at the edge of the final passband.
+ *   FIR     DECIM_FIR_TAPS-tap symmetric filter that decimates by 2 more
+ *           and flattens that droop: 0.13 dB ripple up to 0.4 * output
+ *           rate, better than 48 dB down from 0.6 * output rate (which
+ *           folds back no closer than 0.4).
+ *
+ * The total ratio is 2^(log2_ratio + 1). Each stage averages noise, so
+ * the output carries more bits than the input. It is scaled to out_bits
+ * full scale: with in_bits 14 and out_bits 16, a full-scale 14-bit input
+ * comes out as 65532. Values are int32 because filter overshoot can pass
+ * the nominal range.
+ *
+ * The CIC runs in wrapping uint32 arithmetic, which is exact while
+ * in_bits + 1 + DECIM_CIC_ORDER * log2_ratio fits in 32, hence
+ * DECIM_LOG2_RATIO_MAX for 14-bit input.
+ *
+ * Pure C with no Zephyr dependency, so it can be exercised on a host.
+ */
+#ifndef DECIM_H
+#define DECIM_H
+
+#include <stdint.h>
+
+#define DECIM_CIC_ORDER       3
+#define DECIM_FIR_TAPS        31
+#define DECIM_LOG2_RATIO_MAX  5
+
+struct decim {
+	uint8_t  log2_ratio;
+	int8_t   shift;           /* CIC gain and bit scaling, right shift  */
+	uint16_t phase;           /* input samples into the current CIC output */
+	uint32_t integ[DECIM_CIC_ORDER];
+	uint32_t comb[DECIM_CIC_ORDER];
+	int32_t  fir[2 * DECIM_FIR_TAPS]; /* history, written twice so the
+					   * window is always contiguous      */
+	uint8_t  fir_pos;         /* oldest sample in the window            */
+	uint8_t  fir_odd;         /* FIR outputs only every second input    */
+};
+
+/*
+ * Set up for a CIC ratio of 2^@log2_ratio (1..DECIM_LOG2_RATIO_MAX) and
+ * scale @in_bits input to @out_bits output. Returns -EINVAL if the CIC
+ * could overflow.
+ */
+int decim_init(struct decim *d, uint8_t log2_ratio, uint8_t in_bits, uint8_t out_bits);
+
+/* Input samples per output sample. */
+static inline uint16_t decim_ratio(const struct decim *d)
+{
+	return (uint16_t)(2u << d->log2_ratio);
+}
+
+/*
+ * Filter @n input samples, state carried over from the previous call.
+ * Writes up to @cap output samples to @out and returns how many; an output
+ * that does not fit is lost, so size @out for n / decim_ratio() + 1.
+ */
+uint16_t decim_process(struct decim *d, const int16_t *in, uint16_t n,
+		       int32_t *out, uint16_t cap);
+
+#endif /* DECIM_H */
@@ -0,0 +1,131 @@
+/*
+ * Event detection on a high-rate sample stream.
+ *
+ * event_detect_process() takes one DMA buffer of raw samples at a time and
+ * runs four detectors against a slow baseline (an EWMA of the signal):
+ *
+ *   EVENT_TRIG_THRESHOLD  |x - baseline| > threshold, per sample
+ *   EVENT_TRIG_SLOPE      |x[i] - x[i-1]| > slope, per sample
+ *   EVENT_TRIG_ENERGY     mean (x - baseline)^2 over the buffer > energy
+ *   EVENT_TRIG_ZC         baseline crossings in the buffer > zero_crossings,
+ *                         counted with +/- hysteresis so noise does not chatter
+ *
+ * A trigger opens an event that starts pre_samples before it (taken from
+ * a history ring) and stays open until post_samples after the last
+ * trigger, or max_samples in total. A buffer-level trigger (energy, zero
+ * crossings) counts as a trigger on every sample of that buffer.
+ * The samples of an open event are handed to the sink in chunks of up to
+ * EVENT_DETECT_CHUNK. Samples outside events are only looked at, so the
+ * caller can stream full resolution around events and nothing otherwise.
+ *
+ * Pure C with no Zephyr dependency, cheap enough to run in the SAADC
+ * interrupt: one EWMA, two compares and one ring write per sample, plus
+ * the copy while an event is open. Not reentrant; one engine per stream.
+ */
+#ifndef EVENT_DETECT_H
+#define EVENT_DETECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EVENT_DETECT_PRE_MAX    512   /* history ring, samples            */
+#define EVENT_DETECT_CHUNK      100   /* samples per sink call, at most   */
+
+#define EVENT_TRIG_THRESHOLD    0x01
+#define EVENT_TRIG_SLOPE        0x02
+#define EVENT_TRIG_ENERGY       0x04
+#define EVENT_TRIG_ZC           0x08
+
+/*
+ * Detector settings, in raw sample units. A zero level turns that
+ * detector off. The layout has no padding, so on a little-endian target
+ * the struct doubles as a wire format (the ADC app's config
+ * characteristic).
+ */
+struct event_detect_cfg {
+	uint32_t energy;          /* mean square deviation per buffer      */
+	uint16_t threshold;       /* deviation from the baseline           */
+	uint16_t slope;           /* sample-to-sample step                 */
+	uint16_t zero_crossings;  /* baseline crossings per buffer         */
+	uint16_t hysteresis;      /* band around the baseline for crossings */
+	uint16_t pre_samples;     /* kept before the first trigger         */
+	uint16_t post_samples;    /* kept after the last trigger           */
+	uint16_t max_samples;     /* cap on one event, 0 = none            */
+	uint8_t  baseline_shift;  /* baseline EWMA weight is 2^-shift      */
+	uint8_t  reserved;
+};
+
+/* One event as the sink sees it. Indices count samples since init. */
+struct event_detect_event {
+	uint16_t id;
+	uint8_t  triggers;        /* EVENT_TRIG_* seen so far              */
+	uint32_t start_index;     /* first sample sent, pre-trigger included */
+	uint32_t trigger_index;   /* first trigger                         */
+	uint16_t pre;             /* samples before trigger_index          */
+	uint16_t samples;         /* sent so far                           */
+	uint16_t peak;            /* largest |x - baseline|                */
+	uint16_t max_slope;       /* largest |x[i] - x[i-1]|               */
+};
+
+/*
+ * Called with consecutive chunks of an event, starting at sample @index.
+ * @last is set on the final chunk, after which @ev is complete; a closing
+ * call may carry no samples (@n == 0).
+ */
+typedef void (*event_detect_sink_t)(void *user, const struct event_detect_event *ev,
+				    uint32_t index, const int16_t *samples, uint16_t n,
+				    bool last);
+
+struct event_detect_stats {
+	uint32_t samples;         /* processed                             */
+	uint32_t emitted;         /* handed to the sink                    */
+	uint32_t events;
+	uint32_t hits[4];         /* buffers in which each detector fired  */
+	uint32_t max_energy;      /* largest buffer energy seen            */
+	uint16_t max_zero_crossings;
+};
+
+struct event_detect {
+	struct event_detect_cfg cfg;
+	event_detect_sink_t sink;
+	void *user;
+
+	int32_t  baseline_q8;     /* baseline << 8                         */
+	int16_t  prev;
+	bool     primed;
+	int8_t   zc_side;         /* -1 below, +1 above the band           */
+	uint32_t index;           /* absolute index of the next sample     */
+
+	int16_t  hist[EVENT_DETECT_PRE_MAX];
+	uint16_t hist_head;       /* next write position                   */
+	uint16_t hist_fill;
+
+	bool     open;
+	uint32_t remaining;       /* samples left before the event closes  */
+	struct event_detect_event ev;
+	int16_t  chunk[EVENT_DETECT_CHUNK];
+	uint16_t chunk_len;
+	uint32_t chunk_index;
+
+	struct event_detect_stats stats;
+};
+
+/* Reasonable defaults for 12-bit data; callers override what they need. */
+void event_detect_default_cfg(struct event_detect_cfg *cfg);
+
+void event_detect_init(struct event_detect *ed, const struct event_detect_cfg *cfg,
+		       event_detect_sink_t sink, void *user);
+
+/*
+ * Replace the settings. pre_samples is clamped to EVENT_DETECT_PRE_MAX.
+ * An open event is closed first.
+ */
+void event_detect_configure(struct event_detect *ed, const struct event_detect_cfg *cfg);
+
+/* Run the detectors over one buffer, calling the sink for event samples. */
+void event_detect_process(struct event_detect *ed, const int16_t *samples, uint16_t count);
+
+/* Close an open event now, e.g. when sampling stops. */
+void event_detect_flush(struct event_detect *ed);
+
+#endif /* EVENT_DETECT_H */
@@ -0,0 +1,132 @@
+/*
+ * Fan-out of one stream to several connected centrals.
+ *
+ * The producer publishes each packet once into a ring of FANOUT_SLOTS
+ * slots. Every connection added with fanout_add() has its own read
+ * cursor into that ring and its own notification credits, so a phone and
+ * a logging gateway drain the same packets at their own pace. A sender
+ * thread walks the connections round robin. For each subscribed one that
+ * has a credit, it passes the ring slot at its cursor straight to
+ * bt_gatt_notify_cb(). The only copy is the one the stack makes into its
+ * ACL buffer, so nothing is copied per subscriber on the application side.
+ *
+ * A subscriber that falls FANOUT_SLOTS packets behind is lapped: its
+ * cursor jumps to the oldest packet still held and the packets it missed
+ * are counted in `skipped`. The stream frames carry sequence numbers, so
+ * receivers see the gap. A connection that is not subscribed, or is held
+ * with fanout_hold(), keeps its cursor at the head and builds no backlog.
+ *
+ * Credits work like ble_tx, one per notification in flight, taken before
+ * bt_gatt_notify_cb() and returned by its completion callback. They are
+ * per connection so one slow link cannot hold every TX buffer.
+ * FANOUT_RESERVED_TX buffers are left out of the split for other senders
+ * on the same links, such as the frame_log backlog offload. Those senders
+ * then cannot starve the live stream, or keep the sender thread waiting
+ * for a buffer while publishers wait on it. If the stack still runs out
+ * of buffers, the packet stays at the cursor and is retried on the next
+ * completion.
+ *
+ * Every packet must fit in the ATT MTU of each subscriber (MTU - 3);
+ * longer ones are skipped for that connection and counted as errors.
+ */
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#ifndef FANOUT_SLOTS
+#define FANOUT_SLOTS        32
+#endif
+#ifndef FANOUT_SLOT_SIZE
+#define FANOUT_SLOT_SIZE    244     /* ATT MTU 247 less the opcode and handle */
+#endif
+
+#define FANOUT_MAX_CONN     CONFIG_BT_MAX_CONN
+
+/* ACL TX buffers kept free for senders outside the fan-out */
+#ifndef FANOUT_RESERVED_TX
+#define FANOUT_RESERVED_TX  0
+#endif
+
+/* Notifications in flight per connection; the other TX buffers split evenly */
+#ifndef FANOUT_CREDITS
+#define FANOUT_CREDITS      MAX(1, (CONFIG_BT_BUF_ACL_TX_COUNT - FANOUT_RESERVED_TX) / \
+				   FANOUT_MAX_CONN)
+#endif
+
+#ifndef FANOUT_THREAD_PRIO
+#define FANOUT_THREAD_PRIO  6
+#endif
+
+struct fanout_conn_stats {
+	bool     active;        /* a connection holds this index            */
+	bool     subscribed;
+	uint32_t sent;          /* notifications accepted by the stack     */
+	uint32_t completed;     /* completion callbacks received           */
+	uint32_t bytes;         /* payload bytes of completed packets      */
+	uint32_t skipped;       /* packets lost to being lapped            */
+	uint32_t errors;        /* bt_gatt_notify_cb() failures, oversize   */
+	uint32_t retries;       /* sends put off for lack of a TX buffer    */
+	uint32_t lag;           /* packets published but not yet sent      */
+	uint32_t max_lag;
+	uint32_t connected_ms;  /* uptime when the connection was added    */
+};
+
+/*
+ * Figures since the previous fanout_window() call, for rate_ctrl. One
+ * encoding goes to every subscriber, so the stream has to fit the
+ * slowest of them.
+ */
+struct fanout_window {
+	uint8_t  subscribers;
+	uint32_t bytes;         /* completed by the slowest subscriber     */
+	uint32_t skipped;       /* packets lapped, all subscribers         */
+	uint32_t lag;           /* deepest backlog at the end, packets     */
+};
+
+/* Set the characteristic value to notify. The sender idles until then. */
+void fanout_init(const struct bt_gatt_attr *attr);
+
+/*
+ * Start serving @conn from the current head. Takes a connection ref.
+ * Call from the connected callback.
+ *
+ * @return the connection index, or -ENOMEM if FANOUT_MAX_CONN are served.
+ */
+int fanout_add(struct bt_conn *conn);
+
+/* Stop serving @conn and drop its ref. Call from the disconnected callback. */
+void fanout_remove(struct bt_conn *conn);
+
+/*
+ * Leave @conn out until the next call, for example while its central
+ * takes the stream over l2cap_stream. NULL serves every subscriber.
+ */
+void fanout_hold(struct bt_conn *conn);
+
+/*
+ * Queue one packet for every subscriber. Copies @data into the ring. It
+ * never waits for the link, at most for the sender thread to finish
+ * handing the packets it has credits for to the stack.
+ *
+ * @return the number of subscribers it was queued for, or -EINVAL if
+ *         @len is 0 or more than FANOUT_SLOT_SIZE.
+ */
+int fanout_publish(const void *data, uint16_t len);
+
+/* Connections added / subscribed and not held. */
+uint8_t fanout_count(void);
+uint8_t fanout_subscribers(void);
+
+/* Smallest ATT payload over the subscribers; 0 without any. */
+uint16_t fanout_max_payload(void);
+
+void fanout_get_stats(uint8_t index, struct fanout_conn_stats *out);
+
+void fanout_window(struct fanout_window *out);
+
+#endif /* FANOUT_H */
@@ -0,0 +1,91 @@
+/*
+ * Store-and-forward recorder for stream frames.
+ *
+ * Frames that cannot go out live (no link, notifications off, or no TX
+ * credit) are appended to a circular log on internal flash. The log uses
+ * Zephyr's FCB on `recorder_partition` if the board overlay defines one,
+ * otherwise on `storage_partition`. When the log is full, the oldest
+ * sector is erased and overwritten.
+ *
+ * int16 frames are stored as zigzag-delta varints and expanded again on
+ * readback. Other formats are stored as they are.
+ *
+ * A worker thread owns the FCB. frame_log_append() only queues the frame,
+ * so the sampling thread never waits for a flash write or erase (a 4 kB
+ * page erase takes ~85 ms on the nRF52840).
+ *
+ * After frame_log_start_offload() the worker sends the backlog over the
+ * same characteristic as the live stream. It packs as many frames as fit
+ * in the ATT MTU into each notification and sends them with the ble_tx
+ * credit engine, at most FRAME_LOG_OFFLOAD_CREDITS at a time. The live
+ * stream goes through fanout, which has to leave that many ACL TX buffers
+ * out of its own credits (FANOUT_RESERVED_TX), so the backlog never takes
+ * a buffer the live data needs. If the phone has the l2cap_stream channel
+ * open (CONFIG_BT_L2CAP_DYNAMIC_CHANNEL), the backlog goes there instead,
+ * packed into SDUs of up to L2CAP_STREAM_SDU_MAX bytes, with one SDU
+ * buffer left for live data.
+ * Offloaded frames have STREAM_CH_REPLAY set in their channel byte.
+ * If the next frame does not fit in one packet (a link left at the
+ * default 23-byte MTU), the offload stops with a warning and counts it in
+ * `offload_too_small`; the backlog is offered again on the next start.
+ *
+ * The read position is kept in RAM only. After a reset the whole log is
+ * offered again; receivers drop duplicates by channel, seq and t0_us.
+ */
+#ifndef FRAME_LOG_H
+#define FRAME_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/* Largest buffer frame_log_append() accepts (one or more frames) */
+#define FRAME_LOG_MAX_APPEND   256
+#define FRAME_LOG_QUEUE_LEN    16
+
+/* Backlog notifications in flight at once */
+#ifndef FRAME_LOG_OFFLOAD_CREDITS
+#define FRAME_LOG_OFFLOAD_CREDITS  2
+#endif
+
+/* Rated erase cycles of the nRF52840 internal flash */
+#define FRAME_LOG_FLASH_ENDURANCE  10000
+
+struct frame_log_stats {
+	uint32_t frames_in;      /* frames accepted into the log             */
+	uint32_t bytes_in;       /* their size as stream frames              */
+	uint32_t bytes_stored;   /* record payload after compression         */
+	uint32_t flash_written;  /* bytes programmed, FCB headers/CRC/padding */
+	uint32_t erases;         /* sector erases                            */
+	uint32_t queue_drops;    /* appends lost to a full queue             */
+	uint32_t overwritten;    /* sectors erased before being offloaded    */
+	uint32_t offload_frames;
+	uint32_t offload_bytes;  /* notification / SDU payload bytes         */
+	uint32_t offload_l2cap_bytes; /* of which sent over l2cap_stream     */
+	uint32_t offload_us;     /* time spent offloading                    */
+	uint32_t offload_too_small; /* offloads stopped: frame over the MTU  */
+	uint16_t sector_count;
+	uint32_t sector_size;
+};
+
+/* Mount (and on first use format) the log partition, start the worker. */
+int frame_log_init(void);
+
+/*
+ * Queue one or more back-to-back stream frames for the log. Never blocks.
+ * @return 0, -ENOMEM if the queue is full, -EINVAL if @len is too big.
+ */
+int frame_log_append(const void *frames, uint16_t len);
+
+/* Start sending the backlog on @conn / @attr. Takes a connection ref. */
+void frame_log_start_offload(struct bt_conn *conn, const struct bt_gatt_attr *attr);
+
+/* Stop offloading (call from the disconnected callback). */
+void frame_log_stop_offload(void);
+
+bool frame_log_offload_active(void);
+
+void frame_log_get_stats(struct frame_log_stats *out);
+
+#endif /* FRAME_LOG_H */
@@ -0,0 +1,82 @@
+/*
+ * L2CAP connection-oriented channel for bulk stream data.
+ *
+ * The phone opens an LE credit-based channel on L2CAP_STREAM_PSM
+ * (BluetoothDevice.createInsecureL2capChannel on Android). While it is
+ * open, the same stream frames that would go out as GATT notifications
+ * can be sent as SDUs of up to L2CAP_STREAM_SDU_MAX bytes instead.
+ * An SDU has no ATT header and is not limited by the ATT MTU. The stack
+ * splits it into link-layer-sized PDUs and the peer's credits pace them.
+ *
+ * Flow control works like ble_tx: every SDU in flight holds one buffer
+ * from a pool of L2CAP_STREAM_BUFS. l2cap_stream_send() waits (or fails
+ * with -EAGAIN) while all of them are queued.
+ *
+ * Service      6e2b0a20-7c31-4d8e-9a51-2f0c7d3e5b00
+ *   PSM        ...5b01  READ  u16 LE, the PSM to connect to
+ *
+ * The phone reads the PSM from this service to find out whether the
+ * firmware supports the channel. The server and the service are
+ * registered by l2cap_stream_init(). Needs CONFIG_BT_L2CAP_DYNAMIC_CHANNEL.
+ */
+#ifndef L2CAP_STREAM_H
+#define L2CAP_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+
+#define L2CAP_STREAM_UUID_SVC_VAL \
+	BT_UUID_128_ENCODE(0x6e2b0a20, 0x7c31, 0x4d8e, 0x9a51, 0x2f0c7d3e5b00)
+#define L2CAP_STREAM_UUID_PSM_VAL \
+	BT_UUID_128_ENCODE(0x6e2b0a20, 0x7c31, 0x4d8e, 0x9a51, 0x2f0c7d3e5b01)
+
+/* Dynamic LE PSM range is 0x0080-0x00FF */
+#define L2CAP_STREAM_PSM       0x0081
+
+#ifndef L2CAP_STREAM_SDU_MAX
+#define L2CAP_STREAM_SDU_MAX   1024
+#endif
+#ifndef L2CAP_STREAM_BUFS
+#define L2CAP_STREAM_BUFS      4
+#endif
+
+struct l2cap_stream_stats {
+	uint32_t sent;          /* SDUs queued                              */
+	uint32_t completed;     /* SDUs the stack reported sent             */
+	uint32_t bytes;         /* SDU payload bytes queued                 */
+	uint32_t waits;         /* sends that had to wait for a buffer      */
+	uint32_t timeouts;      /* sends that gave up (-EAGAIN)             */
+	uint32_t errors;        /* bt_l2cap_chan_send() failures            */
+	uint32_t connects;
+};
+
+/* Register the L2CAP server. Call after bt_enable(). */
+int l2cap_stream_init(void);
+
+/* True while the phone has the channel open. */
+bool l2cap_stream_ready(void);
+
+/* Connection the channel is open on; NULL if closed. No ref is taken. */
+struct bt_conn *l2cap_stream_conn(void);
+
+/* Largest SDU the peer accepts, capped at L2CAP_STREAM_SDU_MAX; 0 if closed. */
+uint16_t l2cap_stream_sdu_max(void);
+
+/*
+ * Send @data as one SDU, waiting up to @timeout for a free buffer.
+ *
+ * @return 0 when queued, -ENOTCONN if the channel is closed, -EMSGSIZE
+ *         if @len exceeds l2cap_stream_sdu_max(), -EAGAIN if no buffer
+ *         became free in time, or the bt_l2cap_chan_send() error.
+ */
+int l2cap_stream_send(const void *data, uint16_t len, k_timeout_t timeout);
+
+/* SDUs queued but not yet sent. */
+uint32_t l2cap_stream_in_flight(void);
+
+void l2cap_stream_get_stats(struct l2cap_stream_stats *out);
+void l2cap_stream_reset_stats(void);
+
+#endif /* L2CAP_STREAM_H */
@@ -0,0 +1,81 @@
+/*
+ * Adaptive stream tier controller.
+ *
+ * Picks the stream tier (STREAM_TIER_* in stream_proto.h) of one sensor
+ * channel from what the link actually delivers. The sender calls
+ * rate_ctrl_update() once per window with:
+ *
+ *   - offered and completed bytes: completed comes from notification
+ *     (or SDU) completions, so it is the rate the link really carries
+ *   - failures: sends refused for lack of a credit or buffer, which is
+ *     the closest thing to a NACK the host sees, plus stack errors
+ *   - in_flight / credits: TX buffer pressure at the end of the window
+ *
+ * A window with failures, or with every credit but one in use, counts as
+ * congested. The controller then steps one tier down, at most once every
+ * RATE_CTRL_DOWN_SETTLE windows so the previous step can take effect. The
+ * completion rate of congested windows is recorded as the link capacity.
+ *
+ * After RATE_CTRL_HOLD_MIN clean windows it steps one tier up, but only if
+ * the higher tier's demand fits in 80 % of that capacity. The estimate
+ * creeps up during clean windows, and after RATE_CTRL_HOLD_MAX clean
+ * windows the controller probes up regardless, because the link may have
+ * recovered. A probe that congests within RATE_CTRL_HOLD_MIN windows
+ * doubles the hold time (up to RATE_CTRL_HOLD_MAX). Long clean stretches
+ * halve it again. Like AIMD, it backs off quickly and climbs slowly.
+ *
+ * Pure C with no Zephyr dependency, so it can be exercised on a host.
+ */
+#ifndef RATE_CTRL_H
+#define RATE_CTRL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stream_proto.h"
+
+#define RATE_CTRL_WINDOW_MS     250
+#define RATE_CTRL_DOWN_SETTLE   2     /* windows between two down steps  */
+#define RATE_CTRL_HOLD_MIN      8     /* clean windows before going up   */
+#define RATE_CTRL_HOLD_MAX      120   /* 30 s                            */
+#define RATE_CTRL_HEADROOM_PCT  80
+
+struct rate_ctrl_input {
+	uint32_t window_us;
+	uint32_t offered_bytes;
+	uint32_t completed_bytes;
+	uint32_t failures;
+	uint32_t in_flight;
+	uint32_t credits;
+};
+
+struct rate_ctrl {
+	uint8_t  tier;
+	uint8_t  min_tier;          /* best tier allowed (STREAM_TIER_FULL)  */
+	uint8_t  max_tier;          /* worst tier allowed                    */
+	uint16_t clean;             /* clean windows in a row                */
+	uint16_t since_change;      /* windows since the last switch         */
+	uint16_t hold;              /* clean windows needed to go up         */
+	bool     probing;           /* last switch was up                    */
+	uint32_t capacity_bps;      /* bytes/s seen while congested, 0 = none */
+	uint32_t switches;
+};
+
+void rate_ctrl_init(struct rate_ctrl *rc, uint8_t min_tier, uint8_t max_tier);
+
+/*
+ * Feed one window. @demand_bps[t] is this channel's byte rate at tier t,
+ * headers included. Returns the tier to use for the next window.
+ */
+uint8_t rate_ctrl_update(struct rate_ctrl *rc, const struct rate_ctrl_input *in,
+			 const uint32_t demand_bps[STREAM_TIER_COUNT]);
+
+/*
+ * Byte rate of an I16 channel of @rate_hz sent in frames of @batch
+ * samples, at each tier, for rate_ctrl_update(). @packed_pct is the
+ * expected I16_DELTA size relative to raw (about 60 for EMG).
+ */
+void rate_ctrl_demand_i16(uint32_t demand_bps[STREAM_TIER_COUNT], uint32_t rate_hz,
+			  uint8_t batch, uint8_t packed_pct);
+
+#endif /* RATE_CTRL_H */
@@ -0,0 +1,96 @@
+/*
+ * Oversampled SAADC acquisition with decimation.
+ *
+ * A TIMER compare event triggers SAADC SAMPLE through GPPI, and each
+ * SAMPLE runs 2^oversample_log2 conversions back to back (burst mode).
+ * The SAADC averages them in hardware into one 14-bit result. EasyDMA
+ * fills double buffers of SAADC_ACQ_BUFFER_SIZE, and SAADC END restarts
+ * the next buffer through GPPI, so no conversion waits for the CPU. On
+ * every full buffer, the SAADC interrupt runs the CIC + FIR decimator
+ * (decim.h) and hands out_hz samples at 16-bit full scale to the sink.
+ *
+ * The CPU touches each buffer once rather than each conversion. Hardware
+ * averaging and the decimator both trade rate for resolution:
+ * averaging N conversions of white noise gains log2(N)/2 bits.
+ *
+ *   SAMPLE rate   out_hz * 2^(cic_log2 + 1)
+ *   conversions   SAMPLE rate * 2^oversample_log2
+ *
+ * One burst must fit in one SAMPLE period: 2^oversample_log2 *
+ * (acq_us + 2 us conversion) < 1 / SAMPLE rate. saadc_acq_start()
+ * refuses configurations where it does not. The TIMER runs at 16 MHz,
+ * so out_hz is exact when 16 MHz divides evenly by the SAMPLE rate.
+ *
+ * Single channel, single instance. Uses TIMER SAADC_ACQ_TIMER, which must
+ * be enabled in the devicetree, and owns the SAADC interrupt, so it
+ * cannot share an image with the Zephyr ADC driver.
+ */
+#ifndef SAADC_ACQ_H
+#define SAADC_ACQ_H
+
+#include <stdint.h>
+
+#include <hal/nrf_saadc.h>
+
+#include "decim.h"
+
+#ifndef SAADC_ACQ_TIMER
+#define SAADC_ACQ_TIMER         2
+#endif
+#ifndef SAADC_ACQ_BUFFER_SIZE
+#define SAADC_ACQ_BUFFER_SIZE   128
+#endif
+
+#define SAADC_ACQ_IN_BITS       14
+#define SAADC_ACQ_OUT_BITS      16
+#define SAADC_ACQ_CONV_US       2     /* conversion time, after acquisition */
+
+struct saadc_acq_cfg {
+	nrf_saadc_input_t input;   /* single-ended, gain 1/6, internal ref   */
+	uint32_t out_hz;           /* delivered sample rate                 */
+	uint8_t  oversample_log2;  /* hardware averaging, 0..8              */
+	uint8_t  cic_log2;         /* 1..DECIM_LOG2_RATIO_MAX               */
+	uint8_t  acq_us;           /* 3, 5, 10, 15, 20 or 40                */
+};
+
+/*
+ * Called from the SAADC interrupt with the samples decimated from one
+ * buffer; @t_us is the device time the buffer completed.
+ */
+typedef void (*saadc_acq_sink_t)(void *user, const int32_t *samples, uint16_t n,
+				 uint32_t t_us);
+
+struct saadc_acq_stats {
+	uint32_t buffers;
+	uint32_t samples;       /* delivered to the sink                    */
+	uint32_t errors;        /* buffer_set failures in the interrupt     */
+};
+
+static inline uint32_t saadc_acq_sample_hz(const struct saadc_acq_cfg *cfg)
+{
+	return cfg->out_hz << (cfg->cic_log2 + 1);
+}
+
+static inline uint32_t saadc_acq_conversions_hz(const struct saadc_acq_cfg *cfg)
+{
+	return saadc_acq_sample_hz(cfg) << cfg->oversample_log2;
+}
+
+/* Set up the SAADC, TIMER and GPPI connections once, at boot. */
+int saadc_acq_init(void);
+
+/*
+ * Configure for @cfg and start sampling. @sink runs in interrupt context.
+ *
+ * @return 0, -EINVAL if @cfg is out of range or a burst does not fit
+ *         one SAMPLE period, -EBUSY if already running, or -EIO if nrfx
+ *         refused the configuration.
+ */
+int saadc_acq_start(const struct saadc_acq_cfg *cfg, saadc_acq_sink_t sink, void *user);
+
+/* Stop sampling. A partly filled buffer is dropped. */
+void saadc_acq_stop(void);
+
+void saadc_acq_get_stats(struct saadc_acq_stats *out);
+
+#endif /* SAADC_ACQ_H */
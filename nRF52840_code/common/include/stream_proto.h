@@ -0,0 +1,177 @@
+/*
+ * Binary sensor stream framing shared by every firmware image.
+ *
+ * A notification carries one or more frames back to back. Each frame is
+ * a 14-byte header followed by `count` samples of one channel. All
+ * fields are little-endian:
+ *
+ *   [0]      ver        STREAM_VERSION_BYTE (0xB0 | version). Never a
+ *                       printable character, so receivers can tell frames
+ *                       from the old "EMG,..." text packets.
+ *   [1]      channel    STREAM_CH_*, | STREAM_CH_REPLAY for recorded data
+ *   [2]      format     STREAM_FMT_*
+ *   [3]      count      samples in this frame (payload bytes for
+ *                       STREAM_FMT_BYTES and STREAM_FMT_I16_DELTA)
+ *   [4..5]   seq        per-channel frame counter, wraps at 65536
+ *   [6..9]   t0_us      device uptime of the first sample, wraps at 2^32
+ *   [10..13] period_ns  sample spacing, 0 for a single/irregular sample
+ *   [14..]   samples
+ *
+ * Sample i was taken at t0_us + i * period_ns / 1000. A gap in seq means
+ * frames were lost, either at the source or over the air.
+ *
+ * A channel can be sent at one of several tiers (STREAM_TIER_*) when the
+ * link cannot carry it in full (see rate_ctrl.h). Every frame describes
+ * itself: a decimated frame is plain I16 with a longer period_ns, a
+ * packed frame has format STREAM_FMT_I16_DELTA, and a features frame
+ * has format STREAM_FMT_I16_STATS. The sender also announces every tier
+ * switch on STREAM_CH_CONTROL (STREAM_CTRL_TIER), so receivers can mark
+ * where the fidelity changed.
+ *
+ * The encoder only packs bytes and has no Zephyr dependency, so the
+ * Kotlin and Python decoders can be tested against it on a host.
+ */
+#ifndef STREAM_PROTO_H
+#define STREAM_PROTO_H
+
+#include <stdint.h>
+
+#define STREAM_VERSION          1
+#define STREAM_VERSION_BYTE     (0xB0 | STREAM_VERSION)
+#define STREAM_HDR_LEN          14
+
+/* Channel IDs. 0x00 is reserved for in-band control messages. */
+#define STREAM_CH_CONTROL       0x00
+#define STREAM_CH_EMG           0x01   /* mV, int16                    */
+#define STREAM_CH_PPG           0x02
+#define STREAM_CH_SWEAT         0x03
+#define STREAM_CH_TEST          0x04
+#define STREAM_CH_ADC           0x05   /* mV, int16 (ADC demo boards)  */
+#define STREAM_CH_EIS           0x06
+/*
+ * mV, int16: full-rate snippets around detected events (event_detect.h).
+ * seq is contiguous but t0_us jumps between events, which are delimited
+ * by STREAM_CTRL_EVENT messages.
+ */
+#define STREAM_CH_ADC_EVENT     0x07
+
+/* Set in the channel byte of frames replayed from the flash recorder */
+#define STREAM_CH_REPLAY        0x80
+
+/* Sample formats */
+#define STREAM_FMT_BYTES        0x00   /* opaque record                */
+#define STREAM_FMT_I16          0x01
+#define STREAM_FMT_U16          0x02
+#define STREAM_FMT_I32          0x03
+#define STREAM_FMT_F32          0x04
+/*
+ * [0] sample count, then per sample the zigzag-encoded difference to the
+ * previous one (the first to 0) as an LEB128 varint. Lossless for int16.
+ */
+#define STREAM_FMT_I16_DELTA    0x05
+/*
+ * One window of int16 samples summarised as min, max, mean, rms (count 4).
+ * t0_us is the start of the window and period_ns its length.
+ */
+#define STREAM_FMT_I16_STATS    0x06
+
+/* Stream tiers, highest fidelity and bandwidth first */
+#define STREAM_TIER_FULL        0   /* every sample, I16                 */
+#define STREAM_TIER_PACKED      1   /* every sample, I16_DELTA           */
+#define STREAM_TIER_DECIMATED   2   /* mean of STREAM_DECIMATION samples */
+#define STREAM_TIER_FEATURES    3   /* one I16_STATS frame per batch     */
+#define STREAM_TIER_COUNT       4
+
+#define STREAM_DECIMATION       4
+
+/*
+ * Control messages: STREAM_CH_CONTROL frames of STREAM_FMT_BYTES whose
+ * first payload byte is the opcode.
+ *
+ *   STREAM_CTRL_TIER  [0] op  [1] channel  [2] tier  [3] decimation
+ *                     t0_us = time of the first frame sent at the new tier
+ *
+ *   STREAM_CTRL_EVENT [0] op  [1] channel  [2] triggers  [3] phase
+ *                     [4..5] event id  [6..7] samples
+ *                     phase 0 opens an event: t0_us is its first sample
+ *                     and samples the pre-trigger part. Phase 1 closes
+ *                     it: samples is the total sent for the event.
+ */
+#define STREAM_CTRL_TIER        0x01
+#define STREAM_CTRL_TIER_LEN    4
+#define STREAM_CTRL_EVENT       0x02
+#define STREAM_CTRL_EVENT_LEN   8
+#define STREAM_EVENT_BEGIN      0
+#define STREAM_EVENT_END        1
+
+/* Encoder state of one channel */
+struct stream_channel {
+	uint8_t  id;
+	uint8_t  format;
+	uint16_t seq;           /* seq of the next frame */
+	uint32_t period_ns;
+};
+
+#define STREAM_CHANNEL_INIT(_id, _format, _period_ns) \
+	{ .id = (_id), .format = (_format), .seq = 0, .period_ns = (_period_ns) }
+
+/* Output buffer, normally one notification */
+struct stream_buf {
+	uint8_t  *data;
+	uint16_t  cap;
+	uint16_t  len;
+};
+
+/* Bytes per sample, 0 for an unknown format. */
+uint8_t stream_sample_size(uint8_t format);
+
+void stream_buf_init(struct stream_buf *b, void *data, uint16_t cap);
+
+static inline void stream_buf_reset(struct stream_buf *b)
+{
+	b->len = 0;
+}
+
+/* Samples of @format that still fit into @b in one more frame. */
+uint16_t stream_buf_room(const struct stream_buf *b, uint8_t format);
+
+/*
+ * Append one frame of @count samples to @b and advance the channel's
+ * sequence number. Samples are copied as stored in memory, so they must
+ * already be little-endian (true on every Cortex-M target here).
+ *
+ * @return 0, -EINVAL for an unknown format or count 0, or -ENOSPC if
+ *         the frame does not fit (nothing is written and seq is kept).
+ */
+int stream_put(struct stream_buf *b, struct stream_channel *ch,
+	       uint32_t t0_us, const void *samples, uint8_t count);
+
+/*
+ * Append @count int16 samples of an I16 channel at @tier. Decimation
+ * drops a trailing partial group. Advances seq like stream_put().
+ *
+ * @return 0, -EINVAL for a bad tier, format or count, or -ENOSPC.
+ */
+int stream_put_tier(struct stream_buf *b, struct stream_channel *ch, uint8_t tier,
+		    uint32_t t0_us, const int16_t *samples, uint8_t count);
+
+/* Append a STREAM_CTRL_TIER announcement on the @ctrl channel. */
+int stream_put_tier_change(struct stream_buf *b, struct stream_channel *ctrl,
+			   uint32_t t0_us, uint8_t channel, uint8_t tier);
+
+/* Append a STREAM_CTRL_EVENT message on the @ctrl channel. */
+int stream_put_event(struct stream_buf *b, struct stream_channel *ctrl, uint32_t t0_us,
+		     uint8_t channel, uint16_t id, uint8_t triggers, uint8_t phase,
+		     uint16_t samples);
+
+/*
+ * Zigzag-delta varint coding of little-endian int16 samples, as used by
+ * STREAM_FMT_I16_DELTA (without its count byte).
+ *
+ * stream_pack_i16() returns the packed length, or 0 if it exceeds @cap.
+ * stream_unpack_i16() returns 0 or -EBADMSG.
+ */
+uint16_t stream_pack_i16(const void *samples, uint8_t count, uint8_t *out, uint16_t cap);
+int stream_unpack_i16(const uint8_t *in, uint16_t len, uint8_t count, void *samples);
+
+#endif /* STREAM_PROTO_H */
@@ -0,0 +1,47 @@
+/*
+ * Time-sync GATT service.
+ *
+ * Lets the phone map device timestamps (stream frame t0_us) onto its own
+ * clock. The phone writes a request and notes its send time t1. The
+ * device stamps the arrival (t2) and the reply (t3) with time_sync_now_us()
+ * and notifies them back; the phone notes the arrival t4. From many such
+ * round trips the phone fits offset and drift, weighting the exchanges
+ * with the shortest (t4 - t1) - (t3 - t2) (see ClockSync.kt).
+ *
+ * Service      6e2b0a10-7c31-4d8e-9a51-2f0c7d3e5b00
+ *   Sync       ...5b01  WRITE_WITHOUT_RESP | NOTIFY
+ *
+ * All fields little-endian:
+ *   request   [0] TIME_SYNC_OP_REQ  [1] seq  [2..3] reserved
+ *   response  [0] TIME_SYNC_OP_RSP  [1] seq  [2..3] reserved
+ *             [4..7] t2_us  [8..11] t3_us
+ *
+ * The service is registered statically; linking time_sync.c is enough.
+ * It replies on the connection the request came from.
+ */
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+
+#define TIME_SYNC_UUID_SVC_VAL \
+	BT_UUID_128_ENCODE(0x6e2b0a10, 0x7c31, 0x4d8e, 0x9a51, 0x2f0c7d3e5b00)
+#define TIME_SYNC_UUID_CHAR_VAL \
+	BT_UUID_128_ENCODE(0x6e2b0a10, 0x7c31, 0x4d8e, 0x9a51, 0x2f0c7d3e5b01)
+
+#define TIME_SYNC_OP_REQ    0x01
+#define TIME_SYNC_OP_RSP    0x81
+
+#define TIME_SYNC_REQ_LEN   4
+#define TIME_SYNC_RSP_LEN   12
+
+/*
+ * Device clock used for every timestamp sent to the phone: uptime in µs,
+ * wrapping at 2^32 (about 71.6 minutes).
+ */
+uint32_t time_sync_now_us(void);
+
+/* Requests answered since boot. */
+uint32_t time_sync_count(void);
+
+#endif /* TIME_SYNC_H */
@@ -0,0 +1,155 @@
+/*
+ * Credit-based notification transmit engine. See ble_tx.h.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "ble_tx.h"
+
+K_SEM_DEFINE(tx_credits, BLE_TX_CREDITS, BLE_TX_CREDITS);
+
+/*
+ * Bumped by ble_tx_reset(). Each notification carries the generation it
+ * was sent in, so late completions from a dropped link do not hand out
+ * credits twice. in_flight only changes under irq_lock() and only while
+ * the generation is still the caller's, so a reset in between cannot
+ * leave the new link's count off by one.
+ */
+static atomic_t generation;
+static atomic_t in_flight;
+
+/*
+ * Producer-side fields are only written by the sending thread and
+ * completion-side fields (completed, bytes) only by the BT thread.
+ */
+static struct ble_tx_stats stats;
+
+/* user_data = generation << 16 | length */
+#define TAG(gen, len)   ((void *)(uintptr_t)((((uint32_t)(gen) & 0xFFFF) << 16) | (len)))
+#define TAG_GEN(tag)    ((uint32_t)(uintptr_t)(tag) >> 16)
+#define TAG_LEN(tag)    ((uint32_t)(uintptr_t)(tag) & 0xFFFF)
+
+static void notify_complete(struct bt_conn *conn, void *user_data)
+{
+	unsigned int key = irq_lock();
+
+	if (TAG_GEN(user_data) != ((uint32_t)atomic_get(&generation) & 0xFFFF)) {
+		irq_unlock(key);
+		return;
+	}
+	atomic_dec(&in_flight);
+	irq_unlock(key);
+
+	stats.completed++;
+	stats.bytes += TAG_LEN(user_data);
+	k_sem_give(&tx_credits);
+}
+
+int ble_tx_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+		  const void *data, uint16_t len, k_timeout_t timeout)
+{
+	if (!conn) {
+		return -ENOTCONN;
+	}
+
+	/* The link this send belongs to: read before the credit is taken */
+	atomic_val_t gen = atomic_get(&generation);
+	unsigned int key;
+
+	if (k_sem_take(&tx_credits, K_NO_WAIT) != 0) {
+		stats.waits++;
+		if (k_sem_take(&tx_credits, timeout) != 0) {
+			stats.timeouts++;
+			return -EAGAIN;
+		}
+	}
+
+	struct bt_gatt_notify_params params = {
+		.attr      = attr,
+		.data      = data,
+		.len       = len,
+		.func      = notify_complete,
+		.user_data = TAG(gen, len),
+	};
+
+	/*
+	 * Count before sending: the completion may run before we return.
+	 * If the link was reset while we waited, the credit may be one the
+	 * reset handed out; give it back and let the caller retry.
+	 */
+	key = irq_lock();
+	if (atomic_get(&generation) != gen) {
+		irq_unlock(key);
+		k_sem_give(&tx_credits);
+		return -EAGAIN;
+	}
+	atomic_val_t n = atomic_inc(&in_flight) + 1;
+	irq_unlock(key);
+
+	int err = bt_gatt_notify_cb(conn, &params);
+	if (err) {
+		/* After a reset the credits are already back to full */
+		key = irq_lock();
+		if (atomic_get(&generation) == gen) {
+			atomic_dec(&in_flight);
+			k_sem_give(&tx_credits);
+		}
+		irq_unlock(key);
+		stats.errors++;
+		return err;
+	}
+
+	stats.sent++;
+	stats.max_in_flight = MAX(stats.max_in_flight, (uint32_t)n);
+	return 0;
+}
+
+uint32_t ble_tx_in_flight(void)
+{
+	return (uint32_t)atomic_get(&in_flight);
+}
+
+int ble_tx_flush(k_timeout_t timeout)
+{
+	k_timepoint_t end = sys_timepoint_calc(timeout);
+	int taken = 0;
+
+	/* Holding every credit means nothing is in flight */
+	while (taken < BLE_TX_CREDITS) {
+		if (k_sem_take(&tx_credits, sys_timepoint_timeout(end)) != 0) {
+			break;
+		}
+		taken++;
+	}
+	for (int i = 0; i < taken; i++) {
+		k_sem_give(&tx_credits);
+	}
+	return taken == BLE_TX_CREDITS ? 0 : -EAGAIN;
+}
+
+void ble_tx_reset(void)
+{
+	unsigned int key = irq_lock();
+
+	atomic_inc(&generation);
+	atomic_set(&in_flight, 0);
+	irq_unlock(key);
+
+	/* Waiters wake with -EAGAIN; then refill to the full count */
+	k_sem_reset(&tx_credits);
+	for (int i = 0; i < BLE_TX_CREDITS; i++) {
+		k_sem_give(&tx_credits);
+	}
+}
+
+void ble_tx_get_stats(struct ble_tx_stats *out)
+{
+	*out = stats;
+}
+
+void ble_tx_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
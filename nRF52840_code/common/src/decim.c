@@ -0,0 +1,97 @@
+/*
+ * CIC + FIR decimation. See decim.h.
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "decim.h"
+
+/* Extra fraction bits carried from the CIC into the FIR */
+#define FIR_GUARD_BITS  4
+
+/*
+ * First half of the symmetric FIR, Q15, summing to 1.0 over all taps.
+ * Least-squares fit to 1/sinc^3 up to 0.2 of the FIR input rate and
+ * zero from 0.3 (scipy.signal.firls, stopband weight 20).
+ */
+static const int16_t fir_q15[(DECIM_FIR_TAPS + 1) / 2] = {
+	-29, 38, 133, -70, -325, 107, 658, -136,
+	-1213, 127, 2173, 9, -4147, -812, 10938, 17866,
+};
+
+int decim_init(struct decim *d, uint8_t log2_ratio, uint8_t in_bits, uint8_t out_bits)
+{
+	if (log2_ratio == 0 || log2_ratio > DECIM_LOG2_RATIO_MAX ||
+	    in_bits + 1 + DECIM_CIC_ORDER * log2_ratio > 32 || out_bits > 24) {
+		return -EINVAL;
+	}
+
+	memset(d, 0, sizeof(*d));
+	d->log2_ratio = log2_ratio;
+	d->shift = (int8_t)(DECIM_CIC_ORDER * log2_ratio + in_bits - out_bits - FIR_GUARD_BITS);
+	return 0;
+}
+
+/* CIC output to out_bits + FIR_GUARD_BITS, rounded */
+static inline int32_t cic_scale(const struct decim *d, int32_t v)
+{
+	if (d->shift > 0) {
+		return (v + (1 << (d->shift - 1))) >> d->shift;
+	}
+	return v * (1 << -d->shift);
+}
+
+static int32_t fir_output(const struct decim *d)
+{
+	const int32_t *s = &d->fir[d->fir_pos];
+	int64_t acc = 0;
+
+	for (uint8_t k = 0; k < DECIM_FIR_TAPS / 2; k++) {
+		acc += (int64_t)fir_q15[k] * (s[k] + s[DECIM_FIR_TAPS - 1 - k]);
+	}
+	acc += (int64_t)fir_q15[DECIM_FIR_TAPS / 2] * s[DECIM_FIR_TAPS / 2];
+
+	return (int32_t)((acc + (1 << (14 + FIR_GUARD_BITS))) >> (15 + FIR_GUARD_BITS));
+}
+
+uint16_t decim_process(struct decim *d, const int16_t *in, uint16_t n,
+		       int32_t *out, uint16_t cap)
+{
+	uint16_t cic_ratio = 1u << d->log2_ratio;
+	uint16_t produced = 0;
+
+	for (uint16_t i = 0; i < n; i++) {
+		uint32_t v = (uint32_t)(int32_t)in[i];
+
+		for (uint8_t k = 0; k < DECIM_CIC_ORDER; k++) {
+			d->integ[k] += v;
+			v = d->integ[k];
+		}
+		if (++d->phase < cic_ratio) {
+			continue;
+		}
+		d->phase = 0;
+
+		for (uint8_t k = 0; k < DECIM_CIC_ORDER; k++) {
+			uint32_t prev = d->comb[k];
+
+			d->comb[k] = v;
+			v -= prev;
+		}
+
+		int32_t y = cic_scale(d, (int32_t)v);
+
+		d->fir[d->fir_pos] = y;
+		d->fir[d->fir_pos + DECIM_FIR_TAPS] = y;
+		d->fir_pos = (d->fir_pos + 1) % DECIM_FIR_TAPS;
+
+		d->fir_odd ^= 1;
+		if (d->fir_odd) {
+			continue;
+		}
+		if (produced < cap) {
+			out[produced++] = fir_output(d);
+		}
+	}
+	return produced;
+}
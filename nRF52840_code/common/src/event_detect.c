@@ -0,0 +1,215 @@
+/*
+ * Event detection on a high-rate sample stream. See event_detect.h.
+ */
+#include <string.h>
+
+#include "event_detect.h"
+
+#define BASELINE_SHIFT_MAX  15
+
+/* Zephyr's sys/util.h has these; this file also builds on a host */
+#ifndef MIN
+#define MIN(a, b)  ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+#endif
+
+static inline uint16_t abs_u16(int32_t v)
+{
+	v = v < 0 ? -v : v;
+	return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+void event_detect_default_cfg(struct event_detect_cfg *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->energy = 200u * 200u;
+	cfg->threshold = 400;
+	cfg->slope = 100;
+	cfg->zero_crossings = 48;
+	cfg->hysteresis = 40;
+	cfg->pre_samples = 256;
+	cfg->post_samples = 512;
+	cfg->max_samples = 8192;
+	cfg->baseline_shift = 10;
+}
+
+static void apply_cfg(struct event_detect *ed, const struct event_detect_cfg *cfg)
+{
+	ed->cfg = *cfg;
+	if (ed->cfg.pre_samples > EVENT_DETECT_PRE_MAX) {
+		ed->cfg.pre_samples = EVENT_DETECT_PRE_MAX;
+	}
+	if (ed->cfg.baseline_shift == 0 || ed->cfg.baseline_shift > BASELINE_SHIFT_MAX) {
+		ed->cfg.baseline_shift = BASELINE_SHIFT_MAX;
+	}
+}
+
+void event_detect_init(struct event_detect *ed, const struct event_detect_cfg *cfg,
+		       event_detect_sink_t sink, void *user)
+{
+	memset(ed, 0, sizeof(*ed));
+	apply_cfg(ed, cfg);
+	ed->sink = sink;
+	ed->user = user;
+}
+
+static void flush_chunk(struct event_detect *ed, bool last)
+{
+	ed->sink(ed->user, &ed->ev, ed->chunk_index, ed->chunk, ed->chunk_len, last);
+	ed->chunk_index += ed->chunk_len;
+	ed->chunk_len = 0;
+}
+
+static void push_sample(struct event_detect *ed, int16_t x)
+{
+	ed->chunk[ed->chunk_len++] = x;
+	ed->ev.samples++;
+	ed->stats.emitted++;
+	if (ed->chunk_len == EVENT_DETECT_CHUNK) {
+		flush_chunk(ed, false);
+	}
+}
+
+static void close_event(struct event_detect *ed)
+{
+	flush_chunk(ed, true);
+	ed->open = false;
+	/* Samples already sent are not sent again as the next pre-trigger */
+	ed->hist_fill = 0;
+}
+
+static void open_event(struct event_detect *ed)
+{
+	uint16_t pre = MIN(ed->hist_fill, ed->cfg.pre_samples);
+
+	memset(&ed->ev, 0, sizeof(ed->ev));
+	ed->ev.id = (uint16_t)ed->stats.events++;
+	ed->ev.start_index = ed->index - pre;
+	ed->ev.trigger_index = ed->index;
+	ed->ev.pre = pre;
+	ed->open = true;
+	ed->chunk_len = 0;
+	ed->chunk_index = ed->ev.start_index;
+
+	uint16_t pos = (ed->hist_head + EVENT_DETECT_PRE_MAX - pre) % EVENT_DETECT_PRE_MAX;
+
+	for (uint16_t k = 0; k < pre; k++) {
+		push_sample(ed, ed->hist[pos]);
+		pos = (pos + 1) % EVENT_DETECT_PRE_MAX;
+	}
+}
+
+void event_detect_flush(struct event_detect *ed)
+{
+	if (ed->open) {
+		close_event(ed);
+	}
+}
+
+void event_detect_configure(struct event_detect *ed, const struct event_detect_cfg *cfg)
+{
+	event_detect_flush(ed);
+	apply_cfg(ed, cfg);
+}
+
+void event_detect_process(struct event_detect *ed, const int16_t *samples, uint16_t count)
+{
+	const struct event_detect_cfg *c = &ed->cfg;
+
+	if (count == 0) {
+		return;
+	}
+	if (!ed->primed) {
+		ed->baseline_q8 = (int32_t)samples[0] * 256;
+		ed->prev = samples[0];
+		ed->primed = true;
+	}
+
+	/* Buffer-level detectors, against the baseline at the buffer start */
+	int32_t base = ed->baseline_q8 / 256;
+	int32_t hyst = c->hysteresis;
+	uint64_t sq = 0;
+	uint16_t crossings = 0;
+
+	for (uint16_t i = 0; i < count; i++) {
+		int32_t d = samples[i] - base;
+
+		sq += (uint64_t)((int64_t)d * d);
+		if (d > hyst) {
+			crossings += ed->zc_side < 0;
+			ed->zc_side = 1;
+		} else if (d < -hyst) {
+			crossings += ed->zc_side > 0;
+			ed->zc_side = -1;
+		}
+	}
+
+	uint32_t energy = (uint32_t)MIN(sq / count, UINT32_MAX);
+	uint8_t buf_trig = 0;
+
+	if (c->energy && energy > c->energy) {
+		buf_trig |= EVENT_TRIG_ENERGY;
+	}
+	if (c->zero_crossings && crossings > c->zero_crossings) {
+		buf_trig |= EVENT_TRIG_ZC;
+	}
+	ed->stats.max_energy = MAX(ed->stats.max_energy, energy);
+	ed->stats.max_zero_crossings = MAX(ed->stats.max_zero_crossings, crossings);
+
+	/* Per-sample detectors and capture. Buffer triggers cover every sample. */
+	uint8_t seen = buf_trig;
+
+	for (uint16_t i = 0; i < count; i++) {
+		int16_t x = samples[i];
+		uint16_t dev = abs_u16(x - ed->baseline_q8 / 256);
+		uint16_t step = abs_u16((int32_t)x - ed->prev);
+		uint8_t trig = buf_trig;
+
+		if (c->threshold && dev > c->threshold) {
+			trig |= EVENT_TRIG_THRESHOLD;
+		}
+		if (c->slope && step > c->slope) {
+			trig |= EVENT_TRIG_SLOPE;
+		}
+		seen |= trig;
+
+		if (!ed->open && trig) {
+			open_event(ed);
+		}
+		if (ed->open) {
+			ed->ev.triggers |= trig;
+			ed->ev.peak = MAX(ed->ev.peak, dev);
+			ed->ev.max_slope = MAX(ed->ev.max_slope, step);
+			push_sample(ed, x);
+
+			if (trig) {
+				ed->remaining = c->post_samples;
+			} else if (ed->remaining) {
+				ed->remaining--;
+			}
+			if (ed->remaining == 0 || ed->ev.samples == UINT16_MAX ||
+			    (c->max_samples && ed->ev.samples >= c->max_samples)) {
+				close_event(ed);
+			}
+		} else {
+			ed->hist[ed->hist_head] = x;
+			ed->hist_head = (ed->hist_head + 1) % EVENT_DETECT_PRE_MAX;
+			if (ed->hist_fill < EVENT_DETECT_PRE_MAX) {
+				ed->hist_fill++;
+			}
+		}
+
+		ed->prev = x;
+		ed->baseline_q8 += ((int32_t)x * 256 - ed->baseline_q8) >> c->baseline_shift;
+		ed->index++;
+	}
+
+	ed->stats.samples += count;
+	for (uint8_t k = 0; k < 4; k++) {
+		if (seen & (1u << k)) {
+			ed->stats.hits[k]++;
+		}
+	}
+}
@@ -0,0 +1,336 @@
+/*
+ * Fan-out of one stream to several connected centrals. See fanout.h.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "fanout.h"
+
+#define SENDER_STACK_SIZE  1024
+
+BUILD_ASSERT(FANOUT_MAX_CONN <= 16, "connection index must fit the tag");
+BUILD_ASSERT(FANOUT_SLOT_SIZE <= 0xFFFF, "length must fit the tag");
+
+struct slot {
+	uint16_t len;
+	uint8_t  data[FANOUT_SLOT_SIZE];
+};
+
+struct sub {
+	struct bt_conn *conn;
+	uint32_t cursor;        /* next packet to send, counts like head    */
+	atomic_t credits;
+	atomic_t generation;    /* bumped when the index is (re)assigned    */
+	atomic_t win_bytes;     /* completed since the last fanout_window() */
+	uint32_t win_skipped;
+	struct fanout_conn_stats st;
+};
+
+/*
+ * ring_lock covers the ring, head and the cursors. The sender holds it
+ * across bt_gatt_notify_cb(), which copies the slot into an ACL buffer,
+ * so a publish cannot overwrite a slot while it is being sent.
+ */
+static K_MUTEX_DEFINE(ring_lock);
+static K_SEM_DEFINE(wake, 0, 1);
+
+static struct slot ring[FANOUT_SLOTS];
+static uint32_t head;           /* packets published since boot             */
+static struct sub subs[FANOUT_MAX_CONN];
+static const struct bt_gatt_attr *notify_attr;
+static struct bt_conn *held;    /* compared only, no ref taken               */
+
+/* user_data = index << 28 | generation << 16 | length */
+#define TAG(idx, gen, len) \
+	((void *)(uintptr_t)(((uint32_t)(idx) << 28) | (((uint32_t)(gen) & 0xFFF) << 16) | (len)))
+#define TAG_IDX(tag)    ((uint32_t)(uintptr_t)(tag) >> 28)
+#define TAG_GEN(tag)    (((uint32_t)(uintptr_t)(tag) >> 16) & 0xFFF)
+#define TAG_LEN(tag)    ((uint32_t)(uintptr_t)(tag) & 0xFFFF)
+
+static void notify_complete(struct bt_conn *conn, void *user_data)
+{
+	struct sub *s = &subs[TAG_IDX(user_data)];
+
+	/* A late completion from a dropped link must not hand out a credit */
+	if (TAG_GEN(user_data) != ((uint32_t)atomic_get(&s->generation) & 0xFFF)) {
+		return;
+	}
+
+	atomic_inc(&s->credits);
+	atomic_add(&s->win_bytes, TAG_LEN(user_data));
+	s->st.completed++;
+	s->st.bytes += TAG_LEN(user_data);
+	k_sem_give(&wake);
+}
+
+static bool subscribed(const struct sub *s)
+{
+	return s->conn && notify_attr &&
+	       bt_gatt_is_subscribed(s->conn, notify_attr, BT_GATT_CCC_NOTIFY);
+}
+
+static bool served(const struct sub *s)
+{
+	return s->conn != held && subscribed(s);
+}
+
+static uint32_t lag(const struct sub *s)
+{
+	return MIN(head - s->cursor, (uint32_t)FANOUT_SLOTS);
+}
+
+/*
+ * Send the packet at one subscriber's cursor. Called with ring_lock held.
+ * @return true if the cursor moved.
+ */
+static bool send_one(uint8_t idx)
+{
+	struct sub *s = &subs[idx];
+
+	if (!s->conn) {
+		return false;
+	}
+	if (!served(s)) {
+		s->cursor = head;
+		return false;
+	}
+
+	/* Lapped: resume at the oldest packet still in the ring */
+	if (head - s->cursor > FANOUT_SLOTS) {
+		uint32_t lost = head - FANOUT_SLOTS - s->cursor;
+
+		s->st.skipped += lost;
+		s->win_skipped += lost;
+		s->cursor = head - FANOUT_SLOTS;
+	}
+	s->st.max_lag = MAX(s->st.max_lag, lag(s));
+
+	if (s->cursor == head || atomic_get(&s->credits) <= 0) {
+		return false;
+	}
+
+	const struct slot *p = &ring[s->cursor % FANOUT_SLOTS];
+
+	if (p->len > bt_gatt_get_mtu(s->conn) - 3) {
+		s->st.errors++;
+		s->cursor++;
+		return true;
+	}
+
+	struct bt_gatt_notify_params params = {
+		.attr      = notify_attr,
+		.data      = p->data,
+		.len       = p->len,
+		.func      = notify_complete,
+		.user_data = TAG(idx, atomic_get(&s->generation), p->len),
+	};
+
+	/* Take the credit first: the completion may run before we return */
+	atomic_dec(&s->credits);
+
+	int err = bt_gatt_notify_cb(s->conn, &params);
+	if (err == -ENOMEM) {
+		/* Out of ACL buffers; retry on the next completion */
+		atomic_inc(&s->credits);
+		s->st.retries++;
+		return false;
+	}
+	if (err) {
+		atomic_inc(&s->credits);
+		s->st.errors++;
+	} else {
+		s->st.sent++;
+	}
+	s->cursor++;
+	return true;
+}
+
+static void fanout_sender(void *a, void *b, void *c)
+{
+	ARG_UNUSED(a);
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	for (;;) {
+		bool progress;
+
+		k_sem_take(&wake, K_FOREVER);
+		k_mutex_lock(&ring_lock, K_FOREVER);
+
+		/* One packet per connection per pass, so the links share the air */
+		do {
+			progress = false;
+			for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+				progress |= send_one(i);
+			}
+		} while (progress);
+
+		k_mutex_unlock(&ring_lock);
+	}
+}
+
+K_THREAD_DEFINE(fanout_tid, SENDER_STACK_SIZE, fanout_sender,
+		NULL, NULL, NULL, FANOUT_THREAD_PRIO, 0, 0);
+
+/* ---- Public API ---- */
+
+void fanout_init(const struct bt_gatt_attr *attr)
+{
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	notify_attr = attr;
+	k_mutex_unlock(&ring_lock);
+}
+
+int fanout_add(struct bt_conn *conn)
+{
+	int idx = -ENOMEM;
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		struct sub *s = &subs[i];
+
+		if (s->conn) {
+			continue;
+		}
+		atomic_inc(&s->generation);
+		atomic_set(&s->credits, FANOUT_CREDITS);
+		atomic_set(&s->win_bytes, 0);
+		s->conn = bt_conn_ref(conn);
+		s->cursor = head;
+		s->win_skipped = 0;
+		memset(&s->st, 0, sizeof(s->st));
+		s->st.active = true;
+		s->st.connected_ms = k_uptime_get_32();
+		idx = i;
+		break;
+	}
+	k_mutex_unlock(&ring_lock);
+	return idx;
+}
+
+void fanout_remove(struct bt_conn *conn)
+{
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		struct sub *s = &subs[i];
+
+		if (s->conn == conn) {
+			if (held == conn) {
+				held = NULL;
+			}
+			atomic_inc(&s->generation);
+			bt_conn_unref(s->conn);
+			s->conn = NULL;
+			s->st.active = false;
+		}
+	}
+	k_mutex_unlock(&ring_lock);
+}
+
+void fanout_hold(struct bt_conn *conn)
+{
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	held = conn;
+	k_mutex_unlock(&ring_lock);
+}
+
+int fanout_publish(const void *data, uint16_t len)
+{
+	int n = 0;
+
+	if (len == 0 || len > FANOUT_SLOT_SIZE) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	ring[head % FANOUT_SLOTS].len = len;
+	memcpy(ring[head % FANOUT_SLOTS].data, data, len);
+	head++;
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		n += served(&subs[i]);
+	}
+	k_mutex_unlock(&ring_lock);
+
+	k_sem_give(&wake);
+	return n;
+}
+
+uint8_t fanout_count(void)
+{
+	uint8_t n = 0;
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		n += subs[i].conn != NULL;
+	}
+	k_mutex_unlock(&ring_lock);
+	return n;
+}
+
+uint8_t fanout_subscribers(void)
+{
+	uint8_t n = 0;
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		n += served(&subs[i]);
+	}
+	k_mutex_unlock(&ring_lock);
+	return n;
+}
+
+uint16_t fanout_max_payload(void)
+{
+	uint16_t payload = 0;
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		if (served(&subs[i])) {
+			uint16_t p = bt_gatt_get_mtu(subs[i].conn) - 3;
+
+			payload = payload ? MIN(payload, p) : p;
+		}
+	}
+	k_mutex_unlock(&ring_lock);
+	return MIN(payload, (uint16_t)FANOUT_SLOT_SIZE);
+}
+
+void fanout_get_stats(uint8_t index, struct fanout_conn_stats *out)
+{
+	memset(out, 0, sizeof(*out));
+	if (index >= FANOUT_MAX_CONN) {
+		return;
+	}
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	*out = subs[index].st;
+	if (subs[index].conn) {
+		out->subscribed = subscribed(&subs[index]);
+		out->lag = lag(&subs[index]);
+	}
+	k_mutex_unlock(&ring_lock);
+}
+
+void fanout_window(struct fanout_window *out)
+{
+	memset(out, 0, sizeof(*out));
+
+	k_mutex_lock(&ring_lock, K_FOREVER);
+	for (uint8_t i = 0; i < FANOUT_MAX_CONN; i++) {
+		struct sub *s = &subs[i];
+		uint32_t bytes = (uint32_t)atomic_clear(&s->win_bytes);
+		uint32_t skipped = s->win_skipped;
+
+		s->win_skipped = 0;
+		if (!served(s)) {
+			continue;
+		}
+		out->bytes = out->subscribers ? MIN(out->bytes, bytes) : bytes;
+		out->subscribers++;
+		out->skipped += skipped;
+		out->lag = MAX(out->lag, lag(s));
+	}
+	k_mutex_unlock(&ring_lock);
+}
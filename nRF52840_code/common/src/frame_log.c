@@ -0,0 +1,481 @@
+/*
+ * Store-and-forward recorder for stream frames. See frame_log.h.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "ble_tx.h"
+#include "frame_log.h"
+#include "stream_proto.h"
+#if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
+#include "l2cap_stream.h"
+#define OFFLOAD_BUF_LEN      MAX(OFFLOAD_MAX_PAYLOAD, L2CAP_STREAM_SDU_MAX)
+#else
+#define OFFLOAD_BUF_LEN      OFFLOAD_MAX_PAYLOAD
+#endif
+
+#if FIXED_PARTITION_EXISTS(recorder_partition)
+#define LOG_PARTITION_ID     FIXED_PARTITION_ID(recorder_partition)
+#else
+#define LOG_PARTITION_ID     FIXED_PARTITION_ID(storage_partition)
+#endif
+
+#define LOG_MAX_SECTORS      128
+#define LOG_FCB_MAGIC        0x46524c47   /* "FRLG" */
+#define LOG_FCB_VERSION      1
+
+/* Format bit marking a zigzag-delta varint payload in a stored record */
+#define REC_FMT_PACKED       0x80
+
+/* FCB per-sector header (struct fcb_disk_area) */
+#define FCB_SECTOR_HDR_LEN   8
+
+/* Worst case: 3 varint bytes per int16 sample, then stored raw instead */
+#define REC_MAX_LEN          FRAME_LOG_MAX_APPEND
+
+#define OFFLOAD_MAX_PAYLOAD  244
+#define OFFLOAD_WAIT         K_MSEC(20)
+
+#define WORKER_STACK_SIZE    2048
+#define WORKER_PRIORITY      10
+
+LOG_MODULE_REGISTER(frame_log, LOG_LEVEL_WRN);
+
+enum item_op {
+	OP_APPEND,
+	OP_OFFLOAD_START,
+	OP_OFFLOAD_STOP,
+};
+
+struct log_item {
+	uint8_t op;
+	uint16_t len;
+	struct bt_conn *conn;
+	const struct bt_gatt_attr *attr;
+	uint8_t data[FRAME_LOG_MAX_APPEND];
+};
+
+K_MSGQ_DEFINE(log_q, sizeof(struct log_item), FRAME_LOG_QUEUE_LEN, 4);
+
+static struct flash_sector sectors[LOG_MAX_SECTORS];
+static struct fcb fcb = {
+	.f_magic   = LOG_FCB_MAGIC,
+	.f_version = LOG_FCB_VERSION,
+	.f_sectors = sectors,
+};
+static bool ready;
+
+/* Offload state, only touched by the worker */
+static struct bt_conn *offload_conn;
+static const struct bt_gatt_attr *offload_attr;
+static struct fcb_entry sent_loc;        /* last entry delivered; fe_sector NULL = none */
+static struct flash_sector *last_sector;
+static int64_t offload_start;
+static atomic_t offload_active;
+
+static struct frame_log_stats stats;
+
+/* ---- Record codec ---- */
+
+static uint16_t frame_len(const uint8_t *f)
+{
+	return STREAM_HDR_LEN + f[3] * stream_sample_size(f[2]);
+}
+
+/* Build the stored record for one frame. Returns the record length. */
+static uint16_t encode_record(const uint8_t *frame, uint8_t *rec)
+{
+	uint16_t len = frame_len(frame);
+
+	memcpy(rec, frame, STREAM_HDR_LEN);
+	if (frame[2] == STREAM_FMT_I16) {
+		uint16_t packed = stream_pack_i16(&frame[STREAM_HDR_LEN], frame[3],
+						  &rec[STREAM_HDR_LEN], len - STREAM_HDR_LEN - 1);
+		if (packed) {
+			rec[2] |= REC_FMT_PACKED;
+			return STREAM_HDR_LEN + packed;
+		}
+	}
+	memcpy(&rec[STREAM_HDR_LEN], &frame[STREAM_HDR_LEN], len - STREAM_HDR_LEN);
+	return len;
+}
+
+/* Expand a record into a replay frame at @out. Returns its length or < 0. */
+static int decode_record(const uint8_t *rec, uint16_t len, uint8_t *out, uint16_t cap)
+{
+	uint8_t fmt = rec[2] & ~REC_FMT_PACKED;
+	uint16_t flen = STREAM_HDR_LEN + rec[3] * stream_sample_size(fmt);
+
+	if (len < STREAM_HDR_LEN || flen > cap) {
+		return -EBADMSG;
+	}
+
+	memcpy(out, rec, STREAM_HDR_LEN);
+	out[1] |= STREAM_CH_REPLAY;
+	out[2] = fmt;
+
+	if (rec[2] & REC_FMT_PACKED) {
+		int err = stream_unpack_i16(&rec[STREAM_HDR_LEN], len - STREAM_HDR_LEN,
+					    rec[3], &out[STREAM_HDR_LEN]);
+		if (err) {
+			return err;
+		}
+	} else {
+		if (len != flen) {
+			return -EBADMSG;
+		}
+		memcpy(&out[STREAM_HDR_LEN], &rec[STREAM_HDR_LEN], flen - STREAM_HDR_LEN);
+	}
+	return flen;
+}
+
+/* ---- Flash ---- */
+
+/* Bytes FCB programs for one entry: length field, data and CRC, each aligned */
+static uint32_t entry_flash_bytes(uint16_t len)
+{
+	uint8_t align = MAX(fcb.f_align, 1);
+
+	return ROUND_UP(len < 0x80 ? 1 : 2, align) + ROUND_UP(len, align) +
+	       ROUND_UP(1, align);
+}
+
+static void rotate(void)
+{
+	/*
+	 * Erasing the oldest sector loses whatever in it was not offloaded
+	 * yet: everything if nothing was sent, the rest if the read position
+	 * is inside it.
+	 */
+	if (sent_loc.fe_sector == NULL || sent_loc.fe_sector == fcb.f_oldest) {
+		stats.overwritten++;
+		memset(&sent_loc, 0, sizeof(sent_loc));
+	}
+
+	if (fcb_rotate(&fcb) == 0) {
+		stats.erases++;
+	}
+}
+
+static void store_frame(const uint8_t *frame)
+{
+	uint8_t rec[REC_MAX_LEN];
+	struct fcb_entry loc;
+	uint16_t len = encode_record(frame, rec);
+	int err;
+
+	err = fcb_append(&fcb, len, &loc);
+	if (err == -ENOSPC) {
+		rotate();
+		err = fcb_append(&fcb, len, &loc);
+	}
+	if (err) {
+		return;
+	}
+
+	err = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), rec, len);
+	if (err == 0) {
+		err = fcb_append_finish(&fcb, &loc);
+	}
+	if (err) {
+		return;
+	}
+
+	if (loc.fe_sector != last_sector) {
+		stats.flash_written += ROUND_UP(FCB_SECTOR_HDR_LEN, MAX(fcb.f_align, 1));
+		last_sector = loc.fe_sector;
+	}
+	stats.frames_in++;
+	stats.bytes_in += frame_len(frame);
+	stats.bytes_stored += len;
+	stats.flash_written += entry_flash_bytes(len);
+}
+
+static void store(const uint8_t *data, uint16_t len)
+{
+	uint16_t off = 0;
+
+	while (off + STREAM_HDR_LEN <= len) {
+		uint16_t flen = frame_len(&data[off]);
+
+		if (data[off] != STREAM_VERSION_BYTE || flen > len - off ||
+		    stream_sample_size(data[off + 2]) == 0) {
+			break;
+		}
+		store_frame(&data[off]);
+		off += flen;
+	}
+}
+
+/* ---- Offload ---- */
+
+#if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
+static bool l2cap_busy(void)
+{
+	return l2cap_stream_in_flight() + 1 >= L2CAP_STREAM_BUFS;
+}
+#else
+static bool l2cap_busy(void)
+{
+	return false;
+}
+#endif
+
+static void offload_end(void)
+{
+	if (offload_conn) {
+		bt_conn_unref(offload_conn);
+		offload_conn = NULL;
+	}
+	if (atomic_cas(&offload_active, 1, 0)) {
+		stats.offload_us += (uint32_t)((k_uptime_get() - offload_start) * 1000);
+	}
+}
+
+/*
+ * Send one packet of backlog: an L2CAP SDU while the phone has the
+ * stream channel open, otherwise a notification. Returns false when
+ * there is nothing left or the link is gone.
+ */
+static bool offload_step(void)
+{
+	static uint8_t pkt[OFFLOAD_BUF_LEN];
+	uint8_t rec[REC_MAX_LEN];
+	uint16_t cap = MIN(OFFLOAD_MAX_PAYLOAD, bt_gatt_get_mtu(offload_conn) - 3);
+	struct fcb_entry loc = sent_loc;
+	struct fcb_entry last = sent_loc;
+	uint16_t used = 0;
+	uint16_t need = 0;
+	uint32_t frames = 0;
+	bool l2cap = false;
+	int err;
+
+#if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
+	l2cap = l2cap_stream_ready();
+	if (l2cap) {
+		cap = l2cap_stream_sdu_max();
+	}
+#endif
+
+	/* Stay within the offload's TX share (one SDU buffer short over L2CAP) */
+	if (l2cap ? l2cap_busy() : ble_tx_in_flight() >= FRAME_LOG_OFFLOAD_CREDITS) {
+		k_sleep(K_MSEC(1));
+		return true;
+	}
+
+	while (fcb_getnext(&fcb, &loc) == 0) {
+		uint16_t rlen = MIN(loc.fe_data_len, sizeof(rec));
+		int flen;
+
+		if (flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), rec, rlen)) {
+			break;
+		}
+		flen = decode_record(rec, rlen, &pkt[used], cap - used);
+		if (flen == -EBADMSG && used == 0 && rlen >= STREAM_HDR_LEN) {
+			need = STREAM_HDR_LEN + rec[3] * stream_sample_size(rec[2] & ~REC_FMT_PACKED);
+			if (need <= cap) {
+				/* Corrupt record: skip it */
+				need = 0;
+				last = loc;
+				continue;
+			}
+		}
+		if (flen < 0) {
+			break;
+		}
+		used += flen;
+		frames++;
+		last = loc;
+	}
+
+	if (used == 0) {
+		/* Not even one frame fits: the backlog stays for a larger MTU */
+		if (need) {
+			stats.offload_too_small++;
+			LOG_WRN("%u B frame does not fit in a %u B packet, offload stopped",
+				need, cap);
+		}
+		sent_loc = last;
+		return false;
+	}
+
+#if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
+	if (l2cap) {
+		err = l2cap_stream_send(pkt, used, OFFLOAD_WAIT);
+		/* Channel closed under us: the next step falls back to GATT */
+		if (err == -ENOTCONN || err == -EMSGSIZE) {
+			return true;
+		}
+	} else
+#endif
+	{
+		err = ble_tx_notify(offload_conn, offload_attr, pkt, used, OFFLOAD_WAIT);
+	}
+	if (err == -EAGAIN) {
+		return true;
+	}
+	if (err) {
+		return false;
+	}
+
+	sent_loc = last;
+	stats.offload_frames += frames;
+	stats.offload_bytes += used;
+	if (l2cap) {
+		stats.offload_l2cap_bytes += used;
+	}
+	return true;
+}
+
+static void handle(struct log_item *item)
+{
+	switch (item->op) {
+	case OP_APPEND:
+		store(item->data, item->len);
+		break;
+	case OP_OFFLOAD_START:
+		offload_end();
+		offload_conn = item->conn;
+		offload_attr = item->attr;
+		offload_start = k_uptime_get();
+		atomic_set(&offload_active, 1);
+		break;
+	case OP_OFFLOAD_STOP:
+		offload_end();
+		break;
+	}
+}
+
+static void frame_log_worker(void *a, void *b, void *c)
+{
+	static struct log_item item;
+
+	ARG_UNUSED(a);
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	for (;;) {
+		/* Appends first, then one offload packet */
+		k_timeout_t wait = offload_conn ? K_NO_WAIT : K_FOREVER;
+
+		while (k_msgq_get(&log_q, &item, wait) == 0) {
+			handle(&item);
+			wait = K_NO_WAIT;
+		}
+
+		if (offload_conn && ready && !offload_step()) {
+			offload_end();
+		}
+	}
+}
+
+K_THREAD_DEFINE(frame_log_tid, WORKER_STACK_SIZE, frame_log_worker,
+		NULL, NULL, NULL, WORKER_PRIORITY, 0, 0);
+
+/* ---- Public API ---- */
+
+int frame_log_init(void)
+{
+	const struct flash_area *fa;
+	uint32_t cnt = ARRAY_SIZE(sectors);
+	int err;
+
+	err = flash_area_get_sectors(LOG_PARTITION_ID, &cnt, sectors);
+	if (err) {
+		return err;
+	}
+	fcb.f_sector_cnt = (uint8_t)MIN(cnt, UINT8_MAX);
+	fcb.f_scratch_cnt = 0;
+
+	err = fcb_init(LOG_PARTITION_ID, &fcb);
+	if (err) {
+		/* Not an FCB yet (or another magic): wipe and retry */
+		err = flash_area_open(LOG_PARTITION_ID, &fa);
+		if (err) {
+			return err;
+		}
+		err = flash_area_erase(fa, 0, fa->fa_size);
+		flash_area_close(fa);
+		if (err) {
+			return err;
+		}
+		stats.erases += fcb.f_sector_cnt;
+		err = fcb_init(LOG_PARTITION_ID, &fcb);
+		if (err) {
+			return err;
+		}
+	}
+
+	stats.sector_count = fcb.f_sector_cnt;
+	stats.sector_size = sectors[0].fs_size;
+	ready = true;
+	return 0;
+}
+
+int frame_log_append(const void *frames, uint16_t len)
+{
+	static struct log_item item;
+	static K_MUTEX_DEFINE(append_lock);
+	int err;
+
+	if (len > sizeof(item.data)) {
+		return -EINVAL;
+	}
+	if (!ready) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&append_lock, K_FOREVER);
+	item.op = OP_APPEND;
+	item.len = len;
+	memcpy(item.data, frames, len);
+	err = k_msgq_put(&log_q, &item, K_NO_WAIT);
+	k_mutex_unlock(&append_lock);
+
+	if (err) {
+		stats.queue_drops++;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void put_control(uint8_t op, struct bt_conn *conn,
+			const struct bt_gatt_attr *attr)
+{
+	struct log_item ctl = {
+		.op = op,
+		.conn = conn,
+		.attr = attr,
+	};
+
+	if (k_msgq_put(&log_q, &ctl, K_MSEC(200)) != 0 && conn) {
+		bt_conn_unref(conn);
+	}
+}
+
+void frame_log_start_offload(struct bt_conn *conn, const struct bt_gatt_attr *attr)
+{
+	put_control(OP_OFFLOAD_START, bt_conn_ref(conn), attr);
+}
+
+void frame_log_stop_offload(void)
+{
+	put_control(OP_OFFLOAD_STOP, NULL, NULL);
+}
+
+bool frame_log_offload_active(void)
+{
+	return atomic_get(&offload_active) != 0;
+}
+
+void frame_log_get_stats(struct frame_log_stats *out)
+{
+	*out = stats;
+	if (atomic_get(&offload_active)) {
+		out->offload_us += (uint32_t)((k_uptime_get() - offload_start) * 1000);
+	}
+}
@@ -0,0 +1,185 @@
+/*
+ * L2CAP connection-oriented channel for bulk stream data. See l2cap_stream.h.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <string.h>
+
+#include "l2cap_stream.h"
+
+/* Nothing is expected from the phone; the minimum LE MTU is enough */
+#define RX_MTU   BT_L2CAP_LE_MIN_MTU
+
+NET_BUF_POOL_FIXED_DEFINE(sdu_pool, L2CAP_STREAM_BUFS,
+			  BT_L2CAP_SDU_BUF_SIZE(L2CAP_STREAM_SDU_MAX),
+			  CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+static struct bt_l2cap_le_chan stream_chan;
+static atomic_t chan_open;
+static atomic_t in_flight;
+
+static struct l2cap_stream_stats stats;
+
+/* ---- Channel ---- */
+
+static void chan_connected(struct bt_l2cap_chan *chan)
+{
+	atomic_set(&in_flight, 0);
+	atomic_set(&chan_open, 1);
+	stats.connects++;
+}
+
+static void chan_disconnected(struct bt_l2cap_chan *chan)
+{
+	atomic_set(&chan_open, 0);
+	atomic_set(&in_flight, 0);
+}
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	/* Returning 0 lets the stack free the buffer */
+	return 0;
+}
+
+static void chan_sent(struct bt_l2cap_chan *chan)
+{
+	if (atomic_get(&in_flight) > 0) {
+		atomic_dec(&in_flight);
+	}
+	stats.completed++;
+}
+
+static const struct bt_l2cap_chan_ops chan_ops = {
+	.connected    = chan_connected,
+	.disconnected = chan_disconnected,
+	.recv         = chan_recv,
+	.sent         = chan_sent,
+};
+
+static int accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		  struct bt_l2cap_chan **chan)
+{
+	/* One phone, one channel */
+	if (atomic_get(&chan_open)) {
+		return -ENOMEM;
+	}
+
+	memset(&stream_chan, 0, sizeof(stream_chan));
+	stream_chan.chan.ops = &chan_ops;
+	stream_chan.rx.mtu = RX_MTU;
+	*chan = &stream_chan.chan;
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm       = L2CAP_STREAM_PSM,
+	.sec_level = BT_SECURITY_L1,
+	.accept    = accept,
+};
+
+/* ---- PSM discovery service ---- */
+
+static struct bt_uuid_128 l2cap_stream_svc_uuid = BT_UUID_INIT_128(L2CAP_STREAM_UUID_SVC_VAL);
+static struct bt_uuid_128 l2cap_stream_psm_uuid = BT_UUID_INIT_128(L2CAP_STREAM_UUID_PSM_VAL);
+
+static ssize_t read_psm(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			void *buf, uint16_t len, uint16_t offset)
+{
+	uint8_t psm[2];
+
+	sys_put_le16(L2CAP_STREAM_PSM, psm);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, psm, sizeof(psm));
+}
+
+BT_GATT_SERVICE_DEFINE(l2cap_stream_svc,
+	BT_GATT_PRIMARY_SERVICE(&l2cap_stream_svc_uuid),
+	BT_GATT_CHARACTERISTIC(&l2cap_stream_psm_uuid.uuid, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, read_psm, NULL, NULL),
+);
+
+/* ---- Public API ---- */
+
+int l2cap_stream_init(void)
+{
+	return bt_l2cap_server_register(&server);
+}
+
+bool l2cap_stream_ready(void)
+{
+	return atomic_get(&chan_open) != 0;
+}
+
+struct bt_conn *l2cap_stream_conn(void)
+{
+	return l2cap_stream_ready() ? stream_chan.chan.conn : NULL;
+}
+
+uint16_t l2cap_stream_sdu_max(void)
+{
+	if (!l2cap_stream_ready()) {
+		return 0;
+	}
+	return MIN(stream_chan.tx.mtu, L2CAP_STREAM_SDU_MAX);
+}
+
+int l2cap_stream_send(const void *data, uint16_t len, k_timeout_t timeout)
+{
+	struct net_buf *buf;
+	int err;
+
+	if (!l2cap_stream_ready()) {
+		return -ENOTCONN;
+	}
+	if (len > l2cap_stream_sdu_max()) {
+		return -EMSGSIZE;
+	}
+
+	buf = net_buf_alloc(&sdu_pool, K_NO_WAIT);
+	if (!buf) {
+		stats.waits++;
+		buf = net_buf_alloc(&sdu_pool, timeout);
+		if (!buf) {
+			stats.timeouts++;
+			return -EAGAIN;
+		}
+	}
+
+	net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+	net_buf_add_mem(buf, data, len);
+
+	/* Count before sending: the sent callback may run before we return */
+	atomic_inc(&in_flight);
+
+	err = bt_l2cap_chan_send(&stream_chan.chan, buf);
+	if (err < 0) {
+		atomic_dec(&in_flight);
+		net_buf_unref(buf);
+		stats.errors++;
+		return err;
+	}
+
+	stats.sent++;
+	stats.bytes += len;
+	return 0;
+}
+
+uint32_t l2cap_stream_in_flight(void)
+{
+	return (uint32_t)atomic_get(&in_flight);
+}
+
+void l2cap_stream_get_stats(struct l2cap_stream_stats *out)
+{
+	*out = stats;
+}
+
+void l2cap_stream_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,106 @@
+/*
+ * Adaptive stream tier controller. See rate_ctrl.h.
+ */
+#include <string.h>
+
+#include "rate_ctrl.h"
+
+/* A probe that congests this soon after going up has failed */
+#define PROBE_FAIL_WINDOWS   RATE_CTRL_HOLD_MIN
+
+void rate_ctrl_init(struct rate_ctrl *rc, uint8_t min_tier, uint8_t max_tier)
+{
+	memset(rc, 0, sizeof(*rc));
+	rc->min_tier = min_tier;
+	rc->max_tier = max_tier < STREAM_TIER_COUNT ? max_tier : STREAM_TIER_COUNT - 1;
+	rc->tier = min_tier;
+	rc->hold = RATE_CTRL_HOLD_MIN;
+}
+
+static void set_tier(struct rate_ctrl *rc, uint8_t tier)
+{
+	rc->probing = tier < rc->tier;
+	rc->tier = tier;
+	rc->since_change = 0;
+	rc->clean = 0;
+	rc->switches++;
+}
+
+uint8_t rate_ctrl_update(struct rate_ctrl *rc, const struct rate_ctrl_input *in,
+			 const uint32_t demand_bps[STREAM_TIER_COUNT])
+{
+	uint32_t done_bps = in->window_us ?
+		(uint32_t)((uint64_t)in->completed_bytes * 1000000u / in->window_us) : 0;
+	bool congested = in->failures > 0 ||
+			 (in->credits > 1 && in->in_flight + 1 >= in->credits);
+
+	if (rc->since_change < UINT16_MAX) {
+		rc->since_change++;
+	}
+
+	if (congested) {
+		rc->clean = 0;
+		/* Saturated: what got through is what the link carries */
+		if (rc->capacity_bps == 0 || done_bps < rc->capacity_bps) {
+			rc->capacity_bps = done_bps;
+		} else {
+			rc->capacity_bps = (rc->capacity_bps * 3 + done_bps) / 4;
+		}
+
+		if (rc->probing && rc->since_change <= PROBE_FAIL_WINDOWS) {
+			rc->hold = rc->hold * 2 > RATE_CTRL_HOLD_MAX ?
+				   RATE_CTRL_HOLD_MAX : rc->hold * 2;
+			rc->probing = false;
+		}
+		if (rc->tier < rc->max_tier && rc->since_change >= RATE_CTRL_DOWN_SETTLE) {
+			set_tier(rc, rc->tier + 1);
+		}
+		return rc->tier;
+	}
+
+	if (rc->clean < UINT16_MAX) {
+		rc->clean++;
+	}
+	/*
+	 * Not saturated, so capacity is at least what was carried. The
+	 * estimate also creeps up ~3 % per clean window: interference comes
+	 * and goes, and an estimate taken during a bad spell would otherwise
+	 * pin the channel low until the forced probe.
+	 */
+	if (rc->capacity_bps) {
+		rc->capacity_bps += rc->capacity_bps / 32;
+		if (done_bps > rc->capacity_bps) {
+			rc->capacity_bps = done_bps;
+		}
+	}
+	/* A long clean stretch earns back the probe budget */
+	if (rc->clean >= 4 * rc->hold && rc->hold > RATE_CTRL_HOLD_MIN) {
+		rc->hold /= 2;
+		rc->clean = 0;
+	}
+
+	if (rc->tier > rc->min_tier && rc->clean >= rc->hold) {
+		uint8_t up = rc->tier - 1;
+		bool fits = rc->capacity_bps == 0 ||
+			    (uint64_t)demand_bps[up] * 100 <=
+			    (uint64_t)rc->capacity_bps * RATE_CTRL_HEADROOM_PCT;
+
+		if (fits || rc->clean >= RATE_CTRL_HOLD_MAX) {
+			set_tier(rc, up);
+		}
+	}
+	return rc->tier;
+}
+
+void rate_ctrl_demand_i16(uint32_t demand_bps[STREAM_TIER_COUNT], uint32_t rate_hz,
+			  uint8_t batch, uint8_t packed_pct)
+{
+	uint32_t frames_per_s = batch ? rate_hz / batch : 0;
+	uint32_t hdr_bps = frames_per_s * STREAM_HDR_LEN;
+	uint32_t raw_bps = rate_hz * 2;
+
+	demand_bps[STREAM_TIER_FULL] = hdr_bps + raw_bps;
+	demand_bps[STREAM_TIER_PACKED] = hdr_bps + frames_per_s + raw_bps * packed_pct / 100;
+	demand_bps[STREAM_TIER_DECIMATED] = hdr_bps + raw_bps / STREAM_DECIMATION;
+	demand_bps[STREAM_TIER_FEATURES] = hdr_bps + frames_per_s * 8;
+}
@@ -0,0 +1,189 @@
+/*
+ * Oversampled SAADC acquisition with decimation. See saadc_acq.h.
+ */
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/irq.h>
+#include <zephyr/devicetree.h>
+
+#include <nrfx_saadc.h>
+#include <nrfx_timer.h>
+#include <helpers/nrfx_gppi.h>
+
+#include "saadc_acq.h"
+
+#define TIMER_FREQ_HZ  16000000
+
+static nrfx_timer_t timer_instance = NRFX_TIMER_INSTANCE(SAADC_ACQ_TIMER);
+
+static nrfx_gppi_handle_t sample_handle;
+static nrfx_gppi_handle_t start_handle;
+
+static int16_t sample_buffer[2][SAADC_ACQ_BUFFER_SIZE];
+static uint32_t current_buffer;
+
+/* The smallest total ratio is 4 */
+static int32_t out_buffer[SAADC_ACQ_BUFFER_SIZE / 4 + 1];
+
+static struct decim decim;
+static saadc_acq_sink_t acq_sink;
+static void *acq_user;
+static bool running;
+static struct saadc_acq_stats stats;
+
+static void saadc_event_handler(nrfx_saadc_evt_t const *p_event)
+{
+	switch (p_event->type) {
+	case NRFX_SAADC_EVT_BUF_REQ:
+		if (nrfx_saadc_buffer_set(sample_buffer[current_buffer],
+					  SAADC_ACQ_BUFFER_SIZE) != NRFX_SUCCESS) {
+			stats.errors++;
+		}
+		current_buffer ^= 1U;
+		break;
+
+	case NRFX_SAADC_EVT_DONE: {
+		uint32_t t_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+		uint16_t n = decim_process(&decim, p_event->data.done.p_buffer,
+					   p_event->data.done.size,
+					   out_buffer, ARRAY_SIZE(out_buffer));
+
+		stats.buffers++;
+		stats.samples += n;
+		if (n > 0 && acq_sink) {
+			acq_sink(acq_user, out_buffer, n, t_us);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+static int acq_time(uint8_t us, nrf_saadc_acqtime_t *out)
+{
+	switch (us) {
+	case 3:  *out = NRF_SAADC_ACQTIME_3US;  return 0;
+	case 5:  *out = NRF_SAADC_ACQTIME_5US;  return 0;
+	case 10: *out = NRF_SAADC_ACQTIME_10US; return 0;
+	case 15: *out = NRF_SAADC_ACQTIME_15US; return 0;
+	case 20: *out = NRF_SAADC_ACQTIME_20US; return 0;
+	case 40: *out = NRF_SAADC_ACQTIME_40US; return 0;
+	default: return -EINVAL;
+	}
+}
+
+int saadc_acq_init(void)
+{
+	nrfx_timer_config_t timer_config = NRFX_TIMER_DEFAULT_CONFIG(TIMER_FREQ_HZ);
+
+	timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+	if (nrfx_timer_init(&timer_instance, &timer_config, NULL) != NRFX_SUCCESS) {
+		return -EIO;
+	}
+
+	IRQ_CONNECT(DT_IRQN(DT_NODELABEL(adc)),
+		    DT_IRQ(DT_NODELABEL(adc), priority),
+		    nrfx_isr, nrfx_saadc_irq_handler, 0);
+
+	if (nrfx_saadc_init(DT_IRQ(DT_NODELABEL(adc), priority)) != NRFX_SUCCESS) {
+		return -EIO;
+	}
+
+	uint32_t compare_evt =
+		nrfx_timer_compare_event_address_get(&timer_instance, NRF_TIMER_CC_CHANNEL0);
+	uint32_t sample_task = nrf_saadc_task_address_get(NRF_SAADC, NRF_SAADC_TASK_SAMPLE);
+	uint32_t end_evt = nrf_saadc_event_address_get(NRF_SAADC, NRF_SAADC_EVENT_END);
+	uint32_t start_task = nrf_saadc_task_address_get(NRF_SAADC, NRF_SAADC_TASK_START);
+
+	if (nrfx_gppi_conn_alloc(compare_evt, sample_task, &sample_handle) != NRFX_SUCCESS ||
+	    nrfx_gppi_conn_alloc(end_evt, start_task, &start_handle) != NRFX_SUCCESS) {
+		return -EIO;
+	}
+	return 0;
+}
+
+int saadc_acq_start(const struct saadc_acq_cfg *cfg, saadc_acq_sink_t sink, void *user)
+{
+	nrf_saadc_acqtime_t acq;
+
+	if (running) {
+		return -EBUSY;
+	}
+	if (cfg->out_hz == 0 || cfg->oversample_log2 > NRF_SAADC_OVERSAMPLE_256X ||
+	    acq_time(cfg->acq_us, &acq) != 0 ||
+	    decim_init(&decim, cfg->cic_log2, SAADC_ACQ_IN_BITS, SAADC_ACQ_OUT_BITS) != 0) {
+		return -EINVAL;
+	}
+
+	uint32_t sample_hz = saadc_acq_sample_hz(cfg);
+	uint64_t burst_ns = (uint64_t)(cfg->acq_us + SAADC_ACQ_CONV_US) * 1000u
+			    << cfg->oversample_log2;
+
+	if (sample_hz > TIMER_FREQ_HZ || burst_ns >= 1000000000ull / sample_hz) {
+		return -EINVAL;
+	}
+
+	nrfx_saadc_channel_t channel = NRFX_SAADC_DEFAULT_CHANNEL_SE(cfg->input, 0);
+	nrfx_saadc_adv_config_t adv_config = NRFX_SAADC_DEFAULT_ADV_CONFIG;
+
+	channel.channel_config.gain = NRF_SAADC_GAIN1_6;
+	channel.channel_config.reference = NRF_SAADC_REFERENCE_INTERNAL;
+	channel.channel_config.acq_time = acq;
+	/* All conversions of one SAMPLE task back to back, averaged by the SAADC */
+	channel.channel_config.burst = cfg->oversample_log2 ? NRF_SAADC_BURST_ENABLED
+							    : NRF_SAADC_BURST_DISABLED;
+	adv_config.oversampling = (nrf_saadc_oversample_t)cfg->oversample_log2;
+	adv_config.burst = channel.channel_config.burst;
+
+	if (nrfx_saadc_channels_config(&channel, 1) != NRFX_SUCCESS ||
+	    nrfx_saadc_advanced_mode_set(BIT(0), NRF_SAADC_RESOLUTION_14BIT, &adv_config,
+					 saadc_event_handler) != NRFX_SUCCESS ||
+	    nrfx_saadc_buffer_set(sample_buffer[0], SAADC_ACQ_BUFFER_SIZE) != NRFX_SUCCESS ||
+	    nrfx_saadc_buffer_set(sample_buffer[1], SAADC_ACQ_BUFFER_SIZE) != NRFX_SUCCESS) {
+		return -EIO;
+	}
+	current_buffer = 0;
+
+	acq_sink = sink;
+	acq_user = user;
+	stats = (struct saadc_acq_stats){ 0 };
+
+	if (nrfx_saadc_mode_trigger() != NRFX_SUCCESS) {
+		return -EIO;
+	}
+
+	nrfx_timer_extended_compare(&timer_instance, NRF_TIMER_CC_CHANNEL0,
+				    TIMER_FREQ_HZ / sample_hz,
+				    NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, false);
+	nrfx_timer_clear(&timer_instance);
+	nrfx_gppi_conn_enable(sample_handle);
+	nrfx_gppi_conn_enable(start_handle);
+	nrfx_timer_enable(&timer_instance);
+
+	running = true;
+	return 0;
+}
+
+void saadc_acq_stop(void)
+{
+	if (!running) {
+		return;
+	}
+
+	nrfx_timer_disable(&timer_instance);
+	nrfx_gppi_conn_disable(sample_handle);
+	nrfx_gppi_conn_disable(start_handle);
+	nrfx_saadc_abort();
+	running = false;
+}
+
+void saadc_acq_get_stats(struct saadc_acq_stats *out)
+{
+	unsigned int key = irq_lock();
+
+	*out = stats;
+	irq_unlock(key);
+}
@@ -0,0 +1,303 @@
+/*
+ * Binary sensor stream framing. See stream_proto.h.
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "stream_proto.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "stream_put() copies samples verbatim and needs a little-endian CPU"
+#endif
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+uint8_t stream_sample_size(uint8_t format)
+{
+	switch (format) {
+	case STREAM_FMT_BYTES:
+	case STREAM_FMT_I16_DELTA:
+		return 1;
+	case STREAM_FMT_I16:
+	case STREAM_FMT_U16:
+	case STREAM_FMT_I16_STATS:
+		return 2;
+	case STREAM_FMT_I32:
+	case STREAM_FMT_F32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+void stream_buf_init(struct stream_buf *b, void *data, uint16_t cap)
+{
+	b->data = data;
+	b->cap = cap;
+	b->len = 0;
+}
+
+uint16_t stream_buf_room(const struct stream_buf *b, uint8_t format)
+{
+	uint8_t size = stream_sample_size(format);
+	uint16_t room = b->cap - b->len;
+
+	if (size == 0 || room <= STREAM_HDR_LEN) {
+		return 0;
+	}
+	room = (room - STREAM_HDR_LEN) / size;
+	return room > UINT8_MAX ? UINT8_MAX : room;
+}
+
+/* Reserve a frame of @payload bytes and write its header. NULL if full. */
+static uint8_t *put_header(struct stream_buf *b, struct stream_channel *ch,
+			   uint8_t format, uint8_t count, uint32_t t0_us,
+			   uint32_t period_ns, uint16_t payload)
+{
+	if ((uint32_t)b->len + STREAM_HDR_LEN + payload > b->cap) {
+		return NULL;
+	}
+
+	uint8_t *p = b->data + b->len;
+	p[0] = STREAM_VERSION_BYTE;
+	p[1] = ch->id;
+	p[2] = format;
+	p[3] = count;
+	put_le16(&p[4], ch->seq);
+	put_le32(&p[6], t0_us);
+	put_le32(&p[10], period_ns);
+
+	b->len += STREAM_HDR_LEN + payload;
+	ch->seq++;
+	return &p[STREAM_HDR_LEN];
+}
+
+int stream_put(struct stream_buf *b, struct stream_channel *ch,
+	       uint32_t t0_us, const void *samples, uint8_t count)
+{
+	uint8_t size = stream_sample_size(ch->format);
+
+	if (size == 0 || count == 0) {
+		return -EINVAL;
+	}
+
+	uint16_t payload = (uint16_t)count * size;
+	uint8_t *p = put_header(b, ch, ch->format, count, t0_us, ch->period_ns, payload);
+	if (!p) {
+		return -ENOSPC;
+	}
+	memcpy(p, samples, payload);
+	return 0;
+}
+
+uint16_t stream_pack_i16(const void *samples, uint8_t count, uint8_t *out, uint16_t cap)
+{
+	const uint8_t *src = samples;
+	int16_t prev = 0;
+	uint16_t n = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		int16_t s = (int16_t)(src[2 * i] | (src[2 * i + 1] << 8));
+		int32_t d = (int32_t)s - prev;
+		uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+
+		prev = s;
+		do {
+			if (n >= cap) {
+				return 0;
+			}
+			out[n++] = (z >= 0x80 ? 0x80 : 0) | (z & 0x7F);
+			z >>= 7;
+		} while (z);
+	}
+	return n;
+}
+
+int stream_unpack_i16(const uint8_t *in, uint16_t len, uint8_t count, void *samples)
+{
+	uint8_t *dst = samples;
+	int16_t prev = 0;
+	uint16_t p = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		uint32_t z = 0;
+		uint8_t shift = 0;
+		uint8_t b;
+
+		do {
+			if (p >= len || shift > 14) {
+				return -EBADMSG;
+			}
+			b = in[p++];
+			z |= (uint32_t)(b & 0x7F) << shift;
+			shift += 7;
+		} while (b & 0x80);
+
+		prev = (int16_t)(prev + (int32_t)((z >> 1) ^ -(z & 1)));
+		put_le16(&dst[2 * i], (uint16_t)prev);
+	}
+	return 0;
+}
+
+static int put_delta(struct stream_buf *b, struct stream_channel *ch,
+		     uint32_t t0_us, const int16_t *samples, uint8_t count)
+{
+	/* Worst case 3 bytes per sample; pack into a scratch copy first */
+	uint8_t packed[UINT8_MAX];
+	uint16_t n = stream_pack_i16(samples, count, &packed[1], sizeof(packed) - 1);
+
+	/* Noise-like data that does not pack goes out as it is */
+	if (n == 0 || n + 1u >= 2u * count) {
+		return stream_put(b, ch, t0_us, samples, count);
+	}
+	packed[0] = count;
+
+	uint8_t *p = put_header(b, ch, STREAM_FMT_I16_DELTA, (uint8_t)(n + 1), t0_us,
+				ch->period_ns, n + 1);
+	if (!p) {
+		return -ENOSPC;
+	}
+	memcpy(p, packed, n + 1);
+	return 0;
+}
+
+static int put_decimated(struct stream_buf *b, struct stream_channel *ch,
+			 uint32_t t0_us, const int16_t *samples, uint8_t count)
+{
+	uint8_t out_count = count / STREAM_DECIMATION;
+
+	if (out_count == 0) {
+		return -EINVAL;
+	}
+
+	uint8_t *p = put_header(b, ch, STREAM_FMT_I16, out_count, t0_us,
+				ch->period_ns * STREAM_DECIMATION, 2u * out_count);
+	if (!p) {
+		return -ENOSPC;
+	}
+	/* Boxcar average: a cheap anti-alias filter ahead of the decimation */
+	for (uint8_t i = 0; i < out_count; i++) {
+		int32_t sum = 0;
+
+		for (uint8_t k = 0; k < STREAM_DECIMATION; k++) {
+			sum += samples[i * STREAM_DECIMATION + k];
+		}
+		put_le16(&p[2 * i], (uint16_t)(int16_t)(sum / STREAM_DECIMATION));
+	}
+	return 0;
+}
+
+static uint16_t isqrt32(uint32_t v)
+{
+	uint32_t r = 0;
+	uint32_t bit = 1u << 30;
+
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= r + bit) {
+			v -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint16_t)r;
+}
+
+static int put_stats(struct stream_buf *b, struct stream_channel *ch,
+		     uint32_t t0_us, const int16_t *samples, uint8_t count)
+{
+	int16_t lo = INT16_MAX;
+	int16_t hi = INT16_MIN;
+	int32_t sum = 0;
+	uint64_t sq = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		lo = samples[i] < lo ? samples[i] : lo;
+		hi = samples[i] > hi ? samples[i] : hi;
+		sum += samples[i];
+		sq += (uint64_t)((int32_t)samples[i] * samples[i]);
+	}
+
+	uint8_t *p = put_header(b, ch, STREAM_FMT_I16_STATS, 4, t0_us,
+				ch->period_ns * count, 8);
+	if (!p) {
+		return -ENOSPC;
+	}
+	put_le16(&p[0], (uint16_t)lo);
+	put_le16(&p[2], (uint16_t)hi);
+	put_le16(&p[4], (uint16_t)(int16_t)(sum / count));
+	put_le16(&p[6], isqrt32((uint32_t)(sq / count)));
+	return 0;
+}
+
+int stream_put_tier(struct stream_buf *b, struct stream_channel *ch, uint8_t tier,
+		    uint32_t t0_us, const int16_t *samples, uint8_t count)
+{
+	if (ch->format != STREAM_FMT_I16 || count == 0) {
+		return -EINVAL;
+	}
+
+	switch (tier) {
+	case STREAM_TIER_FULL:
+		return stream_put(b, ch, t0_us, samples, count);
+	case STREAM_TIER_PACKED:
+		return put_delta(b, ch, t0_us, samples, count);
+	case STREAM_TIER_DECIMATED:
+		return put_decimated(b, ch, t0_us, samples, count);
+	case STREAM_TIER_FEATURES:
+		return put_stats(b, ch, t0_us, samples, count);
+	default:
+		return -EINVAL;
+	}
+}
+
+int stream_put_tier_change(struct stream_buf *b, struct stream_channel *ctrl,
+			   uint32_t t0_us, uint8_t channel, uint8_t tier)
+{
+	uint8_t *p = put_header(b, ctrl, STREAM_FMT_BYTES, STREAM_CTRL_TIER_LEN,
+				t0_us, 0, STREAM_CTRL_TIER_LEN);
+
+	if (!p) {
+		return -ENOSPC;
+	}
+	p[0] = STREAM_CTRL_TIER;
+	p[1] = channel;
+	p[2] = tier;
+	p[3] = tier == STREAM_TIER_DECIMATED ? STREAM_DECIMATION : 1;
+	return 0;
+}
+
+int stream_put_event(struct stream_buf *b, struct stream_channel *ctrl, uint32_t t0_us,
+		     uint8_t channel, uint16_t id, uint8_t triggers, uint8_t phase,
+		     uint16_t samples)
+{
+	uint8_t *p = put_header(b, ctrl, STREAM_FMT_BYTES, STREAM_CTRL_EVENT_LEN,
+				t0_us, 0, STREAM_CTRL_EVENT_LEN);
+
+	if (!p) {
+		return -ENOSPC;
+	}
+	p[0] = STREAM_CTRL_EVENT;
+	p[1] = channel;
+	p[2] = triggers;
+	p[3] = phase;
+	put_le16(&p[4], id);
+	put_le16(&p[6], samples);
+	return 0;
+}
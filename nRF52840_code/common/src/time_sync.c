@@ -0,0 +1,61 @@
+/*
+ * Time-sync GATT service. See time_sync.h.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "time_sync.h"
+
+static struct bt_uuid_128 time_sync_svc_uuid = BT_UUID_INIT_128(TIME_SYNC_UUID_SVC_VAL);
+static struct bt_uuid_128 time_sync_char_uuid = BT_UUID_INIT_128(TIME_SYNC_UUID_CHAR_VAL);
+
+static uint32_t answered;
+
+uint32_t time_sync_now_us(void)
+{
+	return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+uint32_t time_sync_count(void)
+{
+	return answered;
+}
+
+static ssize_t write_sync(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			  const void *buf, uint16_t len, uint16_t offset,
+			  uint8_t flags)
+{
+	/* Stamp first: everything below adds to the device-side delay */
+	uint32_t t2 = time_sync_now_us();
+	const uint8_t *req = buf;
+	uint8_t rsp[TIME_SYNC_RSP_LEN];
+
+	if (offset != 0 || len != TIME_SYNC_REQ_LEN) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+	if (req[0] != TIME_SYNC_OP_REQ) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	rsp[0] = TIME_SYNC_OP_RSP;
+	rsp[1] = req[1];
+	sys_put_le16(0, &rsp[2]);
+	sys_put_le32(t2, &rsp[4]);
+	sys_put_le32(time_sync_now_us(), &rsp[8]);
+
+	/* Runs in the BT RX thread, so this only queues the reply */
+	if (bt_gatt_notify(conn, attr, rsp, sizeof(rsp)) == 0) {
+		answered++;
+	}
+	return len;
+}
+
+BT_GATT_SERVICE_DEFINE(time_sync_svc,
+	BT_GATT_PRIMARY_SERVICE(&time_sync_svc_uuid),
+	BT_GATT_CHARACTERISTIC(&time_sync_char_uuid.uuid,
+			       BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_WRITE, NULL, write_sync, NULL),
+	BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
@@ -0,0 +1,309 @@
+/*
+ * SAADC oversampling + decimation versus one adc_read() per sample.
+ *
+ * For each sensor profile this runs RUN_SECONDS of acquisition at the
+ * rate that sensor needs and prints one ACQ line:
+ *
+ *   ACQ,mode,profile,out_hz,delivered_hz,missed,cpu_pct,cycles_per_sample,
+ *       noise_lsb16,enob,mean_mv,nj_per_sample
+ *
+ * The default build uses common/saadc_acq: TIMER-triggered bursts of
+ * 14-bit conversions averaged by the SAADC, then CIC + FIR decimation of
+ * each DMA buffer. -DACQ_MODE=adc_read builds the way the other apps
+ * sample today: a kernel timer and one 12-bit adc_read() per sample. Run
+ * both builds on the same input and compare the lines.
+ *
+ * cpu_pct comes from a load probe, a lowest-priority thread that counts
+ * loop turns. It is calibrated with nothing running, so interrupt and
+ * driver time count as load. noise_lsb16 is the standard deviation in
+ * 16-bit full-scale LSBs. enob is 16 - log2(noise_lsb16 * sqrt(12)),
+ * which is meaningful with AIN0 on a quiet DC source. nj_per_sample is
+ * the energy model below, not a measurement.
+ *
+ * After the table the last profile keeps running with the probe off, so
+ * the board can be put on a current meter.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+
+#include <math.h>
+#include <stdint.h>
+
+#if defined(ACQ_MODE_ADC_READ)
+#include <zephyr/drivers/adc.h>
+#else
+#include "saadc_acq.h"
+#endif
+
+/* =========================
+ * Settings
+ * ========================= */
+
+#define RUN_SECONDS      10
+#define OUT_QUEUE_LEN    512
+
+#define CPU_HZ           DT_PROP(DT_PATH(cpus, cpu_0), clock_frequency)
+
+/*
+ * Energy model. The load probe keeps the CPU awake, so current cannot be
+ * measured while the table runs. These approximate nRF52840 figures at
+ * 3 V on the DC/DC regulator turn CPU load and SAADC duty into an
+ * estimate. Replace them with measurements from the hold phase.
+ */
+#define SUPPLY_MV        3000
+#define I_CPU_UA         3300   /* CPU running from flash at 64 MHz      */
+#define I_SAADC_UA       1000   /* SAADC converting                      */
+#define I_TIMER_UA       400    /* HFXO + 16 MHz TIMER, saadc_acq only   */
+
+/*
+ * Output rate per sensor and how it is reached. Bursts must fit in one
+ * SAMPLE period (see saadc_acq.h):
+ *
+ *   emg   2 kHz, bandwidth to ~500 Hz. 16 kHz SAMPLE, 8 conversions
+ *         (3 us acquisition: the AFE output is low impedance)
+ *   ppg   250 Hz.  4 kHz SAMPLE, 16 conversions
+ *   eis   10 Hz (sweat impedance).  640 Hz SAMPLE, 64 conversions
+ */
+struct profile {
+	const char *name;
+	uint32_t out_hz;
+	uint8_t  oversample_log2;
+	uint8_t  cic_log2;
+	uint8_t  acq_us;
+};
+
+static const struct profile profiles[] = {
+	{ "emg", 2000, 3, 2, 3 },
+	{ "ppg", 250, 4, 3, 10 },
+	{ "eis", 10, 6, 5, 10 },
+};
+
+#define HOLD_PROFILE     (&profiles[ARRAY_SIZE(profiles) - 1])
+
+struct run_result {
+	uint32_t n;
+	uint32_t missed;
+	double   mean;          /* running mean and M2 (Welford), LSB16  */
+	double   m2;
+};
+
+static void result_add(struct run_result *r, double x)
+{
+	double d = x - r->mean;
+
+	r->n++;
+	r->mean += d / r->n;
+	r->m2 += d * (x - r->mean);
+}
+
+/* =========================
+ * Load probe
+ * ========================= */
+
+static volatile uint32_t spins;
+
+static void load_probe(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		spins++;
+	}
+}
+
+K_THREAD_DEFINE(probe_tid, 512, load_probe, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+/* =========================
+ * Acquisition
+ * ========================= */
+
+#if defined(ACQ_MODE_ADC_READ)
+
+#define MODE_NAME        "adc_read"
+#define MODE_FIXED_UA    0      /* the kernel timer runs on the RTC      */
+#define ADC_BITS         12
+#define ADC_CONV_US      (10 + 2)
+
+static const struct adc_dt_spec adc_channel = ADC_DT_SPEC_GET(DT_PATH(zephyr_user));
+
+static int acq_init(void)
+{
+	return adc_is_ready_dt(&adc_channel) ? adc_channel_setup_dt(&adc_channel) : -ENODEV;
+}
+
+/* Share of the time the SAADC is converting */
+static double saadc_duty(const struct profile *p)
+{
+	return p->out_hz * (double)ADC_CONV_US / 1e6;
+}
+
+/* One conversion per timer tick, the way adc_read_threaded samples */
+static void run(const struct profile *p, uint32_t seconds, struct run_result *r)
+{
+	int16_t buf;
+	struct adc_sequence sequence = {
+		.buffer = &buf,
+		.buffer_size = sizeof(buf),
+	};
+	struct k_timer tick;
+	int64_t end = k_uptime_get() + seconds * 1000;
+
+	adc_sequence_init_dt(&adc_channel, &sequence);
+	k_timer_init(&tick, NULL, NULL);
+	k_timer_start(&tick, K_NSEC(1000000000u / p->out_hz), K_NSEC(1000000000u / p->out_hz));
+
+	while (k_uptime_get() < end) {
+		uint32_t due = k_timer_status_sync(&tick);
+
+		r->missed += due > 1 ? due - 1 : 0;
+		if (adc_read_dt(&adc_channel, &sequence) == 0) {
+			result_add(r, buf * (1 << (16 - ADC_BITS)));
+		}
+	}
+	k_timer_stop(&tick);
+}
+
+#else
+
+#define MODE_NAME        "saadc_acq"
+#define MODE_FIXED_UA    I_TIMER_UA
+#define ADC_INPUT_PIN    NRF_SAADC_INPUT_AIN0
+
+K_MSGQ_DEFINE(out_q, sizeof(int32_t), OUT_QUEUE_LEN, 4);
+
+static volatile uint32_t out_dropped;
+
+/* SAADC interrupt: pass the decimated samples to the main thread */
+static void acq_sink(void *user, const int32_t *samples, uint16_t n, uint32_t t_us)
+{
+	ARG_UNUSED(user);
+	ARG_UNUSED(t_us);
+
+	for (uint16_t i = 0; i < n; i++) {
+		if (k_msgq_put(&out_q, &samples[i], K_NO_WAIT) != 0) {
+			out_dropped++;
+		}
+	}
+}
+
+static int acq_init(void)
+{
+	return saadc_acq_init();
+}
+
+static void profile_cfg(const struct profile *p, struct saadc_acq_cfg *cfg)
+{
+	cfg->input = ADC_INPUT_PIN;
+	cfg->out_hz = p->out_hz;
+	cfg->oversample_log2 = p->oversample_log2;
+	cfg->cic_log2 = p->cic_log2;
+	cfg->acq_us = p->acq_us;
+}
+
+static double saadc_duty(const struct profile *p)
+{
+	struct saadc_acq_cfg cfg;
+
+	profile_cfg(p, &cfg);
+	return saadc_acq_conversions_hz(&cfg) * (double)(p->acq_us + SAADC_ACQ_CONV_US) / 1e6;
+}
+
+static void run(const struct profile *p, uint32_t seconds, struct run_result *r)
+{
+	struct saadc_acq_cfg cfg;
+	int64_t end = k_uptime_get() + seconds * 1000;
+	int32_t v;
+	int err;
+
+	profile_cfg(p, &cfg);
+	k_msgq_purge(&out_q);
+	out_dropped = 0;
+
+	err = saadc_acq_start(&cfg, acq_sink, NULL);
+	if (err) {
+		printk("saadc_acq_start(%s) error %d\n", p->name, err);
+		return;
+	}
+
+	while (k_uptime_get() < end) {
+		if (k_msgq_get(&out_q, &v, K_MSEC(100)) == 0) {
+			result_add(r, v);
+		}
+	}
+	saadc_acq_stop();
+	r->missed = out_dropped;
+}
+
+#endif /* ACQ_MODE_ADC_READ */
+
+/* =========================
+ * Report
+ * ========================= */
+
+static void report(const struct profile *p, const struct run_result *r,
+		   uint32_t idle_spins_per_s, uint32_t run_spins)
+{
+	double seconds = RUN_SECONDS;
+	double rate = r->n / seconds;
+	double load = MAX(0.0, 1.0 - run_spins / ((double)idle_spins_per_s * seconds));
+	double noise = r->n > 1 ? sqrt(r->m2 / (r->n - 1)) : 0.0;
+	/* Below the quantization noise of a 16-bit code there is nothing to gain */
+	double enob = noise > 0.0 ? MIN(16.0, 16.0 - log2(noise * sqrt(12.0))) : 16.0;
+	double current_ua = I_CPU_UA * load + I_SAADC_UA * saadc_duty(p) + MODE_FIXED_UA;
+
+	printk("ACQ,%s,%s,%u,%.1f,%u,%.2f,%.0f,%.2f,%.2f,%.2f,%.1f\n",
+	       MODE_NAME, p->name, p->out_hz, rate, r->missed, 100.0 * load,
+	       rate > 0 ? load * CPU_HZ / rate : 0.0, noise, enob,
+	       r->mean * 3600.0 / 65536.0,
+	       rate > 0 ? SUPPLY_MV * current_ua / rate : 0.0);
+}
+
+/* =========================
+ * Main
+ * ========================= */
+
+int main(void)
+{
+	uint32_t idle_spins_per_s;
+	int err;
+
+	printk("SAADC acquisition comparison (%s)\n", MODE_NAME);
+
+	err = acq_init();
+	if (err) {
+		printk("acquisition init error %d\n", err);
+		return 0;
+	}
+
+	/* Calibrate the load probe with nothing else running */
+	spins = 0;
+	k_sleep(K_SECONDS(1));
+	idle_spins_per_s = spins;
+
+	printk("ACQ,mode,profile,out_hz,delivered_hz,missed,cpu_pct,cycles_per_sample,"
+	       "noise_lsb16,enob,mean_mv,nj_per_sample\n");
+
+	for (size_t i = 0; i < ARRAY_SIZE(profiles); i++) {
+		struct run_result r = { 0 };
+
+		spins = 0;
+		run(&profiles[i], RUN_SECONDS, &r);
+		report(&profiles[i], &r, idle_spins_per_s, spins);
+	}
+
+	printk("Holding profile %s with the load probe off\n", HOLD_PROFILE->name);
+	k_thread_suspend(probe_tid);
+
+	while (1) {
+		struct run_result r = { 0 };
+
+		run(HOLD_PROFILE, RUN_SECONDS, &r);
+		printk("hold %s: %u samples, mean %.2f mV\n", HOLD_PROFILE->name, r.n,
+		       r.mean * 3600.0 / 65536.0);
+	}
+
+	return 0;
+}